@@ -0,0 +1,194 @@
+/******************************************
+ *
+ * Filename:    checksum_bench.c
+ *
+ * Description: Microbenchmark of the checksum implementations. Checks that
+ *              every CRC32C engine agrees with a bit-at-a-time reference
+ *              and reports the throughput of each one in GB/s for small,
+ *              MTU-sized and large buffers.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+// Standard Headers
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+// Local Headers
+#include "../include/crc.h"
+#include "../include/crc32c.h"
+
+#define BUFFER_SIZE     (1 << 20)
+#define CHECK_ROUNDS    2000
+
+static const size_t sizes[] = { 64, 1500, 65536 };
+#define N_SIZES (int)(sizeof(sizes) / sizeof(sizes[0]))
+
+static double now_s(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Bit-at-a-time CRC32C used as the reference.
+ */
+static uint32_t crc32c_bitwise(uint32_t seed, const uint8_t *data, size_t len)
+{
+    uint32_t c = ~seed;
+    for (size_t i = 0; i < len; ++i) {
+        c ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            c = (c >> 1) ^ (CRC32C_POLYNOMIAL & (0u - (c & 1u)));
+        }
+    }
+    return ~c;
+}
+
+static uint32_t crc8_adapter(uint32_t seed, const void *data, size_t len)
+{
+    (void)seed;
+    return crcFast(data, (int)len);
+}
+
+/**
+ * @brief Compares every engine with the reference on random lengths and offsets.
+ */
+static bool check_engines(const uint8_t *buffer)
+{
+    int n_engines = 0;
+    const crc32c_engine_t *engines = crc32c_engines(&n_engines);
+    bool ok = true;
+
+    // "123456789" is the standard check input of both CRCs
+    if (crcFast((const uint8_t *)"123456789", 9) != 0xF4 ||
+        crc32c_bitwise(0, (const uint8_t *)"123456789", 9) != 0xE3069283u) {
+        fprintf(stderr, "Check value of CRC-8 or CRC32C reference is wrong\n");
+        ok = false;
+    }
+
+    for (int e = 0; e < n_engines; ++e) {
+        if (!engines[e].available) {
+            continue;
+        }
+        for (int round = 0; round < CHECK_ROUNDS; ++round) {
+            size_t offset = rand() % 64;
+            size_t len = (round < 1024) ? (size_t)round : (size_t)(rand() % (16 * 1024));
+            uint32_t expected = crc32c_bitwise(0, buffer + offset, len);
+
+            // Half of the rounds continue a CRC over two calls
+            size_t split = (round & 1) ? len / 3 : len;
+            uint32_t result = engines[e].compute(0, buffer + offset, split);
+            result = engines[e].compute(result, buffer + offset + split, len - split);
+
+            if (result != expected) {
+                fprintf(stderr, "%s: length %zu offset %zu gives %08x, expected %08x\n",
+                        engines[e].name, len, offset, result, expected);
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    return ok;
+}
+
+/**
+ * @brief Runs one implementation over `total` bytes in `size` byte buffers.
+ *
+ * @return double Throughput in GB/s.
+ */
+static double measure(crc32c_fn compute, const uint8_t *buffer, size_t size, size_t total)
+{
+    size_t n_buffers = BUFFER_SIZE / size;
+    size_t rounds = total / size;
+    volatile uint32_t sink = 0;
+    uint32_t result = 0;
+
+    double start = now_s();
+    for (size_t i = 0; i < rounds; ++i) {
+        result ^= compute(0, buffer + (i % n_buffers) * size, size);
+    }
+    double elapsed = now_s() - start;
+    sink = result;
+    (void)sink;
+
+    return (double)rounds * size / elapsed / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t total_mb = 256;
+    int c = 0;
+
+    while ((c = getopt(argc, argv, "m:h")) != -1) {
+        switch (c) {
+        case 'm':
+            total_mb = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -m [megabytes per measurement]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (total_mb < 1) {
+        fprintf(stderr, "ERROR: at least 1 MB per measurement is needed\n");
+        return 1;
+    }
+
+    uint8_t *buffer = malloc(BUFFER_SIZE + 64);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < BUFFER_SIZE + 64; ++i) {
+        buffer[i] = (uint8_t)rand();
+    }
+
+    if (!check_engines(buffer)) {
+        free(buffer);
+        return 1;
+    }
+    printf("All CRC32C engines match the reference, crc32c() uses %s\n\n", crc32c_engine_name());
+
+    printf("%-22s", "Checksum");
+    for (int s = 0; s < N_SIZES; ++s) {
+        printf("%10zu B", sizes[s]);
+    }
+    printf("\n");
+
+    int n_engines = 0;
+    const crc32c_engine_t *engines = crc32c_engines(&n_engines);
+    size_t total = total_mb << 20;
+
+    // CRC-8 is a byte at a time, so it gets a smaller share of the bytes
+    printf("%-22s", "crc8");
+    for (int s = 0; s < N_SIZES; ++s) {
+        printf("%7.2f GB/s", measure(crc8_adapter, buffer, sizes[s], total / 8));
+    }
+    printf("\n");
+
+    for (int e = 0; e < n_engines; ++e) {
+        printf("crc32c %-15s", engines[e].name);
+        for (int s = 0; s < N_SIZES; ++s) {
+            if (engines[e].available) {
+                printf("%7.2f GB/s", measure(engines[e].compute, buffer, sizes[s], total));
+            }
+            else {
+                printf("%12s", "n/a");
+            }
+        }
+        printf("\n");
+    }
+
+    free(buffer);
+    return 0;
+}
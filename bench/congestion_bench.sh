@@ -0,0 +1,53 @@
+#!/bin/sh
+# Goodput of the congestion control algorithms against the server's drop
+# impairment. Every client sends the same data with every algorithm at
+# every drop probability, goodput is the data divided by the wall time of
+# the client.
+#
+# Usage: bench/congestion_bench.sh [bytes] [window] [drop probabilities...]
+
+BYTES=${1:-2000000}
+WINDOW=${2:-256}
+if [ $# -ge 2 ]; then shift 2; else shift $#; fi
+LOSSES=${*:-"0 0.1 0.2 0.3"}
+ALGORITHMS="fixed newreno cubic"
+BUILD=./build
+
+make -s $BUILD/udp-server $BUILD/gbn-client $BUILD/sr_client || exit 1
+
+now_ms() {
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+run() {
+    mode=$1
+    client=$2
+    loss=$3
+    algorithm=$4
+    $BUILD/udp-server "$mode" -r "$loss" > /tmp/udp_bench_server.log 2>&1 &
+    server=$!
+    sleep 0.3
+    start=$(now_ms)
+    $BUILD/$client -n "$BYTES" -w "$WINDOW" -c "$algorithm" > /tmp/udp_bench_client.log 2>&1
+    elapsed=$(( $(now_ms) - start ))
+    sleep 0.3
+    kill -INT $server
+    wait $server
+
+    sent=$(grep -a 'Packets sent:' /tmp/udp_bench_client.log | sed 's/.*Packets sent: \([0-9]*\).*/\1/')
+    cwnd=$(grep -a '^Congestion:' /tmp/udp_bench_client.log | sed 's/.*cwnd \([0-9.]*\).*/\1/')
+    if grep -aq "Received $BYTES bytes" /tmp/udp_bench_server.log; then
+        goodput=$(awk "BEGIN { printf \"%.1f\", $BYTES * 8 / ($elapsed > 0 ? $elapsed : 1) / 1000 }")
+    else
+        goodput="failed"
+    fi
+    printf "%-6s %-10s %-8s %8s %10s %10s %8s\n" "$loss" "$client" "$algorithm" "$elapsed" "$goodput" "$sent" "$cwnd"
+}
+
+printf "%-6s %-10s %-8s %8s %10s %10s %8s\n" "drop" "client" "cc" "ms" "Mbit/s" "packets" "cwnd"
+for loss in $LOSSES; do
+    for algorithm in $ALGORITHMS; do
+        run -g gbn-client "$loss" "$algorithm"
+        run -s sr_client "$loss" "$algorithm"
+    done
+done
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Compares the server's I/O backends on loopback: one recvfrom()/sendto()
+# per packet, recvmmsg()/sendmmsg() batches and io_uring.
+# The server's packets/s per core is the number of packets it handled
+# divided by the CPU time it used.
+#
+# Usage: bench/io_backend_bench.sh [packets] [window] [flows]
+
+PACKETS=${1:-200000}
+WINDOW=${2:-64}
+FLOWS=${3:-4}
+PORT=6690
+BUILD=./build
+
+make -s $BUILD/udp-server $BUILD/udp-flood || exit 1
+
+run() {
+    name=$1
+    shift
+    $BUILD/udp-server -x 2.2 -p $PORT "$@" > /tmp/udp_bench_server.log 2>&1 &
+    server=$!
+    sleep 0.3
+    flood=$($BUILD/udp-flood -p $PORT -n "$PACKETS" -w "$WINDOW" -f "$FLOWS")
+    kill -INT $server
+    wait $server
+    printf "%-10s %s\n" "$name" "$(grep -a '^Server:' /tmp/udp_bench_server.log)"
+    printf "%-10s %s\n" "" "$flood"
+}
+
+run "single"
+run "batch-32" -b 32
+run "io_uring" -u
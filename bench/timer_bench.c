@@ -0,0 +1,136 @@
+/******************************************
+ *
+ * Filename:    timer_bench.c
+ *
+ * Description: Microbenchmark of the timing wheel. Arms millions of
+ *              retransmission-like timers, re-arms them as ACKs would and
+ *              advances the wheel until every timer has fired, checking
+ *              that none fires early or late.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+// Standard Headers
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+// Local Headers
+#include "../include/timer_wheel.h"
+
+#define MAX_TIMEOUT_US  2000000     /* Longest timeout armed, the default max RTO */
+#define ADVANCE_STEP_US 1000        /* Simulated time between advances */
+
+typedef struct {
+    uint64_t fired;
+    uint64_t errors;
+    uint64_t now_us;
+} bench_state_t;
+
+static double now_s(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * @brief Counts a fired timer, it must be due and at most one step late.
+ */
+static void on_expire(timer_node_t *timer, void *ctx)
+{
+    bench_state_t *state = ctx;
+
+    if (timer->expires_us > state->now_us || timer->expires_us + ADVANCE_STEP_US <= state->now_us) {
+        state->errors++;
+    }
+    state->fired++;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t n_timers = 1000000;
+    int c = 0;
+
+    while ((c = getopt(argc, argv, "n:h")) != -1) {
+        switch (c) {
+        case 'n':
+            n_timers = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -n [timers]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (n_timers < 1) {
+        fprintf(stderr, "ERROR: at least one timer is needed\n");
+        return 1;
+    }
+
+    timer_wheel_t *wheel = malloc(sizeof(*wheel));
+    timer_node_t *timers = calloc(n_timers, sizeof(*timers));
+    if (!wheel || !timers) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(wheel);
+        free(timers);
+        return 1;
+    }
+
+    bench_state_t state = { .now_us = 1000000 };
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    timer_wheel_init(wheel, state.now_us);
+
+    // Arm every timer
+    double start = now_s();
+    for (size_t i = 0; i < n_timers; ++i) {
+        timer_wheel_add(wheel, &timers[i], state.now_us + 1 + next_random(&seed) % MAX_TIMEOUT_US);
+    }
+    double add_s = now_s() - start;
+
+    // Re-arm every timer as an ACK followed by a new send would
+    start = now_s();
+    for (size_t i = 0; i < n_timers; ++i) {
+        timer_wheel_cancel(wheel, &timers[i]);
+        timer_wheel_add(wheel, &timers[i], state.now_us + 1 + next_random(&seed) % MAX_TIMEOUT_US);
+    }
+    double rearm_s = now_s() - start;
+
+    // Advance in steps until every timer has fired
+    size_t advances = 0;
+    start = now_s();
+    while (wheel->count) {
+        state.now_us += ADVANCE_STEP_US;
+        timer_wheel_advance(wheel, state.now_us, on_expire, &state);
+        advances++;
+    }
+    double advance_s = now_s() - start;
+
+    printf("%zu timers, up to %d ms ahead\n", n_timers, MAX_TIMEOUT_US / 1000);
+    printf("%-10s %8.1f ns per timer\n", "add", add_s * 1e9 / n_timers);
+    printf("%-10s %8.1f ns per timer\n", "re-arm", rearm_s * 1e9 / n_timers);
+    printf("%-10s %8.1f ns per timer, %zu advances\n", "expire", advance_s * 1e9 / n_timers, advances);
+
+    bool ok = state.fired == n_timers && state.errors == 0;
+    if (!ok) {
+        fprintf(stderr, "ERROR: %" PRIu64 " of %zu timers fired, %" PRIu64 " at the wrong time\n",
+                state.fired, n_timers, state.errors);
+    }
+
+    free(timers);
+    free(wheel);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,571 @@
+/******************************************
+ *
+ * Filename:    udp_bench.c
+ *
+ * Description: Loopback benchmark driver. Starts the server in every mode,
+ *              pushes a volume of data through it with the matching client
+ *              at every window size and drop probability, and writes the
+ *              goodput, packet rate, CPU per packet, retransmission ratio
+ *              and completion time of every run as JSON.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#define _GNU_SOURCE
+
+// Standard Headers
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// System Headers
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+
+// Local Headers
+#include "../include/codec.h"
+
+#define DEFAULT_BUILD_DIR   "./build"
+#define DEFAULT_MODES       "rdt20,rdt21,rdt22,rdt30,gbn,sr"
+#define DEFAULT_SIZES       "1M,16M"
+#define DEFAULT_WINDOWS     "64,256"
+#define DEFAULT_LOSSES      "0,0.01"
+#define DEFAULT_TIMEOUT_S   300         /* A client still running after this is killed and the run failed */
+#define MAX_VALUES          16          /* Entries of one comma separated list */
+#define SERVER_START_MS     300         /* Time the server gets to bind its port */
+#define SERVER_DRAIN_MS     100         /* Time the server gets to handle the datagrams still queued */
+#define SERVER_STOP_MS      5000        /* Time the server gets to print its counters after SIGINT */
+#define POLL_MS             5           /* Interval of the client exit checks */
+
+/**
+ * @brief A server mode and the client that loads it.
+ *
+ * RDT has no data client, udp-flood keeps a window of RDT packets in
+ * flight instead. It sends the volume in frames of CODEC_MAX_PAYLOAD bytes
+ * like GBN and SR, but without retransmissions there is no goodput.
+ */
+typedef struct {
+    const char *name;           /**< Name in the mode list and the JSON. */
+    const char *server_mode;    /**< Server option selecting the mode. */
+    const char *rdt_version;    /**< Argument of -x, or NULL. */
+    const char *client;         /**< Client program. */
+} bench_mode_t;
+
+static const bench_mode_t bench_modes[] = {
+    { "rdt20", "-x", "2.0", "udp-flood" },
+    { "rdt21", "-x", "2.1", "udp-flood" },
+    { "rdt22", "-x", "2.2", "udp-flood" },
+    { "rdt30", "-x", "3.0", "udp-flood" },
+    { "gbn",   "-g", NULL,  "gbn-client" },
+    { "sr",    "-s", NULL,  "sr_client" },
+};
+
+#define N_MODES (sizeof(bench_modes) / sizeof(bench_modes[0]))
+
+/**
+ * @brief Settings and measurements of one run.
+ */
+typedef struct {
+    const bench_mode_t *mode;   /**< Server mode and client. */
+    unsigned long bytes;        /**< Volume pushed through the server. */
+    unsigned int window;        /**< Window of the client in packets. */
+    double loss;                /**< Drop probability of the server. */
+    bool ok;                    /**< Client finished, with the data intact (GBN, SR) or every handled datagram answered (RDT). */
+    double completion_s;        /**< Wall time of the client. */
+    unsigned long sent;         /**< Datagrams the client sent. */
+    unsigned long needed;       /**< Datagrams the volume takes without retransmissions. */
+    unsigned long lost;         /**< RDT datagrams that never reached the server, dropped by the socket buffers. */
+    unsigned long server_packets; /**< Datagrams the server handled. */
+    double server_cpu_s;        /**< CPU time of the server process. */
+    double client_cpu_s;        /**< CPU time of the client process. */
+    double srtt_ms;             /**< Smoothed RTT at the end, GBN and SR. */
+    double min_rtt_ms;          /**< Smallest RTT sample, GBN and SR. */
+} bench_result_t;
+
+int run_bench(const char *build_dir, bench_result_t *result, unsigned int timeout_s);
+pid_t spawn(char *const argv[], const char *output_path);
+int wait_child(pid_t pid, unsigned int timeout_ms, int *status, double *cpu_s);
+char *read_file(const char *path);
+int parse_list(const char *list, const char *values[], int max_values, char *buffer, size_t buffer_size);
+unsigned long parse_size(const char *text);
+void write_result(FILE *out, const bench_result_t *result, bool first);
+void write_json_string(FILE *out, const char *text);
+
+static uint64_t now_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *build_dir = DEFAULT_BUILD_DIR;
+    const char *mode_list = DEFAULT_MODES;
+    const char *size_list = DEFAULT_SIZES;
+    const char *window_list = DEFAULT_WINDOWS;
+    const char *loss_list = DEFAULT_LOSSES;
+    const char *output = NULL;
+    const char *label = "";
+    unsigned int timeout_s = DEFAULT_TIMEOUT_S;
+    int c = 0;
+
+    while ((c = getopt(argc, argv, "B:m:n:w:r:o:L:t:h")) != -1) {
+        switch (c) {
+        case 'B':
+            // Directory of the server and client programs
+            build_dir = optarg;
+            break;
+        case 'm':
+            // Server modes
+            mode_list = optarg;
+            break;
+        case 'n':
+            // Volumes, with K, M or G
+            size_list = optarg;
+            break;
+        case 'w':
+            // Windows in packets
+            window_list = optarg;
+            break;
+        case 'r':
+            // Drop probabilities of the server
+            loss_list = optarg;
+            break;
+        case 'o':
+            // JSON file
+            output = optarg;
+            break;
+        case 'L':
+            // Label of the build, e.g. the commit
+            label = optarg;
+            break;
+        case 't':
+            // Longest run of a client in seconds
+            timeout_s = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -m [modes] -n [sizes] -w [windows] -r [drop_probabilities] "
+                    "-o [json_file] -L [label] -t [timeout_s] -B [build_dir]\n", argv[0]);
+            fprintf(stderr, "Lists are comma separated, modes: %s, sizes take K, M or G\n", DEFAULT_MODES);
+            return 1;
+        }
+    }
+
+    const char *modes[MAX_VALUES], *sizes[MAX_VALUES], *windows[MAX_VALUES], *losses[MAX_VALUES];
+    char mode_buffer[256], size_buffer[256], window_buffer[256], loss_buffer[256];
+    int n_modes = parse_list(mode_list, modes, MAX_VALUES, mode_buffer, sizeof(mode_buffer));
+    int n_sizes = parse_list(size_list, sizes, MAX_VALUES, size_buffer, sizeof(size_buffer));
+    int n_windows = parse_list(window_list, windows, MAX_VALUES, window_buffer, sizeof(window_buffer));
+    int n_losses = parse_list(loss_list, losses, MAX_VALUES, loss_buffer, sizeof(loss_buffer));
+    if (n_modes < 1 || n_sizes < 1 || n_windows < 1 || n_losses < 1) {
+        fprintf(stderr, "ERROR: every list needs 1 to %d values\n", MAX_VALUES);
+        return 1;
+    }
+
+    // Check the whole matrix before the first run
+    const bench_mode_t *selected[MAX_VALUES];
+    for (int m = 0; m < n_modes; ++m) {
+        selected[m] = NULL;
+        for (size_t k = 0; k < N_MODES; ++k) {
+            if (strcmp(modes[m], bench_modes[k].name) == 0) {
+                selected[m] = &bench_modes[k];
+            }
+        }
+        if (!selected[m]) {
+            fprintf(stderr, "ERROR: unknown mode %s, modes are %s\n", modes[m], DEFAULT_MODES);
+            return 1;
+        }
+    }
+    for (int s = 0; s < n_sizes; ++s) {
+        if (parse_size(sizes[s]) == 0) {
+            fprintf(stderr, "ERROR: invalid size %s\n", sizes[s]);
+            return 1;
+        }
+    }
+    for (int w = 0; w < n_windows; ++w) {
+        if (atoi(windows[w]) < 1 || atoi(windows[w]) > 1024) {
+            fprintf(stderr, "ERROR: windows must be between 1 and 1024\n");
+            return 1;
+        }
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "ERROR: %s not created. (%d)\n", output, errno);
+        return 1;
+    }
+
+    char timestamp[32];
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(out, "{\n  \"label\": ");
+    write_json_string(out, label);
+    fprintf(out, ",\n  \"timestamp\": \"%s\",\n  \"cpus\": %ld,\n  \"runs\": [\n",
+            timestamp, sysconf(_SC_NPROCESSORS_ONLN));
+
+    fprintf(stderr, "%-6s %10s %6s %6s %4s %10s %10s %12s %8s %8s %10s\n", "mode", "bytes", "window", "drop",
+            "ok", "seconds", "Mbit/s", "packets/s", "retx", "lost", "us/packet");
+
+    int failed = 0;
+    bool first = true;
+    for (int m = 0; m < n_modes; ++m) {
+        for (int s = 0; s < n_sizes; ++s) {
+            for (int w = 0; w < n_windows; ++w) {
+                for (int l = 0; l < n_losses; ++l) {
+                    bench_result_t result = {
+                        .mode = selected[m],
+                        .bytes = parse_size(sizes[s]),
+                        .window = atoi(windows[w]),
+                        .loss = atof(losses[l]),
+                    };
+
+                    if (run_bench(build_dir, &result, timeout_s) < 0) {
+                        fclose(out);
+                        return 1;
+                    }
+                    failed += result.ok ? 0 : 1;
+                    write_result(out, &result, first);
+                    first = false;
+
+                    bool rdt = result.mode->rdt_version != NULL;
+                    double seconds = result.completion_s > 0 ? result.completion_s : 1e-9;
+                    unsigned long retransmitted = result.sent > result.needed ? result.sent - result.needed : 0;
+                    fprintf(stderr, "%-6s %10lu %6u %6.3f %4s %10.3f %10.1f %12.0f %8.4f %8lu %10.2f\n",
+                            result.mode->name, result.bytes, result.window, result.loss, result.ok ? "yes" : "no",
+                            result.completion_s, rdt ? 0.0 : result.bytes * 8 / seconds / 1e6, result.sent / seconds,
+                            rdt || result.sent == 0 ? 0.0 : (double)retransmitted / result.sent, result.lost,
+                            result.server_packets ? result.server_cpu_s * 1e6 / result.server_packets : 0.0);
+                }
+            }
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) {
+        fclose(out);
+        fprintf(stderr, "Results: %s\n", output);
+    }
+    if (failed > 0) {
+        fprintf(stderr, "%d runs failed\n", failed);
+    }
+
+    return failed > 0 ? 1 : 0;
+} /* main() */
+
+/**
+ * @brief Starts the server, runs the client against it and collects both outputs.
+ *
+ * @param build_dir Directory of the programs.
+ * @param result Run with the mode, volume, window and loss, filled with the measurements.
+ * @param timeout_s Longest run of the client.
+ * @return int `0` when the run was measured, failed or not, `-1` if a program could not be started.
+ */
+int run_bench(const char *build_dir, bench_result_t *result, unsigned int timeout_s)
+{
+    const bench_mode_t *mode = result->mode;
+    char server_path[512], client_path[512], loss[32], bytes[32], window[32], payload[32];
+    char server_log[] = "/tmp/udp_bench_server_XXXXXX";
+    char client_log[] = "/tmp/udp_bench_client_XXXXXX";
+    int status = 0;
+
+    int server_fd = mkstemp(server_log);
+    int client_fd = mkstemp(client_log);
+    if (server_fd < 0 || client_fd < 0) {
+        fprintf(stderr, "ERROR: mkstemp() failed. (%d)\n", errno);
+        return -1;
+    }
+    close(server_fd);
+    close(client_fd);
+
+    result->needed = (result->bytes + CODEC_MAX_PAYLOAD - 1) / CODEC_MAX_PAYLOAD;
+    snprintf(server_path, sizeof(server_path), "%s/udp-server", build_dir);
+    snprintf(client_path, sizeof(client_path), "%s/%s", build_dir, mode->client);
+    snprintf(loss, sizeof(loss), "%g", result->loss);
+    snprintf(bytes, sizeof(bytes), "%lu", result->bytes);
+    snprintf(window, sizeof(window), "%u", result->window);
+    snprintf(payload, sizeof(payload), "%d", CODEC_MAX_PAYLOAD);
+
+    char *server_argv[8];
+    int n_args = 0;
+    server_argv[n_args++] = server_path;
+    server_argv[n_args++] = (char *)mode->server_mode;
+    if (mode->rdt_version) {
+        server_argv[n_args++] = (char *)mode->rdt_version;
+    }
+    server_argv[n_args++] = "-r";
+    server_argv[n_args++] = loss;
+    server_argv[n_args] = NULL;
+
+    char *flood_argv[] = { client_path, "-b", bytes, "-s", payload, "-w", window, NULL };
+    char *client_argv[] = { client_path, "-n", bytes, "-w", window, NULL };
+
+    pid_t server = spawn(server_argv, server_log);
+    if (server < 0) {
+        return -1;
+    }
+    usleep(SERVER_START_MS * 1000);
+
+    uint64_t start_us = now_us();
+    pid_t client = spawn(mode->rdt_version ? flood_argv : client_argv, client_log);
+    if (client < 0) {
+        kill(server, SIGKILL);
+        waitpid(server, NULL, 0);
+        return -1;
+    }
+    bool client_done = wait_child(client, timeout_s * 1000, &status, &result->client_cpu_s) == 0;
+    result->completion_s = (now_us() - start_us) / 1e6;
+    bool client_ok = client_done && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    usleep(SERVER_DRAIN_MS * 1000);
+    kill(server, SIGINT);
+    int server_status = 0;
+    wait_child(server, SERVER_STOP_MS, &server_status, &result->server_cpu_s);
+
+    char *server_text = read_file(server_log);
+    char *client_text = read_file(client_log);
+    unlink(server_log);
+    unlink(client_log);
+    if (!server_text || !client_text) {
+        free(server_text);
+        free(client_text);
+        return 0;
+    }
+
+    const char *server_line = strstr(server_text, "Server: ");
+    if (server_line) {
+        sscanf(server_line, "Server: %lu packets", &result->server_packets);
+    }
+    const char *line = NULL;
+
+    if (mode->rdt_version) {
+        // Every datagram the server handled must be answered, a dropped one as corrupted.
+        // RDT 2.0 and 2.1 send a NAK twice, so the flood's own loss count is not exact.
+        unsigned long acked = 0;
+        line = strstr(client_text, "Flood: ");
+        if (line) {
+            sscanf(line, "Flood: %*d flows | %lu sent | %lu acked", &result->sent, &acked);
+        }
+        result->lost = (result->sent > result->server_packets) ? result->sent - result->server_packets : 0;
+        result->ok = client_ok && line && server_line && result->sent == result->needed &&
+                     result->server_packets <= result->sent && acked >= result->server_packets;
+    }
+    else {
+        // The server must have delivered the client's data, checked by size and CRC32C
+        unsigned long sent_bytes = 0, received_bytes = 0;
+        unsigned int sent_crc = 0, received_crc = 1;
+        if ((line = strstr(client_text, "Packets sent: "))) {
+            sscanf(line, "Packets sent: %lu", &result->sent);
+        }
+        if ((line = strstr(client_text, "Data sent: "))) {
+            sscanf(line, "Data sent: %lu bytes | CRC32C %x", &sent_bytes, &sent_crc);
+        }
+        if ((line = strstr(client_text, "RTT: smoothed "))) {
+            sscanf(line, "RTT: smoothed %lf ms | variation %*f ms | min %lf ms", &result->srtt_ms, &result->min_rtt_ms);
+        }
+        if ((line = strstr(server_text, "Received "))) {
+            sscanf(line, "Received %lu bytes | CRC32C %x", &received_bytes, &received_crc);
+        }
+        result->ok = client_ok && sent_bytes == result->bytes && received_bytes == sent_bytes && received_crc == sent_crc;
+    }
+
+    free(server_text);
+    free(client_text);
+
+    return 0;
+} /* run_bench() */
+
+/**
+ * @brief Starts a program with its stdout and stderr in a file.
+ *
+ * @return pid_t The child, or -1 if fork() failed.
+ */
+pid_t spawn(char *const argv[], const char *output_path)
+{
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        int fd = open(output_path, O_WRONLY | O_TRUNC);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execv(argv[0], argv);
+        fprintf(stderr, "execv(%s) failed. (%d)\n", argv[0], errno);
+        _exit(127);
+    }
+    if (pid < 0) {
+        fprintf(stderr, "ERROR: fork() failed. (%d)\n", errno);
+    }
+
+    return pid;
+} /* spawn() */
+
+/**
+ * @brief Waits for a child, kills it after the timeout, and takes its CPU time.
+ *
+ * @param pid The child.
+ * @param timeout_ms Time the child gets to exit.
+ * @param[out] status Exit status from wait4().
+ * @param[out] cpu_s User and system CPU time of the child.
+ * @return int `0` if the child exited in time, `-1` if it was killed.
+ */
+int wait_child(pid_t pid, unsigned int timeout_ms, int *status, double *cpu_s)
+{
+    struct rusage usage;
+    uint64_t deadline_us = now_us() + timeout_ms * 1000ULL;
+    int result = 0;
+
+    while (wait4(pid, status, WNOHANG, &usage) == 0) {
+        if (now_us() >= deadline_us) {
+            kill(pid, SIGKILL);
+            wait4(pid, status, 0, &usage);
+            result = -1;
+            break;
+        }
+        usleep(POLL_MS * 1000);
+    }
+
+    *cpu_s = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+             (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+
+    return result;
+} /* wait_child() */
+
+/**
+ * @brief Reads a whole file into a terminated buffer.
+ *
+ * @return char* The contents, freed by the caller, or NULL on error.
+ */
+char *read_file(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *text = malloc(size + 1);
+    if (text) {
+        size_t n = fread(text, 1, size, file);
+        text[n] = '\0';
+    }
+    fclose(file);
+
+    return text;
+} /* read_file() */
+
+/**
+ * @brief Splits a comma separated list.
+ *
+ * @return int Number of values, or -1 if the list does not fit.
+ */
+int parse_list(const char *list, const char *values[], int max_values, char *buffer, size_t buffer_size)
+{
+    int count = 0;
+
+    if (strlen(list) >= buffer_size) {
+        return -1;
+    }
+    strcpy(buffer, list);
+
+    for (char *value = strtok(buffer, ","); value; value = strtok(NULL, ",")) {
+        if (count == max_values) {
+            return -1;
+        }
+        values[count++] = value;
+    }
+
+    return count;
+} /* parse_list() */
+
+/**
+ * @brief Parses a size in bytes with an optional K, M or G (powers of 1024).
+ *
+ * @return unsigned long The size, or 0 if invalid.
+ */
+unsigned long parse_size(const char *text)
+{
+    char *end = NULL;
+    unsigned long size = strtoul(text, &end, 10);
+
+    switch (*end) {
+    case 'K': case 'k':
+        size <<= 10;
+        end++;
+        break;
+    case 'M': case 'm':
+        size <<= 20;
+        end++;
+        break;
+    case 'G': case 'g':
+        size <<= 30;
+        end++;
+        break;
+    }
+
+    return (*end == '\0') ? size : 0;
+} /* parse_size() */
+
+/**
+ * @brief Writes one run as a JSON object, null for what the mode does not measure.
+ */
+void write_result(FILE *out, const bench_result_t *result, bool first)
+{
+    bool rdt = result->mode->rdt_version != NULL;
+    double seconds = result->completion_s > 0 ? result->completion_s : 1e-9;
+    unsigned long retransmitted = result->sent > result->needed ? result->sent - result->needed : 0;
+
+    fprintf(out, "%s    {\"mode\": \"%s\", \"bytes\": %lu, \"window\": %u, \"loss\": %g, \"ok\": %s, "
+            "\"completion_s\": %.6f, \"packets_sent\": %lu, \"packets_per_s\": %.1f, ",
+            first ? "" : ",\n", result->mode->name, result->bytes, result->window, result->loss,
+            result->ok ? "true" : "false", result->completion_s, result->sent, result->sent / seconds);
+
+    if (rdt) {
+        fprintf(out, "\"goodput_mbps\": null, \"retransmission_ratio\": null, \"packets_lost\": %lu, "
+                "\"srtt_ms\": null, \"min_rtt_ms\": null, ", result->lost);
+    }
+    else {
+        fprintf(out, "\"goodput_mbps\": %.3f, \"retransmission_ratio\": %.6f, \"packets_lost\": null, "
+                "\"srtt_ms\": %.3f, \"min_rtt_ms\": %.3f, ",
+                result->ok ? result->bytes * 8 / seconds / 1e6 : 0.0,
+                result->sent ? (double)retransmitted / result->sent : 0.0, result->srtt_ms, result->min_rtt_ms);
+    }
+
+    fprintf(out, "\"server_packets\": %lu, \"server_cpu_s\": %.6f, \"client_cpu_s\": %.6f, "
+            "\"server_cpu_us_per_packet\": %.4f, \"client_cpu_us_per_packet\": %.4f}",
+            result->server_packets, result->server_cpu_s, result->client_cpu_s,
+            result->server_packets ? result->server_cpu_s * 1e6 / result->server_packets : 0.0,
+            result->sent ? result->client_cpu_s * 1e6 / result->sent : 0.0);
+} /* write_result() */
+
+/**
+ * @brief Writes a quoted JSON string, escaping quotes, backslashes and control characters.
+ */
+void write_json_string(FILE *out, const char *text)
+{
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        }
+        else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        }
+        else fputc(*c, out);
+    }
+    fputc('"', out);
+} /* write_json_string() */
@@ -0,0 +1,259 @@
+/******************************************
+ *
+ * Filename:    udp_flood.c
+ *
+ * Description: Load generator for the UDP server. Keeps a window of valid
+ *              RDT 2.2 packets in flight on one or more flows and counts
+ *              the ACKs, so the server can be measured under full load.
+ *              Frames carry one byte, or a volume is sent in frames of up
+ *              to CODEC_MAX_PAYLOAD bytes.
+ *              Start the server with `-x 2.2` and its output discarded.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#define _GNU_SOURCE
+
+// Standard Headers
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// Networking Headers
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+// Local Headers
+#include "../include/crc.h"
+#include "../include/codec.h"
+
+#define ISVALIDSOCKET(s)    ((s) >= 0)
+#define CLOSESOCKET(s)      close(s)
+#define SOCKET              int
+#define GETSOCKETERRNO()    (errno)
+
+#define SERVER_IP           "127.0.0.1"
+#define DEFAULT_PORT        "6666"
+#define MAX_FLOWS           256
+#define BURST               64          /* Datagrams per sendmmsg()/recvmmsg() */
+#define STALL_MS            200         /* Outstanding packets are counted lost after this */
+
+/**
+ * @brief One client flow, a connected UDP socket with its own source port.
+ */
+typedef struct {
+    SOCKET socket;
+    unsigned long sent;
+    unsigned long acked;
+    unsigned long lost;
+    long outstanding;
+} flow_t;
+
+static uint64_t now_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int main(int argc, char *argv[])
+{
+    char *host = SERVER_IP;
+    char *port = DEFAULT_PORT;
+    unsigned long n_packets = 100000;
+    unsigned long n_bytes = 0;
+    long payload = 1;
+    long window = 32;
+    int n_flows = 1;
+    int c = 0;
+
+    while ((c = getopt(argc, argv, "a:p:n:b:s:w:f:h")) != -1) {
+        switch (c) {
+        case 'a':
+            host = optarg;
+            break;
+        case 'p':
+            port = optarg;
+            break;
+        case 'n':
+            n_packets = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            // A volume sets the packet count, the last frame carries the rest
+            n_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            payload = atol(optarg);
+            break;
+        case 'w':
+            window = atol(optarg);
+            break;
+        case 'f':
+            n_flows = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -a [address] -p [port] -n [packets] -b [bytes] -s [payload] -w [window per flow] -f [flows]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (payload < 1 || payload > CODEC_MAX_PAYLOAD) {
+        fprintf(stderr, "ERROR: payload must be 1-%d bytes\n", CODEC_MAX_PAYLOAD);
+        return 1;
+    }
+    if (n_bytes > 0) {
+        n_packets = (n_bytes + payload - 1) / payload;
+    }
+    if (n_flows < 1 || n_flows > MAX_FLOWS || window < 1 || window > BURST * 16) {
+        fprintf(stderr, "ERROR: flows must be 1-%d and window 1-%d\n", MAX_FLOWS, BURST * 16);
+        return 1;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *peer_address;
+    if (getaddrinfo(host, port, &hints, &peer_address)) {
+        fprintf(stderr, "getaddrinfo() failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+
+    static flow_t flows[MAX_FLOWS];
+    static struct pollfd fds[MAX_FLOWS];
+    for (int f = 0; f < n_flows; ++f) {
+        flows[f].socket = socket(peer_address->ai_family, peer_address->ai_socktype, peer_address->ai_protocol);
+        if (!ISVALIDSOCKET(flows[f].socket) ||
+            connect(flows[f].socket, peer_address->ai_addr, peer_address->ai_addrlen)) {
+            fprintf(stderr, "socket() or connect() failed. (%d)\n", GETSOCKETERRNO());
+            return 1;
+        }
+        fds[f].fd = flows[f].socket;
+        fds[f].events = POLLIN;
+    }
+    freeaddrinfo(peer_address);
+
+    // RDT 2.2 data packet: SEQ | DATA | CRC, the server ACKs every one of them
+    static char packet[CODEC_MAX_PAYLOAD + 2];
+    static char last_packet[CODEC_MAX_PAYLOAD + 2];
+    long last_payload = (n_bytes > 0) ? (long)(n_bytes - (n_packets - 1) * payload) : payload;
+    memset(packet, 'x', sizeof(packet));
+    memset(last_packet, 'x', sizeof(last_packet));
+    packet[0] = 0;
+    last_packet[0] = 0;
+    packet[payload + 1] = crcFast((uint8_t *)packet, payload + 1);
+    last_packet[last_payload + 1] = crcFast((uint8_t *)last_packet, last_payload + 1);
+
+    struct mmsghdr msgs[BURST];
+    struct iovec iov[BURST];
+    char ack_buf[BURST][64];
+    memset(msgs, 0, sizeof(msgs));
+
+    unsigned long total_sent = 0;
+    unsigned long total_acked = 0;
+    unsigned long total_lost = 0;
+    uint64_t start_us = now_us();
+    uint64_t last_progress_us = start_us;
+
+    while (total_acked + total_lost < n_packets) {
+        // Fill every flow's window
+        for (int f = 0; f < n_flows && total_sent < n_packets; ++f) {
+            long room = window - flows[f].outstanding;
+            if (room > BURST) {
+                room = BURST;
+            }
+            if ((unsigned long)room > n_packets - total_sent) {
+                room = n_packets - total_sent;
+            }
+            if (room < 1) {
+                continue;
+            }
+            for (long i = 0; i < room; ++i) {
+                bool last = (total_sent + i == n_packets - 1);
+                iov[i].iov_base = last ? last_packet : packet;
+                iov[i].iov_len = (last ? last_payload : payload) + 2;
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                msgs[i].msg_hdr.msg_name = NULL;
+                msgs[i].msg_hdr.msg_namelen = 0;
+            }
+            int sent = sendmmsg(flows[f].socket, msgs, room, 0);
+            if (sent > 0) {
+                flows[f].sent += sent;
+                flows[f].outstanding += sent;
+                total_sent += sent;
+            }
+        }
+
+        int n_ready = poll(fds, n_flows, STALL_MS);
+        if (n_ready < 0 && errno != EINTR) {
+            fprintf(stderr, "poll() failed. (%d)\n", GETSOCKETERRNO());
+            break;
+        }
+
+        for (int f = 0; f < n_flows && n_ready > 0; ++f) {
+            if (!(fds[f].revents & POLLIN)) {
+                continue;
+            }
+            for (int i = 0; i < BURST; ++i) {
+                iov[i].iov_base = ack_buf[i];
+                iov[i].iov_len = sizeof(ack_buf[i]);
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int received = recvmmsg(flows[f].socket, msgs, BURST, MSG_DONTWAIT, NULL);
+
+            // RDT 2.2 and 3.0 send an empty datagram ahead of a NAK, it answers nothing
+            for (int i = 0, n = received; i < n; ++i) {
+                received -= (msgs[i].msg_len == 0) ? 1 : 0;
+            }
+            if (received > 0) {
+                flows[f].acked += received;
+                flows[f].outstanding -= received;
+                if (flows[f].outstanding < 0) {
+                    flows[f].outstanding = 0;
+                }
+                total_acked += received;
+                last_progress_us = now_us();
+            }
+        }
+
+        // Packets dropped by the socket buffers would stall the window forever
+        if (now_us() - last_progress_us > STALL_MS * 1000) {
+            for (int f = 0; f < n_flows; ++f) {
+                flows[f].lost += flows[f].outstanding;
+                total_lost += flows[f].outstanding;
+                flows[f].outstanding = 0;
+            }
+            last_progress_us = now_us();
+        }
+    }
+
+    double elapsed_s = (now_us() - start_us) / 1e6;
+    unsigned long acked = 0;
+    unsigned long lost = 0;
+    for (int f = 0; f < n_flows; ++f) {
+        acked += flows[f].acked;
+        lost += flows[f].lost;
+        CLOSESOCKET(flows[f].socket);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double cpu_s = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                   (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+
+    printf("Flood: %d flows | %lu sent | %lu acked | %lu lost | %.2f s | %.0f ACKs/s | client CPU %.2f s\n",
+            n_flows, total_sent, acked, lost, elapsed_s, elapsed_s > 0 ? acked / elapsed_s : 0.0, cpu_s);
+
+    return 0;
+} /* main() */
@@ -0,0 +1,43 @@
+#!/bin/sh
+# Measures how the server scales with SO_REUSEPORT workers on loopback.
+# For every worker count from 1 to N the server runs with that many pinned
+# workers and the same number of udp-flood processes, each with several
+# flows so the kernel spreads them over all the worker sockets.
+#
+# Usage: bench/worker_scaling_bench.sh [max_workers] [packets] [window] [flows]
+
+MAX_WORKERS=${1:-$(nproc)}
+PACKETS=${2:-200000}
+WINDOW=${3:-16}
+FLOWS=${4:-16}
+PORT=6691
+BUILD=./build
+
+make -s $BUILD/udp-server $BUILD/udp-flood || exit 1
+
+workers=1
+while [ "$workers" -le "$MAX_WORKERS" ]; do
+    $BUILD/udp-server -x 2.2 -p $PORT -b 32 -w "$workers" -c > /tmp/udp_scaling_server.log 2>&1 &
+    server=$!
+    sleep 0.3
+
+    # One load generator per worker, each sends its share of the packets
+    i=0
+    floods=""
+    while [ "$i" -lt "$workers" ]; do
+        $BUILD/udp-flood -p $PORT -n $((PACKETS / workers)) -w "$WINDOW" -f "$FLOWS" > /tmp/udp_scaling_flood.$i &
+        floods="$floods $!"
+        i=$((i + 1))
+    done
+    wait $floods
+
+    kill -INT $server
+    wait $server
+
+    acks=$(cat /tmp/udp_scaling_flood.* | awk '{ for (f = 1; f < NF; ++f) if ($(f + 1) == "ACKs/s") sum += $f } END { printf "%.0f", sum }')
+    printf "%2d workers  %s | Clients: %s ACKs/s\n" "$workers" "$(grep -a '^Server:' /tmp/udp_scaling_server.log)" "$acks"
+    grep -a '^Worker [0-9]' /tmp/udp_scaling_server.log | sed 's/^/            /'
+    rm -f /tmp/udp_scaling_flood.*
+
+    workers=$((workers + 1))
+done
@@ -0,0 +1,84 @@
+/******************************************************************************
+  * @file           : bitmap.h
+  * @brief          : Bit arrays of 64-bit words used by the protocol windows
+******************************************************************************/
+
+#ifndef __BITMAP_H__
+#define __BITMAP_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BITMAP_WORDS(bits)  (((size_t)(bits) + 63) / 64)    /* Words needed for a number of bits */
+
+static inline bool bitmap_test(const uint64_t *map, uint32_t bit)
+{
+    return (map[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static inline void bitmap_set(uint64_t *map, uint32_t bit)
+{
+    map[bit >> 6] |= 1ULL << (bit & 63);
+}
+
+static inline void bitmap_clear(uint64_t *map, uint32_t bit)
+{
+    map[bit >> 6] &= ~(1ULL << (bit & 63));
+}
+
+/**
+ * @brief Counts the bits equal to `value` in a row, starting at `bit` of a ring of `mask + 1` bits.
+ *
+ * Whole words are checked at a time, so the cost grows with the length of
+ * the run divided by 64, not with the size of the ring.
+ *
+ * @param map The bitmap.
+ * @param mask Ring size - 1, the ring size is a power of two.
+ * @param bit First bit, less than the ring size.
+ * @param limit Longest run to report.
+ * @param value true to count set bits, false to count clear bits.
+ * @return uint32_t Length of the run, at most `limit`.
+ */
+static inline uint32_t bitmap_run_of(const uint64_t *map, uint32_t mask, uint32_t bit, uint32_t limit, bool value)
+{
+    uint64_t invert = value ? ~0ULL : 0;
+    uint32_t run = 0;
+
+    while (run < limit) {
+        uint32_t pos = (bit + run) & mask;
+        uint32_t avail = 64 - (pos & 63);
+        if (avail > mask + 1 - pos) {
+            avail = mask + 1 - pos;
+        }
+
+        // Bits of the other value become set, the first of them ends the run
+        uint64_t other = (map[pos >> 6] ^ invert) >> (pos & 63);
+        uint32_t same = other ? (uint32_t)__builtin_ctzll(other) : 64;
+        if (same < avail) {
+            run += same;
+            break;
+        }
+        run += avail;
+    }
+
+    return (run < limit) ? run : limit;
+} /* bitmap_run_of() */
+
+/**
+ * @brief Counts the set bits in a row, see bitmap_run_of().
+ */
+static inline uint32_t bitmap_run(const uint64_t *map, uint32_t mask, uint32_t bit, uint32_t limit)
+{
+    return bitmap_run_of(map, mask, bit, limit, true);
+}
+
+/**
+ * @brief Counts the clear bits in a row, see bitmap_run_of().
+ */
+static inline uint32_t bitmap_gap(const uint64_t *map, uint32_t mask, uint32_t bit, uint32_t limit)
+{
+    return bitmap_run_of(map, mask, bit, limit, false);
+}
+
+#endif /* __BITMAP_H__ */
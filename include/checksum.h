@@ -0,0 +1,71 @@
+/******************************************************************************
+  * @file           : checksum.h
+  * @brief          : Pluggable packet checksums
+******************************************************************************/
+
+#ifndef __CHECKSUM_H__
+#define __CHECKSUM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CHECKSUM_MAX_SIZE   4       /* Largest checksum trailer in bytes */
+
+/**
+ * @brief Checksums a packet can be protected with.
+ *
+ * The value is sent on the wire during negotiation, so existing values
+ * must not change.
+ */
+enum Checksum_type {
+    CHECKSUM_CRC8 = 0,      /**< 1-byte CRC-8, understood by every peer. */
+    CHECKSUM_CRC32C = 1,    /**< 4-byte CRC32C, little endian. */
+    CHECKSUM_TYPES          /**< Number of checksum types. */
+};
+
+/**
+ * @brief One checksum implementation.
+ */
+typedef struct {
+    const char *name;                                       /**< Name used on the command line. */
+    uint8_t type;                                           /**< Value of enum Checksum_type. */
+    uint8_t size;                                           /**< Trailer size in bytes. */
+    uint32_t (*compute)(const void *data, size_t len);      /**< Checksum of a buffer. */
+} checksum_t;
+
+/**
+ * @brief Looks up a checksum by type.
+ *
+ * @return const checksum_t* The checksum, or NULL if the type is unknown.
+ */
+const checksum_t *checksum_get(int type);
+
+/**
+ * @brief Looks up a checksum type by name ("crc8" or "crc32c").
+ *
+ * @return int The checksum type, or -1 if the name is unknown.
+ */
+int checksum_parse(const char *name);
+
+/**
+ * @brief Appends the checksum of a packet to the packet.
+ *
+ * @param type Checksum type, unknown types fall back to CRC-8.
+ * @param packet Packet with room for CHECKSUM_MAX_SIZE more bytes.
+ * @param len Number of bytes in the packet.
+ * @return size_t Length of the packet with the checksum.
+ */
+size_t checksum_seal(int type, char *packet, size_t len);
+
+/**
+ * @brief Checks the checksum trailer of a received packet.
+ *
+ * @param type Checksum type, unknown types fall back to CRC-8.
+ * @param packet Received packet.
+ * @param len Length of the packet including the checksum.
+ * @return true if the packet is intact.
+ */
+bool checksum_verify(int type, const char *packet, size_t len);
+
+#endif /* __CHECKSUM_H__ */
@@ -0,0 +1,320 @@
+/******************************************************************************
+  * @file           : codec.h
+  * @brief          : Frames shared by the clients and the server
+******************************************************************************/
+
+#ifndef __CODEC_H__
+#define __CODEC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../include/checksum.h"
+
+#define CODEC_VERSION       1       /* Version of the binary header */
+#define CODEC_HELLO_SEQ     0xFF    /* First byte of a HELLO frame */
+#define CODEC_HELLO_EXT     16      /* max payload (2) | version (1) | connection id (4) | ISN (4) | window (4) | features (1) */
+#define CODEC_HELLO_EXT_V1  11      /* Fields of the first version 1 HELLO, without the window */
+#define CODEC_HELLO_EXT_WIN 15      /* Fields of a HELLO with the window, without the features */
+#define CODEC_HELLO_MAX     (4 + CHECKSUM_TYPES + CODEC_HELLO_EXT + 1)    /* Largest HELLO frame in bytes */
+#define CODEC_MAX_SEQ       254     /* Last legacy sequence number, 0 and 0xFF are control frames */
+#define CODEC_DEFAULT_WINDOW 5      /* Window of peers that do not negotiate one */
+#define CODEC_MAX_WINDOW    65536   /* Largest window, far below the 2^31 of serial arithmetic */
+
+#define CODEC_MAX_PAYLOAD   1400    /* Payload per datagram, fits a 1500 byte MTU with IPv6 */
+#define CODEC_HEADER_SIZE   16      /* Binary header of version 1 frames */
+#define CODEC_FRAME_MAX     (CODEC_HEADER_SIZE + CODEC_MAX_PAYLOAD + CHECKSUM_MAX_SIZE)
+#define CODEC_SACK_BLOCKS   8       /* Most SACK blocks in one ACK */
+#define CODEC_ACK_MAX       (CODEC_HEADER_SIZE + CODEC_SACK_BLOCKS * 8 + CHECKSUM_MAX_SIZE)
+
+#define CODEC_FEATURE_SACK  0x01    /* HELLO feature: ACKs are cumulative and carry SACK blocks */
+#define CODEC_FLAG_SACK     0x01    /* Header flag of an ACK with SACK blocks as the payload */
+#define CODEC_STREAM_HEAD   512     /* Delivered bytes kept for printing */
+
+/**
+ * @brief Frame types of the binary header.
+ */
+enum Codec_type {
+    CODEC_DATA = 1,     /**< Payload with a sequence number. */
+    CODEC_ACK = 2,      /**< Acknowledgement of the sequence number in the ack field. */
+    CODEC_FIN = 3,      /**< Teardown of the connection. */
+    CODEC_NAK = 4       /**< Request to resend the sequence number in the ack field at once. */
+};
+
+/**
+ * @brief Encoding of one connection, agreed on with a HELLO.
+ *
+ * Version 0 is the legacy encoding of clients and servers without the
+ * binary header: a one byte sequence number and one character per frame.
+ */
+typedef struct {
+    uint8_t version;        /**< 0 for legacy frames, CODEC_VERSION for the binary header. */
+    uint8_t checksum;       /**< enum Checksum_type protecting every packet. */
+    uint16_t max_payload;   /**< Payload bytes per frame. */
+    uint32_t conn_id;       /**< Connection id picked by the client, carried in every header. */
+    uint32_t isn;           /**< Sequence number of the first data frame. */
+    uint32_t window;        /**< Packets the sender may have in flight. */
+    uint8_t features;       /**< CODEC_FEATURE_* flags both peers support. */
+} codec_t;
+
+/**
+ * @brief A decoded frame, the payload points into the datagram.
+ */
+typedef struct {
+    uint8_t type;           /**< enum Codec_type. */
+    uint8_t flags;          /**< CODEC_FLAG_* flags of the header. */
+    uint16_t len;           /**< Payload length. */
+    uint32_t seq;           /**< Sequence number of a data frame. */
+    uint32_t ack;           /**< Acknowledged sequence number of an ACK. */
+    const char *payload;    /**< Payload bytes. */
+} codec_frame_t;
+
+/**
+ * @brief Packets [start, end) the receiver holds above its cumulative ACK.
+ */
+typedef struct {
+    uint32_t start;         /**< First sequence number of the block. */
+    uint32_t end;           /**< Sequence number after the block. */
+} codec_sack_t;
+
+/**
+ * @brief Serial number comparison of 32-bit sequence numbers (RFC 1982).
+ *
+ * Sequence numbers wrap around, a is before b if it is less than 2^31
+ * steps behind it. Windows stay far below that, so transfers are unbounded.
+ */
+static inline bool seq_lt(uint32_t a, uint32_t b)  { return (int32_t)(a - b) < 0; }
+static inline bool seq_leq(uint32_t a, uint32_t b) { return (int32_t)(a - b) <= 0; }
+static inline bool seq_gt(uint32_t a, uint32_t b)  { return (int32_t)(a - b) > 0; }
+static inline bool seq_geq(uint32_t a, uint32_t b) { return (int32_t)(a - b) >= 0; }
+
+/**
+ * @brief Big endian stores and loads used by the header, no alignment needed.
+ */
+static inline void codec_put16(char *p, uint16_t v)
+{
+    p[0] = (char)(v >> 8);
+    p[1] = (char)v;
+}
+
+static inline void codec_put32(char *p, uint32_t v)
+{
+    p[0] = (char)(v >> 24);
+    p[1] = (char)(v >> 16);
+    p[2] = (char)(v >> 8);
+    p[3] = (char)v;
+}
+
+static inline uint16_t codec_get16(const char *p)
+{
+    return (uint16_t)((uint8_t)p[0] << 8 | (uint8_t)p[1]);
+}
+
+static inline uint32_t codec_get32(const char *p)
+{
+    return (uint32_t)(uint8_t)p[0] << 24 | (uint32_t)(uint8_t)p[1] << 16 |
+           (uint32_t)(uint8_t)p[2] << 8 | (uint32_t)(uint8_t)p[3];
+}
+
+/**
+ * @brief Data delivered to the upper layer of a connection.
+ *
+ * Only the first CODEC_STREAM_HEAD bytes are kept, the rest is counted and
+ * covered by a CRC32C so long transfers can be checked end to end.
+ */
+typedef struct {
+    uint64_t bytes;                     /**< Bytes delivered. */
+    uint32_t crc;                       /**< CRC32C of every delivered byte. */
+    char head[CODEC_STREAM_HEAD];       /**< First delivered bytes. */
+} codec_stream_t;
+
+/**
+ * @brief Builds a HELLO frame:
+ *        0xFF | 'H' | 'L' | count | types... | max payload | version | connection id | ISN | window | features | CRC-8
+ *
+ * A client sends the checksums it supports, most preferred first, and its
+ * proposed encoding, window and features. The server answers with a HELLO that holds
+ * the checksum it picked and the encoding, window and features it accepts. A version 0 codec leaves out the
+ * fields after the types, which is the HELLO of legacy peers. HELLO frames
+ * are always protected with CRC-8, which every peer understands.
+ *
+ * @param packet Buffer of at least CODEC_HELLO_MAX bytes.
+ * @param types Checksum types.
+ * @param n_types Number of types, at most CHECKSUM_TYPES.
+ * @param codec Proposed or accepted encoding, the checksum field is not used.
+ * @return size_t Length of the frame.
+ */
+size_t codec_make_hello(char *packet, const uint8_t *types, int n_types, const codec_t *codec);
+
+/**
+ * @brief Parses a HELLO frame.
+ *
+ * A HELLO without the fields after the types asks for legacy frames, one
+ * without the window uses CODEC_DEFAULT_WINDOW and one without the
+ * features has none.
+ *
+ * @param packet Received datagram.
+ * @param len Length of the datagram.
+ * @param types Filled with the checksum types of the frame.
+ * @param max_types Room in types.
+ * @param codec Set to the encoding of the HELLO, the checksum field is not touched.
+ * @return int Number of types, or -1 if the datagram is not an intact HELLO.
+ */
+int codec_parse_hello(const char *packet, size_t len, uint8_t *types, int max_types, codec_t *codec);
+
+/**
+ * @brief Picks the first offered checksum that is also allowed.
+ *
+ * @param offered Checksum types from the peer, most preferred first.
+ * @param n_offered Number of offered types.
+ * @param allowed Bit mask of allowed types (1 << type).
+ * @return int Chosen type, CHECKSUM_CRC8 if nothing else matches.
+ */
+int codec_choose_checksum(const uint8_t *offered, int n_offered, unsigned int allowed);
+
+/**
+ * @brief Random 32-bit number for connection ids and initial sequence numbers.
+ */
+uint32_t codec_random32(void);
+
+/**
+ * @brief Negotiates the codec of a connected client socket.
+ *
+ * Sends a HELLO with the offered checksums and the proposed encoding and
+ * waits for the answer. A server that does not know HELLO either answers
+ * with something else or not at all, then CRC-8 and legacy frames starting
+ * from sequence number 1 are used.
+ *
+ * @param socket Connected UDP socket.
+ * @param types Offered checksum types, most preferred first.
+ * @param n_types Number of offered types.
+ * @param timeout_ms Time to wait for the answer to one HELLO.
+ * @param tries Number of HELLOs sent before giving up.
+ * @param codec Holds the proposed payload size, connection id, ISN,
+ *              window and features, set to the agreed encoding.
+ * @return int 0 on success, -1 if the socket failed.
+ */
+int codec_negotiate(int socket, const uint8_t *types, int n_types, int timeout_ms, int tries,
+                    codec_t *codec);
+
+/**
+ * @brief Builds a data frame.
+ *
+ * Version 1: header | payload | checksum, the header is
+ *            version << 4 | type (1) | flags (1) | length (2) | connection id (4) | seq (4) | ack (4)
+ *            with every field big endian.
+ * Legacy:    seq | payload | checksum, only the low 8 bits of seq are sent.
+ *
+ * @param codec Encoding of the connection.
+ * @param packet Buffer of at least CODEC_FRAME_MAX bytes.
+ * @param seq Sequence number.
+ * @param payload Payload bytes.
+ * @param len Payload length, at most CODEC_MAX_PAYLOAD.
+ * @return size_t Length of the frame.
+ */
+size_t codec_make_frame(const codec_t *codec, char *packet, uint32_t seq, const char *payload, uint16_t len);
+
+/**
+ * @brief Largest data frame of a connection in bytes.
+ */
+size_t codec_frame_size(const codec_t *codec);
+
+/**
+ * @brief Builds an acknowledgement, "seq ACK checksum" in legacy frames.
+ *
+ * @param codec Encoding of the connection.
+ * @param packet Buffer of at least CODEC_ACK_MAX bytes.
+ * @param ack Acknowledged sequence number.
+ * @return size_t Length of the frame.
+ */
+size_t codec_make_ack(const codec_t *codec, char *packet, uint32_t ack);
+
+/**
+ * @brief Builds a cumulative ACK with SACK blocks, CODEC_FEATURE_SACK connections only.
+ *
+ * The header has the CODEC_FLAG_SACK flag, ack is the last packet received
+ * in order and seq the data packet that caused the ACK, so the sender can
+ * measure the RTT from it. The payload is start (4) | end (4) of every
+ * block, big endian.
+ *
+ * @param codec Encoding of the connection.
+ * @param packet Buffer of at least CODEC_ACK_MAX bytes.
+ * @param ack Last sequence number received in order.
+ * @param seq Sequence number of the packet that is answered.
+ * @param blocks Packets received above the cumulative ACK.
+ * @param n_blocks Number of blocks, at most CODEC_SACK_BLOCKS.
+ * @return size_t Length of the frame.
+ */
+size_t codec_make_sack(const codec_t *codec, char *packet, uint32_t ack, uint32_t seq,
+                       const codec_sack_t *blocks, int n_blocks);
+
+/**
+ * @brief Reads the SACK blocks of a parsed ACK.
+ *
+ * @param frame An ACK decoded by codec_parse_frame().
+ * @param blocks Filled with the blocks.
+ * @param max_blocks Room in blocks.
+ * @return int Number of blocks, 0 if the ACK has none.
+ */
+int codec_parse_sack(const codec_frame_t *frame, codec_sack_t *blocks, int max_blocks);
+
+/**
+ * @brief Builds a negative acknowledgement, "seq NAK checksum" in legacy frames.
+ *
+ * A receiver that cannot trust a frame asks for the oldest packet it is
+ * missing, so the sender resends it without waiting for the timeout.
+ *
+ * @param codec Encoding of the connection.
+ * @param packet Buffer of at least CODEC_ACK_MAX bytes.
+ * @param nak Sequence number to resend.
+ * @return size_t Length of the frame.
+ */
+size_t codec_make_nak(const codec_t *codec, char *packet, uint32_t nak);
+
+/**
+ * @brief Builds the teardown frame, the bytes 0 | '0' | 0x90 in legacy frames.
+ *
+ * @param codec Encoding of the connection.
+ * @param packet Buffer of at least CODEC_ACK_MAX bytes.
+ * @return size_t Length of the frame.
+ */
+size_t codec_make_fin(const codec_t *codec, char *packet);
+
+/**
+ * @brief Checks if a datagram is the teardown frame of the connection.
+ */
+bool codec_is_fin(const codec_t *codec, const char *packet, size_t len);
+
+/**
+ * @brief Checks if a datagram looks like a teardown of any connection.
+ *
+ * Only the frame type is checked, a relay that knows no connection uses
+ * this to pass the teardown, which the client sends only once.
+ */
+bool codec_maybe_fin(const char *packet, size_t len);
+
+/**
+ * @brief Checks and decodes a frame.
+ *
+ * Legacy frames only carry the low 8 bits of the sequence number. The full
+ * number is the one closest to `expected` with the same low bits. A legacy
+ * frame with the payload "ACK" or "NAK" is decoded as an ACK or NAK with
+ * seq and ack set.
+ *
+ * @param codec Encoding of the connection.
+ * @param packet Received datagram.
+ * @param len Length of the datagram.
+ * @param expected Sequence number the receiver expects next.
+ * @param frame Filled with the header fields and payload.
+ * @return true if the checksum, version, connection id and length are valid.
+ */
+bool codec_parse_frame(const codec_t *codec, const char *packet, size_t len, uint32_t expected,
+                       codec_frame_t *frame);
+
+/**
+ * @brief Delivers payload bytes to the upper layer.
+ */
+void codec_stream_append(codec_stream_t *stream, const char *data, size_t len);
+
+#endif /* __CODEC_H__ */
@@ -0,0 +1,141 @@
+/******************************************************************************
+  * @file           : congestion.h
+  * @brief          : Pluggable congestion control of the window-based clients
+******************************************************************************/
+
+#ifndef __CONGESTION_H__
+#define __CONGESTION_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define CONGESTION_INITIAL_WINDOW   10      /* Packets sent before the first ACK, RFC 6928 */
+#define CONGESTION_MIN_WINDOW       2       /* Smallest window after a loss */
+#define CONGESTION_LOSS_WINDOW      1       /* Window after a retransmission timeout */
+#define CONGESTION_PACING_SS_GAIN   2.0     /* Pacing rate over cwnd/RTT in slow start, the window doubles per RTT */
+#define CONGESTION_PACING_CA_GAIN   1.25    /* Pacing rate over cwnd/RTT in congestion avoidance */
+
+/**
+ * @brief Congestion control algorithms.
+ */
+enum Congestion_type {
+    CONGESTION_FIXED = 0,       /**< The whole receiver window, no reaction to loss. */
+    CONGESTION_NEWRENO = 1,     /**< AIMD: one packet per RTT, halved on loss, RFC 6582. */
+    CONGESTION_CUBIC = 2,       /**< Cubic growth from the window of the last loss, RFC 8312. */
+    CONGESTION_TYPES            /**< Number of algorithms. */
+};
+
+typedef struct congestion congestion_t;
+
+/**
+ * @brief One congestion control algorithm.
+ *
+ * Slow start, loss recovery and timeouts are shared, an algorithm only
+ * grows the window above the slow start threshold and picks the window
+ * after a loss.
+ */
+typedef struct {
+    const char *name;                                           /**< Name used on the command line. */
+    uint8_t type;                                               /**< Value of enum Congestion_type. */
+    void (*avoid)(congestion_t *cc, uint32_t acked, uint64_t now_us, uint64_t srtt_us); /**< Growth in congestion avoidance, NULL keeps the window. */
+    double (*ssthresh)(congestion_t *cc);                       /**< Slow start threshold after a loss, NULL ignores losses. */
+} congestion_ops_t;
+
+/**
+ * @brief Congestion window of a connection, in packets.
+ *
+ * Packets are numbered as in the sender window. A loss starts a recovery
+ * that lasts until the packets sent before it are acknowledged, further
+ * losses of those packets do not shrink the window again and the window
+ * does not grow meanwhile.
+ */
+struct congestion {
+    const congestion_ops_t *ops;    /**< The algorithm. */
+    double cwnd;                    /**< Congestion window. */
+    double ssthresh;                /**< Slow start threshold. */
+    uint32_t max_window;            /**< Receiver window, the congestion window never exceeds it. */
+    uint64_t recover;               /**< Losses of packets before this one belong to the last reduction. */
+    bool in_recovery;               /**< Fast recovery, the window holds until the base reaches recover. */
+    double w_max;                   /**< CUBIC: window before the last loss. */
+    double k_s;                     /**< CUBIC: time to grow back to w_max. */
+    double w_est;                   /**< CUBIC: window NewReno would have. */
+    uint64_t epoch_us;              /**< CUBIC: start of the growth period, 0 before it. */
+    uint64_t losses;                /**< Loss events that shrank the window. */
+    uint64_t timeouts;              /**< Retransmission timeouts. */
+};
+
+/**
+ * @brief Looks up an algorithm by type.
+ *
+ * @return const congestion_ops_t* The algorithm, or NULL if the type is unknown.
+ */
+const congestion_ops_t *congestion_get(int type);
+
+/**
+ * @brief Looks up an algorithm by name ("fixed", "newreno" or "cubic").
+ *
+ * @return int The type, or -1 if the name is unknown.
+ */
+int congestion_parse(const char *name);
+
+/**
+ * @brief Starts a connection in slow start.
+ *
+ * @param cc The congestion state.
+ * @param type Value of enum Congestion_type, unknown types fall back to fixed.
+ * @param max_window Receiver window in packets.
+ */
+void congestion_init(congestion_t *cc, int type, uint32_t max_window);
+
+/**
+ * @brief Grows the window for newly acknowledged packets.
+ *
+ * @param cc The congestion state.
+ * @param acked Packets this ACK acknowledged.
+ * @param base Oldest packet not acknowledged after the ACK.
+ * @param now_us Current monotonic time.
+ * @param srtt_us Smoothed round-trip time.
+ */
+void congestion_on_ack(congestion_t *cc, uint64_t acked, uint64_t base, uint64_t now_us, uint64_t srtt_us);
+
+/**
+ * @brief Shrinks the window once per window of data when a packet is lost.
+ *
+ * @param cc The congestion state.
+ * @param lost The lost packet.
+ * @param next Next packet to be sent.
+ */
+void congestion_on_loss(congestion_t *cc, uint64_t lost, uint64_t next);
+
+/**
+ * @brief Restarts slow start from one packet after a retransmission timeout.
+ *
+ * @param cc The congestion state.
+ * @param base The packet that timed out.
+ * @param next Next packet to be sent.
+ */
+void congestion_on_timeout(congestion_t *cc, uint64_t base, uint64_t next);
+
+/**
+ * @brief Pacing rate that sends the congestion window over one RTT, with headroom to grow.
+ *
+ * @param cc The congestion state.
+ * @param srtt_us Smoothed round-trip time, 0 before the first sample.
+ * @param packet_bytes Size of a full packet.
+ * @return double Bytes per second, 0 without an RTT sample.
+ */
+double congestion_pacing_rate(const congestion_t *cc, uint64_t srtt_us, size_t packet_bytes);
+
+/**
+ * @brief Packets allowed in flight, at least 1 and at most the receiver window.
+ */
+static inline uint32_t congestion_window(const congestion_t *cc)
+{
+    if (cc->cwnd < 1.0) {
+        return 1;
+    }
+    return (cc->cwnd >= cc->max_window) ? cc->max_window : (uint32_t)cc->cwnd;
+}
+
+#endif /* __CONGESTION_H__ */
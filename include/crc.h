@@ -9,22 +9,16 @@
 #include <stdint.h>
 
 typedef uint8_t crc;
-extern crc crcTable[256]; 
+extern const crc crcTable[256]; 
 
 #define WIDTH   (8 * sizeof(crc))
 #define TOPBIT  (1 << (WIDTH -1))
 
 #define POLYNOMIAL 0x07  /* 11011 followed by 0's */
 
-/**
- * @brief precompute the CRC8 output remainders of each possible input
- * 
- */
-void crcInit(void);
-
 /**
  * @brief Compute the CRC of given message
- * @note  crcInit() must be called first
+ * @note  The table is built at compile time, no initialization is needed
  * @param message '8'-bit message data for which the CRC is calculated
  * @param nBytes The number of bytes in the message
  * @return crc The computed CRC value (uint8_t)
@@ -0,0 +1,66 @@
+/******************************************************************************
+  * @file           : crc32c.h
+  * @brief          : CRC32C (Castagnoli) with hardware and software engines
+******************************************************************************/
+
+#ifndef __CRC32C_H__
+#define __CRC32C_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CRC32C_POLYNOMIAL   0x82F63B78u     /* 0x1EDC6F41 bit reflected */
+
+/**
+ * @brief Computes or continues a CRC32C.
+ *
+ * @param seed Zero to start, or the result of the previous call to continue.
+ * @param data Bytes to add to the CRC.
+ * @param len Number of bytes.
+ * @return uint32_t The CRC32C of all bytes so far.
+ */
+typedef uint32_t (*crc32c_fn)(uint32_t seed, const void *data, size_t len);
+
+/**
+ * @brief One CRC32C engine, listed for benchmarks and tests.
+ */
+typedef struct {
+    const char *name;       /**< Short name of the engine. */
+    crc32c_fn compute;      /**< Engine entry point. */
+    bool available;         /**< The CPU supports the instructions the engine uses. */
+} crc32c_engine_t;
+
+/**
+ * @brief Computes a CRC32C with the fastest engine the CPU supports.
+ *
+ * The engine is chosen once before main() runs: SSE4.2 crc32 instructions
+ * with three interleaved streams recombined with PCLMULQDQ, SSE4.2 alone,
+ * or the portable slicing-by-8 tables.
+ *
+ * @param seed Zero to start, or the result of the previous call to continue.
+ * @param data Bytes to add to the CRC.
+ * @param len Number of bytes.
+ * @return uint32_t The CRC32C of all bytes so far.
+ */
+uint32_t crc32c(uint32_t seed, const void *data, size_t len);
+
+/**
+ * @brief Portable CRC32C processing eight bytes per step with eight tables.
+ */
+uint32_t crc32c_sw(uint32_t seed, const void *data, size_t len);
+
+/**
+ * @brief Lists every CRC32C engine compiled in.
+ *
+ * @param count Set to the number of engines.
+ * @return const crc32c_engine_t* Engines from slowest to fastest.
+ */
+const crc32c_engine_t *crc32c_engines(int *count);
+
+/**
+ * @brief Name of the engine crc32c() uses.
+ */
+const char *crc32c_engine_name(void);
+
+#endif /* __CRC32C_H__ */
@@ -0,0 +1,33 @@
+/******************************************************************************
+  * @file           : crc_table.h
+  * @brief          : Expands CRC lookup tables at compile time
+******************************************************************************/
+
+#ifndef __CRC_TABLE_H__
+#define __CRC_TABLE_H__
+
+/*
+ * A CRC is linear, so the table entry of a byte is the XOR of the entries of
+ * its set bits. ENTRY(k, i) builds the entry of byte i from eight constants and
+ * the macros below list all 256 entries, so the tables are plain initializers
+ * and nothing has to be computed when the program starts.
+ */
+#define CRC_TABLE_BIT(i, b, x)  ((((i) >> (b)) & 1u) ? (x) : 0u)
+
+#define CRC_TABLE_ROW(ENTRY, k, i) \
+    ENTRY(k, (i) + 0x0), ENTRY(k, (i) + 0x1), ENTRY(k, (i) + 0x2), ENTRY(k, (i) + 0x3), \
+    ENTRY(k, (i) + 0x4), ENTRY(k, (i) + 0x5), ENTRY(k, (i) + 0x6), ENTRY(k, (i) + 0x7), \
+    ENTRY(k, (i) + 0x8), ENTRY(k, (i) + 0x9), ENTRY(k, (i) + 0xa), ENTRY(k, (i) + 0xb), \
+    ENTRY(k, (i) + 0xc), ENTRY(k, (i) + 0xd), ENTRY(k, (i) + 0xe), ENTRY(k, (i) + 0xf)
+
+#define CRC_TABLE_256(ENTRY, k) { \
+    CRC_TABLE_ROW(ENTRY, k, 0x00), CRC_TABLE_ROW(ENTRY, k, 0x10), \
+    CRC_TABLE_ROW(ENTRY, k, 0x20), CRC_TABLE_ROW(ENTRY, k, 0x30), \
+    CRC_TABLE_ROW(ENTRY, k, 0x40), CRC_TABLE_ROW(ENTRY, k, 0x50), \
+    CRC_TABLE_ROW(ENTRY, k, 0x60), CRC_TABLE_ROW(ENTRY, k, 0x70), \
+    CRC_TABLE_ROW(ENTRY, k, 0x80), CRC_TABLE_ROW(ENTRY, k, 0x90), \
+    CRC_TABLE_ROW(ENTRY, k, 0xa0), CRC_TABLE_ROW(ENTRY, k, 0xb0), \
+    CRC_TABLE_ROW(ENTRY, k, 0xc0), CRC_TABLE_ROW(ENTRY, k, 0xd0), \
+    CRC_TABLE_ROW(ENTRY, k, 0xe0), CRC_TABLE_ROW(ENTRY, k, 0xf0) }
+
+#endif /* __CRC_TABLE_H__ */
@@ -0,0 +1,94 @@
+/******************************************************************************
+  * @file           : delay_queue.h
+  * @brief          : Min-heap of delayed datagrams ordered by release time
+******************************************************************************/
+
+#ifndef __DELAY_QUEUE_H__
+#define __DELAY_QUEUE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+#define DELAY_QUEUE_DATA_SIZE   2048    /* Largest datagram that can be delayed */
+#define DELAY_QUEUE_MIN         64      /* Entries allocated at first use */
+
+/**
+ * @brief A parked datagram and the client it came from.
+ */
+typedef struct {
+    uint64_t release_us;                        /**< Monotonic time to process the datagram. */
+    uint64_t order;                             /**< Arrival order, keeps equal deadlines FIFO. */
+    struct sockaddr_storage address;            /**< Client address. */
+    socklen_t address_len;                      /**< Length of the client address. */
+    long len;                                   /**< Datagram length. */
+    char data[DELAY_QUEUE_DATA_SIZE];           /**< Datagram. */
+} delay_entry_t;
+
+/**
+ * @brief Binary min-heap of delayed datagrams.
+ *
+ * The heap holds indexes into a pool of entries, so sifting moves four
+ * bytes per level instead of whole datagrams. The pool grows on demand up
+ * to `max_entries`.
+ */
+typedef struct {
+    delay_entry_t *entries;     /**< Entry pool. */
+    uint32_t *heap;             /**< Entry indexes ordered by release time. */
+    uint32_t *free;             /**< Stack of unused entry indexes. */
+    uint32_t free_count;        /**< Number of unused entries. */
+    uint32_t count;             /**< Datagrams in the queue. */
+    uint32_t capacity;          /**< Allocated entries. */
+    uint32_t max_entries;       /**< Upper limit for parked datagrams. */
+    uint64_t next_order;        /**< Arrival counter. */
+
+    unsigned long delayed;      /**< Datagrams parked. */
+    unsigned long released;     /**< Datagrams released. */
+    unsigned long overflows;    /**< Datagrams not parked because the queue was full. */
+    uint32_t max_depth;         /**< Most datagrams parked at once. */
+} delay_queue_t;
+
+/**
+ * @brief Initializes an empty queue, nothing is allocated until the first push.
+ *
+ * @param queue Queue to initialize.
+ * @param max_entries Maximum number of parked datagrams.
+ */
+void delay_queue_init(delay_queue_t *queue, uint32_t max_entries);
+
+/**
+ * @brief Frees the queue and every parked datagram.
+ */
+void delay_queue_free(delay_queue_t *queue);
+
+/**
+ * @brief Parks a copy of a datagram until `release_us`.
+ *
+ * @return int `0` on success, `-1` if the queue is full, the datagram is
+ *         too large or the allocation failed.
+ */
+int delay_queue_push(delay_queue_t *queue, uint64_t release_us, const char *data, long len,
+                     const struct sockaddr *address, socklen_t address_len);
+
+/**
+ * @brief Returns the datagram with the earliest release time.
+ *
+ * The entry stays valid until the next push.
+ *
+ * @return delay_entry_t* The entry, or NULL if the queue is empty.
+ */
+delay_entry_t *delay_queue_peek(delay_queue_t *queue);
+
+/**
+ * @brief Removes the datagram returned by delay_queue_peek().
+ */
+void delay_queue_pop(delay_queue_t *queue);
+
+/**
+ * @brief Release time of the earliest datagram.
+ *
+ * @return uint64_t The release time, or UINT64_MAX if the queue is empty.
+ */
+uint64_t delay_queue_next_us(const delay_queue_t *queue);
+
+#endif /* __DELAY_QUEUE_H__ */
@@ -0,0 +1,169 @@
+/******************************************************************************
+  * @file           : event_loop.h
+  * @brief          : epoll based event loop with timerfd timers, signalfd signals and eventfd notifications
+******************************************************************************/
+
+#ifndef __EVENT_LOOP_H__
+#define __EVENT_LOOP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+
+#define EVENT_LOOP_MAX_EVENTS   64  /* Ready sources returned per wait */
+
+/**
+ * @brief Kind of file descriptor registered to the event loop.
+ */
+enum Event_type {
+    EVENT_SOCKET,   /**< Socket or any other readable descriptor. */
+    EVENT_TIMER,    /**< timerfd created with event_timer_init(). */
+    EVENT_SIGNAL,   /**< signalfd created with event_signal_init(). */
+    EVENT_NOTIFY    /**< eventfd created with event_notify_init(). */
+};
+
+/**
+ * @brief A file descriptor watched by the event loop.
+ *
+ * The struct is owned by the caller and must stay valid while it is
+ * registered. event_loop_wait() hands back pointers to these structs, so
+ * the caller can compare them or use `ctx` to find its own state.
+ */
+typedef struct {
+    int fd;             /**< Watched file descriptor. */
+    int type;           /**< One of enum Event_type. */
+    void *ctx;          /**< Caller data, not used by the loop. */
+} event_source_t;
+
+/**
+ * @brief epoll instance and the buffer for ready events.
+ */
+typedef struct {
+    int epfd;                                           /**< epoll file descriptor. */
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];   /**< Ready events of the last wait. */
+} event_loop_t;
+
+/**
+ * @brief Creates the epoll instance.
+ *
+ * @return int `0` on success, `-1` on error.
+ */
+int event_loop_init(event_loop_t *loop);
+
+/**
+ * @brief Closes the epoll instance. Registered sources are not closed.
+ */
+void event_loop_close(event_loop_t *loop);
+
+/**
+ * @brief Starts watching a source for readability.
+ *
+ * @return int `0` on success, `-1` on error.
+ */
+int event_loop_add(event_loop_t *loop, event_source_t *src);
+
+/**
+ * @brief Stops watching a source.
+ *
+ * @return int `0` on success, `-1` on error.
+ */
+int event_loop_del(event_loop_t *loop, event_source_t *src);
+
+/**
+ * @brief Waits until at least one registered source is readable.
+ *
+ * @param loop Event loop.
+ * @param[out] ready Array that receives the readable sources.
+ * @param max Size of the `ready` array (at most EVENT_LOOP_MAX_EVENTS is used).
+ * @param timeout_ms Maximum wait in milliseconds, `0` to poll or `-1` to block.
+ * @return int Number of ready sources, `0` on timeout or if interrupted
+ *         by a signal, `-1` on error.
+ */
+int event_loop_wait(event_loop_t *loop, event_source_t **ready, int max, int timeout_ms);
+
+/**
+ * @brief Creates a non-blocking monotonic timerfd.
+ *
+ * @return int `0` on success, `-1` on error.
+ */
+int event_timer_init(event_source_t *timer, void *ctx);
+
+/**
+ * @brief Arms the timer, or disarms it if `timeout_us` is `0`.
+ *
+ * @param timer Timer source.
+ * @param timeout_us Time to the first expiration in microseconds.
+ * @param interval_us Period of the following expirations, `0` for a one-shot timer.
+ * @return int `0` on success, `-1` on error.
+ */
+int event_timer_arm(event_source_t *timer, uint64_t timeout_us, uint64_t interval_us);
+
+/**
+ * @brief Arms a one-shot timer for a monotonic deadline.
+ *
+ * The timer is only re-armed when the deadline moved ahead of the one it
+ * is armed for, so most calls cost no system call. The caller clears
+ * `armed_us` when the timer fires.
+ *
+ * @param timer Timer source.
+ * @param armed_us Deadline the timer is armed for, `0` if disarmed, updated.
+ * @param deadline_us The deadline, `UINT64_MAX` if there is none.
+ * @return int `0` on success, `-1` on error.
+ */
+int event_timer_arm_at(event_source_t *timer, uint64_t *armed_us, uint64_t deadline_us);
+
+/**
+ * @brief Consumes the expirations of a readable timer.
+ *
+ * @return uint64_t Number of expirations since the last read, `0` if none.
+ */
+uint64_t event_timer_read(event_source_t *timer);
+
+/**
+ * @brief Blocks the given signals and creates a signalfd that receives them.
+ *
+ * The signals are blocked for the calling thread, so this should be called
+ * before any threads are started.
+ *
+ * @param src Signal source.
+ * @param signals Signals to receive, for example SIGINT and SIGTERM.
+ * @param count Number of signals.
+ * @return int `0` on success, `-1` on error.
+ */
+int event_signal_init(event_source_t *src, const int *signals, int count, void *ctx);
+
+/**
+ * @brief Reads one pending signal from a readable signal source.
+ *
+ * @return int The signal number, or `-1` if no signal was pending.
+ */
+int event_signal_read(event_source_t *src);
+
+/**
+ * @brief Creates a non-blocking eventfd used to wake other threads.
+ *
+ * @return int `0` on success, `-1` on error.
+ */
+int event_notify_init(event_source_t *src, void *ctx);
+
+/**
+ * @brief Makes a notify source readable.
+ *
+ * The counter is never read back, so the source stays readable in every
+ * event loop it is registered to. This is how one thread stops many.
+ *
+ * @return int `0` on success, `-1` on error.
+ */
+int event_notify_signal(event_source_t *src);
+
+/**
+ * @brief Closes the file descriptor of a timer, signal or notify source.
+ */
+void event_source_close(event_source_t *src);
+
+/**
+ * @brief Current time of the monotonic clock in microseconds.
+ */
+uint64_t event_loop_now_us(void);
+
+#endif /* __EVENT_LOOP_H__ */
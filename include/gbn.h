@@ -14,6 +14,8 @@
 #include "../include/sleep.h"
 #include "../include/rdn_num.h"
 #include "../include/crc.h"
+#include "../include/checksum.h"
+#include "../include/codec.h"
 
 /**
  * @brief Represents the status of a received packet in the GBN protocol.
@@ -32,30 +34,35 @@ enum Packet_status {
  * @brief Processes a received packet and performs error checking.
  * 
  * This function takes a received packet, verifies its integrity using CRC, 
- * and checks if the sequence number matches the expected sequence number.
+ * decodes its payload and checks if the sequence number matches the expected
+ * sequence number.
  * 
  * @param read Pointer to the received data buffer.
  * @param bytes_received The number of bytes received in the packet.
  * @param expectedseqnum The expected sequence number of the packet.
+ * @param codec Encoding negotiated for the connection.
+ * @param frame Filled with the sequence number and the payload of the packet.
  * @return int 
  *         - `OK` if the packet is valid and the sequence number matches.
  *         - `CRC_NOK` if there is a CRC error.
  *         - `SEQ_NOK` if the sequence number does not match the expected one.
  */
-int gbn_process_packet (char *read, long bytes_received, int expectedseqnum);
+int gbn_process_packet (char *read, long bytes_received, uint32_t expectedseqnum, const codec_t *codec,
+                        codec_frame_t *frame);
 
 
 /**
- * @brief Constructs an acknowledgment (ACK) packet with a sequence number and CRC.
+ * @brief Constructs a cumulative acknowledgment (ACK) packet.
  * 
- * This function creates an ACK packet containing the expected sequence number, 
- * the "ACK" message, and a CRC checksum for error detection. The resulting packet 
- * is stored in the provided buffer.
+ * This function creates an ACK packet for the last packet received in order
+ * and appends the checksum. The resulting packet is stored in the provided
+ * buffer.
  * 
- * @param packet Pointer to the buffer where the constructed packet will be stored.
- * @param expectedseqnum The expected sequence number to include in the packet.
+ * @param packet Buffer of at least CODEC_ACK_MAX bytes.
+ * @param ackseqnum Sequence number of the last packet received in order.
+ * @param codec Encoding negotiated for the connection.
  * @return int The size of the generated packet.
  */
-int gbn_make_packet(char *packet, uint8_t expectedseqnum);
+int gbn_make_packet(char *packet, uint32_t ackseqnum, const codec_t *codec);
 
 #endif /* __GBN_H__ */
@@ -0,0 +1,149 @@
+/******************************************************************************
+  * @file           : impair.h
+  * @brief          : Loss, delay, reordering and bandwidth impairments of a datagram path
+******************************************************************************/
+
+#ifndef __IMPAIR_H__
+#define __IMPAIR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rdn_num.h"
+#include "impair_trace.h"
+
+#define IMPAIR_ERROR_MASK   0x2     /* Bit flipped in the second last byte of a corrupted datagram */
+#define IMPAIR_RATE_BURST   2048    /* Bytes the link sends back to back, about one datagram */
+#define IMPAIR_HOLD_MAX_US  1000    /* A reordered datagram is released when nothing passes for this long */
+
+/**
+ * @brief Outcome of the impairments for one datagram.
+ */
+enum Impair_action {
+    IMPAIR_PASS,    /**< Datagram is forwarded now. */
+    IMPAIR_DROP,    /**< Datagram is dropped. */
+    IMPAIR_DELAY,   /**< Datagram is forwarded at `release_us` of the verdict. */
+    IMPAIR_HOLD     /**< Datagram is forwarded after `reorder_depth` later datagrams. */
+};
+
+/**
+ * @brief Impairments of one direction.
+ *
+ * Loss is a Bernoulli trial with `drop_probability`, or with `bad_probability`
+ * set a Gilbert-Elliott chain: the path turns bad with `bad_probability`
+ * and good again with `good_probability` per datagram, and loses datagrams
+ * with `drop_probability` while good and `bad_loss` while bad. Mean burst
+ * length is 1 / `good_probability`.
+ *
+ * With a `rate` the path is a link with a token bucket and a queue of
+ * `queue_bytes`, datagrams wait for the link and are dropped when the queue
+ * is full.
+ *
+ * With a `trace` the loss, delay and bit error of every datagram come from
+ * the trace instead of the probabilities.
+ */
+typedef struct {
+    float drop_probability;     /**< Loss probability, in the good state of the Gilbert-Elliott chain. */
+    float bad_probability;      /**< Probability of turning bad, 0 for Bernoulli loss. */
+    float good_probability;     /**< Probability of turning good again. */
+    float bad_loss;             /**< Loss probability in the bad state. */
+    float delay_probability;    /**< Probability of a datagram being delayed. */
+    uint64_t delay_us;          /**< Delay of a delayed datagram. */
+    float error_probability;    /**< Probability of a bit error in a datagram. */
+    float reorder_probability;  /**< Probability of a datagram being held back. */
+    uint32_t reorder_depth;     /**< Later datagrams that overtake a held datagram. */
+    float duplicate_probability; /**< Probability of a datagram being sent twice. */
+    double rate;                /**< Link rate in bytes per second, 0 is unlimited. */
+    uint32_t queue_bytes;       /**< Bytes queued for the link before tail drop. */
+    const impair_trace_t *trace; /**< Recorded fates replayed instead of the probabilities, or NULL. */
+} impair_config_t;
+
+/**
+ * @brief State of one direction carried from datagram to datagram.
+ */
+typedef struct {
+    rand_gen_t rand;            /**< Random numbers of the direction alone. */
+    bool bad;                   /**< Gilbert-Elliott chain is in the bad state. */
+    double tokens;              /**< Link bytes that may be sent now, negative is the queued backlog. */
+    uint64_t last_us;           /**< Time of the last refill. */
+    uint64_t sent;              /**< Datagrams forwarded, the clock of the held datagrams. */
+    uint64_t last_sent_us;      /**< Time of the last forwarded datagram. */
+    uint32_t trace_next;        /**< Record of the next datagram in the trace. */
+} impair_state_t;
+
+/**
+ * @brief Datagrams seen and impaired in one direction.
+ */
+typedef struct {
+    unsigned long packets;      /**< Datagrams seen. */
+    unsigned long dropped;      /**< Datagrams lost, in either state. */
+    unsigned long bursts;       /**< Turns to the bad state. */
+    unsigned long delayed;      /**< Datagrams delayed. */
+    unsigned long corrupted;    /**< Datagrams with a flipped bit. */
+    unsigned long reordered;    /**< Datagrams held back. */
+    unsigned long duplicated;   /**< Datagrams sent twice. */
+    unsigned long queued;       /**< Datagrams that waited for the link. */
+    unsigned long overflowed;   /**< Datagrams dropped because the link queue was full. */
+} impair_stats_t;
+
+/**
+ * @brief What to do with a datagram that is not dropped.
+ */
+typedef struct {
+    uint64_t release_us;        /**< Time to forward a delayed datagram. */
+    uint64_t hold_until;        /**< Value of `sent` that releases a held datagram. */
+    int copies;                 /**< 1, or 2 for a duplicated datagram. */
+} impair_verdict_t;
+
+/**
+ * @brief Checks if any impairment is configured, an unimpaired path skips the random draws.
+ */
+static inline bool impair_enabled(const impair_config_t *config)
+{
+    return config->drop_probability > 0 || config->bad_probability > 0 || config->delay_probability > 0 ||
+           config->error_probability > 0 || config->reorder_probability > 0 ||
+           config->duplicate_probability > 0 || config->rate > 0 || config->trace;
+}
+
+/**
+ * @brief Counts a forwarded datagram, held datagrams wait for this count.
+ */
+static inline void impair_sent(impair_state_t *state, uint64_t now_us)
+{
+    state->sent++;
+    state->last_sent_us = now_us;
+}
+
+/**
+ * @brief Starts a direction in the good state with a full link bucket.
+ *
+ * The direction draws its own random stream, so the fate of its Nth
+ * datagram only depends on the seed, not on the traffic the other way.
+ *
+ * @param state State of the direction.
+ * @param seed Seed of the run.
+ * @param stream Stream of the direction, unique in the process.
+ * @param now_us Current monotonic time.
+ */
+void impair_state_init(impair_state_t *state, uint64_t seed, uint64_t stream, uint64_t now_us);
+
+/**
+ * @brief Decides the fate of a datagram and applies the bit error.
+ *
+ * Loss is decided first, then a held datagram skips the link and the
+ * delay. Other datagrams queue for the link, may be delayed on top of it
+ * and are corrupted as they are.
+ *
+ * @param config Impairments of the direction.
+ * @param state State of the direction.
+ * @param stats Counters of the direction.
+ * @param packet The datagram, modified by the bit error.
+ * @param len Length of the datagram.
+ * @param now_us Current monotonic time.
+ * @param verdict Release time, hold count and copies of the datagram.
+ * @return int One of enum Impair_action.
+ */
+int impair_packet(const impair_config_t *config, impair_state_t *state, impair_stats_t *stats,
+                  char *packet, long len, uint64_t now_us, impair_verdict_t *verdict);
+
+#endif /* __IMPAIR_H__ */
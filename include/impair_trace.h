@@ -0,0 +1,82 @@
+/******************************************************************************
+  * @file           : impair_trace.h
+  * @brief          : Memory-mapped traces of per-datagram loss, delay and bit errors
+******************************************************************************/
+
+#ifndef __IMPAIR_TRACE_H__
+#define __IMPAIR_TRACE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <endian.h>
+
+#define IMPAIR_TRACE_MAGIC          "UDPTRACE"  /* First 8 bytes of a trace file */
+#define IMPAIR_TRACE_VERSION        1
+#define IMPAIR_TRACE_DROP           0x1         /* Record bit: the datagram is lost */
+#define IMPAIR_TRACE_CORRUPT        0x2         /* Record bit: the datagram gets a bit error */
+#define IMPAIR_TRACE_DELAY_SHIFT    2           /* Delay in microseconds in the upper 30 bits */
+#define IMPAIR_TRACE_DELAY_MAX      ((1u << 30) - 1)
+
+/**
+ * @brief Header of a trace file, followed by `count` little-endian 32-bit records.
+ */
+typedef struct {
+    char magic[8];          /**< IMPAIR_TRACE_MAGIC, not terminated. */
+    uint32_t version;       /**< IMPAIR_TRACE_VERSION, little-endian. */
+    uint32_t count;         /**< Records in the file, little-endian. */
+} impair_trace_header_t;
+
+/**
+ * @brief A mapped trace, one record per datagram.
+ *
+ * The mapping is read only and shared, every reader keeps its own cursor
+ * and wraps around at the end, so a trace shorter than the run repeats.
+ */
+typedef struct {
+    const uint32_t *records;    /**< The records after the header. */
+    uint32_t count;             /**< Number of records, at least 1. */
+    void *map;                  /**< Start of the mapping. */
+    size_t map_len;             /**< Length of the mapping. */
+} impair_trace_t;
+
+/**
+ * @brief Maps a trace file and checks its header.
+ *
+ * @param trace The trace.
+ * @param path Path of the trace file.
+ * @return int `0` on success, `-1` with errno set if the file can not be
+ *         mapped or is not a trace (EINVAL).
+ */
+int impair_trace_open(impair_trace_t *trace, const char *path);
+
+/**
+ * @brief Unmaps a trace.
+ */
+void impair_trace_close(impair_trace_t *trace);
+
+/**
+ * @brief Record of the next datagram, advances the reader's cursor.
+ *
+ * @param trace The trace.
+ * @param cursor Position of the reader, starts at 0.
+ * @return uint32_t The record, IMPAIR_TRACE_DROP, IMPAIR_TRACE_CORRUPT and the delay.
+ */
+static inline uint32_t impair_trace_next(const impair_trace_t *trace, uint32_t *cursor)
+{
+    uint32_t record = le32toh(trace->records[*cursor]);
+
+    if (++*cursor == trace->count) {
+        *cursor = 0;
+    }
+    return record;
+}
+
+/**
+ * @brief Delay of a record in microseconds.
+ */
+static inline uint64_t impair_trace_delay_us(uint32_t record)
+{
+    return record >> IMPAIR_TRACE_DELAY_SHIFT;
+}
+
+#endif /* __IMPAIR_TRACE_H__ */
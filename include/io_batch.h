@@ -0,0 +1,121 @@
+/******************************************************************************
+  * @file           : io_batch.h
+  * @brief          : Batched datagram receive and send with recvmmsg/sendmmsg
+******************************************************************************/
+
+#ifndef __IO_BATCH_H__
+#define __IO_BATCH_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+
+#define IO_BATCH_MAX        1024    /* Upper limit for the configurable batch size */
+#define IO_BATCH_BUF_SIZE   2048    /* Size of a single datagram buffer, a full frame fits */
+#define IO_BATCH_TX_FACTOR  2       /* Replies that can be queued per received datagram */
+
+/**
+ * @brief Receive and transmit state for batched datagram I/O.
+ *
+ * Holds preallocated message headers, buffers and peer addresses for up to
+ * `size` received datagrams and `size * IO_BATCH_TX_FACTOR` queued replies.
+ * With a batch size of 1 the plain recvfrom()/sendto() calls are used.
+ */
+typedef struct {
+    unsigned int size;                  /**< Configured batch size. */
+    unsigned int rx_count;              /**< Datagrams in the current receive batch. */
+    unsigned int tx_count;              /**< Replies queued for the next flush. */
+    unsigned int tx_capacity;           /**< Maximum number of queued replies. */
+
+    struct mmsghdr *rx_msgs;            /**< Receive message headers. */
+    struct iovec *rx_iov;               /**< Receive buffer vectors. */
+    char *rx_buf;                       /**< size * IO_BATCH_BUF_SIZE bytes. */
+    struct sockaddr_storage *rx_addr;   /**< Sender address of each datagram. */
+
+    struct mmsghdr *tx_msgs;            /**< Transmit message headers. */
+    struct iovec *tx_iov;               /**< Transmit buffer vectors. */
+    char *tx_buf;                       /**< tx_capacity * IO_BATCH_BUF_SIZE bytes. */
+    struct sockaddr_storage *tx_addr;   /**< Destination address of each reply. */
+
+    unsigned long rx_calls;             /**< Receive calls that returned data. */
+    unsigned long rx_datagrams;         /**< Datagrams received in total. */
+    unsigned long tx_calls;             /**< Send calls made. */
+    unsigned long tx_datagrams;         /**< Datagrams sent in total. */
+} io_batch_t;
+
+/**
+ * @brief Allocates the buffers for a batch of the given size.
+ *
+ * @param batch Batch state to initialize.
+ * @param size Number of datagrams per batch (1 - IO_BATCH_MAX).
+ * @return int `0` on success, `-1` if the size is invalid or allocation failed.
+ */
+int io_batch_init(io_batch_t *batch, unsigned int size);
+
+/**
+ * @brief Releases the buffers allocated by io_batch_init().
+ *
+ * @param batch Batch state to free.
+ */
+void io_batch_free(io_batch_t *batch);
+
+/**
+ * @brief Drains up to `size` datagrams from the socket without blocking.
+ *
+ * Should be called when the socket is readable. Received datagrams are
+ * accessed with io_batch_data(), io_batch_len() and io_batch_addr().
+ *
+ * @param batch Batch state.
+ * @param sock Socket to read from.
+ * @return int Number of datagrams received, `0` if none was pending, or `-1` on error.
+ */
+int io_batch_recv(io_batch_t *batch, int sock);
+
+/**
+ * @brief Returns the payload of the i:th datagram of the current batch.
+ */
+char *io_batch_data(io_batch_t *batch, unsigned int i);
+
+/**
+ * @brief Returns the length of the i:th datagram of the current batch.
+ */
+long io_batch_len(const io_batch_t *batch, unsigned int i);
+
+/**
+ * @brief Returns the sender address of the i:th datagram of the current batch.
+ *
+ * @param[out] addr_len Length of the returned address.
+ */
+struct sockaddr *io_batch_addr(io_batch_t *batch, unsigned int i, socklen_t *addr_len);
+
+/**
+ * @brief Copies a reply into the transmit queue.
+ *
+ * The queue is flushed automatically if it is full.
+ *
+ * @param batch Batch state.
+ * @param sock Socket used if the queue has to be flushed.
+ * @param packet Reply to send.
+ * @param len Length of the reply.
+ * @param addr Destination address.
+ * @param addr_len Length of the destination address.
+ * @return int `0` on success, `-1` if the reply is too large or flushing failed.
+ */
+int io_batch_queue(io_batch_t *batch, int sock, const char *packet, size_t len,
+                   const struct sockaddr *addr, socklen_t addr_len);
+
+/**
+ * @brief Sends all queued replies, with one sendmmsg() when possible.
+ *
+ * @param batch Batch state.
+ * @param sock Socket to send from.
+ * @return int Number of replies sent, or `-1` on error.
+ */
+int io_batch_flush(io_batch_t *batch, int sock);
+
+/**
+ * @brief Average number of datagrams returned per receive call.
+ */
+double io_batch_occupancy(const io_batch_t *batch);
+
+#endif /* __IO_BATCH_H__ */
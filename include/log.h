@@ -0,0 +1,201 @@
+/******************************************************************************
+  * @file           : log.h
+  * @brief          : Asynchronous level-filtered logging through a lock-free ring
+******************************************************************************/
+
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**
+ * @brief Log levels, a message is written if its level is at most the active level.
+ */
+enum Log_level {
+    LOG_LEVEL_ERROR,    /**< Failures. */
+    LOG_LEVEL_WARN,     /**< Unexpected but handled conditions. */
+    LOG_LEVEL_INFO,     /**< Connection events, statistics. */
+    LOG_LEVEL_DEBUG     /**< Every packet. */
+};
+
+/* Messages above this level are removed at compile time, e.g. -DLOG_COMPILE_LEVEL=LOG_LEVEL_INFO */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL   LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_MAX_ARGS        8       /* Arguments per message */
+#define LOG_TEXT_SIZE       48      /* Bytes for copies of string arguments */
+#define LOG_RING_SIZE       8192    /* Records in the ring, must be a power of two */
+
+/**
+ * @brief Type tag of a record argument.
+ */
+enum Log_arg_type {
+    LOG_ARG_INT,        /**< Signed integer, stored as int64_t. */
+    LOG_ARG_UINT,       /**< Unsigned integer, stored as uint64_t. */
+    LOG_ARG_DOUBLE,     /**< Floating point. */
+    LOG_ARG_STRING,     /**< String, copied into the record. */
+    LOG_ARG_POINTER     /**< Pointer value. */
+};
+
+/**
+ * @brief One argument of a message, tagged by LOG_ARG() at compile time.
+ */
+typedef struct {
+    uint8_t type;               /**< One of enum Log_arg_type. */
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const char *s;
+        const void *p;
+    } value;                    /**< The argument. */
+} log_arg_t;
+
+/**
+ * @brief Fixed-size binary record written by the hot path.
+ *
+ * Only the format pointer and the raw arguments are stored, formatting
+ * happens on the logging thread. String arguments are copied into `text`
+ * because the caller's buffer may be gone by then.
+ */
+typedef struct {
+    const char *fmt;                        /**< Format string, must be a literal. */
+    uint8_t level;                          /**< Level of the message. */
+    uint8_t n_args;                         /**< Number of arguments. */
+    uint8_t types[LOG_MAX_ARGS];            /**< Argument types. */
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const void *p;
+    } values[LOG_MAX_ARGS];                 /**< Arguments, strings as offsets into `text`. */
+    char text[LOG_TEXT_SIZE];               /**< Copied string arguments. */
+} log_record_t;
+
+/** Active runtime level, read by the LOG_ macros. */
+extern atomic_int log_runtime_level;
+
+/**
+ * @brief Starts the logging thread.
+ *
+ * The level can be overridden with the `LOG_LEVEL` environment variable
+ * (`error`, `warn`, `info` or `debug`). Until log_init() is called, or if
+ * the thread cannot be started, messages are formatted synchronously.
+ *
+ * @param level Default runtime level.
+ * @return int `0` on success, `-1` if the logging thread could not be started.
+ */
+int log_init(int level);
+
+/**
+ * @brief Writes the queued messages and stops the logging thread.
+ */
+void log_shutdown(void);
+
+/**
+ * @brief Waits until every queued message has been written.
+ */
+void log_flush(void);
+
+/**
+ * @brief Sets the runtime level.
+ */
+void log_set_level(int level);
+
+/**
+ * @brief Parses a level name.
+ *
+ * @return int The level, or `-1` if the name is unknown.
+ */
+int log_parse_level(const char *name);
+
+/**
+ * @brief Number of messages lost because the ring was full.
+ */
+unsigned long log_dropped(void);
+
+/**
+ * @brief Queues a message for the logging thread. Use the LOG_ macros instead.
+ *
+ * Never blocks: if the ring is full the message is counted as dropped.
+ */
+void log_write(int level, const log_arg_t *args, int n_args);
+
+/**
+ * @brief Never called, lets the compiler check the format against its arguments.
+ */
+static inline void log_check_format(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static inline void log_check_format(const char *fmt, ...) { (void)fmt; }
+
+static inline log_arg_t log_arg_int(int64_t v) { log_arg_t a = { .type = LOG_ARG_INT, .value.i = v }; return a; }
+static inline log_arg_t log_arg_uint(uint64_t v) { log_arg_t a = { .type = LOG_ARG_UINT, .value.u = v }; return a; }
+static inline log_arg_t log_arg_double(double v) { log_arg_t a = { .type = LOG_ARG_DOUBLE, .value.d = v }; return a; }
+static inline log_arg_t log_arg_string(const char *v) { log_arg_t a = { .type = LOG_ARG_STRING, .value.s = v }; return a; }
+static inline log_arg_t log_arg_pointer(const void *v) { log_arg_t a = { .type = LOG_ARG_POINTER, .value.p = v }; return a; }
+
+/* Tags an argument with its type */
+#define LOG_ARG(x) _Generic((x),                        \
+    char *: log_arg_string,                             \
+    const char *: log_arg_string,                       \
+    float: log_arg_double,                              \
+    double: log_arg_double,                             \
+    unsigned char: log_arg_uint,                        \
+    unsigned short: log_arg_uint,                       \
+    unsigned int: log_arg_uint,                         \
+    unsigned long: log_arg_uint,                        \
+    unsigned long long: log_arg_uint,                   \
+    _Bool: log_arg_uint,                                \
+    char: log_arg_int,                                  \
+    signed char: log_arg_int,                           \
+    short: log_arg_int,                                 \
+    int: log_arg_int,                                   \
+    long: log_arg_int,                                  \
+    long long: log_arg_int,                             \
+    default: log_arg_pointer)(x)
+
+/* The format is argument 0, the remaining arguments are tagged one by one */
+#define LOG_NARGS(...)  LOG_NARGS_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0, _)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+#define LOG_CAT(a, b)   LOG_CAT_(a, b)
+#define LOG_CAT_(a, b)  a##b
+
+#define LOG_ARGS_0(f)                           log_arg_string(f)
+#define LOG_ARGS_1(f, a)                        LOG_ARGS_0(f), LOG_ARG(a)
+#define LOG_ARGS_2(f, a, b)                     LOG_ARGS_1(f, a), LOG_ARG(b)
+#define LOG_ARGS_3(f, a, b, c)                  LOG_ARGS_2(f, a, b), LOG_ARG(c)
+#define LOG_ARGS_4(f, a, b, c, d)               LOG_ARGS_3(f, a, b, c), LOG_ARG(d)
+#define LOG_ARGS_5(f, a, b, c, d, e)            LOG_ARGS_4(f, a, b, c, d), LOG_ARG(e)
+#define LOG_ARGS_6(f, a, b, c, d, e, g)         LOG_ARGS_5(f, a, b, c, d, e), LOG_ARG(g)
+#define LOG_ARGS_7(f, a, b, c, d, e, g, h)      LOG_ARGS_6(f, a, b, c, d, e, g), LOG_ARG(h)
+#define LOG_ARGS_8(f, a, b, c, d, e, g, h, i)   LOG_ARGS_7(f, a, b, c, d, e, g, h), LOG_ARG(i)
+
+/**
+ * @brief True if messages of `level` are written.
+ *
+ * Use it to skip work that is only needed for a message, e.g. address lookups.
+ */
+#define LOG_ENABLED(level) \
+    ((level) <= LOG_COMPILE_LEVEL && (level) <= atomic_load_explicit(&log_runtime_level, memory_order_relaxed))
+
+#define LOG_AT(level, ...)                                                          \
+    do {                                                                            \
+        if (LOG_ENABLED(level)) {                                                   \
+            const log_arg_t log_args_[] = {                                         \
+                LOG_CAT(LOG_ARGS_, LOG_NARGS(__VA_ARGS__))(__VA_ARGS__) };          \
+            log_write((level), log_args_, sizeof(log_args_) / sizeof(log_args_[0])); \
+        }                                                                           \
+        if (0) {                                                                    \
+            log_check_format(__VA_ARGS__);                                          \
+        }                                                                           \
+    } while (0)
+
+#define LOG_ERROR(...)  LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)   LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...)   LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...)  LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif /* __LOG_H__ */
@@ -0,0 +1,82 @@
+/******************************************************************************
+  * @file           : pacer.h
+  * @brief          : Token bucket pacing of the clients' transmissions
+******************************************************************************/
+
+#ifndef __PACER_H__
+#define __PACER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PACER_BURST_PACKETS     2       /* Packets the bucket holds, sent back to back */
+#define PACER_SPIN_US           50      /* Last part of a wait that is polled instead of slept */
+
+/**
+ * @brief Token bucket that spreads packets at a target rate.
+ *
+ * The bucket fills at the rate in bytes and holds a couple of packets, a
+ * packet is sent once the bucket has its bytes. Packets sent without
+ * asking, e.g. fast retransmits, still take their bytes and may leave the
+ * bucket in debt. A rate of 0 sends every packet at once.
+ */
+typedef struct {
+    double rate;            /**< Target rate in bytes per second, 0 is not paced. */
+    double tokens;          /**< Bytes that may be sent now, negative after unpaced sends. */
+    double burst;           /**< Depth of the bucket in bytes. */
+    uint64_t last_us;       /**< Time of the last refill. */
+    uint64_t release_us;    /**< Time the waiting packet is due, 0 if none waits. */
+    uint64_t paced_us;      /**< Time spent with a target rate. */
+    double target_bytes;    /**< Bytes the target rate allowed meanwhile. */
+    uint64_t paced_bytes;   /**< Bytes sent meanwhile. */
+    uint64_t waits;         /**< Packets that waited for the bucket. */
+    uint64_t late_us;       /**< Sum of the delays from the due time to the send of those packets. */
+} pacer_t;
+
+/**
+ * @brief Starts a full bucket.
+ *
+ * @param pacer The pacer.
+ * @param rate Target rate in bytes per second, 0 is not paced.
+ * @param burst Depth of the bucket in bytes, at least one packet.
+ * @param now_us Current monotonic time.
+ */
+void pacer_init(pacer_t *pacer, double rate, size_t burst, uint64_t now_us);
+
+/**
+ * @brief Changes the target rate, the time until now is filled at the old rate.
+ */
+void pacer_set_rate(pacer_t *pacer, double rate, uint64_t now_us);
+
+/**
+ * @brief Time a packet may be sent.
+ *
+ * @param pacer The pacer.
+ * @param bytes Size of the packet.
+ * @param now_us Current monotonic time.
+ * @return uint64_t now_us or earlier if the packet may be sent now, otherwise the time the bucket has its bytes.
+ */
+uint64_t pacer_release_us(pacer_t *pacer, size_t bytes, uint64_t now_us);
+
+/**
+ * @brief Takes the bytes of a sent packet from the bucket.
+ */
+void pacer_sent(pacer_t *pacer, size_t bytes, uint64_t now_us);
+
+/**
+ * @brief Average target rate in bits per second while the rate was set.
+ */
+static inline double pacer_target_bps(const pacer_t *pacer)
+{
+    return pacer->paced_us ? pacer->target_bytes * 8e6 / pacer->paced_us : 0.0;
+}
+
+/**
+ * @brief Rate achieved in bits per second while the rate was set.
+ */
+static inline double pacer_achieved_bps(const pacer_t *pacer)
+{
+    return pacer->paced_us ? pacer->paced_bytes * 8e6 / pacer->paced_us : 0.0;
+}
+
+#endif /* __PACER_H__ */
@@ -1,15 +1,79 @@
 /******************************************************************************
   * @file           : rdn_num.h
-  * @brief          : Returns random number between 0.1 - 1.0
+  * @brief          : Seedable random numbers (xoshiro256**), per thread or per generator
 */
 
 #ifndef __RDN_NUM_H__
 #define __RDN_NUM_H__
 
+#include <stdint.h>
+#include <stddef.h>
+
+#define RAND_BLOCK  64      /* Numbers drawn per refill of a generator's block */
+
+/**
+ * @brief A generator and the block of numbers it has drawn but not returned.
+ *
+ * The same seed and stream repeat the same numbers bit for bit, streams
+ * of one seed are 2^128 numbers apart and never overlap.
+ */
+typedef struct {
+    uint64_t s[4];                  /**< xoshiro256** state, never all zero. */
+    unsigned int next;              /**< Next unused number of the block. */
+    double block[RAND_BLOCK];       /**< Numbers drawn by the last refill. */
+} rand_gen_t;
+
+/**
+ * @brief Seeds a generator.
+ * @param gen The generator.
+ * @param seed Seed of the run.
+ * @param stream Stream of the generator, e.g. the worker number.
+ */
+void rand_gen_seed(rand_gen_t *gen, uint64_t seed, uint64_t stream);
+
+/**
+ * @brief Next 64 uniform random bits of a generator.
+ */
+uint64_t rand_gen_u64(rand_gen_t *gen);
+
+/**
+ * @brief Fills an array with uniform random numbers in (0, 1].
+ * @note  One call keeps the generator in registers for the whole array.
+ * @param gen The generator.
+ * @param numbers The array.
+ * @param count Numbers to draw.
+ */
+void rand_gen_fill(rand_gen_t *gen, double *numbers, size_t count);
+
+/**
+ * @brief Next uniform random number in (0, 1] of a generator, drawn RAND_BLOCK at a time.
+ */
+static inline double rand_gen_number(rand_gen_t *gen)
+{
+    if (gen->next == RAND_BLOCK) {
+        rand_gen_fill(gen, gen->block, RAND_BLOCK);
+        gen->next = 0;
+    }
+    return gen->block[gen->next++];
+}
+
+/**
+ * @brief Seeds the generator of the calling thread.
+ * @note  Every thread has its own generator, so workers never contend. A
+ *        thread that is not seeded uses seed 0, stream 0.
+ */
+void rand_seed(uint64_t seed, uint64_t stream);
+
+/**
+ * @brief Seed from the clock for runs without an explicit seed, printed so the run can be repeated.
+ */
+uint64_t rand_default_seed(void);
+
 /**
  * @brief Random number generator
- * @note  Random numbers are between 0.1 - 1.0
- * @return random number divided by '10'
+ * @note  Random numbers are uniform in (0, 1], `rand_number() <= p` holds with probability p.
+ *        They come from the generator of the calling thread.
+ * @return random number
  */
 double rand_number(void);
 
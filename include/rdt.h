@@ -14,6 +14,7 @@
 #include "../include/sleep.h"
 #include "../include/rdn_num.h"
 #include "../include/crc.h"
+#include "../include/impair_trace.h"
 
 /**
  * @brief Stores parameters for reliable data transfer (RDT).
@@ -31,9 +32,45 @@ typedef struct Rdt_variables
     uint8_t seq;              /**< Current sequence number of the packet. */
     int8_t last_seq;          /**< Last acknowledged sequence number. */
     uint16_t rdt;             /**< Reliable data transfer version (1.0, 2.0, 2.1, 2.2, or 3.0). */
+    const impair_trace_t *trace; /**< Recorded fates replayed instead of the probabilities, or NULL. */
+    uint32_t trace_next;      /**< Trace record of the next packet, every session replays from the start. */
 } Rdt_variables;
 
+/**
+ * @brief Outcome of the drop and delay impairments.
+ */
+enum Rdt_impairment {
+    RDT_PASS,   /**< Packet is processed now. */
+    RDT_DROP,   /**< Packet is dropped, answered as corrupted. */
+    RDT_DELAY   /**< Packet is processed after the delay. */
+};
 
+/**
+ * @brief Decides whether a received packet is dropped or delayed.
+ *
+ * The delay is not slept here. The caller keeps the packet in a delay
+ * queue and calls process_packet() once the delay has passed, so other
+ * packets are served in the meantime. With a trace the next record
+ * decides instead of the probabilities, and its bit error is applied here.
+ *
+ * @param vars RDT parameters with the drop and delay probabilities or the trace.
+ * @param read Received packet, may be modified by the bit error of a trace.
+ * @param bytes_received Length of the packet.
+ * @param[out] delay_us Delay of a delayed packet.
+ * @return int One of enum Rdt_impairment.
+ */
+int rdt_impair(Rdt_variables *vars, char *read, long bytes_received, uint64_t *delay_us);
+
+/**
+ * @brief Applies the bit error impairment and checks the CRC of a packet.
+ *
+ * Also updates the sequence number state for RDT 2.2 and 3.0.
+ *
+ * @param read Received packet, may be modified by the bit error.
+ * @param bytes_received Length of the packet.
+ * @param vars RDT parameters and sequence state.
+ * @return crc `0` if the CRC check passed.
+ */
 crc process_packet (char *read, long bytes_received, Rdt_variables* vars);
 
 /**
@@ -0,0 +1,79 @@
+/******************************************************************************
+  * @file           : rtt.h
+  * @brief          : Round-trip time estimation and retransmission timeout
+******************************************************************************/
+
+#ifndef __RTT_H__
+#define __RTT_H__
+
+#include <stdint.h>
+
+#define RTT_INITIAL_RTO_US  1000000ULL      /* RTO before the first sample, RFC 6298 */
+#define RTT_MIN_RTO_US      5000ULL         /* Default lower bound of the RTO */
+#define RTT_MAX_RTO_US      2000000ULL      /* Default upper bound of the RTO, the old fixed timeout */
+#define RTT_MAX_BACKOFF     16              /* Most doublings of the RTO */
+
+/**
+ * @brief Smoothed RTT of a connection, Jacobson/Karels.
+ *
+ * Samples are taken only from packets that were sent once (Karn's rule).
+ * The RTO is SRTT + 4 * RTTVAR within the bounds and is doubled on every
+ * timeout until new data is acknowledged.
+ */
+typedef struct {
+    uint64_t srtt_us;       /**< Smoothed round-trip time. */
+    uint64_t rttvar_us;     /**< Round-trip time variation. */
+    uint64_t rto_us;        /**< Timeout without backoff. */
+    uint64_t min_rto_us;    /**< Lower bound of the timeout. */
+    uint64_t max_rto_us;    /**< Upper bound of the timeout. */
+    uint64_t min_rtt_us;    /**< Smallest sample. */
+    uint64_t last_us;       /**< Latest sample. */
+    uint64_t samples;       /**< Number of samples taken. */
+    uint64_t timeouts;      /**< Number of timeouts. */
+    uint32_t backoff;       /**< Doublings of the timeout since the last sample. */
+} rtt_t;
+
+/**
+ * @brief Starts an estimator without samples.
+ *
+ * @param rtt The estimator.
+ * @param min_rto_us Lower bound of the timeout.
+ * @param max_rto_us Upper bound of the timeout, at least min_rto_us.
+ */
+void rtt_init(rtt_t *rtt, uint64_t min_rto_us, uint64_t max_rto_us);
+
+/**
+ * @brief Adds a round-trip time sample and clears the backoff.
+ *
+ * @param rtt The estimator.
+ * @param sample_us Time from sending a packet to its ACK, the packet was sent only once.
+ */
+void rtt_sample(rtt_t *rtt, uint64_t sample_us);
+
+/**
+ * @brief Doubles the timeout after a retransmission timeout.
+ */
+void rtt_backoff(rtt_t *rtt);
+
+/**
+ * @brief Clears the backoff when new data is acknowledged without a sample.
+ *
+ * After a timeout the ACKs of the resent packets give no samples, so the
+ * backoff would otherwise only grow while the path delivers again.
+ */
+static inline void rtt_progress(rtt_t *rtt)
+{
+    rtt->backoff = 0;
+}
+
+/**
+ * @brief Current retransmission timeout with the backoff.
+ */
+static inline uint64_t rtt_rto_us(const rtt_t *rtt)
+{
+    uint64_t rto = rtt->rto_us << rtt->backoff;
+
+    return (rto > rtt->max_rto_us) ? rtt->max_rto_us : rto;
+}
+
+#endif /* __RTT_H__ */
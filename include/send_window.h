@@ -0,0 +1,243 @@
+/******************************************************************************
+  * @file           : send_window.h
+  * @brief          : Sender window and retransmission buffer of the clients
+******************************************************************************/
+
+#ifndef __SEND_WINDOW_H__
+#define __SEND_WINDOW_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "../include/bitmap.h"
+#include "../include/codec.h"
+
+#define SEND_WINDOW_MIN_SLOTS   64      /* Smallest ring, one bitmap word */
+#define SEND_WINDOW_MAX_SLOTS   65536   /* Largest ring */
+#define SEND_WINDOW_DUP_THRESH  3       /* Later packets acknowledged before a packet counts as lost */
+
+/**
+ * @brief Packets sent and not yet acknowledged.
+ *
+ * Packets are numbered from 0 in the order they are sent, the caller maps
+ * an index to the sequence number on the wire. A packet is encoded once
+ * into its slot of a preallocated ring and retransmissions send the stored
+ * bytes again. The ACK flags are a bitmap, so the window slides and finds
+ * unacknowledged packets a 64-bit word at a time.
+ */
+typedef struct {
+    uint64_t base;          /**< Oldest packet not acknowledged. */
+    uint64_t next;          /**< Next packet to be sent. */
+    uint64_t sacked;        /**< Packets after the base acknowledged out of order. */
+    uint32_t window;        /**< Packets allowed in flight. */
+    uint32_t mask;          /**< Number of slots - 1, slots is a power of two. */
+    size_t slot_size;       /**< Bytes per encoded packet. */
+    char *packets;          /**< Encoded packets. */
+    uint16_t *len;          /**< Length of each encoded packet. */
+    uint64_t *sent_us;      /**< Last time each packet was sent. */
+    uint64_t *acked;        /**< Bitmap of acknowledged slots. */
+    uint64_t *resent;       /**< Bitmap of slots sent more than once. */
+} send_window_t;
+
+/**
+ * @brief Allocates the ring of a sender window.
+ *
+ * @param win The window.
+ * @param window Packets allowed in flight, at most SEND_WINDOW_MAX_SLOTS.
+ * @param slot_size Largest encoded packet in bytes.
+ * @return int 0 on success, -1 if the allocation failed.
+ */
+int send_window_init(send_window_t *win, uint32_t window, size_t slot_size);
+
+/**
+ * @brief Frees the ring of a sender window.
+ */
+void send_window_free(send_window_t *win);
+
+/**
+ * @brief Checks if the window has room for another packet.
+ */
+static inline bool send_window_can_send(const send_window_t *win)
+{
+    return win->next - win->base < win->window;
+}
+
+/**
+ * @brief Packets sent and not acknowledged in order or by SACK, the pipe of RFC 6675.
+ *
+ * The congestion window limits this, while the receiver's window limits
+ * the distance from the base to the next packet.
+ */
+static inline uint64_t send_window_in_flight(const send_window_t *win)
+{
+    return win->next - win->base - win->sacked;
+}
+
+/**
+ * @brief Slot the next packet is encoded into, slot_size bytes.
+ */
+static inline char *send_window_slot(send_window_t *win)
+{
+    return &win->packets[(win->next & win->mask) * win->slot_size];
+}
+
+/**
+ * @brief Adds the packet encoded in send_window_slot() to the window.
+ *
+ * @param win The window.
+ * @param len Length of the encoded packet.
+ * @param now_us Time the packet is sent.
+ * @return uint64_t Index of the packet.
+ */
+uint64_t send_window_push(send_window_t *win, size_t len, uint64_t now_us);
+
+/**
+ * @brief Stored bytes of a packet in the window.
+ *
+ * @param win The window.
+ * @param index Index of the packet, base <= index < next.
+ * @param len Set to the length of the packet.
+ * @return const char* The encoded packet.
+ */
+static inline const char *send_window_packet(const send_window_t *win, uint64_t index, size_t *len)
+{
+    *len = win->len[index & win->mask];
+    return &win->packets[(index & win->mask) * win->slot_size];
+}
+
+/**
+ * @brief Records the time a packet was sent again.
+ */
+static inline void send_window_sent(send_window_t *win, uint64_t index, uint64_t now_us)
+{
+    win->sent_us[index & win->mask] = now_us;
+    bitmap_set(win->resent, index & win->mask);
+}
+
+/**
+ * @brief Checks if a packet was sent more than once, its ACK is not an RTT sample.
+ */
+static inline bool send_window_is_resent(const send_window_t *win, uint64_t index)
+{
+    return bitmap_test(win->resent, index & win->mask);
+}
+
+/**
+ * @brief Time a packet in the window was last sent.
+ */
+static inline uint64_t send_window_sent_us(const send_window_t *win, uint64_t index)
+{
+    return win->sent_us[index & win->mask];
+}
+
+/**
+ * @brief Checks if a packet in the window is acknowledged.
+ */
+static inline bool send_window_is_acked(const send_window_t *win, uint64_t index)
+{
+    return bitmap_test(win->acked, index & win->mask);
+}
+
+/**
+ * @brief Acknowledges one packet, Selective Repeat.
+ *
+ * @param win The window.
+ * @param index Index of the packet, ignored outside the window.
+ * @return true if the packet was waiting for this ACK.
+ */
+bool send_window_ack(send_window_t *win, uint64_t index);
+
+/**
+ * @brief Acknowledges every packet up to and including index, Go-Back-N.
+ *
+ * @param win The window.
+ * @param index Index of the last acknowledged packet, ignored outside the window.
+ * @return uint64_t Number of packets the window slid.
+ */
+uint64_t send_window_ack_through(send_window_t *win, uint64_t index);
+
+/**
+ * @brief Acknowledges the packets of a SACK block that are still in flight.
+ *
+ * The block is given as wrapping distances of its wire numbers from the
+ * wire number of the base, the part outside the window is ignored.
+ * Acknowledged runs are skipped a bitmap word at a time.
+ *
+ * @param win The window.
+ * @param start Distance of the first packet of the block.
+ * @param end Distance of the packet after the block.
+ * @param on_ack Called with the index of every packet the block acknowledges, may be NULL.
+ * @param ctx Passed to `on_ack`.
+ * @return uint64_t Number of packets acknowledged.
+ */
+uint64_t send_window_sack(send_window_t *win, int32_t start, int32_t end,
+                          void (*on_ack)(uint64_t index, void *ctx), void *ctx);
+
+/**
+ * @brief Acknowledges the packets a cumulative ACK with SACK blocks reports.
+ *
+ * The cumulative part, the blocks and the packet the ACK answers are all
+ * acknowledged. The sent time and resent flag of the answered packet stay
+ * until the window slides, so the caller can take an RTT sample from it.
+ *
+ * @param win The window.
+ * @param frame An ACK with the CODEC_FLAG_SACK flag.
+ * @param base_seq Wire number of the base.
+ * @param answered Set to the packet the ACK answers if this ACK acknowledged it, otherwise to next.
+ * @param on_ack Called with the index of every packet the ACK acknowledges, may be NULL.
+ * @param ctx Passed to `on_ack`.
+ * @return uint64_t Number of packets acknowledged.
+ */
+uint64_t send_window_apply_sack(send_window_t *win, const codec_frame_t *frame, uint32_t base_seq,
+                                uint64_t *answered, void (*on_ack)(uint64_t index, void *ctx), void *ctx);
+
+/**
+ * @brief Slides the base over the acknowledged packets at the start of the window.
+ *
+ * @return uint64_t Number of packets the window slid.
+ */
+uint64_t send_window_slide(send_window_t *win);
+
+/**
+ * @brief Finds the first unacknowledged packet at or after index.
+ *
+ * @param win The window.
+ * @param index First packet to check, at least base.
+ * @return uint64_t Index of the packet, or next if every packet is acknowledged.
+ */
+uint64_t send_window_next_unacked(const send_window_t *win, uint64_t index);
+
+/**
+ * @brief Finds the next packet that later ACKs show to be lost, for a fast retransmit.
+ *
+ * A packet is lost when a packet at least SEND_WINDOW_DUP_THRESH places
+ * after it is acknowledged and was sent after the packet was last sent,
+ * the selective counterpart of three duplicate ACKs. A resent packet is
+ * only found again once a packet sent after the resend is acknowledged.
+ *
+ * @param win The window.
+ * @param index First packet to check, at least base.
+ * @param acked Packet whose ACK was just received.
+ * @return uint64_t Index of the lost packet, or next if there is none.
+ */
+uint64_t send_window_next_lost(const send_window_t *win, uint64_t index, uint64_t acked);
+
+/**
+ * @brief Converts a wrapping 32-bit number relative to the base into a packet index.
+ *
+ * @param win The window.
+ * @param distance Wire number minus the wire number of the base.
+ * @param index Set to the packet index.
+ * @return true if the index is a packet in flight.
+ */
+static inline bool send_window_index(const send_window_t *win, int32_t distance, uint64_t *index)
+{
+    if (distance < 0 || (uint64_t)distance >= win->next - win->base) {
+        return false;
+    }
+    *index = win->base + (uint64_t)distance;
+    return true;
+}
+
+#endif /* __SEND_WINDOW_H__ */
@@ -0,0 +1,146 @@
+/******************************************************************************
+  * @file           : session.h
+  * @brief          : Per-client session table keyed by client address and port
+******************************************************************************/
+
+#ifndef __SESSION_H__
+#define __SESSION_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+
+#include "../include/rdt.h"
+#include "../include/sr.h"
+#include "../include/codec.h"
+#include "../include/timer_wheel.h"
+
+#define SESSION_CHUNK           1024    /* Sessions allocated at a time */
+
+/**
+ * @brief Compact lookup key built from the client address and port.
+ */
+typedef struct {
+    uint32_t addr[4];       /**< IPv4 address in addr[0], or the IPv6 address. */
+    uint16_t port;          /**< Port in network byte order. */
+    uint16_t family;        /**< AF_INET or AF_INET6. */
+} session_key_t;
+
+/**
+ * @brief Protocol state of one client.
+ *
+ * Replaces the receiver state that used to be shared by every client of
+ * the server. Sessions never move in memory once created.
+ */
+typedef struct session {
+    session_key_t key;                          /**< Lookup key. */
+    struct sockaddr_storage address;            /**< Client address for replies. */
+    socklen_t address_len;                      /**< Length of the client address. */
+    uint64_t last_seen_us;                      /**< Monotonic time of the last packet. */
+    timer_node_t idle_timer;                    /**< Fires when the session may have gone idle. */
+    unsigned long packets;                      /**< Datagrams received from the client. */
+    codec_t codec;                              /**< Negotiated encoding, CRC-8 legacy frames until a HELLO. */
+
+    Rdt_variables rdt_vars;                     /**< RDT parameters and sequence state. */
+    uint32_t expected_seq_num;                  /**< Next in-order GBN sequence. */
+    uint32_t rcv_base;                          /**< SR receive window base. */
+    sr_receive_buffer_t sr_receive_buffer;      /**< SR out-of-order buffer. */
+    uint32_t ack_pending;                       /**< In order packets received since the last ACK. */
+    uint32_t ack_seq;                           /**< Latest packet the delayed ACK answers. */
+    timer_node_t ack_timer;                     /**< Sends the delayed ACK. */
+    codec_stream_t received;                    /**< Data delivered to upper layer. */
+
+    struct session *next_free;                  /**< Free list link while unused. */
+} session_t;
+
+/**
+ * @brief Slot of the open addressing table.
+ *
+ * The hash and the key are stored inline, so a lookup touches only the
+ * slot array until the matching session is found. Two slots fit in one
+ * cache line.
+ */
+typedef struct {
+    uint32_t hash;          /**< Hash of the key, 0 marks an empty slot. */
+    session_key_t key;      /**< Key of the session. */
+    session_t *session;     /**< The session. */
+} session_slot_t;
+
+/**
+ * @brief Open addressing hash table with linear probing.
+ *
+ * Deletion uses backward shifting instead of tombstones, so probe lengths
+ * stay short no matter how many sessions come and go.
+ */
+typedef struct {
+    session_slot_t *slots;      /**< Slot array, capacity is a power of two. */
+    uint32_t capacity;          /**< Number of slots. */
+    uint32_t count;             /**< Sessions in the table. */
+    uint32_t max_sessions;      /**< Upper limit for concurrent sessions. */
+
+    session_t **chunks;         /**< Allocated session chunks. */
+    size_t n_chunks;            /**< Number of chunks. */
+    session_t *free_list;       /**< Unused sessions. */
+
+    unsigned long created;      /**< Sessions created. */
+    unsigned long removed;      /**< Sessions removed by teardown. */
+    unsigned long evicted;      /**< Sessions evicted for being idle. */
+    unsigned long rejected;     /**< New clients refused because the table was full. */
+} session_table_t;
+
+/**
+ * @brief Allocates the slot array.
+ *
+ * @param table Table to initialize.
+ * @param initial_capacity Initial number of slots, rounded up to a power of two.
+ * @param max_sessions Maximum number of concurrent sessions.
+ * @return int `0` on success, `-1` if the allocation failed.
+ */
+int session_table_init(session_table_t *table, uint32_t initial_capacity, uint32_t max_sessions);
+
+/**
+ * @brief Frees the table and every session.
+ */
+void session_table_free(session_table_t *table);
+
+/**
+ * @brief Builds the lookup key of a client address.
+ *
+ * @return int `0` on success, `-1` if the address family is not supported.
+ */
+int session_make_key(session_key_t *key, const struct sockaddr *address, socklen_t address_len);
+
+/**
+ * @brief Finds the session of a client.
+ *
+ * @return session_t* The session, or NULL if the client has none.
+ */
+session_t *session_lookup(session_table_t *table, const session_key_t *key);
+
+/**
+ * @brief Finds the session of a client, creating a zeroed one if needed.
+ *
+ * @param table Session table.
+ * @param address Client address.
+ * @param address_len Length of the client address.
+ * @param[out] created Set to true if a new session was created.
+ * @return session_t* The session, or NULL if the table is full or the
+ *         address family is not supported.
+ */
+session_t *session_get(session_table_t *table, const struct sockaddr *address,
+                       socklen_t address_len, bool *created);
+
+/**
+ * @brief Removes a session from the table and releases it.
+ */
+void session_remove(session_table_t *table, session_t *session);
+
+/**
+ * @brief Removes an idle session from the table and releases it.
+ *
+ * Same as session_remove(), but the session is counted as evicted.
+ */
+void session_evict(session_table_t *table, session_t *session);
+
+#endif /* __SESSION_H__ */
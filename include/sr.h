@@ -38,8 +38,12 @@
 #include "../include/sleep.h"
 #include "../include/rdn_num.h"
 #include "../include/crc.h"
+#include "../include/checksum.h"
+#include "../include/codec.h"
+#include "../include/bitmap.h"
 
-#define MAX_BUFFER_SIZE 50
+#define SR_MIN_SLOTS    64      /* Smallest receive ring, one bitmap word */
+#define SR_MAX_SLOTS    65536   /* Largest receive ring */
 
 enum SR_Packet_ACK {
     NAK = -1,
@@ -47,17 +51,27 @@ enum SR_Packet_ACK {
 };
 
 /**
- * @brief Structure to hold received packets in the Selective Repeat protocol.
+ * @brief Ring of received packets in the Selective Repeat protocol.
  *
- * This struct maintains a buffer for storing received packets and tracking 
- * which packets have been successfully received.
+ * Packet seq is kept in slot seq & mask. The ring size is a power of two,
+ * so slots stay in order when the 32-bit sequence number wraps. The
+ * received flags are a bitmap, which lets delivery find the packets that
+ * are in order a word at a time. Memory is allocated on first use.
  *
- * @param received Boolean array indicating whether each packet has been received.
- * @param data Array storing the actual packet data.
+ * @param mask Number of slots - 1, 0 until allocated.
+ * @param slot_size Payload bytes per slot.
+ * @param received Bitmap of the slots that hold a packet.
+ * @param len Payload length of each slot.
+ * @param data Payload slots.
+ * @param count Packets buffered out of order.
  */
 typedef struct {
-    bool received[MAX_BUFFER_SIZE]; 
-    char data[MAX_BUFFER_SIZE];
+    uint32_t mask;
+    uint16_t slot_size;
+    uint64_t *received;
+    uint16_t *len;
+    char *data;
+    uint32_t count;
 } sr_receive_buffer_t;
 
 /**
@@ -65,43 +79,122 @@ typedef struct {
  *
  * This function extracts data from the received packet, calculates its CRC checksum, 
  * and verifies whether the packet is corrupted. If the packet passes the CRC check, 
- * the function returns the sequence number of the received packet. Otherwise, it 
+ * the sequence number and payload of the packet are in `frame`. Otherwise, it 
  * indicates an error.
  *
  * @param read Pointer to the received packet data.
  * @param bytes_received Number of bytes received in the packet.
+ * @param codec Encoding negotiated for the connection.
+ * @param rcv_base Receive window base, extends the sequence numbers of legacy frames.
+ * @param frame Filled with the sequence number and the payload of the packet.
  * 
- * @return The sequence number of the received packet if the CRC check passes.
+ * @return ACK (0) if the CRC check passes.
  * @return NAK (-1) if the CRC check fails, indicating a corrupted packet.
  */
-int sr_process_packet (char *read, long bytes_received);
+int sr_process_packet (char *read, long bytes_received, const codec_t *codec, uint32_t rcv_base,
+                       codec_frame_t *frame);
 
 /**
  * @brief Constructs an acknowledgment (ACK) packet with a sequence number and CRC checksum.
  *
- * This function creates an ACK packet by combining the sequence number, 
- * acknowledgment message, and CRC checksum into a formatted string.
+ * This function creates an ACK packet for one received sequence number
+ * and appends the checksum.
  *
- * @param packet A pointer to the buffer where the constructed ACK packet will be stored.
+ * @param packet Buffer of at least CODEC_ACK_MAX bytes.
  * @param seqnum The sequence number to be included in the ACK packet.
+ * @param codec Encoding negotiated for the connection.
  * 
  * @return The size of the created ACK packet.
  */
-int sr_make_packet(char *packet, uint8_t seqnum);
+int sr_make_packet(char *packet, uint32_t seqnum, const codec_t *codec);
+
+/**
+ * @brief Ring size for a receive window, the next power of two that holds it.
+ *
+ * @param window Receive window in packets.
+ * @return uint32_t Number of slots, between SR_MIN_SLOTS and SR_MAX_SLOTS.
+ */
+uint32_t sr_buffer_slots(uint32_t window);
+
+/**
+ * @brief Allocates the ring of a receive buffer, an existing ring is freed first.
+ *
+ * @param buffer The receive buffer.
+ * @param slots Number of slots, a power of two.
+ * @param slot_size Payload bytes per slot.
+ * 
+ * @return 0 on success, -1 if the allocation failed.
+ */
+int sr_buffer_init(sr_receive_buffer_t *buffer, uint32_t slots, uint16_t slot_size);
+
+/**
+ * @brief Checks if the slot of a sequence number holds a packet.
+ */
+static inline bool sr_buffer_has(const sr_receive_buffer_t *buffer, uint32_t seq)
+{
+    return buffer->received && bitmap_test(buffer->received, seq & buffer->mask);
+}
+
+/**
+ * @brief Payload slot of a sequence number, slot_size bytes.
+ */
+static inline char *sr_buffer_slot(sr_receive_buffer_t *buffer, uint32_t seq)
+{
+    return &buffer->data[(size_t)(seq & buffer->mask) * buffer->slot_size];
+}
+
+/**
+ * @brief Stores the payload of a received packet until it can be delivered.
+ *
+ * @param buffer The receive buffer, allocated with sr_buffer_init().
+ * @param seq Sequence number of the packet.
+ * @param payload Payload bytes.
+ * @param len Payload length, at most the slot size.
+ * @return int `0` when stored, `-1` if the payload does not fit a slot.
+ */
+int sr_buffer_store(sr_receive_buffer_t *buffer, uint32_t seq, const char *payload, uint16_t len);
+
+/**
+ * @brief Forgets every stored packet, the ring stays allocated.
+ */
+void sr_buffer_clear(sr_receive_buffer_t *buffer);
+
+/**
+ * @brief Frees the ring of a receive buffer.
+ */
+void sr_buffer_free(sr_receive_buffer_t *buffer);
+
+/**
+ * @brief Describes the packets buffered above the receive base as SACK blocks.
+ *
+ * The bitmap is searched a word at a time for runs of received packets,
+ * the lowest ones first since the sender resends the holes below them.
+ *
+ * @param buffer The receive buffer.
+ * @param recv_base First packet not received in order.
+ * @param window Receive window in packets.
+ * @param blocks Filled with the blocks.
+ * @param max_blocks Room in blocks.
+ * 
+ * @return Number of blocks.
+ */
+int sr_sack_blocks(const sr_receive_buffer_t *buffer, uint32_t recv_base, uint32_t window,
+                   codec_sack_t *blocks, int max_blocks);
 
 /**
  * @brief Delivers received packets from the receive buffer to the upper layer.
  *
- * This function iterates through the receive buffer, transferring packets 
- * that have been received in order to the provided data buffer. It updates 
- * the receive buffer state accordingly and marks packets as delivered.
+ * This function finds the run of packets received in order from recv_base
+ * with the bitmap and appends their payloads to the delivered stream
+ * straight from the slots. The cost grows with the number of packets
+ * delivered, not with the size of the ring.
  *
  * @param buffer The receive buffer containing received packets.
- * @param data A pointer to the buffer where the delivered data will be stored.
+ * @param stream The stream the payloads are delivered to.
  * @param recv_base The base sequence number of the first expected packet.
  * 
  * @return The updated base sequence number after delivering all available packets.
  */
-int deliver_data(sr_receive_buffer_t buffer, char *data, int recv_base);
+uint32_t deliver_data(sr_receive_buffer_t *buffer, codec_stream_t *stream, uint32_t recv_base);
 
 #endif
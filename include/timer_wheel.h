@@ -0,0 +1,107 @@
+/******************************************************************************
+  * @file           : timer_wheel.h
+  * @brief          : Hierarchical timing wheel of microsecond timers
+******************************************************************************/
+
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define TIMER_WHEEL_BITS    6                               /* Slots per level as a power of two */
+#define TIMER_WHEEL_SLOTS   (1 << TIMER_WHEEL_BITS)         /* Slots per level */
+#define TIMER_WHEEL_LEVELS  8                               /* Levels, 2^48 us (8.9 years) in total */
+#define TIMER_WHEEL_RANGE   (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))   /* Longest timeout */
+
+/* The structure a timer is embedded in, e.g. timer_entry(timer, session_t, idle_timer) */
+#define timer_entry(timer, type, member)    ((type *)((char *)(timer) - offsetof(type, member)))
+
+/**
+ * @brief A timer, embedded in the structure it belongs to.
+ *
+ * A zeroed timer is not armed, so timers in zeroed memory need no setup.
+ */
+typedef struct timer_node {
+    struct timer_node *next;    /**< Next timer in the slot. */
+    struct timer_node *prev;    /**< Previous timer in the slot. */
+    uint64_t expires_us;        /**< Monotonic time the timer fires. */
+    uint32_t slot;              /**< Slot + 1 while armed, 0 if not armed. */
+} timer_node_t;
+
+/**
+ * @brief Timers hashed into levels of 64 slots by how far ahead they fire.
+ *
+ * Level 0 has one slot per microsecond, every further level slots 64 times
+ * longer. Arming and cancelling a timer link or unlink it from a slot in
+ * O(1). When time reaches a slot of a higher level its timers are moved
+ * down to the level matching their remaining time, so a timer is moved at
+ * most once per level. A bitmap per level finds the next occupied slot
+ * without looking at empty ones.
+ */
+typedef struct {
+    uint64_t now_us;                                            /**< Time the wheel has advanced to. */
+    size_t count;                                               /**< Armed timers. */
+    uint64_t occupied[TIMER_WHEEL_LEVELS];                      /**< Bitmap of non-empty slots per level. */
+    timer_node_t slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS]; /**< List heads of the slots. */
+} timer_wheel_t;
+
+/**
+ * @brief Initializes an empty wheel.
+ *
+ * @param wheel Wheel to initialize.
+ * @param now_us Current monotonic time.
+ */
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now_us);
+
+/**
+ * @brief Arms a timer, or moves an armed timer to a new time.
+ *
+ * @param wheel The wheel.
+ * @param timer The timer.
+ * @param expires_us Monotonic time to fire, a time in the past fires on the
+ *        next advance. Timeouts beyond TIMER_WHEEL_RANGE are shortened.
+ */
+void timer_wheel_add(timer_wheel_t *wheel, timer_node_t *timer, uint64_t expires_us);
+
+/**
+ * @brief Disarms a timer, nothing happens if it is not armed.
+ */
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_node_t *timer);
+
+/**
+ * @brief Checks if a timer is armed.
+ */
+static inline bool timer_armed(const timer_node_t *timer)
+{
+    return timer->slot != 0;
+}
+
+/**
+ * @brief Earliest time the wheel has to be advanced.
+ *
+ * Timers on the higher levels are only known to the slot, so this may be
+ * before the first timer fires. Advancing early just moves them down.
+ *
+ * @return uint64_t The time, or UINT64_MAX if no timer is armed.
+ */
+uint64_t timer_wheel_next_us(const timer_wheel_t *wheel);
+
+/**
+ * @brief Fires every timer due at `now_us` in the order they expire.
+ *
+ * A fired timer is disarmed before its callback, which may arm it or any
+ * other timer again. A callback that keeps arming timers in the past keeps
+ * the advance going.
+ *
+ * @param wheel The wheel.
+ * @param now_us Current monotonic time.
+ * @param on_expire Called for every fired timer.
+ * @param ctx Passed to `on_expire`.
+ * @return size_t Number of timers fired.
+ */
+size_t timer_wheel_advance(timer_wheel_t *wheel, uint64_t now_us,
+                           void (*on_expire)(timer_node_t *timer, void *ctx), void *ctx);
+
+#endif /* __TIMER_WHEEL_H__ */
@@ -0,0 +1,139 @@
+/******************************************************************************
+  * @file           : uring_io.h
+  * @brief          : io_uring receive/ACK backend for the UDP server
+******************************************************************************/
+
+#ifndef __URING_IO_H__
+#define __URING_IO_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#define URING_IO_ENTRIES    256     /* Submission queue size, the completion queue is twice this */
+#define URING_IO_BUFFERS    512     /* Provided receive buffers, must be a power of two */
+#define URING_IO_BUF_SIZE   2048    /* Receive buffer: recvmsg header, peer address and payload */
+#define URING_IO_TX_SLOTS   1024    /* Replies that can be in flight at once */
+
+/**
+ * @brief Kind of completion returned by uring_io_next().
+ */
+enum Uring_event_type {
+    URING_EVENT_NONE,   /**< No more completions, call uring_io_wait(). */
+    URING_EVENT_RECV,   /**< A datagram was received. */
+    URING_EVENT_POLL    /**< The watched descriptor became readable. */
+};
+
+/**
+ * @brief A completion handed to the caller.
+ *
+ * For URING_EVENT_RECV the data and address point into a provided buffer
+ * which is returned to the kernel on the next uring_io_next() call.
+ */
+typedef struct {
+    int type;                   /**< One of enum Uring_event_type. */
+    char *data;                 /**< Received payload. */
+    long len;                   /**< Payload length. */
+    struct sockaddr *addr;      /**< Sender address. */
+    socklen_t addr_len;         /**< Sender address length. */
+} uring_io_event_t;
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+struct uring_tx_slot;
+
+/**
+ * @brief Rings, provided buffers and statistics of the io_uring backend.
+ */
+typedef struct {
+    int ring_fd;                        /**< io_uring file descriptor. */
+    int sock;                           /**< UDP socket served by the ring. */
+    int poll_fd;                        /**< Descriptor watched with multishot poll, or -1. */
+
+    void *sq_ring;                      /**< Mapped submission and completion rings. */
+    size_t sq_ring_size;                /**< Size of the ring mapping. */
+    struct io_uring_sqe *sqes;          /**< Mapped submission queue entries. */
+    size_t sqes_size;                   /**< Size of the entry mapping. */
+
+    unsigned int *sq_head;              /**< Submission ring head (kernel). */
+    unsigned int *sq_tail;              /**< Submission ring tail (us). */
+    unsigned int *sq_array;             /**< Submission index array. */
+    unsigned int sq_mask;               /**< Submission ring mask. */
+    unsigned int sq_entries;            /**< Submission ring size. */
+    unsigned int *cq_head;              /**< Completion ring head (us). */
+    unsigned int *cq_tail;              /**< Completion ring tail (kernel). */
+    unsigned int cq_mask;               /**< Completion ring mask. */
+    struct io_uring_cqe *cqes;          /**< Completion entries. */
+    unsigned int to_submit;             /**< Entries prepared but not yet submitted. */
+
+    struct io_uring_buf_ring *buf_ring; /**< Provided buffer ring shared with the kernel. */
+    char *buffers;                      /**< URING_IO_BUFFERS * URING_IO_BUF_SIZE bytes. */
+    struct msghdr recv_msg;             /**< Template for the multishot recvmsg. */
+    int pending_bid;                    /**< Buffer to recycle on the next call, or -1. */
+
+    struct uring_tx_slot *tx_slots;     /**< Reply slots. */
+    unsigned int *tx_free;              /**< Stack of free reply slot indexes. */
+    unsigned int tx_free_count;         /**< Number of free reply slots. */
+
+    unsigned long waits;                /**< io_uring_enter() calls that waited. */
+    unsigned long rx_datagrams;         /**< Datagrams received. */
+    unsigned long tx_datagrams;         /**< Replies completed. */
+    unsigned long tx_overruns;          /**< Replies dropped because all slots were busy. */
+    unsigned long rx_rearms;            /**< Times the multishot receive had to be re-posted. */
+} uring_io_t;
+
+/**
+ * @brief Sets up the ring, registers the provided buffers and posts the multishot receive.
+ *
+ * @param uring Backend state.
+ * @param sock UDP socket to receive from and reply on.
+ * @param poll_fd Descriptor to watch for readability, for example the
+ *                event loop's epoll fd, or `-1`.
+ * @return int `0` on success, `-1` with errno set if the kernel lacks
+ *         io_uring, provided buffer rings or multishot recvmsg.
+ */
+int uring_io_init(uring_io_t *uring, int sock, int poll_fd);
+
+/**
+ * @brief Cancels outstanding requests and releases the ring.
+ */
+void uring_io_free(uring_io_t *uring);
+
+/**
+ * @brief Submits the queued replies and waits for at least one completion.
+ *
+ * @return int `0` on success, `-1` on error.
+ */
+int uring_io_wait(uring_io_t *uring);
+
+/**
+ * @brief Pops the next completion.
+ *
+ * Send completions and re-arming of the multishot requests are handled
+ * internally, only received datagrams and poll events are returned.
+ *
+ * @param uring Backend state.
+ * @param[out] event The completion.
+ * @return int The event type, URING_EVENT_NONE when the queue is empty.
+ */
+int uring_io_next(uring_io_t *uring, uring_io_event_t *event);
+
+/**
+ * @brief Copies a reply into a send slot and prepares a sendmsg request for it.
+ *
+ * The request is submitted in bulk by the next uring_io_wait() or uring_io_submit().
+ *
+ * @return int `0` on success, `-1` if the reply is too large or no slot was free.
+ */
+int uring_io_queue(uring_io_t *uring, const char *packet, size_t len,
+                   const struct sockaddr *addr, socklen_t addr_len);
+
+/**
+ * @brief Submits the prepared requests without waiting.
+ *
+ * @return int Number of requests submitted, or `-1` on error.
+ */
+int uring_io_submit(uring_io_t *uring);
+
+#endif /* __URING_IO_H__ */
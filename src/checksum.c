@@ -0,0 +1,87 @@
+/******************************************
+ *
+ * Filename:    checksum.c
+ *
+ * Description: Pluggable packet checksums. CRC-8 is kept for the RDT test
+ *              application and older clients, CRC32C is used when both
+ *              peers agree on it.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/checksum.h"
+#include "../include/crc.h"
+#include "../include/crc32c.h"
+
+static uint32_t checksum_crc8(const void *data, size_t len)
+{
+    return crcFast(data, (int)len);
+} /* checksum_crc8() */
+
+static uint32_t checksum_crc32c(const void *data, size_t len)
+{
+    return crc32c(0, data, len);
+} /* checksum_crc32c() */
+
+static const checksum_t checksums[CHECKSUM_TYPES] = {
+    [CHECKSUM_CRC8] = { "crc8", CHECKSUM_CRC8, 1, checksum_crc8 },
+    [CHECKSUM_CRC32C] = { "crc32c", CHECKSUM_CRC32C, 4, checksum_crc32c },
+};
+
+const checksum_t *checksum_get(int type)
+{
+    if (type < 0 || type >= CHECKSUM_TYPES) {
+        return NULL;
+    }
+
+    return &checksums[type];
+} /* checksum_get() */
+
+int checksum_parse(const char *name)
+{
+    for (int type = 0; type < CHECKSUM_TYPES; ++type) {
+        if (strcmp(checksums[type].name, name) == 0) {
+            return type;
+        }
+    }
+
+    return -1;
+} /* checksum_parse() */
+
+size_t checksum_seal(int type, char *packet, size_t len)
+{
+    const checksum_t *checksum = checksum_get(type);
+    if (!checksum) {
+        checksum = &checksums[CHECKSUM_CRC8];
+    }
+
+    uint32_t value = checksum->compute(packet, len);
+    for (uint8_t i = 0; i < checksum->size; ++i) {
+        packet[len + i] = (char)(value >> (8 * i));
+    }
+
+    return len + checksum->size;
+} /* checksum_seal() */
+
+bool checksum_verify(int type, const char *packet, size_t len)
+{
+    const checksum_t *checksum = checksum_get(type);
+    if (!checksum) {
+        checksum = &checksums[CHECKSUM_CRC8];
+    }
+    if (len < checksum->size) {
+        return false;
+    }
+
+    len -= checksum->size;
+    uint32_t received = 0;
+    for (uint8_t i = 0; i < checksum->size; ++i) {
+        received |= (uint32_t)(uint8_t)packet[len + i] << (8 * i);
+    }
+
+    return checksum->compute(packet, len) == received;
+} /* checksum_verify() */
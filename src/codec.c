@@ -0,0 +1,370 @@
+/******************************************
+ *
+ * Filename:    codec.c
+ *
+ * Description: Frames shared by the clients and the server. The HELLO
+ *              frame negotiates which checksum protects the packets of a
+ *              connection, how much payload a data frame carries and
+ *              whether the binary header is used. Headers are written
+ *              with direct big endian stores, nothing is formatted or
+ *              allocated per packet.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/random.h>
+
+#include "../include/codec.h"
+#include "../include/crc32c.h"
+
+// Legacy teardown frame, CRC-8 of 0 | '0'
+static const char legacy_fin[3] = { 0, '0', (char)0x90 };
+
+size_t codec_make_hello(char *packet, const uint8_t *types, int n_types, const codec_t *codec)
+{
+    if (n_types > CHECKSUM_TYPES) {
+        n_types = CHECKSUM_TYPES;
+    }
+
+    packet[0] = (char)CODEC_HELLO_SEQ;
+    packet[1] = 'H';
+    packet[2] = 'L';
+    packet[3] = (char)n_types;
+    memcpy(&packet[4], types, n_types);
+    size_t len = 4 + n_types;
+
+    if (codec->version > 0) {
+        codec_put16(&packet[len], codec->max_payload);
+        packet[len + 2] = (char)codec->version;
+        codec_put32(&packet[len + 3], codec->conn_id);
+        codec_put32(&packet[len + 7], codec->isn);
+        codec_put32(&packet[len + 11], codec->window);
+        packet[len + 15] = (char)codec->features;
+        len += CODEC_HELLO_EXT;
+    }
+
+    return checksum_seal(CHECKSUM_CRC8, packet, len);
+} /* codec_make_hello() */
+
+int codec_parse_hello(const char *packet, size_t len, uint8_t *types, int max_types, codec_t *codec)
+{
+    if (len < 5 || (uint8_t)packet[0] != CODEC_HELLO_SEQ || packet[1] != 'H' || packet[2] != 'L') {
+        return -1;
+    }
+
+    int n_types = (uint8_t)packet[3];
+    size_t ext = 4 + (size_t)n_types;
+    if ((len != ext + 1 && len != ext + CODEC_HELLO_EXT_V1 + 1 && len != ext + CODEC_HELLO_EXT_WIN + 1 &&
+         len != ext + CODEC_HELLO_EXT + 1) ||
+        !checksum_verify(CHECKSUM_CRC8, packet, len)) {
+        return -1;
+    }
+
+    codec->version = 0;
+    codec->max_payload = 1;
+    codec->conn_id = 0;
+    codec->isn = 1;
+    codec->window = CODEC_DEFAULT_WINDOW;
+    codec->features = 0;
+    if (len > ext + 1) {
+        codec->max_payload = codec_get16(&packet[ext]);
+        codec->version = (uint8_t)packet[ext + 2];
+        codec->conn_id = codec_get32(&packet[ext + 3]);
+        codec->isn = codec_get32(&packet[ext + 7]);
+    }
+    if (len >= ext + CODEC_HELLO_EXT_WIN + 1) {
+        codec->window = codec_get32(&packet[ext + 11]);
+    }
+    if (len == ext + CODEC_HELLO_EXT + 1) {
+        codec->features = (uint8_t)packet[ext + 15];
+    }
+
+    if (n_types > max_types) {
+        n_types = max_types;
+    }
+    memcpy(types, &packet[4], n_types);
+
+    return n_types;
+} /* codec_parse_hello() */
+
+int codec_choose_checksum(const uint8_t *offered, int n_offered, unsigned int allowed)
+{
+    for (int i = 0; i < n_offered; ++i) {
+        if (offered[i] < CHECKSUM_TYPES && (allowed & (1u << offered[i]))) {
+            return offered[i];
+        }
+    }
+
+    return CHECKSUM_CRC8;
+} /* codec_choose_checksum() */
+
+uint32_t codec_random32(void)
+{
+    uint32_t value = 0;
+
+    if (getrandom(&value, sizeof(value), GRND_NONBLOCK) != sizeof(value)) {
+        // No entropy yet, mixing time and pid is enough to tell connections apart
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint32_t seed[3] = { (uint32_t)now.tv_sec, (uint32_t)now.tv_nsec, (uint32_t)getpid() };
+        value = crc32c(0, seed, sizeof(seed));
+    }
+
+    return value;
+} /* codec_random32() */
+
+int codec_negotiate(int socket, const uint8_t *types, int n_types, int timeout_ms, int tries,
+                    codec_t *codec)
+{
+    char hello[CODEC_HELLO_MAX];
+    codec->version = CODEC_VERSION;
+    size_t len = codec_make_hello(hello, types, n_types, codec);
+    struct pollfd fd = { .fd = socket, .events = POLLIN };
+    codec_t proposed = *codec;
+
+    codec->version = 0;
+    codec->checksum = CHECKSUM_CRC8;
+    codec->max_payload = 1;
+    codec->conn_id = 0;
+    codec->isn = 1;
+    codec->window = CODEC_DEFAULT_WINDOW;
+    codec->features = 0;
+
+    for (int i = 0; i < tries; ++i) {
+        if (send(socket, hello, len, 0) < 0) {
+            return -1;
+        }
+        if (poll(&fd, 1, timeout_ms) < 1) {
+            continue;
+        }
+
+        char reply[64];
+        long bytes_received = recv(socket, reply, sizeof(reply), 0);
+        if (bytes_received < 0) {
+            return -1;
+        }
+
+        uint8_t chosen = CHECKSUM_CRC8;
+        codec_t accepted;
+        if (codec_parse_hello(reply, bytes_received, &chosen, 1, &accepted) == 1 && chosen < CHECKSUM_TYPES) {
+            codec->checksum = chosen;
+
+            // The binary header is only used if the server echoes the connection
+            if (accepted.version == CODEC_VERSION && accepted.conn_id == proposed.conn_id &&
+                accepted.isn == proposed.isn && accepted.max_payload > 0) {
+                *codec = accepted;
+                codec->checksum = chosen;
+                if (codec->max_payload > proposed.max_payload) {
+                    codec->max_payload = proposed.max_payload;
+                }
+                if (codec->window < 1 || codec->window > proposed.window) {
+                    codec->window = proposed.window;
+                }
+                codec->features &= proposed.features;
+            }
+        }
+
+        return 0;
+    }
+
+    return 0;
+} /* codec_negotiate() */
+
+/**
+ * @brief Writes the version 1 header, every field is a direct big endian store.
+ */
+static size_t codec_put_header(char *packet, uint8_t type, uint8_t flags, uint16_t len, uint32_t conn_id,
+                               uint32_t seq, uint32_t ack)
+{
+    packet[0] = (char)(CODEC_VERSION << 4 | type);
+    packet[1] = (char)flags;
+    codec_put16(&packet[2], len);
+    codec_put32(&packet[4], conn_id);
+    codec_put32(&packet[8], seq);
+    codec_put32(&packet[12], ack);
+
+    return CODEC_HEADER_SIZE;
+} /* codec_put_header() */
+
+size_t codec_make_frame(const codec_t *codec, char *packet, uint32_t seq, const char *payload, uint16_t len)
+{
+    size_t header = 1;
+
+    if (codec->version == CODEC_VERSION) {
+        header = codec_put_header(packet, CODEC_DATA, 0, len, codec->conn_id, seq, 0);
+    }
+    else {
+        packet[0] = (char)seq;
+    }
+    memcpy(&packet[header], payload, len);
+
+    return checksum_seal(codec->checksum, packet, header + len);
+} /* codec_make_frame() */
+
+size_t codec_frame_size(const codec_t *codec)
+{
+    const checksum_t *checksum = checksum_get(codec->checksum);
+    size_t header = (codec->version == CODEC_VERSION) ? CODEC_HEADER_SIZE : 1;
+
+    return header + codec->max_payload + (checksum ? checksum->size : 1);
+} /* codec_frame_size() */
+
+/**
+ * @brief Builds an ACK or NAK, the legacy frame spells out the type after the sequence number.
+ */
+static size_t codec_make_reply(const codec_t *codec, char *packet, uint8_t type, uint32_t ack)
+{
+    if (codec->version == CODEC_VERSION) {
+        size_t header = codec_put_header(packet, type, 0, 0, codec->conn_id, 0, ack);
+        return checksum_seal(codec->checksum, packet, header);
+    }
+
+    packet[0] = (char)ack;
+    memcpy(&packet[1], (type == CODEC_NAK) ? "NAK" : "ACK", 3);
+
+    return checksum_seal(codec->checksum, packet, 4);
+} /* codec_make_reply() */
+
+size_t codec_make_ack(const codec_t *codec, char *packet, uint32_t ack)
+{
+    return codec_make_reply(codec, packet, CODEC_ACK, ack);
+} /* codec_make_ack() */
+
+size_t codec_make_nak(const codec_t *codec, char *packet, uint32_t nak)
+{
+    return codec_make_reply(codec, packet, CODEC_NAK, nak);
+} /* codec_make_nak() */
+
+size_t codec_make_sack(const codec_t *codec, char *packet, uint32_t ack, uint32_t seq,
+                       const codec_sack_t *blocks, int n_blocks)
+{
+    if (n_blocks > CODEC_SACK_BLOCKS) {
+        n_blocks = CODEC_SACK_BLOCKS;
+    }
+
+    size_t len = codec_put_header(packet, CODEC_ACK, CODEC_FLAG_SACK, (uint16_t)(n_blocks * 8),
+                                  codec->conn_id, seq, ack);
+    for (int i = 0; i < n_blocks; ++i) {
+        codec_put32(&packet[len], blocks[i].start);
+        codec_put32(&packet[len + 4], blocks[i].end);
+        len += 8;
+    }
+
+    return checksum_seal(codec->checksum, packet, len);
+} /* codec_make_sack() */
+
+int codec_parse_sack(const codec_frame_t *frame, codec_sack_t *blocks, int max_blocks)
+{
+    if (frame->type != CODEC_ACK || !(frame->flags & CODEC_FLAG_SACK)) {
+        return 0;
+    }
+
+    int n_blocks = frame->len / 8;
+    if (n_blocks > max_blocks) {
+        n_blocks = max_blocks;
+    }
+    for (int i = 0; i < n_blocks; ++i) {
+        blocks[i].start = codec_get32(&frame->payload[i * 8]);
+        blocks[i].end = codec_get32(&frame->payload[i * 8 + 4]);
+    }
+
+    return n_blocks;
+} /* codec_parse_sack() */
+
+size_t codec_make_fin(const codec_t *codec, char *packet)
+{
+    if (codec->version == CODEC_VERSION) {
+        size_t header = codec_put_header(packet, CODEC_FIN, 0, 0, codec->conn_id, 0, 0);
+        return checksum_seal(codec->checksum, packet, header);
+    }
+
+    memcpy(packet, legacy_fin, sizeof(legacy_fin));
+
+    return sizeof(legacy_fin);
+} /* codec_make_fin() */
+
+bool codec_is_fin(const codec_t *codec, const char *packet, size_t len)
+{
+    if (len >= sizeof(legacy_fin) && memcmp(packet, legacy_fin, sizeof(legacy_fin)) == 0) {
+        return true;
+    }
+    if (codec->version != CODEC_VERSION || len < CODEC_HEADER_SIZE ||
+        packet[0] != (char)(CODEC_VERSION << 4 | CODEC_FIN)) {
+        return false;
+    }
+
+    codec_frame_t frame;
+    return codec_parse_frame(codec, packet, len, 0, &frame);
+} /* codec_is_fin() */
+
+bool codec_maybe_fin(const char *packet, size_t len)
+{
+    if (len >= sizeof(legacy_fin) && memcmp(packet, legacy_fin, sizeof(legacy_fin)) == 0) {
+        return true;
+    }
+
+    return len >= CODEC_HEADER_SIZE && packet[0] == (char)(CODEC_VERSION << 4 | CODEC_FIN);
+} /* codec_maybe_fin() */
+
+bool codec_parse_frame(const codec_t *codec, const char *packet, size_t len, uint32_t expected,
+                       codec_frame_t *frame)
+{
+    const checksum_t *checksum = checksum_get(codec->checksum);
+    size_t trailer = checksum ? checksum->size : 1;
+
+    if (codec->version == CODEC_VERSION) {
+        if (len < CODEC_HEADER_SIZE + trailer || ((uint8_t)packet[0] >> 4) != CODEC_VERSION ||
+            !checksum_verify(codec->checksum, packet, len)) {
+            return false;
+        }
+
+        frame->type = (uint8_t)packet[0] & 0x0F;
+        frame->flags = (uint8_t)packet[1];
+        frame->len = codec_get16(&packet[2]);
+        frame->seq = codec_get32(&packet[8]);
+        frame->ack = codec_get32(&packet[12]);
+        frame->payload = &packet[CODEC_HEADER_SIZE];
+
+        // A stale connection id or a length that disagrees with the datagram is not ours
+        return codec_get32(&packet[4]) == codec->conn_id &&
+               frame->len == len - CODEC_HEADER_SIZE - trailer;
+    }
+
+    if (len < 1 + trailer || !checksum_verify(codec->checksum, packet, len)) {
+        return false;
+    }
+
+    // The full sequence number closest to the expected one with the same low byte
+    frame->seq = expected + (uint32_t)(int8_t)((uint8_t)packet[0] - (uint8_t)expected);
+    frame->ack = frame->seq;
+    frame->flags = 0;
+    frame->payload = &packet[1];
+    frame->len = (uint16_t)(len - 1 - trailer);
+    frame->type = CODEC_DATA;
+    if (frame->len == 3 && memcmp(frame->payload, "ACK", 3) == 0) {
+        frame->type = CODEC_ACK;
+    }
+    else if (frame->len == 3 && memcmp(frame->payload, "NAK", 3) == 0) {
+        frame->type = CODEC_NAK;
+    }
+
+    return true;
+} /* codec_parse_frame() */
+
+void codec_stream_append(codec_stream_t *stream, const char *data, size_t len)
+{
+    if (stream->bytes < CODEC_STREAM_HEAD) {
+        size_t n = CODEC_STREAM_HEAD - stream->bytes;
+        memcpy(&stream->head[stream->bytes], data, (len < n) ? len : n);
+    }
+
+    stream->crc = crc32c(stream->crc, data, len);
+    stream->bytes += len;
+} /* codec_stream_append() */
@@ -0,0 +1,200 @@
+/******************************************
+ *
+ * Filename:    congestion.c
+ *
+ * Description: Pluggable congestion control of the window-based clients.
+ *              Slow start, fast recovery and timeouts are shared, NewReno
+ *              and CUBIC differ in congestion avoidance and in the window
+ *              they keep after a loss.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <string.h>
+#include <math.h>
+
+#include "../include/congestion.h"
+
+#define CUBIC_C         0.4     /* Scaling of the cubic growth, packets per second^3 */
+#define CUBIC_BETA      0.7     /* Window kept after a loss */
+#define CUBIC_MAX_STEP  1.5     /* Largest growth of the target per RTT */
+
+static double newreno_ssthresh(congestion_t *cc)
+{
+    return cc->cwnd / 2.0;
+} /* newreno_ssthresh() */
+
+static void newreno_avoid(congestion_t *cc, uint32_t acked, __attribute__((unused)) uint64_t now_us,
+                          __attribute__((unused)) uint64_t srtt_us)
+{
+    // One packet per window of ACKs, one packet per RTT
+    cc->cwnd += (double)acked / cc->cwnd;
+} /* newreno_avoid() */
+
+static double cubic_ssthresh(congestion_t *cc)
+{
+    // Fast convergence: a flow that lost below its last maximum leaves room for newer flows
+    if (cc->cwnd < cc->w_max) {
+        cc->w_max = cc->cwnd * (1.0 + CUBIC_BETA) / 2.0;
+    }
+    else cc->w_max = cc->cwnd;
+    cc->epoch_us = 0;
+
+    return cc->cwnd * CUBIC_BETA;
+} /* cubic_ssthresh() */
+
+/**
+ * @brief Grows the window along W(t) = C (t - K)^3 + W_max.
+ *
+ * The window is concave below the window of the last loss and convex
+ * above it. Where NewReno would be faster, e.g. on short RTTs, the
+ * window follows the NewReno estimate instead.
+ */
+static void cubic_avoid(congestion_t *cc, uint32_t acked, uint64_t now_us, uint64_t srtt_us)
+{
+    if (cc->epoch_us == 0) {
+        cc->epoch_us = now_us;
+        if (cc->cwnd < cc->w_max) {
+            cc->k_s = cbrt((cc->w_max - cc->cwnd) / CUBIC_C);
+        }
+        else {
+            cc->k_s = 0.0;
+            cc->w_max = cc->cwnd;
+        }
+        cc->w_est = cc->cwnd;
+    }
+
+    // The target is the window one RTT ahead
+    double t_s = (now_us - cc->epoch_us + srtt_us) / 1e6 - cc->k_s;
+    double target = cc->w_max + CUBIC_C * t_s * t_s * t_s;
+
+    cc->w_est += 3.0 * (1.0 - CUBIC_BETA) / (1.0 + CUBIC_BETA) * acked / cc->cwnd;
+    if (target < cc->w_est) {
+        target = cc->w_est;
+    }
+    if (target > cc->cwnd * CUBIC_MAX_STEP) {
+        target = cc->cwnd * CUBIC_MAX_STEP;
+    }
+
+    if (target > cc->cwnd) {
+        cc->cwnd += (target - cc->cwnd) / cc->cwnd * acked;
+    }
+    else cc->cwnd += 0.01 * acked / cc->cwnd;
+} /* cubic_avoid() */
+
+static const congestion_ops_t algorithms[CONGESTION_TYPES] = {
+    [CONGESTION_FIXED] = { "fixed", CONGESTION_FIXED, NULL, NULL },
+    [CONGESTION_NEWRENO] = { "newreno", CONGESTION_NEWRENO, newreno_avoid, newreno_ssthresh },
+    [CONGESTION_CUBIC] = { "cubic", CONGESTION_CUBIC, cubic_avoid, cubic_ssthresh },
+};
+
+const congestion_ops_t *congestion_get(int type)
+{
+    if (type < 0 || type >= CONGESTION_TYPES) {
+        return NULL;
+    }
+
+    return &algorithms[type];
+} /* congestion_get() */
+
+int congestion_parse(const char *name)
+{
+    for (int type = 0; type < CONGESTION_TYPES; ++type) {
+        if (strcmp(algorithms[type].name, name) == 0) {
+            return type;
+        }
+    }
+
+    return -1;
+} /* congestion_parse() */
+
+void congestion_init(congestion_t *cc, int type, uint32_t max_window)
+{
+    memset(cc, 0, sizeof(*cc));
+    cc->ops = congestion_get(type);
+    if (!cc->ops) {
+        cc->ops = &algorithms[CONGESTION_FIXED];
+    }
+    cc->max_window = (max_window < 1) ? 1 : max_window;
+    cc->ssthresh = cc->max_window;
+
+    // Without an algorithm the whole receiver window is used from the start
+    cc->cwnd = cc->ops->ssthresh ? CONGESTION_INITIAL_WINDOW : cc->max_window;
+    if (cc->cwnd > cc->max_window) {
+        cc->cwnd = cc->max_window;
+    }
+} /* congestion_init() */
+
+void congestion_on_ack(congestion_t *cc, uint64_t acked, uint64_t base, uint64_t now_us, uint64_t srtt_us)
+{
+    if (!cc->ops->ssthresh || acked == 0) {
+        return;
+    }
+    if (cc->in_recovery) {
+        if (base < cc->recover) {
+            return;
+        }
+        cc->in_recovery = false;
+    }
+
+    if (cc->cwnd < cc->ssthresh) {
+        cc->cwnd += acked;
+    }
+    else if (cc->ops->avoid) {
+        cc->ops->avoid(cc, (uint32_t)acked, now_us, srtt_us);
+    }
+
+    // A window the receiver does not allow is never used, so it does not grow past it
+    if (cc->cwnd > cc->max_window) {
+        cc->cwnd = cc->max_window;
+    }
+} /* congestion_on_ack() */
+
+void congestion_on_loss(congestion_t *cc, uint64_t lost, uint64_t next)
+{
+    if (!cc->ops->ssthresh || lost < cc->recover) {
+        return;
+    }
+
+    cc->ssthresh = cc->ops->ssthresh(cc);
+    if (cc->ssthresh < CONGESTION_MIN_WINDOW) {
+        cc->ssthresh = CONGESTION_MIN_WINDOW;
+    }
+    cc->cwnd = cc->ssthresh;
+    cc->recover = next;
+    cc->in_recovery = true;
+    cc->losses++;
+} /* congestion_on_loss() */
+
+void congestion_on_timeout(congestion_t *cc, uint64_t base, uint64_t next)
+{
+    cc->timeouts++;
+    if (!cc->ops->ssthresh) {
+        return;
+    }
+
+    // Repeated timeouts of the same window only shrink it once
+    if (base >= cc->recover) {
+        cc->ssthresh = cc->ops->ssthresh(cc);
+        if (cc->ssthresh < CONGESTION_MIN_WINDOW) {
+            cc->ssthresh = CONGESTION_MIN_WINDOW;
+        }
+        cc->losses++;
+    }
+    cc->cwnd = CONGESTION_LOSS_WINDOW;
+    cc->recover = next;
+    cc->in_recovery = false;
+    cc->epoch_us = 0;
+} /* congestion_on_timeout() */
+
+double congestion_pacing_rate(const congestion_t *cc, uint64_t srtt_us, size_t packet_bytes)
+{
+    if (srtt_us == 0) {
+        return 0.0;
+    }
+
+    double gain = (cc->cwnd < cc->ssthresh) ? CONGESTION_PACING_SS_GAIN : CONGESTION_PACING_CA_GAIN;
+
+    return gain * congestion_window(cc) * packet_bytes * 1e6 / srtt_us;
+} /* congestion_pacing_rate() */
@@ -2,7 +2,8 @@
  * 
  * Filename:    crc.c
  * 
- * Description: Fast implementation of CRC8
+ * Description: Fast implementation of CRC8. The lookup table is built
+ *              at compile time.
  * 
  * Notes:       Based on Michael Barr's CRC8 examples: 
  *              https://barrgroup.com/blog/crc-series-part-3-crc-implementation-code-cc
@@ -15,27 +16,18 @@
 #include <string.h>
 
 #include "../include/crc.h"
-
-void crcInit(void)
-{
-    crc remainder;
-
-    for (int dividend = 0; dividend < 256; ++dividend) {
-        remainder = dividend << (WIDTH - 8);
-
-        for (uint8_t bit = 8; bit > 0; --bit) {
-            if (remainder & TOPBIT) {
-                remainder = (remainder << 1) ^ POLYNOMIAL;
-            }
-            else {
-                remainder = (remainder << 1);
-            }
-        }
-
-        crcTable[dividend] = remainder;
-
-    }
-}   /* crcInit */
+#include "../include/crc_table.h"
+
+/*
+ * Entry of a byte with only bit b set is x^(b + 8) mod POLYNOMIAL, the entry
+ * of any other byte is the XOR of the entries of its bits.
+ */
+#define CRC8_ENTRY(k, i) (crc)(CRC_TABLE_BIT(i, 0, 0x07) ^ CRC_TABLE_BIT(i, 1, 0x0e) ^ \
+                               CRC_TABLE_BIT(i, 2, 0x1c) ^ CRC_TABLE_BIT(i, 3, 0x38) ^ \
+                               CRC_TABLE_BIT(i, 4, 0x70) ^ CRC_TABLE_BIT(i, 5, 0xe0) ^ \
+                               CRC_TABLE_BIT(i, 6, 0xc7) ^ CRC_TABLE_BIT(i, 7, 0x89))
+
+const crc crcTable[256] = CRC_TABLE_256(CRC8_ENTRY, 0);
 
 crc crcFast (uint8_t const message[], int nBytes) 
 {
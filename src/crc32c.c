@@ -0,0 +1,257 @@
+/******************************************
+ *
+ * Filename:    crc32c.c
+ *
+ * Description: CRC32C (Castagnoli) engines. The portable engine uses
+ *              slicing-by-8 tables built at compile time, on x86-64 the
+ *              SSE4.2 crc32 instruction is used, and with PCLMULQDQ three
+ *              independent crc32 streams run in parallel and are joined
+ *              with carry-less multiplication.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/crc32c.h"
+#include "../include/crc_table.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#define CRC32C_X86  1
+#endif
+
+/*
+ * Table k gives the CRC of a byte followed by k zero bytes. The entry of a
+ * byte with only bit b set is x^(39 - b + 8k) mod P, bit reflected.
+ */
+#define CRC32C_BASIS_0  0xf26b8303u, 0xe13b70f7u, 0xc79a971fu, 0x8ad958cfu, 0x105ec76fu, 0x20bd8edeu, 0x417b1dbcu, 0x82f63b78u
+#define CRC32C_BASIS_1  0x13a29877u, 0x274530eeu, 0x4e8a61dcu, 0x9d14c3b8u, 0x3fc5f181u, 0x7f8be302u, 0xff17c604u, 0xfbc3faf9u
+#define CRC32C_BASIS_2  0xa541927eu, 0x4f6f520du, 0x9edea41au, 0x38513ec5u, 0x70a27d8au, 0xe144fb14u, 0xc76580d9u, 0x8b277743u
+#define CRC32C_BASIS_3  0xdd45aab8u, 0xbf672381u, 0x7b2231f3u, 0xf64463e6u, 0xe964b13du, 0xd725148bu, 0xaba65fe7u, 0x52a0c93fu
+#define CRC32C_BASIS_4  0x38116facu, 0x7022df58u, 0xe045beb0u, 0xc5670b91u, 0x8f2261d3u, 0x1ba8b557u, 0x37516aaeu, 0x6ea2d55cu
+#define CRC32C_BASIS_5  0xef306b19u, 0xdb8ca0c3u, 0xb2f53777u, 0x6006181fu, 0xc00c303eu, 0x85f4168du, 0x0e045bebu, 0x1c08b7d6u
+#define CRC32C_BASIS_6  0x68032cc8u, 0xd0065990u, 0xa5e0c5d1u, 0x4e2dfd53u, 0x9c5bfaa6u, 0x3d5b83bdu, 0x7ab7077au, 0xf56e0ef4u
+#define CRC32C_BASIS_7  0x493c7d27u, 0x9278fa4eu, 0x211d826du, 0x423b04dau, 0x847609b4u, 0x0d006599u, 0x1a00cb32u, 0x34019664u
+
+#define CRC32C_SUM_(i, b0, b1, b2, b3, b4, b5, b6, b7) \
+    (CRC_TABLE_BIT(i, 0, b0) ^ CRC_TABLE_BIT(i, 1, b1) ^ CRC_TABLE_BIT(i, 2, b2) ^ CRC_TABLE_BIT(i, 3, b3) ^ \
+     CRC_TABLE_BIT(i, 4, b4) ^ CRC_TABLE_BIT(i, 5, b5) ^ CRC_TABLE_BIT(i, 6, b6) ^ CRC_TABLE_BIT(i, 7, b7))
+#define CRC32C_SUM(i, basis)    CRC32C_SUM_(i, basis)
+#define CRC32C_ENTRY(k, i)      CRC32C_SUM(i, CRC32C_BASIS_##k)
+
+static const uint32_t crc32c_table[8][256] = {
+    CRC_TABLE_256(CRC32C_ENTRY, 0), CRC_TABLE_256(CRC32C_ENTRY, 1),
+    CRC_TABLE_256(CRC32C_ENTRY, 2), CRC_TABLE_256(CRC32C_ENTRY, 3),
+    CRC_TABLE_256(CRC32C_ENTRY, 4), CRC_TABLE_256(CRC32C_ENTRY, 5),
+    CRC_TABLE_256(CRC32C_ENTRY, 6), CRC_TABLE_256(CRC32C_ENTRY, 7)
+};
+
+uint32_t crc32c_sw(uint32_t seed, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint32_t c = ~seed;
+
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        c = crc32c_table[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+        len--;
+    }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // The first byte of the word is the lowest one and is followed by seven more
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        word ^= c;
+        c = crc32c_table[7][word & 0xff] ^
+            crc32c_table[6][(word >> 8) & 0xff] ^
+            crc32c_table[5][(word >> 16) & 0xff] ^
+            crc32c_table[4][(word >> 24) & 0xff] ^
+            crc32c_table[3][(word >> 32) & 0xff] ^
+            crc32c_table[2][(word >> 40) & 0xff] ^
+            crc32c_table[1][(word >> 48) & 0xff] ^
+            crc32c_table[0][word >> 56];
+        p += 8;
+        len -= 8;
+    }
+#endif
+
+    while (len > 0) {
+        c = crc32c_table[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+        len--;
+    }
+
+    return ~c;
+} /* crc32c_sw() */
+
+#ifdef CRC32C_X86
+
+/*
+ * Three streams of CRC32C_LONG or CRC32C_SHORT bytes are computed at the same
+ * time to hide the latency of the crc32 instruction. Shifting a CRC over n zero
+ * bytes is a multiplication by x^(8n) mod P, done as a carry-less multiply by
+ * x^(8n - 33) mod P followed by one crc32 of the 64-bit product.
+ */
+#define CRC32C_LONG         1024
+#define CRC32C_SHORT        128
+#define CRC32C_SHIFT_1024   0x170076fau     /* x^(8 * 1024 - 33) mod P */
+#define CRC32C_SHIFT_2048   0xa51b6135u     /* x^(8 * 2048 - 33) mod P */
+#define CRC32C_SHIFT_128    0x0d3b6092u     /* x^(8 * 128 - 33) mod P */
+#define CRC32C_SHIFT_256    0xb9e02b86u     /* x^(8 * 256 - 33) mod P */
+
+__attribute__((target("sse4.2")))
+static inline uint64_t crc32c_hw_words(uint64_t c, const uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+    }
+
+    return c;
+} /* crc32c_hw_words() */
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t seed, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint64_t c = (uint32_t)~seed;
+
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        len--;
+    }
+
+    size_t words = len & ~(size_t)7;
+    c = crc32c_hw_words(c, p, words);
+    p += words;
+    len -= words;
+
+    while (len > 0) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        len--;
+    }
+
+    return ~(uint32_t)c;
+} /* crc32c_sse42() */
+
+__attribute__((target("sse4.2,pclmul")))
+static inline uint64_t crc32c_shift(uint64_t c, uint32_t constant)
+{
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)(uint32_t)c),
+                                           _mm_cvtsi32_si128((int)constant), 0x00);
+
+    return _mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(product));
+} /* crc32c_shift() */
+
+__attribute__((target("sse4.2,pclmul")))
+static uint64_t crc32c_3way(uint64_t c, const uint8_t **p, size_t *len, size_t stride,
+                            uint32_t shift_1, uint32_t shift_2)
+{
+    while (*len >= 3 * stride) {
+        const uint8_t *a = *p;
+        uint64_t c0 = c;
+        uint64_t c1 = 0;
+        uint64_t c2 = 0;
+
+        for (size_t i = 0; i < stride; i += 8) {
+            uint64_t w0, w1, w2;
+            memcpy(&w0, a + i, sizeof(w0));
+            memcpy(&w1, a + stride + i, sizeof(w1));
+            memcpy(&w2, a + 2 * stride + i, sizeof(w2));
+            c0 = _mm_crc32_u64(c0, w0);
+            c1 = _mm_crc32_u64(c1, w1);
+            c2 = _mm_crc32_u64(c2, w2);
+        }
+
+        c = crc32c_shift(c0, shift_2) ^ crc32c_shift(c1, shift_1) ^ c2;
+        *p += 3 * stride;
+        *len -= 3 * stride;
+    }
+
+    return c;
+} /* crc32c_3way() */
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32c_pclmul(uint32_t seed, const void *data, size_t len)
+{
+    // Short buffers have no block to interleave
+    if (len < 3 * CRC32C_SHORT) {
+        return crc32c_sse42(seed, data, len);
+    }
+
+    const uint8_t *p = data;
+    uint64_t c = (uint32_t)~seed;
+
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        len--;
+    }
+
+    c = crc32c_3way(c, &p, &len, CRC32C_LONG, CRC32C_SHIFT_1024, CRC32C_SHIFT_2048);
+    c = crc32c_3way(c, &p, &len, CRC32C_SHORT, CRC32C_SHIFT_128, CRC32C_SHIFT_256);
+
+    size_t words = len & ~(size_t)7;
+    c = crc32c_hw_words(c, p, words);
+    p += words;
+    len -= words;
+
+    while (len > 0) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        len--;
+    }
+
+    return ~(uint32_t)c;
+} /* crc32c_pclmul() */
+
+#endif /* CRC32C_X86 */
+
+static crc32c_engine_t engines[] = {
+    { "slicing-by-8", crc32c_sw, true },
+#ifdef CRC32C_X86
+    { "sse4.2", crc32c_sse42, false },
+    { "sse4.2+pclmul", crc32c_pclmul, false },
+#endif
+};
+
+#define N_ENGINES   (int)(sizeof(engines) / sizeof(engines[0]))
+
+static const crc32c_engine_t *best_engine = &engines[0];
+
+/**
+ * @brief Checks the CPU features and picks the engine before main() runs.
+ */
+__attribute__((constructor))
+static void crc32c_select(void)
+{
+#ifdef CRC32C_X86
+    __builtin_cpu_init();
+    engines[1].available = __builtin_cpu_supports("sse4.2");
+    engines[2].available = engines[1].available && __builtin_cpu_supports("pclmul");
+#endif
+
+    for (int i = 0; i < N_ENGINES; ++i) {
+        if (engines[i].available) {
+            best_engine = &engines[i];
+        }
+    }
+} /* crc32c_select() */
+
+uint32_t crc32c(uint32_t seed, const void *data, size_t len)
+{
+    return best_engine->compute(seed, data, len);
+} /* crc32c() */
+
+const crc32c_engine_t *crc32c_engines(int *count)
+{
+    *count = N_ENGINES;
+    return engines;
+} /* crc32c_engines() */
+
+const char *crc32c_engine_name(void)
+{
+    return best_engine->name;
+} /* crc32c_engine_name() */
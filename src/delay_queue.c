@@ -0,0 +1,182 @@
+/******************************************
+ *
+ * Filename:    delay_queue.c
+ *
+ * Description: Delay queue of the UDP server. Delayed datagrams are kept
+ *              in a binary min-heap keyed by release time, so the event
+ *              loop keeps serving other packets while they wait.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "../include/delay_queue.h"
+
+/**
+ * @brief True if entry `a` is released before entry `b`.
+ */
+static int before(const delay_queue_t *queue, uint32_t a, uint32_t b)
+{
+    const delay_entry_t *ea = &queue->entries[a];
+    const delay_entry_t *eb = &queue->entries[b];
+
+    if (ea->release_us != eb->release_us) {
+        return ea->release_us < eb->release_us;
+    }
+    return ea->order < eb->order;
+} /* before() */
+
+static void sift_up(delay_queue_t *queue, uint32_t pos)
+{
+    uint32_t index = queue->heap[pos];
+
+    while (pos > 0) {
+        uint32_t parent = (pos - 1) / 2;
+        if (!before(queue, index, queue->heap[parent])) {
+            break;
+        }
+        queue->heap[pos] = queue->heap[parent];
+        pos = parent;
+    }
+    queue->heap[pos] = index;
+} /* sift_up() */
+
+static void sift_down(delay_queue_t *queue, uint32_t pos)
+{
+    uint32_t index = queue->heap[pos];
+
+    for (;;) {
+        uint32_t child = pos * 2 + 1;
+        if (child >= queue->count) {
+            break;
+        }
+        if (child + 1 < queue->count && before(queue, queue->heap[child + 1], queue->heap[child])) {
+            child++;
+        }
+        if (!before(queue, queue->heap[child], index)) {
+            break;
+        }
+        queue->heap[pos] = queue->heap[child];
+        pos = child;
+    }
+    queue->heap[pos] = index;
+} /* sift_down() */
+
+/**
+ * @brief Doubles the entry pool, the new entries go to the free stack.
+ */
+static int grow(delay_queue_t *queue)
+{
+    uint32_t capacity = queue->capacity ? queue->capacity * 2 : DELAY_QUEUE_MIN;
+    if (capacity > queue->max_entries) {
+        capacity = queue->max_entries;
+    }
+    if (capacity <= queue->capacity) {
+        return -1;
+    }
+
+    delay_entry_t *entries = realloc(queue->entries, capacity * sizeof(*entries));
+    if (!entries) {
+        return -1;
+    }
+    queue->entries = entries;
+
+    uint32_t *heap = realloc(queue->heap, capacity * sizeof(*heap));
+    if (!heap) {
+        return -1;
+    }
+    queue->heap = heap;
+
+    uint32_t *free_stack = realloc(queue->free, capacity * sizeof(*free_stack));
+    if (!free_stack) {
+        return -1;
+    }
+    queue->free = free_stack;
+
+    for (uint32_t i = capacity; i > queue->capacity; --i) {
+        queue->free[queue->free_count++] = i - 1;
+    }
+    queue->capacity = capacity;
+
+    return 0;
+} /* grow() */
+
+void delay_queue_init(delay_queue_t *queue, uint32_t max_entries)
+{
+    memset(queue, 0, sizeof(*queue));
+    queue->max_entries = max_entries;
+} /* delay_queue_init() */
+
+void delay_queue_free(delay_queue_t *queue)
+{
+    free(queue->entries);
+    free(queue->heap);
+    free(queue->free);
+    memset(queue, 0, sizeof(*queue));
+} /* delay_queue_free() */
+
+int delay_queue_push(delay_queue_t *queue, uint64_t release_us, const char *data, long len,
+                     const struct sockaddr *address, socklen_t address_len)
+{
+    if (len < 0 || len > DELAY_QUEUE_DATA_SIZE || address_len > sizeof(struct sockaddr_storage)) {
+        queue->overflows++;
+        return -1;
+    }
+    if (queue->free_count == 0 && grow(queue) < 0) {
+        queue->overflows++;
+        return -1;
+    }
+
+    uint32_t index = queue->free[--queue->free_count];
+    delay_entry_t *entry = &queue->entries[index];
+
+    entry->release_us = release_us;
+    entry->order = queue->next_order++;
+    memcpy(&entry->address, address, address_len);
+    entry->address_len = address_len;
+    entry->len = len;
+    memcpy(entry->data, data, len);
+
+    queue->heap[queue->count] = index;
+    sift_up(queue, queue->count++);
+
+    queue->delayed++;
+    if (queue->count > queue->max_depth) {
+        queue->max_depth = queue->count;
+    }
+
+    return 0;
+} /* delay_queue_push() */
+
+delay_entry_t *delay_queue_peek(delay_queue_t *queue)
+{
+    if (queue->count == 0) {
+        return NULL;
+    }
+    return &queue->entries[queue->heap[0]];
+} /* delay_queue_peek() */
+
+void delay_queue_pop(delay_queue_t *queue)
+{
+    if (queue->count == 0) {
+        return;
+    }
+
+    queue->free[queue->free_count++] = queue->heap[0];
+    queue->heap[0] = queue->heap[--queue->count];
+    if (queue->count > 0) {
+        sift_down(queue, 0);
+    }
+    queue->released++;
+} /* delay_queue_pop() */
+
+uint64_t delay_queue_next_us(const delay_queue_t *queue)
+{
+    if (queue->count == 0) {
+        return UINT64_MAX;
+    }
+    return queue->entries[queue->heap[0]].release_us;
+} /* delay_queue_next_us() */
@@ -0,0 +1,198 @@
+/******************************************
+ *
+ * Filename:    event_loop.c
+ *
+ * Description: Event loop built on epoll. Protocol timers use timerfd,
+ *              shutdown signals use signalfd and threads wake each other
+ *              with eventfd, so everything is waited on with one
+ *              epoll_wait() call.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+
+#include "../include/event_loop.h"
+
+int event_loop_init(event_loop_t *loop)
+{
+    memset(loop, 0, sizeof(*loop));
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        return -1;
+    }
+
+    return 0;
+} /* event_loop_init() */
+
+void event_loop_close(event_loop_t *loop)
+{
+    if (loop->epfd >= 0) {
+        close(loop->epfd);
+    }
+    loop->epfd = -1;
+} /* event_loop_close() */
+
+int event_loop_add(event_loop_t *loop, event_source_t *src)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = src;
+
+    return epoll_ctl(loop->epfd, EPOLL_CTL_ADD, src->fd, &event);
+} /* event_loop_add() */
+
+int event_loop_del(event_loop_t *loop, event_source_t *src)
+{
+    return epoll_ctl(loop->epfd, EPOLL_CTL_DEL, src->fd, NULL);
+} /* event_loop_del() */
+
+int event_loop_wait(event_loop_t *loop, event_source_t **ready, int max, int timeout_ms)
+{
+    if (max > EVENT_LOOP_MAX_EVENTS) {
+        max = EVENT_LOOP_MAX_EVENTS;
+    }
+
+    int n_ready = epoll_wait(loop->epfd, loop->events, max, timeout_ms);
+    if (n_ready < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (int i = 0; i < n_ready; ++i) {
+        ready[i] = loop->events[i].data.ptr;
+    }
+
+    return n_ready;
+} /* event_loop_wait() */
+
+int event_timer_init(event_source_t *timer, void *ctx)
+{
+    timer->type = EVENT_TIMER;
+    timer->ctx = ctx;
+    timer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    return (timer->fd < 0) ? -1 : 0;
+} /* event_timer_init() */
+
+int event_timer_arm(event_source_t *timer, uint64_t timeout_us, uint64_t interval_us)
+{
+    struct itimerspec spec;
+
+    spec.it_value.tv_sec = timeout_us / 1000000;
+    spec.it_value.tv_nsec = (timeout_us % 1000000) * 1000;
+    spec.it_interval.tv_sec = interval_us / 1000000;
+    spec.it_interval.tv_nsec = (interval_us % 1000000) * 1000;
+
+    return timerfd_settime(timer->fd, 0, &spec, NULL);
+} /* event_timer_arm() */
+
+int event_timer_arm_at(event_source_t *timer, uint64_t *armed_us, uint64_t deadline_us)
+{
+    if (deadline_us == UINT64_MAX || (*armed_us && *armed_us <= deadline_us)) {
+        return 0;
+    }
+
+    // A zero timeout would disarm the timer, so a due deadline waits one microsecond
+    uint64_t now_us = event_loop_now_us();
+    uint64_t timeout_us = deadline_us > now_us ? deadline_us - now_us : 1;
+    if (event_timer_arm(timer, timeout_us, 0) < 0) {
+        return -1;
+    }
+    *armed_us = deadline_us;
+
+    return 0;
+} /* event_timer_arm_at() */
+
+uint64_t event_timer_read(event_source_t *timer)
+{
+    uint64_t expirations = 0;
+
+    if (read(timer->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return 0;
+    }
+
+    return expirations;
+} /* event_timer_read() */
+
+int event_signal_init(event_source_t *src, const int *signals, int count, void *ctx)
+{
+    sigset_t mask;
+
+    src->type = EVENT_SIGNAL;
+    src->ctx = ctx;
+    src->fd = -1;
+
+    sigemptyset(&mask);
+    for (int i = 0; i < count; ++i) {
+        sigaddset(&mask, signals[i]);
+    }
+
+    // Signals must be blocked, otherwise the default action runs instead
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0) {
+        return -1;
+    }
+
+    src->fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    return (src->fd < 0) ? -1 : 0;
+} /* event_signal_init() */
+
+int event_signal_read(event_source_t *src)
+{
+    struct signalfd_siginfo info;
+
+    if (read(src->fd, &info, sizeof(info)) != sizeof(info)) {
+        return -1;
+    }
+
+    return (int)info.ssi_signo;
+} /* event_signal_read() */
+
+int event_notify_init(event_source_t *src, void *ctx)
+{
+    src->type = EVENT_NOTIFY;
+    src->ctx = ctx;
+    src->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    return (src->fd < 0) ? -1 : 0;
+} /* event_notify_init() */
+
+int event_notify_signal(event_source_t *src)
+{
+    uint64_t one = 1;
+
+    if (write(src->fd, &one, sizeof(one)) != sizeof(one)) {
+        return -1;
+    }
+
+    return 0;
+} /* event_notify_signal() */
+
+void event_source_close(event_source_t *src)
+{
+    if (src->fd >= 0) {
+        close(src->fd);
+    }
+    src->fd = -1;
+} /* event_source_close() */
+
+uint64_t event_loop_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+} /* event_loop_now_us() */
@@ -1,26 +1,18 @@
 #include "../include/gbn.h"
+#include "../include/log.h"
 
 
-int gbn_process_packet (char *read, long bytes_received, int expectedseqnum)
+int gbn_process_packet (char *read, long bytes_received, uint32_t expectedseqnum, const codec_t *codec,
+                        codec_frame_t *frame)
 {
 
-    crc data[100];
-    memset(data, '\0', sizeof(data));
-
-    for (long i = 0; i < bytes_received; ++i) {
-        data[i] = read[i];
-    }
-    data[bytes_received] = '\0';
-
-    crc result = crcFast(data, bytes_received);
-
-    if (result != 0) {
+    if (!codec_parse_frame(codec, read, bytes_received, expectedseqnum, frame) || frame->type != CODEC_DATA) {
         return CRC_NOK;
     }
 
-    int received_seq_num = (int)read[0];
-    printf("----- Packet Received Successfully -------\n");
-    printf("(%d/%d) Received / Expected Sequence\n", received_seq_num, expectedseqnum);
+    uint32_t received_seq_num = frame->seq;
+    LOG_DEBUG("----- Packet Received Successfully -------\n");
+    LOG_DEBUG("(%u/%u) Received / Expected Sequence\n", received_seq_num, expectedseqnum);
     
 
     if (received_seq_num != expectedseqnum) {
@@ -32,23 +24,8 @@ int gbn_process_packet (char *read, long bytes_received, int expectedseqnum)
 }
 
 
-int gbn_make_packet(char *packet, uint8_t expectedseqnum)
+int gbn_make_packet(char *packet, uint32_t ackseqnum, const codec_t *codec)
 {
-    // int packet_len = -1;
-    crc CRC = 0;
-    char *ack = "ACK";
-
-    char ack_message[8];
-    memset(ack_message, '0', sizeof(ack_message));
-    int message_len = snprintf(NULL, 0, "%c%s", expectedseqnum, ack);
-    snprintf(ack_message, message_len + 1, "%c%s", expectedseqnum, ack);
-
-
-    CRC = crcFast((crc *)ack_message, message_len);
-
-    size_t size = snprintf(NULL, 0, "%c%s%c", expectedseqnum, ack, CRC);
-    snprintf(packet, size + 1, "%c%s%c", expectedseqnum, ack, CRC);
-
-    return  size;
+    return (int)codec_make_ack(codec, packet, ackseqnum);
 }
 
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <inttypes.h>
 
 // Networking Headers
 #include <sys/types.h>
@@ -45,9 +46,23 @@
 
 // Local Headers
 #include "../include/crc.h"
-
-void timeout_alarm(__attribute__((unused))int ignore);
-size_t make_packet (uint8_t next_sequence, char data, crc packet_crc, char *packet);
+#include "../include/checksum.h"
+#include "../include/codec.h"
+#include "../include/crc32c.h"
+#include "../include/event_loop.h"
+#include "../include/send_window.h"
+#include "../include/rtt.h"
+#include "../include/congestion.h"
+#include "../include/pacer.h"
+#include "../include/timer_wheel.h"
+#include "../include/log.h"
+
+size_t make_packet (uint32_t next_sequence, const char *data, uint16_t len, const codec_t *codec, char *packet);
+char *load_data(const char *path, size_t generated, size_t *len);
+void size_socket_buffers(int sock, size_t bytes);
+void retransmission_timeout(timer_node_t *timer, void *ctx);
+int resend_packet(int sock, send_window_t *window, pacer_t *pacer, uint64_t index, uint64_t now_us);
+uint64_t send_limit(const congestion_t *cc, uint64_t dup_acks);
 
 #define RED     "\033[1;31m"
 #define ORANGE  "\033[1;33m"
@@ -62,7 +77,8 @@ size_t make_packet (uint8_t next_sequence, char data, crc packet_crc, char *pack
 #define SERVER_IP           "127.0.0.1"
 #define DEFAULT_PORT        "6666"
 #define MAXTRIES            10
-#define TIMEOUT_SECONDS      2
+#define HELLO_TIMEOUT_MS    200
+#define HELLO_TRIES         3
 #define MESSAGE             "Hello World from GB-N"
 
 enum CRC_Status {
@@ -71,39 +87,113 @@ enum CRC_Status {
 };
 
 
-volatile int g_tries = 0;
-volatile bool g_timeout = false;
-crc crcTable[256];
+int g_tries = 0;
+bool g_timeout = false;
 
 
-int main(void)
+int main(int argc, char *argv[])
 {
-
-    // Timeout handler
-    struct sigaction my_timeout;
-
-    my_timeout.sa_handler = timeout_alarm;
-    if (sigfillset(&my_timeout.sa_mask) < 0){
-        fprintf(stderr, "sigfillset failed\n");
-        return 1;
+    size_t payload_size = CODEC_MAX_PAYLOAD;
+    const char *path = NULL;
+    size_t generated = 0;
+    bool isn_set = false;
+    uint32_t isn = 0;
+    uint32_t window_size = CODEC_DEFAULT_WINDOW;
+    uint64_t min_rto_us = RTT_MIN_RTO_US;
+    uint64_t max_rto_us = RTT_MAX_RTO_US;
+    int congestion_type = CONGESTION_CUBIC;
+    double pacing_mbps = -1.0;
+    const char *port = DEFAULT_PORT;
+    int c = 0;
+
+    while ((c = getopt(argc, argv, "s:f:n:i:w:t:T:c:b:p:h")) != -1) {
+        switch (c) {
+        case 's':
+            // Payload bytes per datagram
+            payload_size = strtoul(optarg, NULL, 10);
+            if (payload_size < 1 || payload_size > CODEC_MAX_PAYLOAD) {
+                fprintf(stderr, "ERROR: payload size must be between 1 and %d\n", CODEC_MAX_PAYLOAD);
+                return 1;
+            }
+            break;
+        case 'f':
+            // Send the contents of a file
+            path = optarg;
+            break;
+        case 'n':
+            // Send generated bytes
+            generated = strtoul(optarg, NULL, 10);
+            break;
+        case 'i':
+            // First sequence number, random by default
+            isn = (uint32_t)strtoul(optarg, NULL, 0);
+            isn_set = true;
+            break;
+        case 'w':
+            // Packets in flight, the server may grant fewer
+            window_size = strtoul(optarg, NULL, 10);
+            if (window_size < 1 || window_size > CODEC_MAX_WINDOW) {
+                fprintf(stderr, "ERROR: window must be between 1 and %d packets\n", CODEC_MAX_WINDOW);
+                return 1;
+            }
+            break;
+        case 't':
+            // Lower bound of the retransmission timeout
+            min_rto_us = strtoull(optarg, NULL, 10) * 1000;
+            if (min_rto_us < 1000) {
+                fprintf(stderr, "ERROR: minimum timeout must be at least 1 ms\n");
+                return 1;
+            }
+            break;
+        case 'T':
+            // Upper bound of the retransmission timeout
+            max_rto_us = strtoull(optarg, NULL, 10) * 1000;
+            break;
+        case 'c':
+            // Congestion control algorithm
+            congestion_type = congestion_parse(optarg);
+            if (congestion_type < 0) {
+                fprintf(stderr, "ERROR: congestion control must be newreno, cubic or fixed\n");
+                return 1;
+            }
+            break;
+        case 'b':
+            // Pacing rate in Mbit/s, 0 sends unpaced, by default the rate follows cwnd/RTT
+            pacing_mbps = strtod(optarg, NULL);
+            if (pacing_mbps < 0.0) {
+                fprintf(stderr, "ERROR: pacing rate must be at least 0 Mbit/s\n");
+                return 1;
+            }
+            break;
+        case 'p':
+            // Port of the server, or of a udp-impair relay in front of it
+            port = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -s [payload_bytes] -f [file] -n [generated_bytes] -i [first_seq] -w [window] "
+                    "-t [min_rto_ms] -T [max_rto_ms] -c [congestion_control] -b [pacing_mbps] -p [port]\n", argv[0]);
+            return 1;
+        }
     }
-    my_timeout.sa_flags = 0;
 
-    if (sigaction (SIGALRM, &my_timeout, 0) < 0) {
-        fprintf(stderr, "sigaction() failed.\n");
+    size_t data_len = 0;
+    char *data = load_data(path, generated, &data_len);
+    if (!data) {
+        fprintf(stderr, "Reading the data failed. (%d)\n", GETSOCKETERRNO());
         return 1;
     }
 
-
-    // Initialize fastCRC
-    crcInit();
+    // Send, receive and resend messages are written by the logging thread
+    if (log_init(LOG_LEVEL_INFO) < 0) {
+        fprintf(stderr, "Logging thread not started, logging synchronously. (%d)\n", GETSOCKETERRNO());
+    }
 
     printf("Configuring remote address...\n");
     struct addrinfo hints;
     memset(&hints, 0, sizeof(hints));
     hints.ai_socktype = SOCK_DGRAM;
     struct addrinfo *peer_address;
-    if (getaddrinfo(SERVER_IP, DEFAULT_PORT, &hints, &peer_address)) {
+    if (getaddrinfo(SERVER_IP, port, &hints, &peer_address)) {
         fprintf(stderr, "getaddrinfo() failed. (%d)\n", GETSOCKETERRNO());
         return 1;
     }
@@ -135,209 +225,507 @@ int main(void)
 
     printf("Connected.\n");
 
+    // Socket, retransmission timer and shutdown signals share one event loop
+    event_loop_t loop;
+    event_source_t socket_source = { socket_peer, EVENT_SOCKET, NULL };
+    event_source_t timer_source;
+    event_source_t signal_source;
+    const int shutdown_signals[] = { SIGINT, SIGTERM };
+
+    if (event_loop_init(&loop) < 0 ||
+        event_timer_init(&timer_source, NULL) < 0 ||
+        event_signal_init(&signal_source, shutdown_signals, 2, NULL) < 0 ||
+        event_loop_add(&loop, &socket_source) < 0 ||
+        event_loop_add(&loop, &timer_source) < 0 ||
+        event_loop_add(&loop, &signal_source) < 0) {
+        fprintf(stderr, "Event loop setup failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+
+    // Agree on the checksum and frame format, a server without negotiation only knows CRC-8 and one character per packet
+    static const uint8_t offered_checksums[] = { CHECKSUM_CRC32C, CHECKSUM_CRC8 };
+    codec_t codec;
+    codec.max_payload = payload_size;
+    codec.conn_id = codec_random32();
+    codec.isn = isn_set ? isn : codec_random32();
+    codec.window = window_size;
+    codec.features = CODEC_FEATURE_SACK;
+    if (codec_negotiate(socket_peer, offered_checksums, 2, HELLO_TIMEOUT_MS, HELLO_TRIES, &codec) < 0) {
+        fprintf(stderr, "Codec negotiation failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+    size_t frame_payload = codec.max_payload;
+    size_t n_packets = (data_len + frame_payload - 1) / frame_payload;
+    printf("Checksum: %s | Payload: %zu bytes per packet | %zu packets\n", checksum_get(codec.checksum)->name,
+           frame_payload, n_packets);
+    printf("Header: version %d | Connection: %08x | First SEQ: %u | Window: %u packets%s\n", codec.version,
+           codec.conn_id, codec.isn, codec.window, (codec.features & CODEC_FEATURE_SACK) ? " | SACK" : "");
+
+    // Legacy frames only have a one byte sequence number
+    if (codec.version == 0 && n_packets > CODEC_MAX_SEQ) {
+        fprintf(stderr, "ERROR: %zu bytes need more than %d packets\n", data_len, CODEC_MAX_SEQ);
+        return 1;
+    }
+
     printf("Ready to send data to server\n");
 
     // GBN Client begins
 
+    // Packets are encoded once into the sender window, a packet's SEQ on the wire is codec.isn + its index and wraps around
+    send_window_t window;
+    if (send_window_init(&window, codec.window, codec_frame_size(&codec)) < 0) {
+        fprintf(stderr, "Sender window allocation failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+    size_socket_buffers(socket_peer, (size_t)codec.window * codec_frame_size(&codec) * 2);
+
+    // The retransmission timeout follows the measured RTT instead of a fixed period
+    rtt_t rtt;
+    rtt_init(&rtt, min_rto_us, max_rto_us);
+
+    // The packets in flight are the smaller of the congestion window and the window the server granted
+    congestion_t cc;
+    congestion_init(&cc, congestion_type, codec.window);
+    printf("Congestion control: %s\n", cc.ops->name);
+
+    // The pacer spreads the window over the RTT instead of sending it as one burst into the server's socket buffer
+    size_t frame_size = codec_frame_size(&codec);
+    pacer_t pacer;
+    pacer_init(&pacer, (pacing_mbps > 0.0) ? pacing_mbps * 1e6 / 8 : 0.0, PACER_BURST_PACKETS * frame_size,
+               event_loop_now_us());
+    if (pacing_mbps < 0.0) {
+        printf("Pacing: cwnd/RTT\n");
+    }
+    else if (pacing_mbps > 0.0) {
+        printf("Pacing: %.1f Mbit/s\n", pacing_mbps);
+    }
+    else printf("Pacing: off\n");
+
+    // One retransmission timer for the connection on the timing wheel, the timerfd follows the wheel
+    timer_wheel_t wheel;
+    timer_wheel_init(&wheel, event_loop_now_us());
+    timer_node_t rtx_timer = {0};
+    uint64_t timer_armed_us = 0;
+    uint64_t dup_acks = 0;
+    uint64_t stale_acks = 0;
+    bool go_back = false;
+    uint64_t resend_next = 0;
+    uint64_t resend_end = 0;
+    size_t fast_retransmits = 0;
     size_t packet_received = 0;
     size_t packet_sent = 0;
-    uint8_t next_seq_num = 1;
-    int window_size = 5;       // TODO: Needs to be received command line argumets
-    size_t base = 1;
     char recv_packet[4096];
-    size_t n_packets = strlen(MESSAGE);
     
     do { 
 
-        fd_set reads;
-        FD_ZERO(&reads);
-        FD_SET(socket_peer, &reads);
-        FD_SET(0, &reads);
-
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 1000;
-
-        if(select(socket_peer+1, &reads, 0,0, &timeout) < 0) {
-            // Timeout occurred
-            if (errno == EINTR) {
-                printf("TImeout! %d more tries...\n", MAXTRIES - g_tries);
-                printf(BLUE "----- Timeout occurred -------\n" RESET);
-                printf("Retries left: %d | Next SEQ: %d\n", MAXTRIES - g_tries, next_seq_num);
-                continue;
+        // Poll when there is something to send, otherwise sleep until the socket, timer or a signal is ready.
+        // A packet the pacer holds back sleeps on the timer until shortly before it is due and polls the rest,
+        // the wakeup of a timer is not precise enough for gaps of a few microseconds
+        uint64_t loop_us = event_loop_now_us();
+        if (pacing_mbps < 0.0) {
+            pacer_set_rate(&pacer, congestion_pacing_rate(&cc, rtt.srtt_us, frame_size), loop_us);
+        }
+        bool sendable = (resend_next < resend_end && resend_next < window.base + congestion_window(&cc)) ||
+                        (send_window_can_send(&window) && send_window_in_flight(&window) < send_limit(&cc, dup_acks) &&
+                         window.next < n_packets);
+        int wait_ms = -1;
+        uint64_t wake_us = timer_wheel_next_us(&wheel);
+        if (sendable) {
+            uint64_t release_us = pacer_release_us(&pacer, frame_size, loop_us);
+            if (release_us <= loop_us + PACER_SPIN_US) {
+                wait_ms = 0;
             }
-            else {
-                fprintf(stderr, "select() failed. (%d)\n", GETSOCKETERRNO());
-                break;
+            else if (release_us - PACER_SPIN_US < wake_us) {
+                wake_us = release_us - PACER_SPIN_US;
+            }
+        }
+        event_timer_arm_at(&timer_source, &timer_armed_us, wake_us);
+
+        event_source_t *ready[EVENT_LOOP_MAX_EVENTS];
+        int n_ready = event_loop_wait(&loop, ready, EVENT_LOOP_MAX_EVENTS, wait_ms);
+        if (n_ready < 0) {
+            LOG_ERROR("epoll_wait() failed. (%d)\n", GETSOCKETERRNO());
+            break;
+        }
 
+        bool socket_readable = false;
+        bool shutdown_requested = false;
+        for (int r = 0; r < n_ready; ++r) {
+            if (ready[r] == &socket_source) {
+                socket_readable = true;
+            }
+            else if (ready[r] == &timer_source && event_timer_read(&timer_source) > 0) {
+                timer_armed_us = 0;
+                timer_wheel_advance(&wheel, event_loop_now_us(), retransmission_timeout, NULL);
+            }
+            else if (ready[r] == &signal_source) {
+                LOG_INFO("\n------- Signal %d received -------\n\n", event_signal_read(&signal_source));
+                shutdown_requested = true;
             }
-            
+        }
+        if (shutdown_requested) {
+            break;
         }
         
-        if(FD_ISSET(socket_peer, &reads)) {
-            printf("----- Packet Receive Start -------\n");
-            memset(&recv_packet, 0, sizeof(recv_packet));
-            int bytes_received = recv(socket_peer, recv_packet, 4096, 0);
+        if (socket_readable) {
+            LOG_DEBUG("----- Packet Receive Start -------\n");
+            int bytes_received = recv(socket_peer, recv_packet, sizeof(recv_packet), 0);
             if (bytes_received < 1 ) {
-                printf("Connection close by peer\n");
+                LOG_DEBUG("Connection close by peer\n");
                 break;
             }
-            //printf("Received (%d bytes): %.*s\n", bytes_received, (int)bytes_received, recv_packet);
 
+            // Check if the packet is corrupted or not, a repeated HELLO answer is not an ACK
+            uint32_t base_seq = codec.isn + (uint32_t)window.base;
+            codec_frame_t frame;
+            int crc_result = (codec_parse_frame(&codec, recv_packet, bytes_received, base_seq, &frame) &&
+                              frame.type == CODEC_ACK) ? OK : NOK;
+
+            // With SACK the server keeps the packets after a gap and reports them, only the holes are resent
+            uint64_t acked = 0;
+            if (crc_result == OK && (frame.flags & CODEC_FLAG_SACK)) {
+                uint64_t answered = 0;
+                uint64_t now_us = event_loop_now_us();
+                uint64_t newly_acked = send_window_apply_sack(&window, &frame, base_seq, &answered, NULL, NULL);
+                if (newly_acked > 0) {
+                    rtt_progress(&rtt);
+                }
+                if (answered < window.next) {
+                    // Karn's rule: the ACK of a resent packet may belong to either copy
+                    if (!send_window_is_resent(&window, answered)) {
+                        rtt_sample(&rtt, now_us - send_window_sent_us(&window, answered));
+                    }
+
+                    // Holes the answered packet has overtaken are resent without waiting for the timeout
+                    for (uint64_t i = send_window_next_lost(&window, window.base, answered); i < window.next;
+                         i = send_window_next_lost(&window, i + 1, answered)) {
+                        LOG_DEBUG("Fast retransmit: SEQ %u\n", codec.isn + (uint32_t)i);
+                        if (resend_packet(socket_peer, &window, &pacer, i, now_us) < 1) {
+                            LOG_ERROR("Error occurred\n");
+                            break;
+                        }
+                        congestion_on_loss(&cc, i, window.next);
+                        fast_retransmits++;
+                        packet_sent++;
+                    }
+                }
+                packet_received++;
 
-            // Reserving memory for incoming message. Byte_received misses the NULL to terminate the string
-            char *data = malloc(bytes_received + 1);
-            if (!data) {
-                fprintf(stderr, "Memory allocation failed\n");
-                exit(1);
+                // The timer of the base restarts when the window slides
+                bool slid = send_window_slide(&window) > 0;
+                congestion_on_ack(&cc, newly_acked, window.base, now_us, rtt.srtt_us);
+                if (slid) {
+                    g_tries = 0;
+                    if (window.base == window.next) {
+                        timer_wheel_cancel(&wheel, &rtx_timer);
+                    }
+                    else timer_wheel_add(&wheel, &rtx_timer, now_us + rtt_rto_us(&rtt));
+                }
             }
-            memcpy(data, recv_packet, bytes_received);
-            data[bytes_received] = '\0';
-
-            // Check if the packet is corrupted or not
-            crc crc_result = crcFast((crc *)data, bytes_received);
-            free(data);
-
-            if (crc_result == OK) {
-                base = recv_packet[0];
-                printf("ACK received: SEQ %zu | CRC Check: OK\n", base); 
+            // Cumulative ACK of the last packet in order, ACKs outside the window do not move it
+            else if (crc_result == OK && send_window_index(&window, (int32_t)(frame.ack - base_seq), &acked)) {
+                // Karn's rule: the ACK of a resent packet may belong to either copy
+                if (!send_window_is_resent(&window, acked)) {
+                    rtt_sample(&rtt, event_loop_now_us() - send_window_sent_us(&window, acked));
+                }
+                rtt_progress(&rtt);
+                uint64_t newly_acked = send_window_ack_through(&window, acked);
+                congestion_on_ack(&cc, newly_acked, window.base, event_loop_now_us(), rtt.srtt_us);
+                LOG_DEBUG("ACK received: SEQ %u | CRC Check: OK\n", frame.ack); 
                 
                 // Increase packet counters
-                base++;     
                 packet_received++;
+
+                // Only timeouts without progress in between count as retries
+                g_tries = 0;
+                dup_acks = 0;
+                stale_acks = 0;
                 
-                // If the base is same than next packet to send, zero the timer
-                if (base == next_seq_num) {
-                    alarm(0);
+                // If the base is same than next packet to send, stop the timer
+                if (window.base == window.next) {
+                    timer_wheel_cancel(&wheel, &rtx_timer);
                 } 
-                // Otherwise initiate the timer
-                else alarm(TIMEOUT_SECONDS);
+                // Otherwise restart the timer
+                else timer_wheel_add(&wheel, &rtx_timer, event_loop_now_us() + rtt_rto_us(&rtt));
                 
             }
+            else if (crc_result == OK && frame.ack == base_seq - 1 && window.base < window.next) {
+                // The server repeats the last ACK for every packet after a gap, three of them resend the window at
+                // once. The packets sent before the last go back still arrive behind the gap, their repeats are
+                // not counted, the ACK of the resent base shows that they are through
+                if (stale_acks > 0) {
+                    stale_acks--;
+                }
+                else if (++dup_acks >= SEND_WINDOW_DUP_THRESH) {
+                    LOG_DEBUG("Fast retransmit: SEQ %u after %" PRIu64 " duplicate ACKs\n", base_seq, dup_acks);
+                    congestion_on_loss(&cc, window.base, window.next);
+                    fast_retransmits++;
+                    go_back = true;
+                }
+            }
             else if (crc_result == NOK) {
-                printf("ACK Received: SEQ %d | CRC Check: NOK\n", recv_packet[0]);
+                LOG_DEBUG("ACK Received | CRC Check: NOK\n");
             }
-            printf("----- Packet Receive End -------\n\n");
+            LOG_DEBUG("----- Packet Receive End -------\n\n");
            
             
             
         }
 
-        // Send data to Server if there is room in sending window
-            if (next_seq_num < (base + window_size)) {
-                char *message = MESSAGE;
-                
-                
-                char seq_message[4096];
-                snprintf(seq_message, sizeof seq_message, "%c%c", next_seq_num, message[next_seq_num - 1]); 
-
-                // Event though the message size of is 2 chars, the below code is prepared for bigger messages.
-                int len = strlen(seq_message);
-                crc *data_to_send = malloc(len * sizeof(char));
-                if (!data_to_send) {
-                    fprintf(stderr, "Memory allocation failed");
-                    exit(1);
-                } 
-
-                for (long i = 0; i < len; i++) {
-                    data_to_send[i] = seq_message[i];
+            // The packets of the last go back are resent as the congestion window opens and the pacer lets them, before any new data
+            if (resend_next < window.base) {
+                resend_next = window.base;
+            }
+            while (resend_next < resend_end && resend_next < window.base + congestion_window(&cc)) {
+                uint64_t i = send_window_next_unacked(&window, resend_next);
+                if (i >= resend_end) {
+                    resend_next = resend_end;
+                    break;
                 }
-                data_to_send[len] = '\0';
-                
-                crc crc_send = crcFast(data_to_send, len);
-                free(data_to_send);
-
-                char *packet = malloc(sizeof(char) * len);
-                if (!packet) {
-                    fprintf(stderr, "Memory allocation failed\n");
-                    exit(1);
-
+                uint64_t now_us = event_loop_now_us();
+                if (pacer_release_us(&pacer, frame_size, now_us) > now_us) {
+                    break;
+                }
+                if (resend_packet(socket_peer, &window, &pacer, i, now_us) < 1) {
+                    LOG_ERROR("Error occurred\n");
+                    break;
                 }
-                size_t size = make_packet(next_seq_num, message[next_seq_num - 1], crc_send, packet);
+                packet_sent++;
+                resend_next = i + 1;
+            }
+
+        // Send data to Server if there is room in sending window
+            if (send_window_can_send(&window) && send_window_in_flight(&window) < send_limit(&cc, dup_acks) &&
+                window.next < n_packets && resend_next >= resend_end &&
+                pacer_release_us(&pacer, frame_size, event_loop_now_us()) <= event_loop_now_us()) {
+                size_t offset = (size_t)window.next * frame_payload;
+                uint32_t seq = codec.isn + (uint32_t)window.next;
+                uint16_t len = (data_len - offset < frame_payload) ? data_len - offset : frame_payload;
+
+                // The packet is encoded straight into its slot of the window
+                char *packet = send_window_slot(&window);
+                size_t size = make_packet(seq, &data[offset], len, &codec, packet);
                 
-                printf("----- Sending Packet %d -------\n", next_seq_num); 
+                LOG_DEBUG("----- Sending Packet %u -------\n", seq); 
                 
+                // Stamped before the send, the ACK may be back before send() returns
+                uint64_t sent_us = event_loop_now_us();
                 int bytes_sent = send(socket_peer, packet, size, 0);
 
                 // Start timer
-                if (base == next_seq_num) {
-                    alarm(TIMEOUT_SECONDS);
+                if (window.base == window.next) {
+                    timer_wheel_add(&wheel, &rtx_timer, sent_us + rtt_rto_us(&rtt));
                 }
                 if (bytes_sent < 1) {
-                    fprintf(stderr, "Error occurred\n");
+                    LOG_ERROR("Error occurred\n");
                     break;
                 }
-                // free(outgoing_data);
-                printf("Packet sent: SEQ %d | Data: %c | Bytes: %d\n", packet[0], packet[1], bytes_sent);
+                LOG_DEBUG("Packet sent: SEQ %u | Payload: %d | Bytes: %d\n", seq, len, bytes_sent);
                 
-                // Cleaning up memory
-                free (packet);
-
                 // Increase packet counters
-                next_seq_num++;
+                send_window_push(&window, size, sent_us);
+                pacer_sent(&pacer, size, sent_us);
                 packet_sent++;
 
-                printf("----- Packet Send End -------\n\n"); 
+                LOG_DEBUG("----- Packet Send End -------\n\n"); 
                 
             }
             if (g_timeout == true) {
-                next_seq_num = base;
-                packet_received = next_seq_num;
                 g_timeout = false;
-                printf(BLUE "----- Timeout occurred -------\n" RESET);
-                printf("Window base: %zu | Next SEQ: %d\n", base, next_seq_num);
-                alarm(TIMEOUT_SECONDS);
-                printf(BLUE "----- Timeout end -------\n\n" RESET);
+                rtt_backoff(&rtt);
+                congestion_on_timeout(&cc, window.base, window.next);
+                // One record per timeout, the packets gone back over are only logged at debug level
+                LOG_INFO(BLUE "----- Timeout occurred -------\n" RESET "Window base: %u | Next SEQ: %u | RTO: %" PRIu64 " us\n",
+                         codec.isn + (uint32_t)window.base, codec.isn + (uint32_t)window.next, rtt_rto_us(&rtt));
+                go_back = true;
+            }
+            if (go_back == true) {
+                go_back = false;
+
+                // Every packet in flight behind the base that has not been repeated yet may still be
+                uint64_t in_flight = window.next - window.base - 1;
+                stale_acks = (in_flight > dup_acks) ? in_flight - dup_acks : 0;
+                dup_acks = 0;
+
+                // Go back N: every packet in flight is sent again from the window, nothing is encoded twice.
+                // The packets the server reported with SACK are skipped, the congestion window and the pacer
+                // let the rest out from the next round of the loop
+                resend_next = window.base;
+                resend_end = window.next;
+                timer_wheel_add(&wheel, &rtx_timer, event_loop_now_us() + rtt_rto_us(&rtt));
+                LOG_DEBUG(BLUE "----- Go back end -------\n\n" RESET);
 
             }
-    }  while ((base < n_packets + 1) && g_tries < MAXTRIES);
+    }  while ((window.base < n_packets) && g_tries < MAXTRIES);
 
     // Teardown sending SEQ 0 Data 0 with 0x69
+    log_flush();
     printf("------- ALL PACKETS SENT AND RECEIVED -------\n");
     printf("------- Teardown the connection -------\n\n");
-    char teardown[5];
-    uint8_t teardown_seq = 0;
-    char *teardown_data = "00";
-    crc teardown_crc = 0x90;
-    int size = make_packet(teardown_seq, *teardown_data, teardown_crc, teardown);
-    send(socket_peer, teardown, size, 0);
+    char teardown[CODEC_ACK_MAX];
+    send(socket_peer, teardown, codec_make_fin(&codec, teardown), 0);
 
+    send_window_free(&window);
     freeaddrinfo(peer_address);
+    event_source_close(&timer_source);
+    event_source_close(&signal_source);
+    event_loop_close(&loop);
     printf("Retries left: %d \t Packets sent: %zu \t Packets received: %zu\n", g_tries, packet_sent, packet_received);
+    printf("Data sent: %zu bytes | CRC32C %08x\n", data_len, crc32c(0, data, data_len));
+    printf("RTT: smoothed %.3f ms | variation %.3f ms | min %.3f ms | last %.3f ms | %" PRIu64 " samples\n",
+           rtt.srtt_us / 1000.0, rtt.rttvar_us / 1000.0, rtt.min_rtt_us / 1000.0, rtt.last_us / 1000.0, rtt.samples);
+    printf("RTO: %.3f ms | backoff %u | %" PRIu64 " timeouts\n", rtt_rto_us(&rtt) / 1000.0, rtt.backoff, rtt.timeouts);
+    printf("Fast retransmits: %zu\n", fast_retransmits);
+    printf("Congestion: %s | cwnd %.1f | ssthresh %.1f | %" PRIu64 " loss events | %" PRIu64 " timeouts\n",
+           cc.ops->name, cc.cwnd, cc.ssthresh, cc.losses, cc.timeouts);
+    printf("Pacing: target %.1f Mbit/s | achieved %.1f Mbit/s | %" PRIu64 " waits | %.1f us late on average\n",
+           pacer_target_bps(&pacer) / 1e6, pacer_achieved_bps(&pacer) / 1e6, pacer.waits,
+           pacer.waits ? (double)pacer.late_us / pacer.waits : 0.0);
+    free(data);
     CLOSESOCKET(socket_peer);
 
     printf("Finished\n\n");
+    log_shutdown();
 
     return 0;
 }
 
 
-void timeout_alarm(__attribute__((unused)) int ignore)
+/**
+ * @brief Constructs a data packet with a sequence number, data, and CRC checksum.
+ *
+ * This function encodes the sequence number and payload in the frame format
+ * negotiated with the server and appends the checksum.
+ *
+ * @param next_sequence The sequence number of the packet.
+ * @param data The payload to be sent.
+ * @param len The payload length.
+ * @param codec The encoding negotiated with the server.
+ * @param packet Buffer of at least CODEC_FRAME_MAX bytes for the packet.
+ * 
+ * @return The size of the created packet.
+ */
+size_t make_packet (uint32_t next_sequence, const char *data, uint16_t len, const codec_t *codec, char *packet)
 {
-    g_tries++;
-    g_timeout = true;
+    return codec_make_frame(codec, packet, next_sequence, data, len);
+}
+
+/**
+ * @brief Reads the data to send.
+ *
+ * @param path File to send, or NULL.
+ * @param generated Number of generated bytes to send if there is no file.
+ * @param len Set to the length of the data.
+ * 
+ * @return The data, MESSAGE if there is no file and nothing is generated,
+ *         or NULL on failure. The caller frees it.
+ */
+char *load_data(const char *path, size_t generated, size_t *len)
+{
+    char *data = NULL;
+
+    if (path) {
+        FILE *file = fopen(path, "rb");
+        if (!file) {
+            return NULL;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        data = (size > 0) ? malloc(size) : NULL;
+        if (data && fread(data, 1, size, file) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+        fclose(file);
+        *len = (size > 0) ? (size_t)size : 0;
+    }
+    else if (generated > 0) {
+        data = malloc(generated);
+        for (size_t i = 0; data && i < generated; ++i) {
+            data[i] = 'a' + i % 26;
+        }
+        *len = generated;
+    }
+    else {
+        *len = strlen(MESSAGE);
+        data = malloc(*len);
+        if (data) {
+            memcpy(data, MESSAGE, *len);
+        }
+    }
 
+    return data;
 }
 
 /**
- * @brief Constructs a data packet with a sequence number, data, and CRC checksum.
+ * @brief Sizes the socket buffers for a full window of packets.
  *
- * This function creates a packet by formatting the sequence number, data byte, 
- * and CRC checksum into a string format.
+ * The kernel caps the sizes at net.core.wmem_max and rmem_max, smaller
+ * buffers only cost drops, so failures are not fatal. A queued datagram
+ * is charged about twice its size, the caller allows for that.
  *
- * @param next_sequence The sequence number of the packet.
- * @param data The data character to be sent.
- * @param packet_crc The CRC checksum for error detection.
- * @param packet A pointer to the buffer where the constructed packet will be stored.
+ * @param sock The socket.
+ * @param bytes Bytes of one window.
+ */
+void size_socket_buffers(int sock, size_t bytes)
+{
+    int size = (bytes > (64 << 20)) ? (64 << 20) : (int)bytes;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) ||
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size))) {
+        fprintf(stderr, "setsockopt() of the socket buffers failed. (%d)\n", GETSOCKETERRNO());
+    }
+}
+
+/**
+ * @brief Marks a retransmission timeout when the timer of the connection fires.
+ *
+ * @param timer The retransmission timer.
+ * @param ctx Unused.
+ */
+void retransmission_timeout(__attribute__((unused)) timer_node_t *timer, __attribute__((unused)) void *ctx)
+{
+    g_tries++;
+    g_timeout = true;
+}
+
+/**
+ * @brief Sends a packet in the window again as it was encoded.
+ *
+ * @param sock The connected socket.
+ * @param window The sender window.
+ * @param pacer The pacer, the packet takes its bytes.
+ * @param index Index of the packet.
+ * @param now_us Time the packet is resent.
  * 
- * @return The size of the created packet, or -1 if the sequence number is invalid.
+ * @return The number of bytes sent, or -1 on error.
  */
-size_t make_packet (uint8_t next_sequence, char data, crc packet_crc, char *packet)
+int resend_packet(int sock, send_window_t *window, pacer_t *pacer, uint64_t index, uint64_t now_us)
 {
+    size_t size = 0;
+    const char *packet = send_window_packet(window, index, &size);
 
-    size_t len = snprintf(NULL, 0, "%c%c%c", next_sequence, data, packet_crc);
+    send_window_sent(window, index, now_us);
+    pacer_sent(pacer, size, now_us);
 
-    snprintf(packet, len + 1,  "%c%c%c", next_sequence, data, packet_crc);
+    return (int)send(sock, packet, size, 0);
+}
 
-    return len;
+/**
+ * @brief Packets allowed in flight under the congestion window.
+ *
+ * The first two duplicate ACKs each let one new packet out (limited
+ * transmit, RFC 3042), so a small window still gets the third duplicate
+ * ACK of a fast retransmit instead of waiting for the timeout.
+ *
+ * @param cc The congestion state.
+ * @param dup_acks Duplicate ACKs since the last new ACK.
+ *
+ * @return The number of packets.
+ */
+uint64_t send_limit(const congestion_t *cc, uint64_t dup_acks)
+{
+    return congestion_window(cc) + ((dup_acks < 2) ? dup_acks : 2);
 }
@@ -0,0 +1,124 @@
+/******************************************
+ *
+ * Filename:    impair.c
+ *
+ * Description: Loss, delay, bit error, reordering, duplication and
+ *              bandwidth impairments of a datagram path.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <string.h>
+
+#include "../include/impair.h"
+
+static bool impair_lost(const impair_config_t *config, impair_state_t *state, impair_stats_t *stats)
+{
+    float loss = config->drop_probability;
+
+    // Gilbert-Elliott: the chain moves first, then the state decides the loss
+    if (config->bad_probability > 0) {
+        if (!state->bad && rand_gen_number(&state->rand) <= config->bad_probability) {
+            state->bad = true;
+            stats->bursts++;
+        }
+        else if (state->bad && rand_gen_number(&state->rand) <= config->good_probability) {
+            state->bad = false;
+        }
+        if (state->bad) {
+            loss = config->bad_loss;
+        }
+    }
+
+    return loss > 0 && rand_gen_number(&state->rand) <= loss;
+} /* impair_lost() */
+
+// The link sends at the rate from a bucket of IMPAIR_RATE_BURST, the bucket's debt is the queue
+static int impair_link(const impair_config_t *config, impair_state_t *state, impair_stats_t *stats,
+                       long bytes, uint64_t now_us, uint64_t *release_us)
+{
+    if (now_us > state->last_us) {
+        state->tokens += config->rate * (now_us - state->last_us) / 1e6;
+        if (state->tokens > IMPAIR_RATE_BURST) {
+            state->tokens = IMPAIR_RATE_BURST;
+        }
+        state->last_us = now_us;
+    }
+
+    // Bytes beyond the tokens wait in the queue
+    if (bytes - state->tokens > config->queue_bytes) {
+        stats->overflowed++;
+        return -1;
+    }
+
+    state->tokens -= bytes;
+    if (state->tokens < 0) {
+        *release_us = now_us + (uint64_t)(-state->tokens * 1e6 / config->rate);
+        stats->queued++;
+    }
+
+    return 0;
+} /* impair_link() */
+
+void impair_state_init(impair_state_t *state, uint64_t seed, uint64_t stream, uint64_t now_us)
+{
+    memset(state, 0, sizeof(*state));
+    rand_gen_seed(&state->rand, seed, stream);
+    state->tokens = IMPAIR_RATE_BURST;
+    state->last_us = now_us;
+    state->last_sent_us = now_us;
+} /* impair_state_init() */
+
+int impair_packet(const impair_config_t *config, impair_state_t *state, impair_stats_t *stats,
+                  char *packet, long len, uint64_t now_us, impair_verdict_t *verdict)
+{
+    verdict->release_us = now_us;
+    verdict->copies = 1;
+
+    stats->packets++;
+    if (!impair_enabled(config)) {
+        return IMPAIR_PASS;
+    }
+
+    // A trace replays the recorded loss, delay and bit error of the datagram
+    uint32_t record = config->trace ? impair_trace_next(config->trace, &state->trace_next) : 0;
+    if ((record & IMPAIR_TRACE_DROP) || (!config->trace && impair_lost(config, state, stats))) {
+        stats->dropped++;
+        return IMPAIR_DROP;
+    }
+
+    if (config->duplicate_probability > 0 && rand_gen_number(&state->rand) <= config->duplicate_probability) {
+        verdict->copies = 2;
+        stats->duplicated++;
+    }
+
+    // The second last byte is in the CRC32C trailer or the last data byte, either way the check fails
+    bool corrupt = config->trace ? (record & IMPAIR_TRACE_CORRUPT) != 0 :
+                   config->error_probability > 0 && rand_gen_number(&state->rand) <= config->error_probability;
+    if (corrupt && len >= 2) {
+        packet[len - 2] ^= IMPAIR_ERROR_MASK;
+        stats->corrupted++;
+    }
+
+    if (config->reorder_probability > 0 && config->reorder_depth > 0 &&
+        rand_gen_number(&state->rand) <= config->reorder_probability) {
+        verdict->hold_until = state->sent + config->reorder_depth;
+        stats->reordered++;
+        return IMPAIR_HOLD;
+    }
+
+    if (config->rate > 0 && impair_link(config, state, stats, len * verdict->copies, now_us, &verdict->release_us) < 0) {
+        return IMPAIR_DROP;
+    }
+
+    uint64_t delay_us = config->trace ? impair_trace_delay_us(record) :
+                        (config->delay_probability > 0 && rand_gen_number(&state->rand) <= config->delay_probability) ?
+                        config->delay_us : 0;
+    if (delay_us > 0) {
+        verdict->release_us += delay_us;
+        stats->delayed++;
+    }
+
+    return (verdict->release_us > now_us) ? IMPAIR_DELAY : IMPAIR_PASS;
+} /* impair_packet() */
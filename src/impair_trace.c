@@ -0,0 +1,75 @@
+/******************************************
+ *
+ * Filename:    impair_trace.c
+ *
+ * Description: Maps recorded loss, delay and bit error traces, so the
+ *              impairments can replay a real link datagram by datagram.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/impair_trace.h"
+
+int impair_trace_open(impair_trace_t *trace, const char *path)
+{
+    memset(trace, 0, sizeof(*trace));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(impair_trace_header_t) + sizeof(uint32_t)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    // The count must match the file, a truncated trace is refused rather than half replayed
+    const impair_trace_header_t *header = map;
+    uint32_t count = le32toh(header->count);
+    if (memcmp(header->magic, IMPAIR_TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        le32toh(header->version) != IMPAIR_TRACE_VERSION || count == 0 ||
+        (size_t)st.st_size != sizeof(*header) + (size_t)count * sizeof(uint32_t)) {
+        munmap(map, st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Read front to back, the kernel reads ahead
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    trace->map = map;
+    trace->map_len = st.st_size;
+    trace->records = (const uint32_t *)(header + 1);
+    trace->count = count;
+
+    return 0;
+} /* impair_trace_open() */
+
+void impair_trace_close(impair_trace_t *trace)
+{
+    if (trace->map) {
+        munmap(trace->map, trace->map_len);
+    }
+    memset(trace, 0, sizeof(*trace));
+} /* impair_trace_close() */
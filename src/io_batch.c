@@ -0,0 +1,202 @@
+/******************************************
+ *
+ * Filename:    io_batch.c
+ *
+ * Description: Batched datagram I/O. Drains several datagrams per wakeup
+ *              with recvmmsg() and flushes the queued replies with one
+ *              sendmmsg() call.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "../include/io_batch.h"
+#include "../include/log.h"
+
+int io_batch_init(io_batch_t *batch, unsigned int size)
+{
+    memset(batch, 0, sizeof(*batch));
+
+    if (size < 1 || size > IO_BATCH_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    batch->size = size;
+    batch->tx_capacity = size * IO_BATCH_TX_FACTOR;
+
+    batch->rx_msgs = calloc(size, sizeof(*batch->rx_msgs));
+    batch->rx_iov = calloc(size, sizeof(*batch->rx_iov));
+    batch->rx_buf = calloc(size, IO_BATCH_BUF_SIZE);
+    batch->rx_addr = calloc(size, sizeof(*batch->rx_addr));
+
+    batch->tx_msgs = calloc(batch->tx_capacity, sizeof(*batch->tx_msgs));
+    batch->tx_iov = calloc(batch->tx_capacity, sizeof(*batch->tx_iov));
+    batch->tx_buf = calloc(batch->tx_capacity, IO_BATCH_BUF_SIZE);
+    batch->tx_addr = calloc(batch->tx_capacity, sizeof(*batch->tx_addr));
+
+    if (!batch->rx_msgs || !batch->rx_iov || !batch->rx_buf || !batch->rx_addr ||
+        !batch->tx_msgs || !batch->tx_iov || !batch->tx_buf || !batch->tx_addr) {
+        io_batch_free(batch);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // Receive headers point to fixed buffers, so they are set up only once
+    for (unsigned int i = 0; i < size; ++i) {
+        batch->rx_iov[i].iov_base = batch->rx_buf + (size_t)i * IO_BATCH_BUF_SIZE;
+        batch->rx_iov[i].iov_len = IO_BATCH_BUF_SIZE;
+        batch->rx_msgs[i].msg_hdr.msg_iov = &batch->rx_iov[i];
+        batch->rx_msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->rx_msgs[i].msg_hdr.msg_name = &batch->rx_addr[i];
+    }
+
+    for (unsigned int i = 0; i < batch->tx_capacity; ++i) {
+        batch->tx_iov[i].iov_base = batch->tx_buf + (size_t)i * IO_BATCH_BUF_SIZE;
+        batch->tx_msgs[i].msg_hdr.msg_iov = &batch->tx_iov[i];
+        batch->tx_msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->tx_msgs[i].msg_hdr.msg_name = &batch->tx_addr[i];
+    }
+
+    return 0;
+} /* io_batch_init() */
+
+void io_batch_free(io_batch_t *batch)
+{
+    free(batch->rx_msgs);
+    free(batch->rx_iov);
+    free(batch->rx_buf);
+    free(batch->rx_addr);
+    free(batch->tx_msgs);
+    free(batch->tx_iov);
+    free(batch->tx_buf);
+    free(batch->tx_addr);
+    memset(batch, 0, sizeof(*batch));
+} /* io_batch_free() */
+
+int io_batch_recv(io_batch_t *batch, int sock)
+{
+    int received = 0;
+
+    batch->rx_count = 0;
+
+    if (batch->size == 1) {
+        socklen_t addr_len = sizeof(batch->rx_addr[0]);
+        long bytes = recvfrom(sock, batch->rx_buf, IO_BATCH_BUF_SIZE, MSG_DONTWAIT,
+                              (struct sockaddr *)&batch->rx_addr[0], &addr_len);
+        if (bytes < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        batch->rx_msgs[0].msg_len = bytes;
+        batch->rx_msgs[0].msg_hdr.msg_namelen = addr_len;
+        received = 1;
+    }
+    else {
+        // msg_namelen is overwritten by the kernel, so it is reset on every call
+        for (unsigned int i = 0; i < batch->size; ++i) {
+            batch->rx_msgs[i].msg_hdr.msg_namelen = sizeof(batch->rx_addr[i]);
+        }
+
+        received = recvmmsg(sock, batch->rx_msgs, batch->size, MSG_DONTWAIT, NULL);
+        if (received < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+    }
+
+    if (received > 0) {
+        batch->rx_calls++;
+        batch->rx_datagrams += received;
+    }
+    batch->rx_count = received;
+
+    return received;
+} /* io_batch_recv() */
+
+char *io_batch_data(io_batch_t *batch, unsigned int i)
+{
+    return batch->rx_iov[i].iov_base;
+} /* io_batch_data() */
+
+long io_batch_len(const io_batch_t *batch, unsigned int i)
+{
+    return batch->rx_msgs[i].msg_len;
+} /* io_batch_len() */
+
+struct sockaddr *io_batch_addr(io_batch_t *batch, unsigned int i, socklen_t *addr_len)
+{
+    *addr_len = batch->rx_msgs[i].msg_hdr.msg_namelen;
+    return (struct sockaddr *)&batch->rx_addr[i];
+} /* io_batch_addr() */
+
+int io_batch_queue(io_batch_t *batch, int sock, const char *packet, size_t len,
+                   const struct sockaddr *addr, socklen_t addr_len)
+{
+    if (len > IO_BATCH_BUF_SIZE || addr_len > sizeof(struct sockaddr_storage)) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    if (batch->tx_count == batch->tx_capacity && io_batch_flush(batch, sock) < 0) {
+        return -1;
+    }
+
+    unsigned int slot = batch->tx_count++;
+    memcpy(batch->tx_iov[slot].iov_base, packet, len);
+    batch->tx_iov[slot].iov_len = len;
+    memcpy(&batch->tx_addr[slot], addr, addr_len);
+    batch->tx_msgs[slot].msg_hdr.msg_namelen = addr_len;
+
+    return 0;
+} /* io_batch_queue() */
+
+int io_batch_flush(io_batch_t *batch, int sock)
+{
+    unsigned int sent = 0;
+
+    while (sent < batch->tx_count) {
+        int result = 0;
+
+        if (batch->size == 1) {
+            struct msghdr *msg = &batch->tx_msgs[sent].msg_hdr;
+            result = sendto(sock, msg->msg_iov->iov_base, msg->msg_iov->iov_len, 0,
+                            msg->msg_name, msg->msg_namelen) < 0 ? -1 : 1;
+        }
+        else {
+            result = sendmmsg(sock, &batch->tx_msgs[sent], batch->tx_count - sent, 0);
+        }
+
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("send failed. (%d)\n", errno);
+            batch->tx_count = 0;
+            return -1;
+        }
+
+        batch->tx_calls++;
+        sent += result;
+    }
+
+    batch->tx_datagrams += sent;
+    batch->tx_count = 0;
+
+    return sent;
+} /* io_batch_flush() */
+
+double io_batch_occupancy(const io_batch_t *batch)
+{
+    if (batch->rx_calls == 0) {
+        return 0;
+    }
+    return (double)batch->rx_datagrams / batch->rx_calls;
+} /* io_batch_occupancy() */
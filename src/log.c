@@ -0,0 +1,419 @@
+/******************************************
+ *
+ * Filename:    log.c
+ *
+ * Description: Asynchronous logging. The packet path only copies the
+ *              format pointer and the raw arguments of a message into a
+ *              bounded lock-free ring; a background thread formats the
+ *              records and writes them to stdout (errors to stderr).
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "../include/log.h"
+
+#define LOG_LINE_SIZE       1024    /* Longest formatted message */
+#define LOG_IDLE_MS         100     /* Longest sleep of the logging thread */
+
+/**
+ * @brief Ring slot. `seq` tells producers and the consumer whose turn it is.
+ */
+typedef struct {
+    atomic_size_t seq;
+    log_record_t record;
+} log_slot_t;
+
+atomic_int log_runtime_level = LOG_LEVEL_INFO;
+
+static log_slot_t ring[LOG_RING_SIZE];
+static atomic_size_t enqueue_pos;           /* Next slot for producers */
+static size_t dequeue_pos;                  /* Next slot for the logging thread */
+static atomic_size_t written;               /* Records written by the logging thread */
+static atomic_ulong dropped;                /* Records lost because the ring was full */
+
+static atomic_bool running;                 /* Logging thread accepts records */
+static atomic_bool stopping;                /* Logging thread should drain and exit */
+static atomic_int sleeping;                 /* Logging thread waits for a wakeup */
+static int wake_fd = -1;                    /* eventfd that wakes the logging thread */
+static pthread_t thread;
+
+static const char *const level_names[] = { "error", "warn", "info", "debug" };
+
+/**
+ * @brief Formats one record into `out`, the conversions of the format are
+ *        rewritten to match the stored argument types.
+ *
+ * @return size_t Length of the formatted message.
+ */
+static size_t format_record(const log_record_t *record, char *out, size_t size)
+{
+    const char *p = record->fmt;
+    size_t len = 0;
+    int arg = 1;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+    while (*p && len + 1 < size) {
+        if (*p != '%') {
+            out[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // Copy flags, width and precision, drop the length modifiers
+        char spec[32];
+        size_t spec_len = 0;
+        const char *start = p++;
+        spec[spec_len++] = '%';
+        while (*p && strchr("-+ #0123456789.", *p) && spec_len < sizeof(spec) - 4) {
+            spec[spec_len++] = *p++;
+        }
+        while (*p && strchr("hlLqjzt", *p)) {
+            p++;
+        }
+        char conversion = *p ? *p++ : '\0';
+
+        if (arg >= record->n_args || conversion == '\0') {
+            // No argument for this conversion, print it as it was written
+            size_t n = p - start;
+            if (n > size - 1 - len) {
+                n = size - 1 - len;
+            }
+            memcpy(&out[len], start, n);
+            len += n;
+            continue;
+        }
+
+        uint8_t type = record->types[arg];
+        int n = 0;
+        size_t room = size - len;
+
+        switch (conversion) {
+        case 'd':
+        case 'i':
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = conversion;
+            spec[spec_len] = '\0';
+            n = snprintf(&out[len], room, spec,
+                         type == LOG_ARG_DOUBLE ? (long long)record->values[arg].d : (long long)record->values[arg].i);
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = conversion;
+            spec[spec_len] = '\0';
+            n = snprintf(&out[len], room, spec,
+                         type == LOG_ARG_DOUBLE ? (unsigned long long)record->values[arg].d : (unsigned long long)record->values[arg].u);
+            break;
+        case 'c':
+            spec[spec_len++] = conversion;
+            spec[spec_len] = '\0';
+            n = snprintf(&out[len], room, spec, (int)record->values[arg].i);
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec[spec_len++] = conversion;
+            spec[spec_len] = '\0';
+            n = snprintf(&out[len], room, spec,
+                         type == LOG_ARG_DOUBLE ? record->values[arg].d :
+                         type == LOG_ARG_INT ? (double)record->values[arg].i : (double)record->values[arg].u);
+            break;
+        case 's': {
+            const char *s = "(?)";
+            if (type == LOG_ARG_STRING) {
+                s = record->values[arg].u < LOG_TEXT_SIZE ? &record->text[record->values[arg].u] : "";
+            }
+            spec[spec_len++] = conversion;
+            spec[spec_len] = '\0';
+            n = snprintf(&out[len], room, spec, s);
+            break;
+        }
+        case 'p':
+            spec[spec_len++] = conversion;
+            spec[spec_len] = '\0';
+            n = snprintf(&out[len], room, spec, record->values[arg].p);
+            break;
+        default:
+            n = 0;
+            break;
+        }
+        arg++;
+
+        if (n > 0) {
+            len += ((size_t)n < room) ? (size_t)n : room - 1;
+        }
+    }
+#pragma GCC diagnostic pop
+
+    out[len] = '\0';
+    return len;
+} /* format_record() */
+
+/**
+ * @brief Formats a record and writes it to its stream.
+ */
+static void output_record(const log_record_t *record)
+{
+    char line[LOG_LINE_SIZE];
+    size_t len = format_record(record, line, sizeof(line));
+
+    fwrite(line, 1, len, record->level == LOG_LEVEL_ERROR ? stderr : stdout);
+} /* output_record() */
+
+/**
+ * @brief Copies the message into a record, strings into its text area.
+ */
+static void fill_record(log_record_t *record, int level, const log_arg_t *args, int n_args)
+{
+    size_t text_len = 0;
+
+    if (n_args > LOG_MAX_ARGS) {
+        n_args = LOG_MAX_ARGS;
+    }
+    record->fmt = args[0].value.s;
+    record->level = (uint8_t)level;
+    record->n_args = (uint8_t)n_args;
+
+    for (int i = 1; i < n_args; ++i) {
+        record->types[i] = args[i].type;
+        if (args[i].type != LOG_ARG_STRING) {
+            record->values[i].u = args[i].value.u;
+            continue;
+        }
+
+        const char *s = args[i].value.s ? args[i].value.s : "(null)";
+        size_t n = strnlen(s, LOG_TEXT_SIZE);
+        if (text_len >= LOG_TEXT_SIZE) {
+            record->values[i].u = LOG_TEXT_SIZE;
+            continue;
+        }
+        if (n > LOG_TEXT_SIZE - 1 - text_len) {
+            n = LOG_TEXT_SIZE - 1 - text_len;
+        }
+        memcpy(&record->text[text_len], s, n);
+        record->text[text_len + n] = '\0';
+        record->values[i].u = text_len;
+        text_len += n + 1;
+    }
+} /* fill_record() */
+
+/**
+ * @brief Takes the next record from the ring.
+ *
+ * @return bool False if the ring is empty.
+ */
+static bool dequeue(log_record_t *record)
+{
+    log_slot_t *slot = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != dequeue_pos + 1) {
+        return false;
+    }
+    *record = slot->record;
+    atomic_store_explicit(&slot->seq, dequeue_pos + LOG_RING_SIZE, memory_order_release);
+    dequeue_pos++;
+
+    return true;
+} /* dequeue() */
+
+static void *log_thread(void *arg)
+{
+    log_record_t record;
+    (void)arg;
+
+    for (;;) {
+        size_t count = 0;
+        while (dequeue(&record)) {
+            output_record(&record);
+            count++;
+        }
+        if (count > 0) {
+            fflush(stdout);
+            atomic_fetch_add(&written, count);
+            continue;
+        }
+        if (atomic_load(&stopping)) {
+            break;
+        }
+
+        // Producers only pay for a wakeup when this thread is about to sleep
+        atomic_store(&sleeping, 1);
+        log_slot_t *slot = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+        if (atomic_load(&slot->seq) != dequeue_pos + 1 && !atomic_load(&stopping)) {
+            struct pollfd pfd = { wake_fd, POLLIN, 0 };
+            poll(&pfd, 1, LOG_IDLE_MS);
+        }
+        atomic_store(&sleeping, 0);
+
+        uint64_t wakeups;
+        if (read(wake_fd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN) {
+            break;
+        }
+    }
+
+    return NULL;
+} /* log_thread() */
+
+static void wake_thread(void)
+{
+    uint64_t one = 1;
+
+    if (atomic_exchange(&sleeping, 0) && write(wake_fd, &one, sizeof(one)) < 0) {
+        return;
+    }
+} /* wake_thread() */
+
+void log_write(int level, const log_arg_t *args, int n_args)
+{
+    if (!atomic_load_explicit(&running, memory_order_acquire)) {
+        log_record_t record;
+        fill_record(&record, level, args, n_args);
+        output_record(&record);
+        return;
+    }
+
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    log_slot_t *slot;
+    for (;;) {
+        slot = &ring[pos & (LOG_RING_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // Ring is full, the packet path never waits for the logging thread
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        }
+        else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    fill_record(&slot->record, level, args, n_args);
+    atomic_store(&slot->seq, pos + 1);
+
+    if (atomic_load(&sleeping)) {
+        wake_thread();
+    }
+} /* log_write() */
+
+int log_parse_level(const char *name)
+{
+    for (size_t i = 0; i < sizeof(level_names) / sizeof(level_names[0]); ++i) {
+        if (strcasecmp(name, level_names[i]) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+} /* log_parse_level() */
+
+void log_set_level(int level)
+{
+    atomic_store(&log_runtime_level, level);
+} /* log_set_level() */
+
+unsigned long log_dropped(void)
+{
+    return atomic_load(&dropped);
+} /* log_dropped() */
+
+int log_init(int level)
+{
+    const char *env = getenv("LOG_LEVEL");
+    if (env && log_parse_level(env) >= 0) {
+        level = log_parse_level(env);
+    }
+    log_set_level(level);
+
+    for (size_t i = 0; i < LOG_RING_SIZE; ++i) {
+        atomic_init(&ring[i].seq, i);
+    }
+    atomic_store(&enqueue_pos, 0);
+    dequeue_pos = 0;
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        return -1;
+    }
+
+    // Signals are for the event loops, the logging thread starts with all of them blocked
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int created = pthread_create(&thread, NULL, log_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (created != 0) {
+        close(wake_fd);
+        wake_fd = -1;
+        return -1;
+    }
+    atomic_store_explicit(&running, true, memory_order_release);
+
+    return 0;
+} /* log_init() */
+
+void log_flush(void)
+{
+    if (!atomic_load(&running)) {
+        fflush(stdout);
+        return;
+    }
+
+    size_t target = atomic_load(&enqueue_pos);
+    while (atomic_load(&written) < target) {
+        struct timespec pause = { 0, 1000000 };
+        atomic_store(&sleeping, 1);
+        wake_thread();
+        nanosleep(&pause, NULL);
+    }
+} /* log_flush() */
+
+void log_shutdown(void)
+{
+    if (!atomic_load(&running)) {
+        return;
+    }
+
+    log_flush();
+    atomic_store(&running, false);
+    atomic_store(&stopping, true);
+    atomic_store(&sleeping, 1);
+    wake_thread();
+    pthread_join(thread, NULL);
+    close(wake_fd);
+    wake_fd = -1;
+    fflush(stdout);
+} /* log_shutdown() */
@@ -0,0 +1,82 @@
+/******************************************
+ *
+ * Filename:    pacer.c
+ *
+ * Description: Token bucket that spreads the clients' packets over time
+ *              instead of sending a whole window as one burst.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <string.h>
+
+#include "../include/pacer.h"
+
+static void pacer_refill(pacer_t *pacer, uint64_t now_us)
+{
+    if (now_us <= pacer->last_us) {
+        return;
+    }
+
+    uint64_t elapsed_us = now_us - pacer->last_us;
+    pacer->last_us = now_us;
+    if (pacer->rate <= 0.0) {
+        return;
+    }
+
+    double credit = pacer->rate * elapsed_us / 1e6;
+    pacer->paced_us += elapsed_us;
+    pacer->target_bytes += credit;
+    pacer->tokens += credit;
+    if (pacer->tokens > pacer->burst) {
+        pacer->tokens = pacer->burst;
+    }
+} /* pacer_refill() */
+
+void pacer_init(pacer_t *pacer, double rate, size_t burst, uint64_t now_us)
+{
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->rate = (rate > 0.0) ? rate : 0.0;
+    pacer->burst = (burst > 0) ? (double)burst : 1.0;
+    pacer->tokens = pacer->burst;
+    pacer->last_us = now_us;
+} /* pacer_init() */
+
+void pacer_set_rate(pacer_t *pacer, double rate, uint64_t now_us)
+{
+    pacer_refill(pacer, now_us);
+    pacer->rate = (rate > 0.0) ? rate : 0.0;
+} /* pacer_set_rate() */
+
+uint64_t pacer_release_us(pacer_t *pacer, size_t bytes, uint64_t now_us)
+{
+    // The bucket never holds more than its depth, a larger packet waits for a full bucket
+    double needed = ((double)bytes < pacer->burst) ? (double)bytes : pacer->burst;
+
+    pacer_refill(pacer, now_us);
+    if (pacer->rate <= 0.0 || pacer->tokens >= needed) {
+        return now_us;
+    }
+
+    uint64_t wait_us = (uint64_t)((needed - pacer->tokens) * 1e6 / pacer->rate) + 1;
+    pacer->release_us = now_us + wait_us;
+
+    return pacer->release_us;
+} /* pacer_release_us() */
+
+void pacer_sent(pacer_t *pacer, size_t bytes, uint64_t now_us)
+{
+    pacer_refill(pacer, now_us);
+    if (pacer->rate > 0.0) {
+        pacer->paced_bytes += bytes;
+    }
+    pacer->tokens -= (double)bytes;
+
+    // How precisely the loop hit the release time of a packet that had to wait
+    if (pacer->release_us) {
+        pacer->waits++;
+        pacer->late_us += (now_us > pacer->release_us) ? now_us - pacer->release_us : 0;
+        pacer->release_us = 0;
+    }
+} /* pacer_sent() */
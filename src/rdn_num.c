@@ -2,24 +2,128 @@
  * 
  * Filename:    rdn_num.c
  * 
- * Description: Generates random numbers between 0.1 - 1.0
+ * Description: Seedable per-thread xoshiro256** generator with uniform
+ *              random numbers in (0, 1]
  * 
  * Copyright (c) 2024 Kariantti Laitala
  * Permission tba
  *******************************************/
 
 
-#include <stdio.h>
-#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "../include/rdn_num.h"
 
+static __thread rand_gen_t thread_gen;
+static __thread bool thread_seeded;
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t xoshiro_next(uint64_t *s)
+{
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+// Equivalent to 2^128 calls of xoshiro_next(), the start of the next stream
+static void xoshiro_jump(uint64_t *s)
+{
+    static const uint64_t jump[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                     0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    uint64_t t[4] = {0};
+
+    for (int i = 0; i < 4; ++i) {
+        for (int b = 0; b < 64; ++b) {
+            if (jump[i] & (1ULL << b)) {
+                t[0] ^= s[0];
+                t[1] ^= s[1];
+                t[2] ^= s[2];
+                t[3] ^= s[3];
+            }
+            xoshiro_next(s);
+        }
+    }
+    s[0] = t[0];
+    s[1] = t[1];
+    s[2] = t[2];
+    s[3] = t[3];
+} /* xoshiro_jump() */
+
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void rand_gen_seed(rand_gen_t *gen, uint64_t seed, uint64_t stream)
+{
+    // splitmix64 spreads any seed, 0 included, over a state that is never all zero
+    for (int i = 0; i < 4; ++i) {
+        gen->s[i] = splitmix64(&seed);
+    }
+    for (uint64_t i = 0; i < stream; ++i) {
+        xoshiro_jump(gen->s);
+    }
+    gen->next = RAND_BLOCK;
+} /* rand_gen_seed() */
+
+uint64_t rand_gen_u64(rand_gen_t *gen)
+{
+    return xoshiro_next(gen->s);
+} /* rand_gen_u64() */
+
+void rand_gen_fill(rand_gen_t *gen, double *numbers, size_t count)
+{
+    uint64_t s[4] = { gen->s[0], gen->s[1], gen->s[2], gen->s[3] };
+
+    // The top 53 bits plus one, scaled to (0, 1]: no number is 0, so a probability of 0 never hits
+    for (size_t i = 0; i < count; ++i) {
+        numbers[i] = (double)((xoshiro_next(s) >> 11) + 1) * 0x1.0p-53;
+    }
+
+    gen->s[0] = s[0];
+    gen->s[1] = s[1];
+    gen->s[2] = s[2];
+    gen->s[3] = s[3];
+} /* rand_gen_fill() */
+
+void rand_seed(uint64_t seed, uint64_t stream)
+{
+    rand_gen_seed(&thread_gen, seed, stream);
+    thread_seeded = true;
+} /* rand_seed() */
+
+uint64_t rand_default_seed(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    uint64_t x = ((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec) ^ ((uint64_t)getpid() << 32);
+    return splitmix64(&x);
+} /* rand_default_seed() */
+
 double rand_number(void)
 {
-    int max = 10;
-    int min = 1;
+    if (!thread_seeded) {
+        rand_seed(0, 0);
+    }
 
-    int rd_num = rand() % (max - min + 1) + min;
-    
-    return (double)rd_num / 10;
+    return rand_gen_number(&thread_gen);
 }   /* rand_number() */
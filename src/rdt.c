@@ -1,5 +1,6 @@
 
 #include "../include/rdt.h"
+#include "../include/log.h"
 
 #define RED     "\033[1;31m"
 #define ORANGE  "\033[1;33m"
@@ -7,31 +8,45 @@
 #define RESET   "\033[0m"
 
 
-crc process_packet (char *read, long bytes_received, Rdt_variables* vars)
+int rdt_impair(Rdt_variables *vars, char *read, long bytes_received, uint64_t *delay_us)
 {
-    if (rand_number() <= vars->drop_probability) {
-        printf(RED "------- Packet Dropped -------\n\n" RESET);
-        return true;
-    }
-    // TODO: Remove else 
-    else {
-    // Add delay   
-        if (rand_number() <= vars->delay_probability) {
-            printf(RED "------- Delay Added -------\n\n" RESET);
-            msleep(vars->delay_ms);
+    *delay_us = vars->delay_ms * 1000ULL;
+
+    // A trace replays the recorded fate of the packet
+    if (vars->trace) {
+        uint32_t record = impair_trace_next(vars->trace, &vars->trace_next);
+        if (record & IMPAIR_TRACE_DROP) {
+            LOG_DEBUG(RED "------- Packet Dropped -------\n\n" RESET);
+            return RDT_DROP;
         }
-        // Add bit error
-        if (rand_number() <= vars->error_probability) {
+        if ((record & IMPAIR_TRACE_CORRUPT) && bytes_received >= 2) {
             char mask = 0x2;
             read[bytes_received-2] = read[bytes_received-2] ^ mask;
         }
+        *delay_us = impair_trace_delay_us(record);
+        return (*delay_us > 0) ? RDT_DELAY : RDT_PASS;
     }
 
-    crc data[100];
-    memset(data, '\0', sizeof(data));
-    
-    memcpy(data, read, bytes_received);
-    data[bytes_received] = '\0';
+    if (vars->drop_probability > 0 && rand_number() <= vars->drop_probability) {
+        LOG_DEBUG(RED "------- Packet Dropped -------\n\n" RESET);
+        return RDT_DROP;
+    }
+    // Add delay, the caller parks the packet until the delay has passed
+    if (vars->delay_probability > 0 && rand_number() <= vars->delay_probability) {
+        LOG_DEBUG(RED "------- Delay Added -------\n\n" RESET);
+        return RDT_DELAY;
+    }
+
+    return RDT_PASS;
+} /* rdt_impair() */
+
+crc process_packet (char *read, long bytes_received, Rdt_variables* vars)
+{
+    // Add bit error, a trace has applied its own in rdt_impair()
+    if (!vars->trace && vars->error_probability > 0 && rand_number() <= vars->error_probability) {
+        char mask = 0x2;
+        read[bytes_received-2] = read[bytes_received-2] ^ mask;
+    }
 
     // printf("READ[0] = %d\n", read[0]);
     if (vars->rdt == 22) {
@@ -42,7 +57,7 @@ crc process_packet (char *read, long bytes_received, Rdt_variables* vars)
     if (vars->rdt == 30) {
         if (vars->last_seq == vars->seq) {
             // Duplicate
-            printf(RED "------- Duplicate Packet -------\n\n" RESET);
+            LOG_DEBUG(RED "------- Duplicate Packet -------\n\n" RESET);
             vars->seq = vars->last_seq;
         } 
     
@@ -53,7 +68,7 @@ crc process_packet (char *read, long bytes_received, Rdt_variables* vars)
     }
 
     // printf("seq = %d\n", vars->seq);
-    crc result = crcFast(data, bytes_received);
+    crc result = crcFast((const uint8_t *)read, bytes_received);
 
     return result;
                
@@ -75,20 +90,21 @@ int make_packet(char *packet, int version, uint8_t seq, int result) {
         CRC = 0x12;
     }
 
-    char *ack = (result == 0 ? "ACK" : "NAK");
+    const char *ack = (result == 0 ? "ACK" : "NAK");
 
     // If rdt version is 2.0 or 2.1, no seq number needed with ACK packet.
     if (version == 20 || version == 21) {
-        size_t size = strlen(ack) + 2;  // Adding 2 as one for CRC and other for null terminator
-        snprintf(packet, size, "%s%c", ack, CRC);
-        packet_len = snprintf(packet, size,"%s%c", ack, CRC);
+        memcpy(packet, ack, 3);
+        packet[3] = (char)CRC;
+        packet_len = 4;
 
     }
     // rdt version 2.2 and 3.0 needs seq number with ACK packet
     else if (version == 22 || version == 30) {
-        size_t size = strlen(ack) + 3;  // Adding 3 as one for SEQ, one for CRC and for null terminator 
-        snprintf(packet, size, "%c%s%c", seq, ack, CRC);
-        packet_len = snprintf(packet, size, "%c%s%c", seq, ack, CRC);            
+        packet[0] = (char)seq;
+        memcpy(&packet[1], ack, 3);
+        packet[4] = (char)CRC;
+        packet_len = 5;
 
     }
 
@@ -0,0 +1,63 @@
+/******************************************
+ *
+ * Filename:    rtt.c
+ *
+ * Description: Round-trip time estimation of the clients. The RTO follows
+ *              RFC 6298: SRTT and RTTVAR are smoothed with gains of 1/8
+ *              and 1/4 and the timeout doubles on every expiry.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <string.h>
+
+#include "../include/rtt.h"
+
+static uint64_t rtt_clamp(const rtt_t *rtt, uint64_t rto_us)
+{
+    if (rto_us < rtt->min_rto_us) {
+        return rtt->min_rto_us;
+    }
+
+    return (rto_us > rtt->max_rto_us) ? rtt->max_rto_us : rto_us;
+} /* rtt_clamp() */
+
+void rtt_init(rtt_t *rtt, uint64_t min_rto_us, uint64_t max_rto_us)
+{
+    memset(rtt, 0, sizeof(*rtt));
+    rtt->min_rto_us = min_rto_us;
+    rtt->max_rto_us = (max_rto_us < min_rto_us) ? min_rto_us : max_rto_us;
+    rtt->rto_us = rtt_clamp(rtt, RTT_INITIAL_RTO_US);
+} /* rtt_init() */
+
+void rtt_sample(rtt_t *rtt, uint64_t sample_us)
+{
+    if (rtt->samples == 0) {
+        rtt->srtt_us = sample_us;
+        rtt->rttvar_us = sample_us / 2;
+        rtt->min_rtt_us = sample_us;
+    }
+    else {
+        uint64_t delta = (sample_us > rtt->srtt_us) ? sample_us - rtt->srtt_us : rtt->srtt_us - sample_us;
+        rtt->rttvar_us = (3 * rtt->rttvar_us + delta) / 4;
+        rtt->srtt_us = (7 * rtt->srtt_us + sample_us) / 8;
+        if (sample_us < rtt->min_rtt_us) {
+            rtt->min_rtt_us = sample_us;
+        }
+    }
+    rtt->last_us = sample_us;
+    rtt->samples++;
+
+    // A valid sample ends the backoff
+    rtt->rto_us = rtt_clamp(rtt, rtt->srtt_us + 4 * rtt->rttvar_us);
+    rtt->backoff = 0;
+} /* rtt_sample() */
+
+void rtt_backoff(rtt_t *rtt)
+{
+    if (rtt->backoff < RTT_MAX_BACKOFF && (rtt->rto_us << rtt->backoff) < rtt->max_rto_us) {
+        rtt->backoff++;
+    }
+    rtt->timeouts++;
+} /* rtt_backoff() */
@@ -0,0 +1,185 @@
+/******************************************
+ *
+ * Filename:    send_window.c
+ *
+ * Description: Sender window shared by the GBN and SR clients. Packets
+ *              are encoded once into a preallocated ring and resent from
+ *              there, acknowledgements are kept in a bitmap.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/send_window.h"
+
+int send_window_init(send_window_t *win, uint32_t window, size_t slot_size)
+{
+    uint32_t slots = SEND_WINDOW_MIN_SLOTS;
+
+    memset(win, 0, sizeof(*win));
+    if (window < 1 || window > SEND_WINDOW_MAX_SLOTS) {
+        return -1;
+    }
+    while (slots < window) {
+        slots <<= 1;
+    }
+
+    win->window = window;
+    win->mask = slots - 1;
+    win->slot_size = slot_size;
+    win->packets = malloc((size_t)slots * slot_size);
+    win->len = calloc(slots, sizeof(uint16_t));
+    win->sent_us = calloc(slots, sizeof(uint64_t));
+    win->acked = calloc(BITMAP_WORDS(slots), sizeof(uint64_t));
+    win->resent = calloc(BITMAP_WORDS(slots), sizeof(uint64_t));
+    if (!win->packets || !win->len || !win->sent_us || !win->acked || !win->resent) {
+        send_window_free(win);
+        return -1;
+    }
+
+    return 0;
+} /* send_window_init() */
+
+void send_window_free(send_window_t *win)
+{
+    free(win->packets);
+    free(win->len);
+    free(win->sent_us);
+    free(win->acked);
+    free(win->resent);
+    memset(win, 0, sizeof(*win));
+} /* send_window_free() */
+
+uint64_t send_window_push(send_window_t *win, size_t len, uint64_t now_us)
+{
+    uint32_t slot = win->next & win->mask;
+
+    win->len[slot] = (uint16_t)len;
+    win->sent_us[slot] = now_us;
+    bitmap_clear(win->acked, slot);
+    bitmap_clear(win->resent, slot);
+
+    return win->next++;
+} /* send_window_push() */
+
+bool send_window_ack(send_window_t *win, uint64_t index)
+{
+    if (index < win->base || index >= win->next || send_window_is_acked(win, index)) {
+        return false;
+    }
+    bitmap_set(win->acked, index & win->mask);
+    win->sacked++;
+
+    return true;
+} /* send_window_ack() */
+
+uint64_t send_window_ack_through(send_window_t *win, uint64_t index)
+{
+    if (index < win->base || index >= win->next) {
+        return 0;
+    }
+
+    // Slots behind the base are not looked at again, their flags are cleared when reused
+    uint64_t slid = index + 1 - win->base;
+    win->base = index + 1;
+
+    // Packets acknowledged out of order before may now be behind the base
+    if (win->sacked > 0) {
+        win->sacked = 0;
+        for (uint64_t i = win->base; i < win->next; ) {
+            uint64_t hole = send_window_next_unacked(win, i);
+            win->sacked += hole - i;
+            i = (hole < win->next) ? hole + bitmap_gap(win->acked, win->mask, hole & win->mask,
+                                                       (uint32_t)(win->next - hole)) : hole;
+        }
+    }
+
+    return slid;
+} /* send_window_ack_through() */
+
+uint64_t send_window_sack(send_window_t *win, int32_t start, int32_t end,
+                          void (*on_ack)(uint64_t index, void *ctx), void *ctx)
+{
+    uint64_t in_flight = win->next - win->base;
+    uint64_t first = (start < 0) ? 0 : (uint64_t)start;
+    uint64_t last = (end < 0) ? 0 : (uint64_t)end;
+    uint64_t acked = 0;
+
+    if (last > in_flight) {
+        last = in_flight;
+    }
+    for (uint64_t i = send_window_next_unacked(win, win->base + first); i < win->base + last;
+         i = send_window_next_unacked(win, i + 1)) {
+        bitmap_set(win->acked, i & win->mask);
+        win->sacked++;
+        acked++;
+        if (on_ack) {
+            on_ack(i, ctx);
+        }
+    }
+
+    return acked;
+} /* send_window_sack() */
+
+uint64_t send_window_apply_sack(send_window_t *win, const codec_frame_t *frame, uint32_t base_seq,
+                                uint64_t *answered, void (*on_ack)(uint64_t index, void *ctx), void *ctx)
+{
+    int32_t latest = (int32_t)(frame->seq - base_seq);
+    uint64_t acked = 0;
+
+    // The answered packet first, it tells if this ACK is the first to report it
+    *answered = win->next;
+    if (latest >= 0 && (uint64_t)latest < win->next - win->base &&
+        send_window_sack(win, latest, latest + 1, on_ack, ctx) > 0) {
+        *answered = win->base + (uint64_t)latest;
+        acked++;
+    }
+    acked += send_window_sack(win, 0, (int32_t)(frame->ack + 1 - base_seq), on_ack, ctx);
+
+    codec_sack_t blocks[CODEC_SACK_BLOCKS];
+    int n_blocks = codec_parse_sack(frame, blocks, CODEC_SACK_BLOCKS);
+    for (int b = 0; b < n_blocks; ++b) {
+        acked += send_window_sack(win, (int32_t)(blocks[b].start - base_seq), (int32_t)(blocks[b].end - base_seq),
+                                  on_ack, ctx);
+    }
+
+    return acked;
+} /* send_window_apply_sack() */
+
+uint64_t send_window_slide(send_window_t *win)
+{
+    uint64_t in_flight = win->next - win->base;
+    uint32_t run = bitmap_run(win->acked, win->mask, win->base & win->mask, (uint32_t)in_flight);
+
+    win->base += run;
+    win->sacked -= run;
+
+    return run;
+} /* send_window_slide() */
+
+uint64_t send_window_next_unacked(const send_window_t *win, uint64_t index)
+{
+    if (index >= win->next) {
+        return win->next;
+    }
+
+    return index + bitmap_run(win->acked, win->mask, index & win->mask, (uint32_t)(win->next - index));
+} /* send_window_next_unacked() */
+
+uint64_t send_window_next_lost(const send_window_t *win, uint64_t index, uint64_t acked)
+{
+    uint64_t acked_sent_us = send_window_sent_us(win, acked);
+
+    // Only the holes are looked at, the bitmap skips the acknowledged runs
+    for (uint64_t i = send_window_next_unacked(win, index); i + SEND_WINDOW_DUP_THRESH <= acked;
+         i = send_window_next_unacked(win, i + 1)) {
+        if (send_window_sent_us(win, i) <= acked_sent_us) {
+            return i;
+        }
+    }
+
+    return win->next;
+} /* send_window_next_lost() */
@@ -0,0 +1,294 @@
+/******************************************
+ *
+ * Filename:    session.c
+ *
+ * Description: Session table of the UDP server. Sessions are found with an
+ *              open addressing hash keyed by the client address and port,
+ *              so the cost per packet stays constant with thousands of
+ *              concurrent clients.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <netinet/in.h>
+
+#include "../include/session.h"
+
+#define SESSION_MIN_CAPACITY    64
+
+/**
+ * @brief Hashes a key with the 64-bit finalizer of MurmurHash3.
+ *
+ * @return uint32_t Non-zero hash, zero is reserved for empty slots.
+ */
+static uint32_t hash_key(const session_key_t *key)
+{
+    uint64_t h = ((uint64_t)key->addr[0] << 32 | key->addr[1]) ^
+                 ((uint64_t)key->addr[2] << 32 | key->addr[3]) * 0x9e3779b97f4a7c15ULL ^
+                 ((uint64_t)key->port << 16 | key->family);
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    uint32_t hash = (uint32_t)h;
+    return hash ? hash : 1;
+} /* hash_key() */
+
+static bool key_equal(const session_key_t *a, const session_key_t *b)
+{
+    return memcmp(a, b, sizeof(*a)) == 0;
+} /* key_equal() */
+
+/**
+ * @brief Finds the slot holding the key, or the empty slot where it would go.
+ */
+static uint32_t find_slot(const session_table_t *table, const session_key_t *key, uint32_t hash)
+{
+    uint32_t mask = table->capacity - 1;
+    uint32_t i = hash & mask;
+
+    while (table->slots[i].hash != 0) {
+        if (table->slots[i].hash == hash && key_equal(&table->slots[i].key, key)) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+
+    return i;
+} /* find_slot() */
+
+/**
+ * @brief Doubles the slot array and reinserts every session.
+ */
+static int grow(session_table_t *table)
+{
+    session_slot_t *old_slots = table->slots;
+    uint32_t old_capacity = table->capacity;
+
+    session_slot_t *slots = calloc((size_t)old_capacity * 2, sizeof(*slots));
+    if (!slots) {
+        return -1;
+    }
+
+    table->slots = slots;
+    table->capacity = old_capacity * 2;
+
+    for (uint32_t i = 0; i < old_capacity; ++i) {
+        if (old_slots[i].hash != 0) {
+            uint32_t slot = find_slot(table, &old_slots[i].key, old_slots[i].hash);
+            table->slots[slot] = old_slots[i];
+        }
+    }
+    free(old_slots);
+
+    return 0;
+} /* grow() */
+
+/**
+ * @brief Takes a session from the free list, allocating a new chunk if it is empty.
+ */
+static session_t *alloc_session(session_table_t *table)
+{
+    if (!table->free_list) {
+        session_t **chunks = realloc(table->chunks, (table->n_chunks + 1) * sizeof(*chunks));
+        if (!chunks) {
+            return NULL;
+        }
+        table->chunks = chunks;
+
+        session_t *chunk = malloc(SESSION_CHUNK * sizeof(*chunk));
+        if (!chunk) {
+            return NULL;
+        }
+        table->chunks[table->n_chunks++] = chunk;
+
+        for (size_t i = SESSION_CHUNK; i > 0; --i) {
+            chunk[i - 1].next_free = table->free_list;
+            table->free_list = &chunk[i - 1];
+        }
+    }
+
+    session_t *session = table->free_list;
+    table->free_list = session->next_free;
+
+    return session;
+} /* alloc_session() */
+
+int session_table_init(session_table_t *table, uint32_t initial_capacity, uint32_t max_sessions)
+{
+    memset(table, 0, sizeof(*table));
+
+    uint32_t capacity = SESSION_MIN_CAPACITY;
+    while (capacity < initial_capacity && capacity < (1U << 31)) {
+        capacity <<= 1;
+    }
+
+    table->slots = calloc(capacity, sizeof(*table->slots));
+    if (!table->slots) {
+        return -1;
+    }
+    table->capacity = capacity;
+    table->max_sessions = max_sessions;
+
+    return 0;
+} /* session_table_init() */
+
+void session_table_free(session_table_t *table)
+{
+    for (uint32_t i = 0; i < table->capacity; ++i) {
+        if (table->slots[i].session) {
+            sr_buffer_free(&table->slots[i].session->sr_receive_buffer);
+        }
+    }
+    for (size_t i = 0; i < table->n_chunks; ++i) {
+        free(table->chunks[i]);
+    }
+    free(table->chunks);
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+} /* session_table_free() */
+
+int session_make_key(session_key_t *key, const struct sockaddr *address, socklen_t address_len)
+{
+    memset(key, 0, sizeof(*key));
+
+    if (address->sa_family == AF_INET && address_len >= sizeof(struct sockaddr_in)) {
+        const struct sockaddr_in *in = (const struct sockaddr_in *)address;
+        key->addr[0] = in->sin_addr.s_addr;
+        key->port = in->sin_port;
+        key->family = AF_INET;
+        return 0;
+    }
+    if (address->sa_family == AF_INET6 && address_len >= sizeof(struct sockaddr_in6)) {
+        const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)address;
+        memcpy(key->addr, &in6->sin6_addr, sizeof(key->addr));
+        key->port = in6->sin6_port;
+        key->family = AF_INET6;
+        return 0;
+    }
+
+    errno = EAFNOSUPPORT;
+    return -1;
+} /* session_make_key() */
+
+session_t *session_lookup(session_table_t *table, const session_key_t *key)
+{
+    uint32_t hash = hash_key(key);
+    uint32_t slot = find_slot(table, key, hash);
+
+    return table->slots[slot].session;
+} /* session_lookup() */
+
+session_t *session_get(session_table_t *table, const struct sockaddr *address,
+                       socklen_t address_len, bool *created)
+{
+    session_key_t key;
+
+    *created = false;
+    if (session_make_key(&key, address, address_len) < 0) {
+        return NULL;
+    }
+
+    uint32_t hash = hash_key(&key);
+    uint32_t slot = find_slot(table, &key, hash);
+    if (table->slots[slot].session) {
+        return table->slots[slot].session;
+    }
+
+    if (table->count >= table->max_sessions) {
+        table->rejected++;
+        return NULL;
+    }
+
+    // Keep the load factor at most 1/2 so probe sequences stay short
+    if ((table->count + 1) * 2 > table->capacity) {
+        if (grow(table) < 0) {
+            return NULL;
+        }
+        slot = find_slot(table, &key, hash);
+    }
+
+    session_t *session = alloc_session(table);
+    if (!session) {
+        return NULL;
+    }
+    memset(session, 0, sizeof(*session));
+    session->key = key;
+    memcpy(&session->address, address, address_len);
+    session->address_len = address_len;
+
+    table->slots[slot].hash = hash;
+    table->slots[slot].key = key;
+    table->slots[slot].session = session;
+    table->count++;
+    table->created++;
+    *created = true;
+
+    return session;
+} /* session_get() */
+
+/**
+ * @brief Empties a slot and shifts the following entries of its cluster back.
+ */
+static void delete_slot(session_table_t *table, uint32_t hole)
+{
+    uint32_t mask = table->capacity - 1;
+    uint32_t i = (hole + 1) & mask;
+
+    while (table->slots[i].hash != 0) {
+        uint32_t home = table->slots[i].hash & mask;
+
+        // Move the entry if its home slot is not between the hole and its position
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table->slots[hole] = table->slots[i];
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+
+    memset(&table->slots[hole], 0, sizeof(table->slots[hole]));
+    table->count--;
+} /* delete_slot() */
+
+/**
+ * @brief Takes a session out of the table and puts it on the free list.
+ *
+ * @return bool false if the session is not in the table.
+ */
+static bool release_session(session_table_t *table, session_t *session)
+{
+    uint32_t slot = find_slot(table, &session->key, hash_key(&session->key));
+    if (table->slots[slot].session != session) {
+        return false;
+    }
+
+    delete_slot(table, slot);
+    sr_buffer_free(&session->sr_receive_buffer);
+
+    session->next_free = table->free_list;
+    table->free_list = session;
+
+    return true;
+} /* release_session() */
+
+void session_remove(session_table_t *table, session_t *session)
+{
+    if (release_session(table, session)) {
+        table->removed++;
+    }
+} /* session_remove() */
+
+void session_evict(session_table_t *table, session_t *session)
+{
+    if (release_session(table, session)) {
+        table->evicted++;
+    }
+} /* session_evict() */
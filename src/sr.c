@@ -1,65 +1,143 @@
 #include "../include/sr.h"
+#include "../include/log.h"
 
 
-int sr_process_packet (char *read, long bytes_received)
+int sr_process_packet (char *read, long bytes_received, const codec_t *codec, uint32_t rcv_base,
+                       codec_frame_t *frame)
 {
 
-    crc data[100];
-    memset(data, '\0', sizeof(data));
-   
-    memcpy(data, read, bytes_received);
-    data[bytes_received] = '\0';
+    if (!codec_parse_frame(codec, read, bytes_received, rcv_base, frame) || frame->type != CODEC_DATA) {
+        return NAK;
+    }
 
-    crc result = crcFast(data, bytes_received);
+    LOG_DEBUG("----- Packet Received -------\n");
+    LOG_DEBUG("Received: SEQ %u | Bytes: %d | CRC Check: OK\n", frame->seq, frame->len); 
 
-    if (result != 0) {
-        return NAK;
+    return ACK;
+
+}
+
+
+int sr_make_packet(char *packet, uint32_t seqnum, const codec_t *codec)
+{
+    return (int)codec_make_ack(codec, packet, seqnum);
+}
+
+uint32_t sr_buffer_slots(uint32_t window)
+{
+    uint32_t slots = SR_MIN_SLOTS;
+
+    while (slots < window && slots < SR_MAX_SLOTS) {
+        slots <<= 1;
     }
 
-    int received_seq_num = (int)read[0];
-    printf("----- Packet Received -------\n");
-    printf("Received: SEQ %d | CRC Check: OK\n", received_seq_num); 
+    return slots;
+}
+
+int sr_buffer_init(sr_receive_buffer_t *buffer, uint32_t slots, uint16_t slot_size)
+{
+    sr_buffer_free(buffer);
+    if (slot_size < 1) {
+        slot_size = 1;
+    }
 
-    return received_seq_num;
+    buffer->received = calloc(BITMAP_WORDS(slots), sizeof(uint64_t));
+    buffer->len = malloc(slots * sizeof(uint16_t));
+    buffer->data = malloc((size_t)slots * slot_size);
+    if (!buffer->received || !buffer->len || !buffer->data) {
+        sr_buffer_free(buffer);
+        return -1;
+    }
+    buffer->mask = slots - 1;
+    buffer->slot_size = slot_size;
 
+    return 0;
 }
 
+int sr_buffer_store(sr_receive_buffer_t *buffer, uint32_t seq, const char *payload, uint16_t len)
+{
+    // The caller rejects oversized frames, a cut payload would be delivered silently
+    if (len > buffer->slot_size) {
+        LOG_ERROR("ERROR: %u payload bytes do not fit a %u byte slot\n", len, buffer->slot_size);
+        return -1;
+    }
+
+    memcpy(sr_buffer_slot(buffer, seq), payload, len);
+    buffer->len[seq & buffer->mask] = len;
+    if (!bitmap_test(buffer->received, seq & buffer->mask)) {
+        buffer->count++;
+    }
+    bitmap_set(buffer->received, seq & buffer->mask);
 
-int sr_make_packet(char *packet, uint8_t seqnum)
+    return 0;
+}
+
+void sr_buffer_clear(sr_receive_buffer_t *buffer)
 {
-    crc CRC = 0;
-    char *ack = "ACK";
+    if (buffer->received) {
+        memset(buffer->received, 0, BITMAP_WORDS(buffer->mask + 1) * sizeof(uint64_t));
+    }
+    buffer->count = 0;
+}
 
-    char ack_message[8];
-    memset(ack_message, '0', sizeof(ack_message));
-    int message_len = snprintf(NULL, 0, "%c%s", seqnum, ack);
-    snprintf(ack_message, message_len + 1, "%c%s", seqnum, ack);
+void sr_buffer_free(sr_receive_buffer_t *buffer)
+{
+    free(buffer->received);
+    free(buffer->len);
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
 
+int sr_sack_blocks(const sr_receive_buffer_t *buffer, uint32_t recv_base, uint32_t window,
+                   codec_sack_t *blocks, int max_blocks)
+{
+    int n_blocks = 0;
 
-    CRC = crcFast((crc *)ack_message, message_len);
+    if (!buffer->received) {
+        return 0;
+    }
+    if (window > buffer->mask + 1) {
+        window = buffer->mask + 1;
+    }
 
-    size_t size = snprintf(NULL, 0, "%c%s%c", seqnum, ack, CRC);
-    snprintf(packet, size + 1, "%c%s%c", seqnum, ack, CRC);
+    // Holes and runs alternate from the base, which is always a hole
+    uint32_t offset = 0;
+    while (offset < window && n_blocks < max_blocks) {
+        offset += bitmap_gap(buffer->received, buffer->mask, (recv_base + offset) & buffer->mask, window - offset);
+        if (offset >= window) {
+            break;
+        }
+        uint32_t run = bitmap_run(buffer->received, buffer->mask, (recv_base + offset) & buffer->mask, window - offset);
+        blocks[n_blocks].start = recv_base + offset;
+        blocks[n_blocks].end = recv_base + offset + run;
+        n_blocks++;
+        offset += run;
+    }
 
-    return  size;
+    return n_blocks;
 }
 
-int deliver_data(sr_receive_buffer_t buffer, char *data, int recv_base) 
+uint32_t deliver_data(sr_receive_buffer_t *buffer, codec_stream_t *stream, uint32_t recv_base) 
 {
-    int base = recv_base;
+    if (!buffer->received) {
+        return recv_base;
+    }
+
+    // Packets in order from the base form one run of set bits
+    uint32_t run = bitmap_run(buffer->received, buffer->mask, recv_base & buffer->mask, buffer->mask + 1);
 
-    printf("\n----- Delivering Packets to Upper Layer -------\n");
-    while(buffer.received[base]) {
-        data[base-1] = buffer.data[base];
-        printf("Packet %d  | Data: %c\n", base, data[base-1]); 
+    LOG_DEBUG("\n----- Delivering Packets to Upper Layer -------\n");
+    for (uint32_t base = recv_base; base != recv_base + run; ++base) {
+        uint32_t slot = base & buffer->mask;
+        codec_stream_append(stream, sr_buffer_slot(buffer, base), buffer->len[slot]);
+        LOG_DEBUG("Packet %u  | Bytes: %d\n", base, buffer->len[slot]); 
 
-        // Changing packet state to false, so it won't read again
-        buffer.received[base] = false;  
-        base++; 
+        // Clearing the slot, so it won't read again
+        bitmap_clear(buffer->received, slot);
     }
-    printf("\n----- Delivering Done -------\n");
+    LOG_DEBUG("\n----- Delivering Done -------\n");
+    buffer->count -= run;
     
-    data[base] = '\0';
-    return base;
+    return recv_base + run;
 
 }
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <inttypes.h>
 
 // Networking Headers
 #include <sys/types.h>
@@ -45,9 +46,23 @@
 
 // Local Headers
 #include "../include/crc.h"
-
-void timeout_alarm(__attribute__((unused))int ignore);
-size_t make_packet (uint8_t next_sequence, char data, crc packet_crc, char *packet);
+#include "../include/checksum.h"
+#include "../include/codec.h"
+#include "../include/crc32c.h"
+#include "../include/event_loop.h"
+#include "../include/send_window.h"
+#include "../include/rtt.h"
+#include "../include/congestion.h"
+#include "../include/pacer.h"
+#include "../include/timer_wheel.h"
+#include "../include/log.h"
+
+size_t make_packet (uint32_t next_sequence, const char *data, uint16_t len, const codec_t *codec, char *packet);
+char *load_data(const char *path, size_t generated, size_t *len);
+void size_socket_buffers(int sock, size_t bytes);
+void packet_timeout(timer_node_t *timer, void *ctx);
+void packet_acked(uint64_t index, void *ctx);
+int resend_packet(int sock, send_window_t *window, pacer_t *pacer, uint64_t index, uint64_t now_us);
 
 #define RED     "\033[1;31m"
 #define ORANGE  "\033[1;33m"
@@ -62,44 +77,123 @@ size_t make_packet (uint8_t next_sequence, char data, crc packet_crc, char *pack
 #define SERVER_IP           "127.0.0.1"
 #define DEFAULT_PORT        "6666"
 #define MAXTRIES            20
-#define TIMEOUT_SECONDS     2
-#define WINDOW_SIZE         5 
+#define HELLO_TIMEOUT_MS    200     /* Wait for the answer to a checksum HELLO */
+#define HELLO_TRIES         3
 #define MESSAGE             "Hello World from Selective Repeat"
 
-enum Packet_ack {
-    NACK,
-    ACK,
-};
+/**
+ * @brief Retransmission timers of the window and the packets whose timer fired during one wheel advance.
+ */
+typedef struct {
+    timer_wheel_t *wheel;   /**< Wheel the timers are armed on. */
+    timer_node_t *timers;   /**< Timer of every window slot. */
+    uint32_t mask;          /**< Number of slots - 1. */
+    uint32_t *slots;        /**< Window slots of the expired packets, in expiry order. */
+    uint32_t count;         /**< Number of expired packets. */
+} expired_t;
 
-volatile int g_tries = 0;
-volatile bool g_timeout = false;
-crc crcTable[256];
+size_t resend_lost(int sock, send_window_t *window, expired_t *timers, congestion_t *cc, pacer_t *pacer,
+                   uint64_t acked, uint64_t now_us, uint64_t rto_us);
 
-int packet_timer[WINDOW_SIZE];      // Timer for a sent packets. Tracking ony packets within window
-int packet_tracker[WINDOW_SIZE];       // Tracks if a packet is sent
+int g_tries = 0;
 
 
-int main(void)
+int main(int argc, char *argv[])
 {
-
-    // Timeout handler
-    struct sigaction my_timeout;
-
-    my_timeout.sa_handler = timeout_alarm;
-    if (sigfillset(&my_timeout.sa_mask) < 0){
-        fprintf(stderr, "sigfillset failed\n");
-        return 1;
+    size_t payload_size = CODEC_MAX_PAYLOAD;
+    const char *path = NULL;
+    size_t generated = 0;
+    bool isn_set = false;
+    uint32_t isn = 0;
+    uint32_t window_size = CODEC_DEFAULT_WINDOW;
+    uint64_t min_rto_us = RTT_MIN_RTO_US;
+    uint64_t max_rto_us = RTT_MAX_RTO_US;
+    int congestion_type = CONGESTION_CUBIC;
+    double pacing_mbps = -1.0;
+    const char *port = DEFAULT_PORT;
+    int c = 0;
+
+    while ((c = getopt(argc, argv, "s:f:n:i:w:t:T:c:b:p:h")) != -1) {
+        switch (c) {
+        case 's':
+            // Payload bytes per datagram
+            payload_size = strtoul(optarg, NULL, 10);
+            if (payload_size < 1 || payload_size > CODEC_MAX_PAYLOAD) {
+                fprintf(stderr, "ERROR: payload size must be between 1 and %d\n", CODEC_MAX_PAYLOAD);
+                return 1;
+            }
+            break;
+        case 'f':
+            // Send the contents of a file
+            path = optarg;
+            break;
+        case 'n':
+            // Send generated bytes
+            generated = strtoul(optarg, NULL, 10);
+            break;
+        case 'i':
+            // First sequence number, random by default
+            isn = (uint32_t)strtoul(optarg, NULL, 0);
+            isn_set = true;
+            break;
+        case 'w':
+            // Packets in flight, the server may grant fewer
+            window_size = strtoul(optarg, NULL, 10);
+            if (window_size < 1 || window_size > CODEC_MAX_WINDOW) {
+                fprintf(stderr, "ERROR: window must be between 1 and %d packets\n", CODEC_MAX_WINDOW);
+                return 1;
+            }
+            break;
+        case 't':
+            // Lower bound of the retransmission timeout
+            min_rto_us = strtoull(optarg, NULL, 10) * 1000;
+            if (min_rto_us < 1000) {
+                fprintf(stderr, "ERROR: minimum timeout must be at least 1 ms\n");
+                return 1;
+            }
+            break;
+        case 'T':
+            // Upper bound of the retransmission timeout
+            max_rto_us = strtoull(optarg, NULL, 10) * 1000;
+            break;
+        case 'c':
+            // Congestion control algorithm
+            congestion_type = congestion_parse(optarg);
+            if (congestion_type < 0) {
+                fprintf(stderr, "ERROR: congestion control must be newreno, cubic or fixed\n");
+                return 1;
+            }
+            break;
+        case 'b':
+            // Pacing rate in Mbit/s, 0 sends unpaced, by default the rate follows cwnd/RTT
+            pacing_mbps = strtod(optarg, NULL);
+            if (pacing_mbps < 0.0) {
+                fprintf(stderr, "ERROR: pacing rate must be at least 0 Mbit/s\n");
+                return 1;
+            }
+            break;
+        case 'p':
+            // Port of the server, or of a udp-impair relay in front of it
+            port = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -s [payload_bytes] -f [file] -n [generated_bytes] -i [first_seq] -w [window] "
+                    "-t [min_rto_ms] -T [max_rto_ms] -c [congestion_control] -b [pacing_mbps] -p [port]\n", argv[0]);
+            return 1;
+        }
     }
-    my_timeout.sa_flags = 0;
 
-    if (sigaction (SIGALRM, &my_timeout, 0) < 0) {
-        fprintf(stderr, "sigaction() failed.\n");
+    size_t data_len = 0;
+    char *data = load_data(path, generated, &data_len);
+    if (!data) {
+        fprintf(stderr, "Reading the data failed. (%d)\n", GETSOCKETERRNO());
         return 1;
     }
 
-
-    // Initialize fastCRC
-    crcInit();
+    // Send, receive and resend messages are written by the logging thread
+    if (log_init(LOG_LEVEL_INFO) < 0) {
+        fprintf(stderr, "Logging thread not started, logging synchronously. (%d)\n", GETSOCKETERRNO());
+    }
 
     // Configure remote address and create a socket
     printf("Configuring remote address...\n");
@@ -107,7 +201,7 @@ int main(void)
     memset(&hints, 0, sizeof(hints));
     hints.ai_socktype = SOCK_DGRAM;
     struct addrinfo *peer_address;
-    if (getaddrinfo(SERVER_IP, DEFAULT_PORT, &hints, &peer_address)) {
+    if (getaddrinfo(SERVER_IP, port, &hints, &peer_address)) {
         fprintf(stderr, "getaddrinfo() failed. (%d)\n", GETSOCKETERRNO());
         return 1;
     }
@@ -139,263 +233,517 @@ int main(void)
 
     printf("Connected.\n");
 
+    // Socket, retransmission timer and shutdown signals share one event loop
+    event_loop_t loop;
+    event_source_t socket_source = { socket_peer, EVENT_SOCKET, NULL };
+    event_source_t timer_source;
+    event_source_t signal_source;
+    const int shutdown_signals[] = { SIGINT, SIGTERM };
+
+    if (event_loop_init(&loop) < 0 ||
+        event_timer_init(&timer_source, NULL) < 0 ||
+        event_signal_init(&signal_source, shutdown_signals, 2, NULL) < 0 ||
+        event_loop_add(&loop, &socket_source) < 0 ||
+        event_loop_add(&loop, &timer_source) < 0 ||
+        event_loop_add(&loop, &signal_source) < 0) {
+        fprintf(stderr, "Event loop setup failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+
+    // Agree on the checksum and frame format, a server without negotiation only knows CRC-8 and one character per packet
+    static const uint8_t offered_checksums[] = { CHECKSUM_CRC32C, CHECKSUM_CRC8 };
+    codec_t codec;
+    codec.max_payload = payload_size;
+    codec.conn_id = codec_random32();
+    codec.isn = isn_set ? isn : codec_random32();
+    codec.window = window_size;
+    codec.features = CODEC_FEATURE_SACK;
+    if (codec_negotiate(socket_peer, offered_checksums, 2, HELLO_TIMEOUT_MS, HELLO_TRIES, &codec) < 0) {
+        fprintf(stderr, "Codec negotiation failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+    size_t frame_payload = codec.max_payload;
+    size_t n_packets = (data_len + frame_payload - 1) / frame_payload;
+    printf("Checksum: %s | Payload: %zu bytes per packet | %zu packets\n", checksum_get(codec.checksum)->name,
+           frame_payload, n_packets);
+    printf("Header: version %d | Connection: %08x | First SEQ: %u | Window: %u packets%s\n", codec.version,
+           codec.conn_id, codec.isn, codec.window, (codec.features & CODEC_FEATURE_SACK) ? " | SACK" : "");
+
+    // Legacy frames only have a one byte sequence number
+    if (codec.version == 0 && n_packets > CODEC_MAX_SEQ) {
+        fprintf(stderr, "ERROR: %zu bytes need more than %d packets\n", data_len, CODEC_MAX_SEQ);
+        return 1;
+    }
+
     printf("Ready to send data to server\n");
 
     // Selective Repeat Client begins
 
+    // Packets are encoded once into the sender window, a packet's SEQ on the wire is codec.isn + its index and wraps around
+    send_window_t window;
+    if (send_window_init(&window, codec.window, codec_frame_size(&codec)) < 0) {
+        fprintf(stderr, "Sender window allocation failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+    size_socket_buffers(socket_peer, (size_t)codec.window * codec_frame_size(&codec) * 2);
+
+    // The retransmission timeout follows the measured RTT instead of a fixed period
+    rtt_t rtt;
+    rtt_init(&rtt, min_rto_us, max_rto_us);
+
+    // New packets are sent while the packets in flight fit the congestion window and the window the server granted
+    congestion_t cc;
+    congestion_init(&cc, congestion_type, codec.window);
+    printf("Congestion control: %s\n", cc.ops->name);
+
+    // The pacer spreads the window over the RTT instead of sending it as one burst into the server's socket buffer
+    size_t frame_size = codec_frame_size(&codec);
+    pacer_t pacer;
+    pacer_init(&pacer, (pacing_mbps > 0.0) ? pacing_mbps * 1e6 / 8 : 0.0, PACER_BURST_PACKETS * frame_size,
+               event_loop_now_us());
+    if (pacing_mbps < 0.0) {
+        printf("Pacing: cwnd/RTT\n");
+    }
+    else if (pacing_mbps > 0.0) {
+        printf("Pacing: %.1f Mbit/s\n", pacing_mbps);
+    }
+    else printf("Pacing: off\n");
+
+    // Every packet in flight has its own retransmission timer on the timing wheel, the timerfd follows the wheel
+    timer_wheel_t wheel;
+    timer_wheel_init(&wheel, event_loop_now_us());
+    uint32_t slots = window.mask + 1;
+    expired_t expired = { &wheel, calloc(slots, sizeof(timer_node_t)), window.mask, calloc(slots, sizeof(uint32_t)), 0 };
+    if (!expired.timers || !expired.slots) {
+        fprintf(stderr, "Timer allocation failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+    uint64_t timer_armed_us = 0;
+    size_t fast_retransmits = 0;
+    size_t naks_received = 0;
     size_t packet_received = 0;
     size_t packet_sent = 0;
-    uint8_t next_seq_num = 1;
-    int window_size = WINDOW_SIZE;       // TODO: Needs to be received command line argumets
-    size_t base = 1;
     char recv_packet[4096];
-    size_t n_packets = strlen(MESSAGE);
     
     do { 
 
-        fd_set reads;
-        FD_ZERO(&reads);
-        FD_SET(socket_peer, &reads);
-        FD_SET(0, &reads);
-
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 1000;
-
-        if(select(socket_peer+1, &reads, 0,0, &timeout) < 0) {
-            // Timeout occured. 
-            if (errno == EINTR) {
-                                
-                alarm(TIMEOUT_SECONDS);
-                continue;
+        // Poll when there is room to send, otherwise sleep until the socket, timer or a signal is ready.
+        // A packet the pacer holds back sleeps on the timer until shortly before it is due and polls the rest,
+        // the wakeup of a timer is not precise enough for gaps of a few microseconds
+        uint64_t loop_us = event_loop_now_us();
+        if (pacing_mbps < 0.0) {
+            pacer_set_rate(&pacer, congestion_pacing_rate(&cc, rtt.srtt_us, frame_size), loop_us);
+        }
+        int wait_ms = -1;
+        uint64_t wake_us = timer_wheel_next_us(&wheel);
+        if (send_window_can_send(&window) && send_window_in_flight(&window) < congestion_window(&cc) &&
+            window.next < n_packets) {
+            uint64_t release_us = pacer_release_us(&pacer, frame_size, loop_us);
+            if (release_us <= loop_us + PACER_SPIN_US) {
+                wait_ms = 0;
             }
-            else {
-                fprintf(stderr, "select() failed. (%d)\n", GETSOCKETERRNO());
-                break;
+            else if (release_us - PACER_SPIN_US < wake_us) {
+                wake_us = release_us - PACER_SPIN_US;
+            }
+        }
+        event_timer_arm_at(&timer_source, &timer_armed_us, wake_us);
+
+        event_source_t *ready[EVENT_LOOP_MAX_EVENTS];
+        int n_ready = event_loop_wait(&loop, ready, EVENT_LOOP_MAX_EVENTS, wait_ms);
+        if (n_ready < 0) {
+            LOG_ERROR("epoll_wait() failed. (%d)\n", GETSOCKETERRNO());
+            break;
+        }
 
+        bool socket_readable = false;
+        bool shutdown_requested = false;
+        for (int r = 0; r < n_ready; ++r) {
+            if (ready[r] == &socket_source) {
+                socket_readable = true;
             }
-            
+            else if (ready[r] == &timer_source && event_timer_read(&timer_source) > 0) {
+                timer_armed_us = 0;
+                timer_wheel_advance(&wheel, event_loop_now_us(), packet_timeout, &expired);
+            }
+            else if (ready[r] == &signal_source) {
+                LOG_INFO("\n------- Signal %d received -------\n\n", event_signal_read(&signal_source));
+                shutdown_requested = true;
+            }
+        }
+        if (shutdown_requested) {
+            break;
         }
         
-        // Receive data from Server
-        if(FD_ISSET(socket_peer, &reads)) {
-
-            printf("----- Packet Receive Start -------\n");
-            memset(&recv_packet, 0, sizeof(recv_packet));
-            int bytes_received = recv(socket_peer, recv_packet, 4096, 0);
+        if (socket_readable) {
+            LOG_DEBUG("----- Packet Receive Start -------\n");
+            int bytes_received = recv(socket_peer, recv_packet, sizeof(recv_packet), 0);
             if (bytes_received < 1 ) {
-                printf("Connection close by peer\n");
+                LOG_DEBUG("Connection close by peer\n");
                 break;
             }
 
-            // Reserving memory for incoming message. Bytes_received is missing the NULL to terminate the string
-            // char *data = malloc(sizeof(char) * bytes_received + 1);
-            char *data = malloc(bytes_received + 1);
-            if (!data) {
-                fprintf(stderr, "Memory allocation failed\n");
-                exit(1);
+            // Check if the packet is corrupted or not, a repeated HELLO answer is not an ACK
+            uint32_t base_seq = codec.isn + (uint32_t)window.base;
+            codec_frame_t frame;
+            bool intact = codec_parse_frame(&codec, recv_packet, bytes_received, base_seq, &frame) &&
+                          (frame.type == CODEC_ACK || frame.type == CODEC_NAK);
+
+            // A SACK acknowledges the packets up to the cumulative ACK and the blocks after it at once
+            uint64_t acked = 0;
+            if (intact && frame.type == CODEC_ACK && (frame.flags & CODEC_FLAG_SACK)) {
+                uint64_t answered = 0;
+                uint64_t now_us = event_loop_now_us();
+                uint64_t newly_acked = send_window_apply_sack(&window, &frame, base_seq, &answered, packet_acked, &expired);
+                if (newly_acked > 0) {
+                    rtt_progress(&rtt);
+                }
+                if (answered < window.next) {
+                    // Karn's rule: the ACK of a resent packet may belong to either copy
+                    if (!send_window_is_resent(&window, answered)) {
+                        rtt_sample(&rtt, now_us - send_window_sent_us(&window, answered));
+                    }
+                    size_t resent = resend_lost(socket_peer, &window, &expired, &cc, &pacer, answered, now_us, rtt_rto_us(&rtt));
+                    fast_retransmits += resent;
+                    packet_sent += resent;
+                }
+                if (send_window_slide(&window) > 0) {
+                    g_tries = 0;
+                }
+                congestion_on_ack(&cc, newly_acked, window.base, now_us, rtt.srtt_us);
+                packet_received++;
             }
-            memcpy(data, recv_packet, bytes_received);
-            data[bytes_received] = '\0';
-
-            // Check if the packet is corrupted or not
-            crc crc_result = crcFast((crc *)data, bytes_received);
-            free(data);
-
-            // If not corrupted
-            if (crc_result == 0) {
-                int rcv_seq = 0;
-                
-                rcv_seq = recv_packet[0];
-                printf("ACK received: SEQ %d | CRC Check: OK\n", rcv_seq);
-
-                packet_tracker[rcv_seq] = ACK;
-                packet_timer[rcv_seq] = 0;
-               
-                if ((rcv_seq - base) < 2) {
-                    size_t i = base;
-                    while(i < base + WINDOW_SIZE && packet_tracker[i] == ACK) {
-                        i++;
+            // Only ACKs of packets in flight count, the distance from the base wraps with the SEQ
+            else if (intact && frame.type == CODEC_ACK && send_window_index(&window, (int32_t)(frame.ack - base_seq), &acked)) {
+                LOG_DEBUG("ACK received: SEQ %u | CRC Check: OK\n", frame.ack);
+
+                // Karn's rule: the ACK of a resent packet may belong to either copy
+                if (send_window_ack(&window, acked)) {
+                    timer_wheel_cancel(&wheel, &expired.timers[acked & window.mask]);
+                    if (!send_window_is_resent(&window, acked)) {
+                        rtt_sample(&rtt, event_loop_now_us() - send_window_sent_us(&window, acked));
                     }
-                    base = i;
+                    rtt_progress(&rtt);
 
+                    // Packets the later ACKs have overtaken are resent without waiting for their timers
+                    size_t resent = resend_lost(socket_peer, &window, &expired, &cc, &pacer, acked, event_loop_now_us(),
+                                                rtt_rto_us(&rtt));
+                    fast_retransmits += resent;
+                    packet_sent += resent;
                 }
+
+                // Only timeouts without progress in between count as retries
+                if (send_window_slide(&window) > 0) {
+                    g_tries = 0;
+                }
+                congestion_on_ack(&cc, 1, window.base, event_loop_now_us(), rtt.srtt_us);
                 packet_received++;
                 
             }
-            else if (crc_result != 0) {
-                printf("ACK Received: SEQ %d | CRC Check: NOK\n", recv_packet[0]);
+            else if (intact && frame.type == CODEC_NAK) {
+                // The server could not read a packet and asks for the oldest one it misses, once per RTT
+                uint64_t now_us = event_loop_now_us();
+                naks_received++;
+                if (send_window_index(&window, (int32_t)(frame.ack - base_seq), &acked) &&
+                    !send_window_is_acked(&window, acked) &&
+                    now_us - send_window_sent_us(&window, acked) >= rtt.srtt_us) {
+                    LOG_DEBUG("NAK received: SEQ %u, resending\n", frame.ack);
+                    if (resend_packet(socket_peer, &window, &pacer, acked, now_us) < 1) {
+                        LOG_ERROR("Error occurred\n");
+                        break;
+                    }
+                    timer_wheel_add(&wheel, &expired.timers[acked & window.mask], now_us + rtt_rto_us(&rtt));
+                    congestion_on_loss(&cc, acked, window.next);
+                    fast_retransmits++;
+                    packet_sent++;
+                }
+            }
+            else if (!intact) {
+                LOG_DEBUG("ACK Received | CRC Check: NOK\n");
             }
-            printf("----- Packet Receive End -------\n\n");
+            LOG_DEBUG("----- Packet Receive End -------\n\n");
            
             
         }
 
         // Send data to Server if there is room in sending window
-            if (next_seq_num < (base + window_size)) {
-                char *message = MESSAGE; 
+            if (send_window_can_send(&window) && send_window_in_flight(&window) < congestion_window(&cc) &&
+                window.next < n_packets && pacer_release_us(&pacer, frame_size, event_loop_now_us()) <= event_loop_now_us()) {
+                size_t offset = (size_t)window.next * frame_payload;
+                uint32_t seq = codec.isn + (uint32_t)window.next;
+                uint16_t len = (data_len - offset < frame_payload) ? data_len - offset : frame_payload;
+
+                // Create a packet that is sent to server, straight into its slot of the window
+                char *packet = send_window_slot(&window);
+                size_t size = make_packet(seq, &data[offset], len, &codec, packet);
                 
-                char seq_message[4096];
-                snprintf(seq_message, sizeof seq_message, "%c%c", next_seq_num, message[next_seq_num - 1]); 
-
-                
-                // Event though the message size of is 2 chars, the below code is prepared for bigger messages.
-                int len = strlen(seq_message);
-                crc *data_to_send = malloc(len * sizeof(char));
-                if (!data_to_send) {
-                    fprintf(stderr, "Memory allocation failed");
-                    exit(1);
-                }
-
-                for (long i = 0; i < len; i++) {
-                    data_to_send[i] = seq_message[i];
-                }
-                data_to_send[len] = '\0';
-                
-                crc crc_send = crcFast(data_to_send, len);
-                free(data_to_send);
-
-                char *packet = malloc(sizeof(char) * len);
-                if (!packet) {
-                    fprintf(stderr, "Memory allocation failed\n");
-                    exit(1);
-
-                }
-                
-                // Create a packet that is sent to server
-                size_t size = make_packet(next_seq_num, message[next_seq_num - 1], crc_send, packet);
-                
-                printf("----- Sending Packet %d -------\n", next_seq_num); 
+                LOG_DEBUG("----- Sending Packet %u -------\n", seq); 
                 
+                // Stamped before the send, the ACK may be back before send() returns
+                uint64_t sent_us = event_loop_now_us();
                 int bytes_sent = send(socket_peer, packet, size, 0);
 
-                packet_tracker[next_seq_num] = NACK;
-                packet_timer[next_seq_num] = TIMEOUT_SECONDS;
-
-                // Starting the timer
-                if (base == next_seq_num) {
-                    alarm(TIMEOUT_SECONDS);
-                }
+                // Starting the timer of the packet
+                timer_wheel_add(&wheel, &expired.timers[window.next & window.mask], sent_us + rtt_rto_us(&rtt));
                 if (bytes_sent < 1) {
-                    fprintf(stderr, "Error occurred\n");
+                    LOG_ERROR("Error occurred\n");
                     break;
                 }
-
-                printf("Packet sent: SEQ %d | Data: %c | Bytes: %d\n", packet[0], packet[1], bytes_sent);
-
-                // Cleaning up memory
-                free (packet);
+                LOG_DEBUG("Packet sent: SEQ %u | Payload: %d | Bytes: %d\n", seq, len, bytes_sent);
                 
                 // Increasing packet counters
-                next_seq_num++;
+                send_window_push(&window, size, sent_us);
+                pacer_sent(&pacer, size, sent_us);
                 packet_sent++;
 
-                printf("----- Packet Send End -------\n\n"); 
+                LOG_DEBUG("----- Packet Send End -------\n\n"); 
                 
             }
             // If the timeout occured
-            if (g_timeout == true) {
-                g_timeout = false;
-                
-                // Decreasing individual packet timers
-                for (uint8_t i = base; i < base + WINDOW_SIZE; ++i) {
-                    if (packet_timer[i] > 0) {
-                        packet_timer[i]--;
-
-                        // If packet have timeout and do ACK received, resending packets
-                        if (packet_timer[i] == 0 && packet_tracker[i] == NACK) {
-                            // TODO: Make and send packet
-                            char *message = MESSAGE;
-
-                            char seq_message[2048];
-                            snprintf(seq_message, sizeof(seq_message), "%c%c", i, message[i-1]);
-                            
-                            int len = strlen(seq_message);
-                            crc *data_to_resend = malloc(sizeof(char) * len);
-
-                            for (uint8_t y = 0; y < len; ++y) {
-                                data_to_resend[y] = seq_message[y];
-                            }
-                            data_to_resend[len] = '\0';
-
-                            crc crc_send = crcFast(data_to_resend, len);
-
-                            char *packet = malloc(sizeof(char) * len);
-                            int size = make_packet(i, message[i-1], crc_send, packet);
-                            printf(BLUE "----- Timeout occurred -------\n" RESET);
-                            printf(BLUE "----- Resending Packet %d -------\n" RESET, i); 
-
-                            int bytes_sent = send(socket_peer, packet, size, 0);
-
-                            printf("Packet resent: SEQ %d | Data: %c | Bytes: %d\n", packet[0], packet[1], bytes_sent);
-            
-                            packet_tracker[i] = NACK;
-                            packet_timer[i] = TIMEOUT_SECONDS;
-                            if (bytes_sent < 1) {
-                                fprintf(stderr, "Error occurred\n");
-                                break;
-                            }
-            
-                            free(data_to_resend);
-                            free (packet);
-                            printf(BLUE "----- Packet Resend End -------\n\n" RESET); 
-
+            if (expired.count > 0) {
+                uint64_t now_us = event_loop_now_us();
+
+                // Every packet in flight has an armed timer but the expired ones. Like a single timer, only a timeout of
+                // the base backs off and counts as a retry, the others may be spread over the window by fast retransmits
+                if (window.base < window.next && !timer_armed(&expired.timers[window.base & window.mask])) {
+                    g_tries++;
+                    rtt_backoff(&rtt);
+                    congestion_on_timeout(&cc, window.base, window.next);
+                }
 
-                        }
+                // Only the expired packets are resent from the window as they are, one record per timeout at info level
+                uint32_t resent = 0;
+                for (uint32_t e = 0; e < expired.count; ++e) {
+                    // An ACK read since the timer fired may have acknowledged the packet or reused its slot
+                    uint64_t i = window.base + ((expired.slots[e] - window.base) & window.mask);
+                    if (i >= window.next || send_window_is_acked(&window, i) || timer_armed(&expired.timers[expired.slots[e]])) {
+                        continue;
+                    }
+                    uint32_t seq = codec.isn + (uint32_t)i;
+                    LOG_DEBUG(BLUE "----- Resending Packet %u -------\n" RESET, seq);
+
+                    int bytes_sent = resend_packet(socket_peer, &window, &pacer, i, now_us);
+
+                    LOG_DEBUG("Packet resent: SEQ %u | Bytes: %d\n", seq, bytes_sent);
+                    congestion_on_loss(&cc, i, window.next);
+                    packet_sent++;
+                    resent++;
+                    timer_wheel_add(&wheel, &expired.timers[expired.slots[e]], now_us + rtt_rto_us(&rtt));
+                    if (bytes_sent < 1) {
+                        LOG_ERROR("Error occurred\n");
+                        break;
                     }
+
+                    LOG_DEBUG(BLUE "----- Packet Resend End -------\n\n" RESET);
+                }
+                if (resent > 0) {
+                    LOG_INFO(BLUE "----- Timeout occurred -------\n" RESET "Packets resent: %u | Window base: %u | Next SEQ: %u | RTO: %" PRIu64 " us\n",
+                             resent, codec.isn + (uint32_t)window.base, codec.isn + (uint32_t)window.next, rtt_rto_us(&rtt));
                 }
-                alarm(TIMEOUT_SECONDS);
+                expired.count = 0;
             }
-    }  while ((base < n_packets + 1) && g_tries < MAXTRIES);
+    }  while ((window.base < n_packets) && g_tries < MAXTRIES);
 
     // Teardown sending SEQ 0 Data 0 with 0x69
+    log_flush();
     printf("------- ALL PACKETS SENT AND RECEIVED -------\n");
     printf("------- Teardown the connection -------\n\n");
-    char teardown[5];
-    uint8_t teardown_seq = 0;
-    char *teardown_data = "00";
-    crc teardown_crc = 0x90;
-    int size = make_packet(teardown_seq, *teardown_data, teardown_crc, teardown);
-    send(socket_peer, teardown, size, 0);
+    char teardown[CODEC_ACK_MAX];
+    send(socket_peer, teardown, codec_make_fin(&codec, teardown), 0);
 
+    send_window_free(&window);
+    free(expired.timers);
+    free(expired.slots);
     freeaddrinfo(peer_address);
+    event_source_close(&timer_source);
+    event_source_close(&signal_source);
+    event_loop_close(&loop);
     printf("Retries left: %d \t Packets sent: %zu \t Packets received: %zu\n", g_tries, packet_sent, packet_received);
+    printf("Data sent: %zu bytes | CRC32C %08x\n", data_len, crc32c(0, data, data_len));
+    printf("RTT: smoothed %.3f ms | variation %.3f ms | min %.3f ms | last %.3f ms | %" PRIu64 " samples\n",
+           rtt.srtt_us / 1000.0, rtt.rttvar_us / 1000.0, rtt.min_rtt_us / 1000.0, rtt.last_us / 1000.0, rtt.samples);
+    printf("RTO: %.3f ms | backoff %u | %" PRIu64 " timeouts\n", rtt_rto_us(&rtt) / 1000.0, rtt.backoff, rtt.timeouts);
+    printf("Fast retransmits: %zu | NAKs received: %zu\n", fast_retransmits, naks_received);
+    printf("Congestion: %s | cwnd %.1f | ssthresh %.1f | %" PRIu64 " loss events | %" PRIu64 " timeouts\n",
+           cc.ops->name, cc.cwnd, cc.ssthresh, cc.losses, cc.timeouts);
+    printf("Pacing: target %.1f Mbit/s | achieved %.1f Mbit/s | %" PRIu64 " waits | %.1f us late on average\n",
+           pacer_target_bps(&pacer) / 1e6, pacer_achieved_bps(&pacer) / 1e6, pacer.waits,
+           pacer.waits ? (double)pacer.late_us / pacer.waits : 0.0);
+    free(data);
     CLOSESOCKET(socket_peer);
 
     printf("Finished\n\n");
+    log_shutdown();
 
     return 0;
 }
 
 
-void timeout_alarm(__attribute__((unused)) int ignore)
+/**
+ * @brief Constructs a data packet with a sequence number, data, and CRC checksum.
+ *
+ * This function encodes the sequence number and payload in the frame format
+ * negotiated with the server and appends the checksum.
+ *
+ * @param next_sequence The sequence number of the packet.
+ * @param data The payload to be sent.
+ * @param len The payload length.
+ * @param codec The encoding negotiated with the server.
+ * @param packet Buffer of at least CODEC_FRAME_MAX bytes for the packet.
+ * 
+ * @return The size of the created packet.
+ */
+size_t make_packet (uint32_t next_sequence, const char *data, uint16_t len, const codec_t *codec, char *packet)
 {
-    g_tries++;
-    g_timeout = true;
+    return codec_make_frame(codec, packet, next_sequence, data, len);
+}
 
+/**
+ * @brief Reads the data to send.
+ *
+ * @param path File to send, or NULL.
+ * @param generated Number of generated bytes to send if there is no file.
+ * @param len Set to the length of the data.
+ * 
+ * @return The data, MESSAGE if there is no file and nothing is generated,
+ *         or NULL on failure. The caller frees it.
+ */
+char *load_data(const char *path, size_t generated, size_t *len)
+{
+    char *data = NULL;
+
+    if (path) {
+        FILE *file = fopen(path, "rb");
+        if (!file) {
+            return NULL;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        data = (size > 0) ? malloc(size) : NULL;
+        if (data && fread(data, 1, size, file) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+        fclose(file);
+        *len = (size > 0) ? (size_t)size : 0;
+    }
+    else if (generated > 0) {
+        data = malloc(generated);
+        for (size_t i = 0; data && i < generated; ++i) {
+            data[i] = 'a' + i % 26;
+        }
+        *len = generated;
+    }
+    else {
+        *len = strlen(MESSAGE);
+        data = malloc(*len);
+        if (data) {
+            memcpy(data, MESSAGE, *len);
+        }
+    }
+
+    return data;
 }
 
 /**
- * @brief Constructs a data packet with a sequence number, data, and CRC checksum.
+ * @brief Sizes the socket buffers for a full window of packets.
  *
- * This function creates a packet by formatting the sequence number, data byte, 
- * and CRC checksum into a string format.
+ * The kernel caps the sizes at net.core.wmem_max and rmem_max, smaller
+ * buffers only cost drops, so failures are not fatal. A queued datagram
+ * is charged about twice its size, the caller allows for that.
  *
- * @param next_sequence The sequence number of the packet.
- * @param data The data character to be sent.
- * @param packet_crc The CRC checksum for error detection.
- * @param packet A pointer to the buffer where the constructed packet will be stored.
+ * @param sock The socket.
+ * @param bytes Bytes of one window.
+ */
+void size_socket_buffers(int sock, size_t bytes)
+{
+    int size = (bytes > (64 << 20)) ? (64 << 20) : (int)bytes;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) ||
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size))) {
+        fprintf(stderr, "setsockopt() of the socket buffers failed. (%d)\n", GETSOCKETERRNO());
+    }
+}
+
+/**
+ * @brief Collects a packet whose retransmission timer fired.
+ *
+ * @param timer The timer of the packet.
+ * @param ctx The expired_t list, the packets are resent after the advance.
+ */
+void packet_timeout(timer_node_t *timer, void *ctx)
+{
+    expired_t *expired = ctx;
+
+    expired->slots[expired->count++] = (uint32_t)(timer - expired->timers);
+}
+
+/**
+ * @brief Sends a packet in the window again as it was encoded.
+ *
+ * @param sock The connected socket.
+ * @param window The sender window.
+ * @param pacer The pacer, the packet takes its bytes.
+ * @param index Index of the packet.
+ * @param now_us Time the packet is resent.
  * 
- * @return The size of the created packet, or -1 if the sequence number is invalid.
+ * @return The number of bytes sent, or -1 on error.
  */
-size_t make_packet (uint8_t next_sequence, char data, crc packet_crc, char *packet)
+int resend_packet(int sock, send_window_t *window, pacer_t *pacer, uint64_t index, uint64_t now_us)
 {
+    size_t size = 0;
+    const char *packet = send_window_packet(window, index, &size);
 
-    size_t len = snprintf(NULL, 0, "%c%c%c", next_sequence, data, packet_crc);
+    send_window_sent(window, index, now_us);
+    pacer_sent(pacer, size, now_us);
 
-    snprintf(packet, len + 1,  "%c%c%c", next_sequence, data, packet_crc);
+    return (int)send(sock, packet, size, 0);
+}
 
-    return len;
+/**
+ * @brief Resends the packets an ACK has overtaken and restarts their timers.
+ *
+ * @param sock The connected socket.
+ * @param window The sender window.
+ * @param timers Retransmission timers of the window.
+ * @param cc Congestion state, every lost packet is reported to it.
+ * @param pacer The pacer, the resent packets take their bytes.
+ * @param acked Packet whose ACK was just received.
+ * @param now_us Time the packets are resent.
+ * @param rto_us Retransmission timeout of the resent packets.
+ * 
+ * @return The number of packets resent.
+ */
+size_t resend_lost(int sock, send_window_t *window, expired_t *timers, congestion_t *cc, pacer_t *pacer,
+                   uint64_t acked, uint64_t now_us, uint64_t rto_us)
+{
+    size_t resent = 0;
+
+    for (uint64_t i = send_window_next_lost(window, window->base, acked); i < window->next;
+         i = send_window_next_lost(window, i + 1, acked)) {
+        LOG_DEBUG("Fast retransmit: packet %" PRIu64 "\n", i);
+        if (resend_packet(sock, window, pacer, i, now_us) < 1) {
+            LOG_ERROR("Error occurred\n");
+            break;
+        }
+        timer_wheel_add(timers->wheel, &timers->timers[i & timers->mask], now_us + rto_us);
+        congestion_on_loss(cc, i, window->next);
+        resent++;
+    }
+
+    return resent;
 }
 
+/**
+ * @brief Stops the retransmission timer of a packet a SACK acknowledged.
+ *
+ * @param index Index of the packet.
+ * @param ctx The expired_t timers of the window.
+ */
+void packet_acked(uint64_t index, void *ctx)
+{
+    expired_t *timers = ctx;
 
+    timer_wheel_cancel(timers->wheel, &timers->timers[index & timers->mask]);
+}
@@ -0,0 +1,205 @@
+/******************************************
+ *
+ * Filename:    timer_wheel.c
+ *
+ * Description: Hierarchical timing wheel. A timer is placed on the level
+ *              of its remaining time, slots of the higher levels are moved
+ *              down a level when time reaches them.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <string.h>
+
+#include "../include/timer_wheel.h"
+
+#define SLOT_MASK   (TIMER_WHEEL_SLOTS - 1)
+
+static void wheel_link(timer_wheel_t *wheel, timer_node_t *timer)
+{
+    // Due timers go to the current slot, the ones too far ahead to the last level
+    uint64_t delta = (timer->expires_us > wheel->now_us) ? timer->expires_us - wheel->now_us : 0;
+    if (delta >= TIMER_WHEEL_RANGE) {
+        delta = TIMER_WHEEL_RANGE - 1;
+    }
+    uint64_t at_us = wheel->now_us + delta;
+
+    uint32_t level = delta ? (uint32_t)(63 - __builtin_clzll(delta)) / TIMER_WHEEL_BITS : 0;
+    uint32_t index = (at_us >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK;
+    uint32_t slot = level * TIMER_WHEEL_SLOTS + index;
+
+    timer_node_t *head = &wheel->slots[slot];
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+    timer->slot = slot + 1;
+    wheel->occupied[level] |= 1ULL << index;
+} /* wheel_link() */
+
+static void wheel_unlink(timer_wheel_t *wheel, timer_node_t *timer)
+{
+    uint32_t slot = timer->slot - 1;
+
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer->prev = NULL;
+    timer->slot = 0;
+
+    timer_node_t *head = &wheel->slots[slot];
+    if (head->next == head) {
+        wheel->occupied[slot / TIMER_WHEEL_SLOTS] &= ~(1ULL << (slot & SLOT_MASK));
+    }
+} /* wheel_unlink() */
+
+/**
+ * @brief Finds the time the first occupied slot is reached.
+ *
+ * A slot of level L is reached when the time has its index in bits
+ * 6L..6L+5 and zeros below. On the levels above 0 the current slot was
+ * already run, its timers are a whole turn of the level ahead.
+ *
+ * @return uint64_t The time, or UINT64_MAX if the wheel is empty.
+ */
+static uint64_t wheel_next_slot(const timer_wheel_t *wheel)
+{
+    uint64_t next_us = UINT64_MAX;
+
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        uint64_t occupied = wheel->occupied[level];
+        if (!occupied) {
+            continue;
+        }
+
+        uint32_t shift = level * TIMER_WHEEL_BITS;
+        uint32_t current = (wheel->now_us >> shift) & SLOT_MASK;
+        uint64_t turn = 1ULL << (shift + TIMER_WHEEL_BITS);
+        uint64_t base = wheel->now_us & ~(turn - 1);
+
+        // Slots behind the first one to check belong to the next turn
+        uint32_t first = (level == 0) ? current : current + 1;
+        uint64_t ahead = (first < TIMER_WHEEL_SLOTS) ? occupied & (~0ULL << first) : 0;
+        uint32_t index = 0;
+        if (ahead) {
+            index = __builtin_ctzll(ahead);
+        }
+        else {
+            index = __builtin_ctzll(occupied);
+            base += turn;
+        }
+
+        uint64_t at_us = base | ((uint64_t)index << shift);
+        if (at_us < next_us) {
+            next_us = at_us;
+        }
+    }
+
+    return next_us;
+} /* wheel_next_slot() */
+
+/**
+ * @brief Fires the due timers of a slot and moves the others down a level.
+ *
+ * The slot is detached first, so timers the callbacks arm into it wait for
+ * its next turn.
+ */
+static size_t wheel_run_slot(timer_wheel_t *wheel, uint32_t slot,
+                             void (*on_expire)(timer_node_t *timer, void *ctx), void *ctx)
+{
+    timer_node_t *head = &wheel->slots[slot];
+    timer_node_t pending;
+    size_t fired = 0;
+
+    if (head->next == head) {
+        return 0;
+    }
+    pending.next = head->next;
+    pending.prev = head->prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    head->next = head->prev = head;
+    wheel->occupied[slot / TIMER_WHEEL_SLOTS] &= ~(1ULL << (slot & SLOT_MASK));
+
+    // A callback may cancel a pending timer, which unlinks it from this list
+    while (pending.next != &pending) {
+        timer_node_t *timer = pending.next;
+        pending.next = timer->next;
+        timer->next->prev = &pending;
+        timer->next = timer->prev = NULL;
+        timer->slot = 0;
+
+        if (timer->expires_us <= wheel->now_us) {
+            wheel->count--;
+            fired++;
+            on_expire(timer, ctx);
+        }
+        else {
+            wheel_link(wheel, timer);
+        }
+    }
+
+    return fired;
+} /* wheel_run_slot() */
+
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now_us)
+{
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now_us = now_us;
+    for (uint32_t i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; ++i) {
+        wheel->slots[i].next = wheel->slots[i].prev = &wheel->slots[i];
+    }
+} /* timer_wheel_init() */
+
+void timer_wheel_add(timer_wheel_t *wheel, timer_node_t *timer, uint64_t expires_us)
+{
+    if (timer_armed(timer)) {
+        wheel_unlink(wheel, timer);
+    }
+    else {
+        wheel->count++;
+    }
+    timer->expires_us = expires_us;
+    wheel_link(wheel, timer);
+} /* timer_wheel_add() */
+
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_node_t *timer)
+{
+    if (!timer_armed(timer)) {
+        return;
+    }
+    wheel_unlink(wheel, timer);
+    wheel->count--;
+} /* timer_wheel_cancel() */
+
+uint64_t timer_wheel_next_us(const timer_wheel_t *wheel)
+{
+    return wheel->count ? wheel_next_slot(wheel) : UINT64_MAX;
+} /* timer_wheel_next_us() */
+
+size_t timer_wheel_advance(timer_wheel_t *wheel, uint64_t now_us,
+                           void (*on_expire)(timer_node_t *timer, void *ctx), void *ctx)
+{
+    size_t fired = 0;
+    uint64_t at_us = 0;
+
+    while (wheel->count && (at_us = wheel_next_slot(wheel)) <= now_us) {
+        wheel->now_us = at_us;
+
+        // Every slot that starts now, from the top so timers move down before the lower slots run
+        for (int level = TIMER_WHEEL_LEVELS - 1; level >= 0; --level) {
+            uint32_t shift = level * TIMER_WHEEL_BITS;
+            if (wheel->now_us & ((1ULL << shift) - 1)) {
+                continue;
+            }
+            uint32_t slot = level * TIMER_WHEEL_SLOTS + ((wheel->now_us >> shift) & SLOT_MASK);
+            fired += wheel_run_slot(wheel, slot, on_expire, ctx);
+        }
+    }
+
+    if (now_us > wheel->now_us) {
+        wheel->now_us = now_us;
+    }
+
+    return fired;
+} /* timer_wheel_advance() */
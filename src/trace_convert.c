@@ -0,0 +1,215 @@
+/******************************************
+ *
+ * Filename:    trace_convert.c
+ *
+ * Description: Converts a text trace of per-datagram loss, delay and bit
+ *              errors to the binary trace the server and udp-impair map,
+ *              and dumps a binary trace back to text.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "../include/impair_trace.h"
+
+#define LINE_SIZE   256     /* Longest line of a text trace */
+
+int text_to_trace(FILE *in, FILE *out);
+int dump_trace(const char *path);
+int parse_line(const char *line, uint32_t *record);
+
+int main(int argc, char *argv[])
+{
+    const char *output = NULL;
+    const char *dump = NULL;
+    int c = 0;
+
+    while ((c = getopt(argc, argv, "o:d:h")) != -1) {
+        switch (c) {
+        case 'o':
+            // Binary trace to write
+            output = optarg;
+            break;
+        case 'd':
+            // Binary trace to print as text
+            dump = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -o [trace_file] [text_file]\n", argv[0]);
+            fprintf(stderr, "       %s -d [trace_file]\n", argv[0]);
+            fprintf(stderr, "Text: one line per datagram, 'drop' or the delay in microseconds, "
+                    "optionally followed by 'corrupt'. '#' starts a comment.\n");
+            return 1;
+        }
+    }
+
+    if (dump) {
+        return dump_trace(dump);
+    }
+    if (!output) {
+        fprintf(stderr, "ERROR: -o or -d is needed, %s -h for help\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = (optind < argc) ? fopen(argv[optind], "r") : stdin;
+    if (!in) {
+        fprintf(stderr, "ERROR: %s not opened. (%d)\n", argv[optind], errno);
+        return 1;
+    }
+    FILE *out = fopen(output, "wb");
+    if (!out) {
+        fprintf(stderr, "ERROR: %s not created. (%d)\n", output, errno);
+        return 1;
+    }
+
+    int status = text_to_trace(in, out);
+    if (fclose(out) != 0) {
+        status = 1;
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (status != 0) {
+        remove(output);
+    }
+
+    return status;
+} /* main() */
+
+/**
+ * @brief Writes the header and a record for every datagram line of a text trace.
+ *
+ * The count in the header is only known at the end, it is written last.
+ *
+ * @return int `0` on success, `1` on a malformed line or a write error.
+ */
+int text_to_trace(FILE *in, FILE *out)
+{
+    impair_trace_header_t header;
+    char line[LINE_SIZE];
+    unsigned long line_number = 0;
+    unsigned long dropped = 0, delayed = 0, corrupted = 0;
+    uint32_t count = 0;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMPAIR_TRACE_MAGIC, sizeof(header.magic));
+    header.version = htole32(IMPAIR_TRACE_VERSION);
+    if (fwrite(&header, sizeof(header), 1, out) != 1) {
+        fprintf(stderr, "ERROR: header not written. (%d)\n", errno);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        uint32_t record = 0;
+
+        line_number++;
+        int result = parse_line(line, &record);
+        if (result < 0) {
+            fprintf(stderr, "ERROR: line %lu: %s", line_number, line);
+            return 1;
+        }
+        if (result == 0) {
+            continue;
+        }
+        if (count == UINT32_MAX) {
+            fprintf(stderr, "ERROR: more than %u datagrams\n", UINT32_MAX - 1);
+            return 1;
+        }
+
+        dropped += (record & IMPAIR_TRACE_DROP) ? 1 : 0;
+        corrupted += (record & IMPAIR_TRACE_CORRUPT) ? 1 : 0;
+        delayed += (impair_trace_delay_us(record) > 0) ? 1 : 0;
+        record = htole32(record);
+        if (fwrite(&record, sizeof(record), 1, out) != 1) {
+            fprintf(stderr, "ERROR: record not written. (%d)\n", errno);
+            return 1;
+        }
+        count++;
+    }
+
+    if (count == 0) {
+        fprintf(stderr, "ERROR: no datagrams in the trace\n");
+        return 1;
+    }
+    header.count = htole32(count);
+    if (fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1) {
+        fprintf(stderr, "ERROR: header not written. (%d)\n", errno);
+        return 1;
+    }
+
+    printf("Trace: %u datagrams | %lu dropped | %lu delayed | %lu corrupted\n", count, dropped, delayed, corrupted);
+
+    return 0;
+} /* text_to_trace() */
+
+/**
+ * @brief Parses one line of a text trace.
+ *
+ * @param line The line.
+ * @param[out] record Record of the datagram.
+ * @return int `1` for a datagram, `0` for a blank or comment line, `-1` if malformed.
+ */
+int parse_line(const char *line, uint32_t *record)
+{
+    char fate[32] = {0}, extra[32] = {0}, rest[2] = {0};
+
+    int fields = sscanf(line, " %31[^# \t\r\n] %31[^# \t\r\n] %1[^# \t\r\n]", fate, extra, rest);
+    if (fields < 1) {
+        return 0;
+    }
+    if (fields == 3 || (fields == 2 && strcmp(extra, "corrupt") != 0)) {
+        return -1;
+    }
+
+    if (strcmp(fate, "drop") == 0) {
+        *record = IMPAIR_TRACE_DROP;
+    }
+    else {
+        char *end = NULL;
+        unsigned long delay_us = strtoul(fate, &end, 10);
+        if (*end != '\0' || fate[0] == '-' || delay_us > IMPAIR_TRACE_DELAY_MAX) {
+            return -1;
+        }
+        *record = (uint32_t)delay_us << IMPAIR_TRACE_DELAY_SHIFT;
+    }
+    if (fields == 2) {
+        *record |= IMPAIR_TRACE_CORRUPT;
+    }
+
+    return 1;
+} /* parse_line() */
+
+/**
+ * @brief Prints a binary trace in the text format it was converted from.
+ *
+ * @return int `0` on success, `1` if the trace could not be mapped.
+ */
+int dump_trace(const char *path)
+{
+    impair_trace_t trace;
+    uint32_t cursor = 0;
+
+    if (impair_trace_open(&trace, path) < 0) {
+        fprintf(stderr, "ERROR: trace %s not mapped. (%d)\n", path, errno);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < trace.count; ++i) {
+        uint32_t record = impair_trace_next(&trace, &cursor);
+        if (record & IMPAIR_TRACE_DROP) {
+            printf("drop");
+        }
+        else printf("%lu", (unsigned long)impair_trace_delay_us(record));
+        printf("%s\n", (record & IMPAIR_TRACE_CORRUPT) ? " corrupt" : "");
+    }
+    impair_trace_close(&trace);
+
+    return 0;
+} /* dump_trace() */
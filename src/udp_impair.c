@@ -0,0 +1,1207 @@
+/******************************************
+ *
+ * Filename:    udp_impair.c
+ *
+ * Description: UDP relay between the clients and the server that applies
+ *              the drop, delay and bit error impairments in both
+ *              directions, so the server itself runs unimpaired. Every
+ *              client gets its own socket towards the server, the relay
+ *              knows nothing about the protocol.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#define _GNU_SOURCE
+
+// Standard Headers
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+// Networking Headers
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <poll.h>
+
+// Local Headers
+#include "../include/codec.h"
+#include "../include/impair.h"
+#include "../include/io_batch.h"
+#include "../include/event_loop.h"
+#include "../include/delay_queue.h"
+#include "../include/timer_wheel.h"
+#include "../include/log.h"
+
+#define ISVALIDSOCKET(s) ((s) >= 0)
+#define CLOSESOCKET(s)   close(s)
+#define SOCKET int
+#define GETSOCKETERRNO() (errno)
+
+#define DEFAULT_PORT            "6667"      /* Port the clients send to */
+#define DEFAULT_SERVER_HOST     "127.0.0.1"
+#define DEFAULT_SERVER_PORT     "6666"
+#define DEFAULT_BATCH_SIZE      64          /* Datagrams per system call */
+#define DEFAULT_IDLE_TIMEOUT_S  30          /* Flows without traffic are closed after this */
+#define DEFAULT_MAX_FLOWS       1000        /* Clients relayed per worker, one socket each */
+#define MAX_WORKERS             64          /* Worker threads with -w */
+#define DELAY_QUEUE_MAX         65536       /* Delayed datagrams parked per worker and direction */
+#define DEFAULT_QUEUE_KB        64          /* Link queue with -L when no size is given */
+#define DIRECTION_TO_SERVER     0x1         /* -s selections of the directions the options apply to */
+#define DIRECTION_TO_CLIENT     0x2
+#define SOCKET_BUFFER           (8 << 20)   /* Buffers of every socket, a full window of either side fits */
+
+/**
+ * @brief One client and its socket towards the server.
+ */
+typedef struct flow {
+    struct sockaddr_storage address;    /**< Client address. */
+    socklen_t address_len;              /**< Length of the client address. */
+    uint32_t hash;                      /**< Hash of the client address. */
+    event_source_t upstream;            /**< Socket connected to the server, ctx is the flow. */
+    timer_node_t idle_timer;            /**< Closes the flow when the client goes quiet. */
+} flow_t;
+
+/**
+ * @brief Open addressing table of the flows with linear probing.
+ *
+ * The slots hold pointers, so a flow stays where it is while the event
+ * loop and the timers refer to it and removal shifts only pointers.
+ */
+typedef struct {
+    flow_t **slots;             /**< Flows, NULL marks an empty slot. */
+    uint32_t mask;              /**< Number of slots - 1. */
+    uint32_t count;             /**< Flows in the table. */
+    uint32_t max_flows;         /**< Upper limit of the flows. */
+    unsigned long created;      /**< Flows opened. */
+    unsigned long evicted;      /**< Flows closed by the idle timer. */
+    unsigned long rejected;     /**< Datagrams of new clients not relayed because of the limit or an error. */
+} flow_table_t;
+
+/**
+ * @brief One direction of a worker with its impairment state and parked datagrams.
+ */
+typedef struct {
+    const impair_config_t *config;  /**< Impairments of the direction. */
+    impair_state_t state;           /**< Loss chain, link and count of forwarded datagrams. */
+    impair_stats_t stats;           /**< Counters of the direction. */
+    delay_queue_t delayed;          /**< Delayed datagrams keyed by release time, with the client address. */
+    delay_queue_t held;             /**< Reordered datagrams keyed by the forwarded count they wait for. */
+} relay_path_t;
+
+/**
+ * @brief Settings shared by the workers.
+ */
+typedef struct {
+    impair_config_t to_server;          /**< Impairments of the client to server direction. */
+    impair_config_t to_client;          /**< Impairments of the server to client direction. */
+    struct sockaddr_storage server;     /**< Server address. */
+    socklen_t server_len;               /**< Length of the server address. */
+    uint64_t idle_timeout_us;           /**< Idle time before a flow is closed. */
+    uint32_t max_flows;                 /**< Flows per worker. */
+    unsigned int batch_size;            /**< Datagrams per system call. */
+    uint64_t seed;                      /**< Seed of the impairments, every direction of every worker draws its own stream. */
+    impair_trace_t traces[2];           /**< Traces given with -T, one per direction at most. */
+    int n_traces;                       /**< Traces mapped. */
+} relay_config_t;
+
+/**
+ * @brief A worker thread with its own listening socket, flows and delay queues.
+ *
+ * With `-w N` every worker binds its own SO_REUSEPORT socket, the kernel
+ * hashes a client to one of them and the flow lives on that worker only.
+ */
+typedef struct {
+    int id;                         /**< Worker number. */
+    int cpu;                        /**< CPU the worker is pinned to, or -1. */
+    const relay_config_t *config;   /**< Shared settings. */
+    SOCKET socket;                  /**< Socket the clients send to. */
+    event_loop_t loop;              /**< Event loop of the worker. */
+    event_source_t listen_source;   /**< The listening socket. */
+    event_source_t timer_source;    /**< Fires for the earliest delayed datagram or idle flow. */
+    uint64_t timer_armed_us;        /**< Deadline the timer is armed for, 0 if disarmed. */
+    event_source_t *stop_source;    /**< signalfd with one worker, shared eventfd with more. */
+    io_batch_t rx;                  /**< Receive batch of every socket. */
+    io_batch_t up;                  /**< Datagrams queued to the server. */
+    flow_t *up_flow;                /**< Flow whose socket the queued datagrams leave from. */
+    io_batch_t down;                /**< Datagrams queued to the clients. */
+    flow_table_t flows;             /**< Clients of the worker. */
+    timer_wheel_t idle_timers;      /**< Idle timers of the flows. */
+    relay_path_t to_server;         /**< Client to server direction. */
+    relay_path_t to_client;         /**< Server to client direction. */
+    uint64_t now_us;                /**< Time of the current wakeup. */
+    pthread_t thread;               /**< Thread running worker_run(). */
+    uint64_t start_us;              /**< Time the worker started waiting. */
+    uint64_t stop_us;               /**< Time the worker stopped. */
+    double cpu_s;                   /**< CPU time used by the worker thread. */
+    int status;                     /**< 0, or 1 if the worker stopped on an error. */
+} relay_worker_t;
+
+SOCKET configure_socket(struct addrinfo *bind_address, bool reuse_port);
+int worker_setup(relay_worker_t *worker, struct addrinfo *bind_address, bool reuse_port);
+void *worker_run(void *arg);
+void worker_stop_all(relay_worker_t *worker);
+void worker_free(relay_worker_t *worker);
+void relay_from_clients(relay_worker_t *worker);
+void relay_from_server(relay_worker_t *worker, flow_t *flow);
+void relay_packet(relay_worker_t *worker, relay_path_t *path, flow_t *flow, char *packet, long len,
+                  const struct sockaddr *address, socklen_t address_len);
+void send_packet(relay_worker_t *worker, relay_path_t *path, flow_t *flow, const char *packet, long len,
+                 const struct sockaddr *address, socklen_t address_len);
+void transmit(relay_worker_t *worker, relay_path_t *path, flow_t *flow, const char *packet, long len,
+              const struct sockaddr *address, socklen_t address_len);
+void forward_up(relay_worker_t *worker, flow_t *flow, const char *packet, long len);
+void release_delayed(relay_worker_t *worker, relay_path_t *path);
+void worker_arm_timer(relay_worker_t *worker);
+int flow_table_init(flow_table_t *table, uint32_t max_flows);
+void flow_table_free(flow_table_t *table, event_loop_t *loop);
+flow_t *flow_lookup(flow_table_t *table, const struct sockaddr *address, socklen_t address_len, uint32_t hash);
+flow_t *flow_open(relay_worker_t *worker, const struct sockaddr *address, socklen_t address_len);
+void flow_close(relay_worker_t *worker, flow_t *flow);
+void evict_flow(timer_node_t *timer, void *ctx);
+uint32_t hash_address(const struct sockaddr *address, socklen_t address_len);
+int parse_impairment(impair_config_t *impair, int option, const char *arg);
+void print_impairment(const char *direction, const impair_config_t *impair);
+void print_probabilities(const char *direction, const impair_config_t *impair);
+void add_stats(impair_stats_t *total, const impair_stats_t *stats);
+void print_path_stats(const char *direction, const impair_stats_t *stats);
+void print_relay_stats(const relay_worker_t *workers, int n_workers, uint64_t start_us);
+
+int main(int argc, char *argv[])
+{
+    char *port = DEFAULT_PORT;
+    const char *server_host = DEFAULT_SERVER_HOST;
+    const char *server_port = DEFAULT_SERVER_PORT;
+    int c = 0;
+    int n_workers = 1;
+    bool pin_workers = false;
+    int log_level = LOG_LEVEL_INFO;
+
+    static relay_config_t config = {
+        .idle_timeout_us = DEFAULT_IDLE_TIMEOUT_S * 1000000ULL,
+        .max_flows = DEFAULT_MAX_FLOWS,
+        .batch_size = DEFAULT_BATCH_SIZE,
+    };
+    int directions = DIRECTION_TO_SERVER | DIRECTION_TO_CLIENT;
+
+    config.seed = rand_default_seed();
+    // Parse command line arguments
+    while ((c = getopt(argc, argv, "p:H:P:s:r:G:d:t:v:R:D:L:T:S:b:i:m:w:cl:h")) != -1) {
+        switch (c) {
+        case 'p':
+            // Port the clients send to
+            port = optarg;
+            break;
+        case 'H':
+            // Server host
+            server_host = optarg;
+            break;
+        case 'P':
+            // Server port
+            server_port = optarg;
+            break;
+        case 's':
+            // Direction the following impairments apply to
+            if (strcmp(optarg, "up") == 0) {
+                directions = DIRECTION_TO_SERVER;
+            }
+            else if (strcmp(optarg, "down") == 0) {
+                directions = DIRECTION_TO_CLIENT;
+            }
+            else if (strcmp(optarg, "both") == 0) {
+                directions = DIRECTION_TO_SERVER | DIRECTION_TO_CLIENT;
+            }
+            else {
+                fprintf(stderr, "ERROR: direction must be up, down or both\n");
+                return 1;
+            }
+            break;
+        case 'r':
+        case 'G':
+        case 'd':
+        case 't':
+        case 'v':
+        case 'R':
+        case 'D':
+        case 'L':
+            // Impairments of the selected directions
+            if (((directions & DIRECTION_TO_SERVER) && parse_impairment(&config.to_server, c, optarg) < 0) ||
+                ((directions & DIRECTION_TO_CLIENT) && parse_impairment(&config.to_client, c, optarg) < 0)) {
+                fprintf(stderr, "ERROR: invalid -%c %s\n", c, optarg);
+                return 1;
+            }
+            break;
+        case 'T':
+            // Recorded trace replayed instead of the loss, delay and error probabilities
+            if (config.n_traces == 2 || impair_trace_open(&config.traces[config.n_traces], optarg) < 0) {
+                fprintf(stderr, "ERROR: trace %s not mapped, one per direction. (%d)\n", optarg, GETSOCKETERRNO());
+                return 1;
+            }
+            if (directions & DIRECTION_TO_SERVER) {
+                config.to_server.trace = &config.traces[config.n_traces];
+            }
+            if (directions & DIRECTION_TO_CLIENT) {
+                config.to_client.trace = &config.traces[config.n_traces];
+            }
+            config.n_traces++;
+            break;
+        case 'S':
+            // Seed of the impairments, repeats a run
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'b':
+            // Datagrams received and sent per system call
+            if (atoi(optarg) < 1 || atoi(optarg) > IO_BATCH_MAX) {
+                fprintf(stderr, "ERROR: batch size must be between 1 and %d\n", IO_BATCH_MAX);
+                return 1;
+            }
+            config.batch_size = atoi(optarg);
+            break;
+        case 'i':
+            // Idle time in seconds before a flow is closed
+            if (atoi(optarg) < 1) {
+                fprintf(stderr, "ERROR: idle timeout must be at least 1 second\n");
+                return 1;
+            }
+            config.idle_timeout_us = atoi(optarg) * 1000000ULL;
+            break;
+        case 'm':
+            // Maximum number of clients per worker
+            if (atoi(optarg) < 1) {
+                fprintf(stderr, "ERROR: at least 1 flow is needed\n");
+                return 1;
+            }
+            config.max_flows = atoi(optarg);
+            break;
+        case 'w':
+            // Worker threads, each with its own SO_REUSEPORT socket
+            n_workers = atoi(optarg);
+            if (n_workers < 1 || n_workers > MAX_WORKERS) {
+                fprintf(stderr, "ERROR: workers must be between 1 and %d\n", MAX_WORKERS);
+                return 1;
+            }
+            break;
+        case 'c':
+            // Pin worker N to CPU N
+            pin_workers = true;
+            break;
+        case 'l':
+            // Log level
+            log_level = log_parse_level(optarg);
+            if (log_level < 0) {
+                fprintf(stderr, "ERROR: log level must be error, warn, info or debug\n");
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -p [port] -H [server_host] -P [server_port] -s [up|down|both] "
+                    "-r [drop_probability] -G [bad,good[,bad_loss]] -d [delay_probability] -t [delay_ms] "
+                    "-v [error_probability] -R [reorder_probability,depth] -D [duplicate_probability] "
+                    "-L [mbit_s[,queue_kb]] -T [trace_file] -S [seed] -b [batch_size] -i [idle_timeout_s] -m [max_flows] -w [workers] "
+                    "-l [log_level] [-c]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *server_address;
+    if (getaddrinfo(server_host, server_port, &hints, &server_address)) {
+        fprintf(stderr, "getaddrinfo() of the server failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+    memcpy(&config.server, server_address->ai_addr, server_address->ai_addrlen);
+    config.server_len = server_address->ai_addrlen;
+    freeaddrinfo(server_address);
+
+    printf("Relay: port %s -> %s %s\n", port, server_host, server_port);
+    print_impairment("Client to server", &config.to_server);
+    print_impairment("Server to client", &config.to_client);
+    printf("Random seed: %lu\n", (unsigned long)config.seed);
+
+    // Packet path messages are formatted and written by the logging thread
+    if (log_init(log_level) < 0) {
+        fprintf(stderr, "Logging thread not started, logging synchronously. (%d)\n", GETSOCKETERRNO());
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = config.server.ss_family;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo *bind_address;
+    if (getaddrinfo(0, port, &hints, &bind_address)) {
+        fprintf(stderr, "getaddrinfo() failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+
+    // Signals are blocked before any worker starts, so only the signalfd receives them
+    event_source_t signal_source;
+    const int shutdown_signals[] = { SIGINT, SIGTERM };
+    if (event_signal_init(&signal_source, shutdown_signals, 2, NULL) < 0) {
+        fprintf(stderr, "signalfd() failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+
+    // Workers share the port with SO_REUSEPORT and are stopped with one eventfd
+    event_source_t stop_source;
+    if (n_workers > 1 && event_notify_init(&stop_source, NULL) < 0) {
+        fprintf(stderr, "eventfd() failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    relay_worker_t *workers = calloc(n_workers, sizeof(*workers));
+    if (!workers) {
+        fprintf(stderr, "Out of memory. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
+
+    for (int w = 0; w < n_workers; ++w) {
+        relay_worker_t *worker = &workers[w];
+        worker->id = w;
+        worker->cpu = (pin_workers && n_cpus > 0) ? (int)(w % n_cpus) : -1;
+        worker->config = &config;
+        worker->stop_source = (n_workers > 1) ? &stop_source : &signal_source;
+        if (worker_setup(worker, bind_address, n_workers > 1) < 0) {
+            return 1;
+        }
+    }
+    freeaddrinfo(bind_address);
+
+    if (n_workers > 1) {
+        printf("Workers: %d sockets on port %s with SO_REUSEPORT%s\n", n_workers, port,
+                pin_workers ? ", pinned to CPUs" : "");
+    }
+    printf("Batched I/O: up to %u datagrams per system call\n", config.batch_size);
+    printf("Relaying....\n\n");
+
+    uint64_t start_us = event_loop_now_us();
+    int status = 0;
+    if (n_workers == 1) {
+        worker_run(&workers[0]);
+    }
+    else {
+        for (int w = 0; w < n_workers; ++w) {
+            if (pthread_create(&workers[w].thread, NULL, worker_run, &workers[w]) != 0) {
+                fprintf(stderr, "pthread_create() failed.\n");
+                return 1;
+            }
+        }
+
+        // The main thread waits for the shutdown signal, or for a failed worker that stopped the others
+        int signal = 0;
+        while ((signal = event_signal_read(&signal_source)) < 0) {
+            struct pollfd pfds[2] = { { signal_source.fd, POLLIN, 0 }, { stop_source.fd, POLLIN, 0 } };
+            poll(pfds, 2, -1);
+            if (pfds[1].revents & POLLIN) {
+                break;
+            }
+        }
+        if (signal >= 0) {
+            printf("\n------- Signal %d received, shutting down -------\n\n", signal);
+        }
+        else printf("\n------- Worker failed, shutting down -------\n\n");
+        event_notify_signal(&stop_source);
+
+        for (int w = 0; w < n_workers; ++w) {
+            pthread_join(workers[w].thread, NULL);
+        }
+    }
+
+    for (int w = 0; w < n_workers; ++w) {
+        status |= workers[w].status;
+    }
+    log_flush();
+    print_relay_stats(workers, n_workers, start_us);
+
+    for (int w = 0; w < n_workers; ++w) {
+        worker_free(&workers[w]);
+    }
+    free(workers);
+    for (int t = 0; t < config.n_traces; ++t) {
+        impair_trace_close(&config.traces[t]);
+    }
+    if (n_workers > 1) {
+        event_source_close(&stop_source);
+    }
+    event_source_close(&signal_source);
+
+    printf("Finished.\n");
+    log_shutdown();
+
+    return status;
+} /* main() */
+
+/**
+ * @brief Creates the worker's socket, event loop, flow table and delay queues.
+ *
+ * @param worker Worker with `id`, `cpu`, `config` and `stop_source` filled in.
+ * @param bind_address Address to bind the socket to.
+ * @param reuse_port Set SO_REUSEPORT, so the kernel spreads clients over the workers.
+ * @return int `0` on success, `-1` on error.
+ */
+int worker_setup(relay_worker_t *worker, struct addrinfo *bind_address, bool reuse_port)
+{
+    worker->socket = configure_socket(bind_address, reuse_port);
+    if (!ISVALIDSOCKET(worker->socket)) {
+        return -1;
+    }
+
+    if (io_batch_init(&worker->rx, worker->config->batch_size) < 0 ||
+        io_batch_init(&worker->up, worker->config->batch_size) < 0 ||
+        io_batch_init(&worker->down, worker->config->batch_size) < 0 ||
+        flow_table_init(&worker->flows, worker->config->max_flows) < 0) {
+        fprintf(stderr, "Buffer allocation failed. (%d)\n", GETSOCKETERRNO());
+        return -1;
+    }
+    worker->to_server.config = &worker->config->to_server;
+    worker->to_client.config = &worker->config->to_client;
+    relay_path_t *paths[] = { &worker->to_server, &worker->to_client };
+    for (int i = 0; i < 2; ++i) {
+        impair_state_init(&paths[i]->state, worker->config->seed, worker->id * 2 + i, event_loop_now_us());
+        delay_queue_init(&paths[i]->delayed, DELAY_QUEUE_MAX);
+        delay_queue_init(&paths[i]->held, DELAY_QUEUE_MAX);
+    }
+    timer_wheel_init(&worker->idle_timers, event_loop_now_us());
+
+    // The listening socket, the flows' sockets, the timer and the stop signal share one event loop
+    worker->listen_source = (event_source_t){ worker->socket, EVENT_SOCKET, NULL };
+    if (event_loop_init(&worker->loop) < 0 ||
+        event_timer_init(&worker->timer_source, worker) < 0 ||
+        event_loop_add(&worker->loop, &worker->listen_source) < 0 ||
+        event_loop_add(&worker->loop, &worker->timer_source) < 0 ||
+        event_loop_add(&worker->loop, worker->stop_source) < 0) {
+        fprintf(stderr, "Event loop setup failed. (%d)\n", GETSOCKETERRNO());
+        return -1;
+    }
+
+    return 0;
+} /* worker_setup() */
+
+/**
+ * @brief Event loop of one worker.
+ *
+ * @param arg The relay_worker_t of the worker.
+ * @return void* Always NULL, errors are reported in `status` and stop the other workers.
+ */
+void *worker_run(void *arg)
+{
+    relay_worker_t *worker = arg;
+
+    if (worker->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker->cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            LOG_WARN("Worker %d: pinning to CPU %d failed\n", worker->id, worker->cpu);
+        }
+    }
+
+    worker->start_us = event_loop_now_us();
+    bool running = true;
+    while (running) {
+        event_source_t *ready[EVENT_LOOP_MAX_EVENTS];
+        int n_ready = event_loop_wait(&worker->loop, ready, EVENT_LOOP_MAX_EVENTS, -1);
+        if (n_ready < 0) {
+            LOG_ERROR("epoll_wait() failed. (%d)\n", GETSOCKETERRNO());
+            worker->status = 1;
+            break;
+        }
+        worker->now_us = event_loop_now_us();
+
+        bool timer_fired = false;
+        for (int r = 0; r < n_ready; ++r) {
+            // Shutdown requested with SIGINT or SIGTERM, or by the main thread
+            if (ready[r] == worker->stop_source) {
+                if (worker->stop_source->type == EVENT_SIGNAL) {
+                    LOG_INFO("\n------- Signal %d received, shutting down -------\n\n", event_signal_read(worker->stop_source));
+                }
+                running = false;
+                break;
+            }
+            if (ready[r] == &worker->timer_source) {
+                event_timer_read(&worker->timer_source);
+                timer_fired = true;
+            }
+            else if (ready[r] == &worker->listen_source) {
+                relay_from_clients(worker);
+            }
+            else relay_from_server(worker, ready[r]->ctx);
+        }
+
+        // Flows are only closed after the round, a later entry of the ready list may be the socket of one
+        if (timer_fired && running) {
+            worker->timer_armed_us = 0;
+            release_delayed(worker, &worker->to_server);
+            release_delayed(worker, &worker->to_client);
+            timer_wheel_advance(&worker->idle_timers, worker->now_us, evict_flow, worker);
+        }
+
+        worker_arm_timer(worker);
+    }
+
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    worker->cpu_s = cpu.tv_sec + cpu.tv_nsec / 1e9;
+    worker->stop_us = event_loop_now_us();
+    worker_stop_all(worker);
+
+    return NULL;
+} /* worker_run() */
+
+/**
+ * @brief Stops the other workers and wakes the main thread after a worker failed.
+ *
+ * The socket of a failed worker stays bound and the kernel would keep
+ * sending it clients, so the whole process shuts down with an error.
+ */
+void worker_stop_all(relay_worker_t *worker)
+{
+    if (worker->status != 0 && worker->stop_source->type == EVENT_NOTIFY) {
+        event_notify_signal(worker->stop_source);
+    }
+} /* worker_stop_all() */
+
+/**
+ * @brief Relays one batch of client datagrams to the server.
+ *
+ * A new client gets a flow with its own socket, so the server tells the
+ * clients apart by the port of the relay's socket. The teardown is never
+ * impaired, the clients send it only once.
+ */
+void relay_from_clients(relay_worker_t *worker)
+{
+    int received = io_batch_recv(&worker->rx, worker->socket);
+    if (received < 0) {
+        LOG_ERROR("recvmmsg() failed. (%d)\n", GETSOCKETERRNO());
+        return;
+    }
+
+    for (int i = 0; i < received; ++i) {
+        socklen_t address_len = 0;
+        struct sockaddr *address = io_batch_addr(&worker->rx, i, &address_len);
+        char *packet = io_batch_data(&worker->rx, i);
+        long len = io_batch_len(&worker->rx, i);
+
+        flow_t *flow = flow_lookup(&worker->flows, address, address_len, hash_address(address, address_len));
+        if (!flow) {
+            flow = flow_open(worker, address, address_len);
+            if (!flow) {
+                continue;
+            }
+        }
+        timer_wheel_add(&worker->idle_timers, &flow->idle_timer, worker->now_us + worker->config->idle_timeout_us);
+
+        if (codec_maybe_fin(packet, len)) {
+            send_packet(worker, &worker->to_server, flow, packet, len, address, address_len);
+        }
+        else relay_packet(worker, &worker->to_server, flow, packet, len, address, address_len);
+    }
+
+    if (worker->up_flow) {
+        io_batch_flush(&worker->up, worker->up_flow->upstream.fd);
+    }
+} /* relay_from_clients() */
+
+/**
+ * @brief Relays one batch of server datagrams to the client of a flow.
+ */
+void relay_from_server(relay_worker_t *worker, flow_t *flow)
+{
+    int received = io_batch_recv(&worker->rx, flow->upstream.fd);
+    if (received < 0) {
+        // A connected socket reports the ICMP port unreachable of a server that is not up
+        LOG_DEBUG("recvmmsg() of a flow failed. (%d)\n", GETSOCKETERRNO());
+        return;
+    }
+
+    for (int i = 0; i < received; ++i) {
+        char *packet = io_batch_data(&worker->rx, i);
+        long len = io_batch_len(&worker->rx, i);
+
+        relay_packet(worker, &worker->to_client, flow, packet, len,
+                     (struct sockaddr *)&flow->address, flow->address_len);
+    }
+
+    io_batch_flush(&worker->down, worker->socket);
+} /* relay_from_server() */
+
+/**
+ * @brief Impairs a datagram and forwards, parks or drops its copies.
+ *
+ * A delayed or held datagram that does not fit its queue is forwarded now.
+ *
+ * @param worker The worker.
+ * @param path Direction of the datagram.
+ * @param flow Flow of the datagram.
+ * @param packet The datagram.
+ * @param len Length of the datagram.
+ * @param address Client address, kept with a parked datagram.
+ * @param address_len Length of the client address.
+ */
+void relay_packet(relay_worker_t *worker, relay_path_t *path, flow_t *flow, char *packet, long len,
+                  const struct sockaddr *address, socklen_t address_len)
+{
+    impair_verdict_t verdict;
+    int action = impair_packet(path->config, &path->state, &path->stats, packet, len, worker->now_us, &verdict);
+
+    for (int copy = 0; copy < verdict.copies; ++copy) {
+        if (action == IMPAIR_DELAY &&
+            delay_queue_push(&path->delayed, verdict.release_us, packet, len, address, address_len) == 0) {
+            continue;
+        }
+        if (action == IMPAIR_HOLD &&
+            delay_queue_push(&path->held, verdict.hold_until, packet, len, address, address_len) == 0) {
+            continue;
+        }
+        if (action != IMPAIR_DROP) {
+            send_packet(worker, path, flow, packet, len, address, address_len);
+        }
+    }
+} /* relay_packet() */
+
+/**
+ * @brief Forwards a datagram and the held datagrams it was the last to overtake.
+ */
+void send_packet(relay_worker_t *worker, relay_path_t *path, flow_t *flow, const char *packet, long len,
+                 const struct sockaddr *address, socklen_t address_len)
+{
+    delay_entry_t *entry = NULL;
+
+    transmit(worker, path, flow, packet, len, address, address_len);
+    impair_sent(&path->state, worker->now_us);
+
+    while ((entry = delay_queue_peek(&path->held)) && entry->release_us <= path->state.sent) {
+        transmit(worker, path, NULL, entry->data, entry->len, (struct sockaddr *)&entry->address, entry->address_len);
+        impair_sent(&path->state, worker->now_us);
+        delay_queue_pop(&path->held);
+    }
+} /* send_packet() */
+
+/**
+ * @brief Queues a datagram to the server on the socket of its flow, or to its client.
+ *
+ * @param flow Flow of the datagram, or NULL to look it up by the client address.
+ */
+void transmit(relay_worker_t *worker, relay_path_t *path, flow_t *flow, const char *packet, long len,
+              const struct sockaddr *address, socklen_t address_len)
+{
+    if (path == &worker->to_client) {
+        io_batch_queue(&worker->down, worker->socket, packet, len, address, address_len);
+        return;
+    }
+
+    // The flow may have been closed while the datagram waited
+    if (!flow) {
+        flow = flow_lookup(&worker->flows, address, address_len, hash_address(address, address_len));
+    }
+    if (flow) {
+        forward_up(worker, flow, packet, len);
+    }
+} /* transmit() */
+
+/**
+ * @brief Queues a datagram to the server on the socket of its flow.
+ *
+ * Consecutive datagrams of the same flow leave with one sendmmsg(), the
+ * queue is flushed when the next datagram belongs to another flow.
+ */
+void forward_up(relay_worker_t *worker, flow_t *flow, const char *packet, long len)
+{
+    if (worker->up_flow != flow) {
+        if (worker->up_flow) {
+            io_batch_flush(&worker->up, worker->up_flow->upstream.fd);
+        }
+        worker->up_flow = flow;
+    }
+
+    io_batch_queue(&worker->up, flow->upstream.fd, packet, len,
+                   (struct sockaddr *)&worker->config->server, worker->config->server_len);
+} /* forward_up() */
+
+/**
+ * @brief Forwards the delayed datagrams whose release time has passed.
+ *
+ * Held datagrams are released in order when nothing has been forwarded for
+ * IMPAIR_HOLD_MAX_US, the datagrams that should overtake them may never come.
+ */
+void release_delayed(relay_worker_t *worker, relay_path_t *path)
+{
+    delay_entry_t *entry = NULL;
+
+    while ((entry = delay_queue_peek(&path->delayed)) && entry->release_us <= worker->now_us) {
+        send_packet(worker, path, NULL, entry->data, entry->len, (struct sockaddr *)&entry->address, entry->address_len);
+        delay_queue_pop(&path->delayed);
+    }
+
+    if (path->held.count > 0 && worker->now_us >= path->state.last_sent_us + IMPAIR_HOLD_MAX_US) {
+        while ((entry = delay_queue_peek(&path->held))) {
+            transmit(worker, path, NULL, entry->data, entry->len, (struct sockaddr *)&entry->address, entry->address_len);
+            impair_sent(&path->state, worker->now_us);
+            delay_queue_pop(&path->held);
+        }
+    }
+
+    if (path == &worker->to_client) {
+        io_batch_flush(&worker->down, worker->socket);
+    }
+    else if (worker->up_flow) {
+        io_batch_flush(&worker->up, worker->up_flow->upstream.fd);
+    }
+} /* release_delayed() */
+
+/**
+ * @brief Arms the timer for the earliest delayed or held datagram or idle flow.
+ */
+void worker_arm_timer(relay_worker_t *worker)
+{
+    uint64_t deadline_us = timer_wheel_next_us(&worker->idle_timers);
+    const relay_path_t *paths[] = { &worker->to_server, &worker->to_client };
+
+    for (int i = 0; i < 2; ++i) {
+        uint64_t path_us = delay_queue_next_us(&paths[i]->delayed);
+        if (paths[i]->held.count > 0 && paths[i]->state.last_sent_us + IMPAIR_HOLD_MAX_US < path_us) {
+            path_us = paths[i]->state.last_sent_us + IMPAIR_HOLD_MAX_US;
+        }
+        if (path_us < deadline_us) {
+            deadline_us = path_us;
+        }
+    }
+    event_timer_arm_at(&worker->timer_source, &worker->timer_armed_us, deadline_us);
+} /* worker_arm_timer() */
+
+/**
+ * @brief Closes the flows, delay queues, buffers and sockets of a worker.
+ */
+void worker_free(relay_worker_t *worker)
+{
+    flow_table_free(&worker->flows, &worker->loop);
+    delay_queue_free(&worker->to_server.delayed);
+    delay_queue_free(&worker->to_server.held);
+    delay_queue_free(&worker->to_client.delayed);
+    delay_queue_free(&worker->to_client.held);
+    io_batch_free(&worker->rx);
+    io_batch_free(&worker->up);
+    io_batch_free(&worker->down);
+    event_source_close(&worker->timer_source);
+    event_loop_close(&worker->loop);
+    if (ISVALIDSOCKET(worker->socket)) {
+        CLOSESOCKET(worker->socket);
+    }
+} /* worker_free() */
+
+/**
+ * @brief Allocates the slots for twice the flow limit, the table never grows.
+ *
+ * @return int `0` on success, `-1` if the allocation failed.
+ */
+int flow_table_init(flow_table_t *table, uint32_t max_flows)
+{
+    uint32_t slots = 16;
+
+    memset(table, 0, sizeof(*table));
+    while (slots < max_flows * 2) {
+        slots <<= 1;
+    }
+    table->slots = calloc(slots, sizeof(*table->slots));
+    if (!table->slots) {
+        return -1;
+    }
+    table->mask = slots - 1;
+    table->max_flows = max_flows;
+
+    return 0;
+} /* flow_table_init() */
+
+/**
+ * @brief Closes every flow and frees the table.
+ */
+void flow_table_free(flow_table_t *table, event_loop_t *loop)
+{
+    for (uint32_t i = 0; table->slots && i <= table->mask; ++i) {
+        flow_t *flow = table->slots[i];
+        if (flow) {
+            event_loop_del(loop, &flow->upstream);
+            CLOSESOCKET(flow->upstream.fd);
+            free(flow);
+        }
+    }
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+} /* flow_table_free() */
+
+/**
+ * @brief Finds the flow of a client.
+ *
+ * @return flow_t* The flow, or NULL if the client has none.
+ */
+flow_t *flow_lookup(flow_table_t *table, const struct sockaddr *address, socklen_t address_len, uint32_t hash)
+{
+    for (uint32_t i = hash & table->mask; table->slots[i]; i = (i + 1) & table->mask) {
+        flow_t *flow = table->slots[i];
+        if (flow->hash == hash && flow->address_len == address_len &&
+            memcmp(&flow->address, address, address_len) == 0) {
+            return flow;
+        }
+    }
+
+    return NULL;
+} /* flow_lookup() */
+
+/**
+ * @brief Opens a flow with a socket connected to the server for a new client.
+ *
+ * @return flow_t* The flow, or NULL if the limit is reached or the socket failed.
+ */
+flow_t *flow_open(relay_worker_t *worker, const struct sockaddr *address, socklen_t address_len)
+{
+    flow_table_t *table = &worker->flows;
+    const relay_config_t *config = worker->config;
+
+    if (table->count >= table->max_flows || address_len > sizeof(struct sockaddr_storage)) {
+        table->rejected++;
+        return NULL;
+    }
+
+    flow_t *flow = calloc(1, sizeof(*flow));
+    SOCKET upstream = socket(config->server.ss_family, SOCK_DGRAM, 0);
+    if (!flow || !ISVALIDSOCKET(upstream) ||
+        connect(upstream, (const struct sockaddr *)&config->server, config->server_len)) {
+        LOG_WARN("Socket of a new flow failed. (%d)\n", GETSOCKETERRNO());
+        if (ISVALIDSOCKET(upstream)) {
+            CLOSESOCKET(upstream);
+        }
+        free(flow);
+        table->rejected++;
+        return NULL;
+    }
+
+    // The kernel caps the sizes at net.core.rmem_max and wmem_max, smaller buffers only cost drops
+    int size = SOCKET_BUFFER;
+    setsockopt(upstream, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(upstream, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    memcpy(&flow->address, address, address_len);
+    flow->address_len = address_len;
+    flow->hash = hash_address(address, address_len);
+    flow->upstream = (event_source_t){ upstream, EVENT_SOCKET, flow };
+    if (event_loop_add(&worker->loop, &flow->upstream) < 0) {
+        LOG_WARN("Event loop add of a new flow failed. (%d)\n", GETSOCKETERRNO());
+        CLOSESOCKET(upstream);
+        free(flow);
+        table->rejected++;
+        return NULL;
+    }
+
+    uint32_t i = flow->hash & table->mask;
+    while (table->slots[i]) {
+        i = (i + 1) & table->mask;
+    }
+    table->slots[i] = flow;
+    table->count++;
+    table->created++;
+    LOG_INFO("------- New flow (%u active) -------\n", table->count);
+
+    return flow;
+} /* flow_open() */
+
+/**
+ * @brief Removes a flow, closes its socket and shifts the probe chain behind it.
+ */
+void flow_close(relay_worker_t *worker, flow_t *flow)
+{
+    flow_table_t *table = &worker->flows;
+    uint32_t i = flow->hash & table->mask;
+
+    while (table->slots[i] != flow) {
+        i = (i + 1) & table->mask;
+    }
+    table->slots[i] = NULL;
+
+    // Backward shift: a later flow moves into the hole unless its home slot is between the hole and it
+    for (uint32_t j = (i + 1) & table->mask; table->slots[j]; j = (j + 1) & table->mask) {
+        uint32_t home = table->slots[j]->hash & table->mask;
+        if (((j - home) & table->mask) >= ((j - i) & table->mask)) {
+            table->slots[i] = table->slots[j];
+            table->slots[j] = NULL;
+            i = j;
+        }
+    }
+    table->count--;
+
+    if (worker->up_flow == flow) {
+        worker->up_flow = NULL;
+    }
+    timer_wheel_cancel(&worker->idle_timers, &flow->idle_timer);
+    event_loop_del(&worker->loop, &flow->upstream);
+    CLOSESOCKET(flow->upstream.fd);
+    free(flow);
+} /* flow_close() */
+
+/**
+ * @brief Closes a flow whose client has been quiet for the idle timeout.
+ *
+ * @param timer The idle timer of the flow.
+ * @param ctx The relay_worker_t the flow belongs to.
+ */
+void evict_flow(timer_node_t *timer, void *ctx)
+{
+    relay_worker_t *worker = ctx;
+
+    worker->flows.evicted++;
+    flow_close(worker, timer_entry(timer, flow_t, idle_timer));
+    LOG_INFO("------- Idle flow closed (%u active) -------\n", worker->flows.count);
+} /* evict_flow() */
+
+/**
+ * @brief FNV-1a hash of a client address, never 0.
+ */
+uint32_t hash_address(const struct sockaddr *address, socklen_t address_len)
+{
+    const uint8_t *bytes = (const uint8_t *)address;
+    uint32_t hash = 2166136261u;
+
+    for (socklen_t i = 0; i < address_len; ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash ? hash : 1;
+} /* hash_address() */
+
+/**
+ * @brief Sets one impairment option of a direction.
+ *
+ * @param impair Impairments of the direction.
+ * @param option The option character.
+ * @param arg The option argument, `bad,good[,bad_loss]` for -G,
+ *        `probability,depth` for -R and `mbit_s[,queue_kb]` for -L.
+ * @return int `0` on success, `-1` if the argument is invalid.
+ */
+int parse_impairment(impair_config_t *impair, int option, const char *arg)
+{
+    float probability = atof(arg);
+    float good = 0, bad_loss = 1.0f;
+    unsigned int depth = 0, queue_kb = DEFAULT_QUEUE_KB;
+    double mbit_s = 0;
+
+    switch (option) {
+    case 'r':
+        impair->drop_probability = probability;
+        break;
+    case 'G':
+        if (sscanf(arg, "%f,%f,%f", &probability, &good, &bad_loss) < 2 || good <= 0 || good > 1 ||
+            bad_loss < 0 || bad_loss > 1) {
+            return -1;
+        }
+        impair->bad_probability = probability;
+        impair->good_probability = good;
+        impair->bad_loss = bad_loss;
+        break;
+    case 'd':
+        impair->delay_probability = probability;
+        break;
+    case 't':
+        impair->delay_us = atoi(arg) * 1000ULL;
+        return 0;
+    case 'v':
+        impair->error_probability = probability;
+        break;
+    case 'R':
+        if (sscanf(arg, "%f,%u", &probability, &depth) != 2 || depth < 1) {
+            return -1;
+        }
+        impair->reorder_probability = probability;
+        impair->reorder_depth = depth;
+        break;
+    case 'D':
+        impair->duplicate_probability = probability;
+        break;
+    case 'L':
+        if (sscanf(arg, "%lf,%u", &mbit_s, &queue_kb) < 1 || mbit_s <= 0 || queue_kb < 1) {
+            return -1;
+        }
+        impair->rate = mbit_s * 1e6 / 8;
+        impair->queue_bytes = queue_kb * 1024;
+        return 0;
+    }
+
+    return (probability >= 0 && probability <= 1) ? 0 : -1;
+} /* parse_impairment() */
+
+/**
+ * @brief Prints the impairments of a direction.
+ */
+void print_impairment(const char *direction, const impair_config_t *impair)
+{
+    if (impair->trace) {
+        printf("%s: Trace: %u records | Reorder: %.3f by %u | Duplicate: %.3f", direction, impair->trace->count,
+               impair->reorder_probability, impair->reorder_depth, impair->duplicate_probability);
+    }
+    else {
+        print_probabilities(direction, impair);
+    }
+    if (impair->rate > 0) {
+        printf(" | Link: %.1f Mbit/s, %u KB queue", impair->rate * 8 / 1e6, impair->queue_bytes / 1024);
+    }
+    printf("\n");
+} /* print_impairment() */
+
+/**
+ * @brief Prints the loss, delay, error, reordering and duplication probabilities of a direction.
+ */
+void print_probabilities(const char *direction, const impair_config_t *impair)
+{
+    printf("%s: Packet Loss: %.3f", direction, impair->drop_probability);
+    if (impair->bad_probability > 0) {
+        printf(" (Gilbert-Elliott: bad %.3f | good %.3f | bad loss %.2f)",
+               impair->bad_probability, impair->good_probability, impair->bad_loss);
+    }
+    printf(" | Packet Delay: %.3f | Delay: %lu ms | Bit Error: %.3f | Reorder: %.3f by %u | Duplicate: %.3f",
+           impair->delay_probability, (unsigned long)(impair->delay_us / 1000), impair->error_probability,
+           impair->reorder_probability, impair->reorder_depth, impair->duplicate_probability);
+} /* print_probabilities() */
+
+/**
+ * @brief Adds the counters of a worker's direction to the totals.
+ */
+void add_stats(impair_stats_t *total, const impair_stats_t *stats)
+{
+    total->packets += stats->packets;
+    total->dropped += stats->dropped;
+    total->bursts += stats->bursts;
+    total->delayed += stats->delayed;
+    total->corrupted += stats->corrupted;
+    total->reordered += stats->reordered;
+    total->duplicated += stats->duplicated;
+    total->queued += stats->queued;
+    total->overflowed += stats->overflowed;
+} /* add_stats() */
+
+/**
+ * @brief Prints the counters of a direction, the bursts and the link only if they happened.
+ */
+void print_path_stats(const char *direction, const impair_stats_t *stats)
+{
+    printf("%s: %lu datagrams | %lu dropped", direction, stats->packets, stats->dropped);
+    if (stats->bursts > 0) {
+        printf(" in %lu bursts", stats->bursts);
+    }
+    printf(" | %lu delayed | %lu corrupted | %lu reordered | %lu duplicated\n",
+            stats->delayed, stats->corrupted, stats->reordered, stats->duplicated);
+    if (stats->queued > 0 || stats->overflowed > 0) {
+        printf("%s link: %lu datagrams queued | %lu dropped from a full queue\n",
+                direction, stats->queued, stats->overflowed);
+    }
+} /* print_path_stats() */
+
+/**
+ * @brief Prints the impairment counters of both directions and the relay rate.
+ *
+ * @param workers The workers.
+ * @param n_workers Number of workers.
+ * @param start_us Time when the relay started waiting for packets.
+ */
+void print_relay_stats(const relay_worker_t *workers, int n_workers, uint64_t start_us)
+{
+    impair_stats_t up = {0}, down = {0};
+    unsigned long created = 0, evicted = 0, rejected = 0, overflows = 0;
+    uint32_t active = 0;
+
+    for (int w = 0; w < n_workers; ++w) {
+        const relay_worker_t *worker = &workers[w];
+        double worker_s = (worker->stop_us - worker->start_us) / 1e6;
+        unsigned long packets = worker->to_server.stats.packets + worker->to_client.stats.packets;
+
+        add_stats(&up, &worker->to_server.stats);
+        add_stats(&down, &worker->to_client.stats);
+        active += worker->flows.count;
+        created += worker->flows.created;
+        evicted += worker->flows.evicted;
+        rejected += worker->flows.rejected;
+        overflows += worker->to_server.delayed.overflows + worker->to_server.held.overflows +
+                     worker->to_client.delayed.overflows + worker->to_client.held.overflows;
+
+        if (n_workers > 1) {
+            // An unpinned worker has no CPU of its own
+            char cpu_name[16] = "unpinned";
+            if (worker->cpu >= 0) {
+                snprintf(cpu_name, sizeof(cpu_name), "CPU %d", worker->cpu);
+            }
+            printf("Worker %d (%s): %lu datagrams | %.0f datagrams/s | CPU: %.2f s | %.0f datagrams/s per core | %lu flows\n",
+                    worker->id, cpu_name, packets, worker_s > 0 ? packets / worker_s : 0.0, worker->cpu_s,
+                    worker->cpu_s > 0 ? packets / worker->cpu_s : 0.0, worker->flows.created);
+        }
+        printf("Batched I/O: %lu datagrams in %lu receive calls | %lu to the server in %lu send calls | %lu to the clients in %lu send calls\n",
+                worker->rx.rx_datagrams, worker->rx.rx_calls, worker->up.tx_datagrams, worker->up.tx_calls,
+                worker->down.tx_datagrams, worker->down.tx_calls);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double wall_s = (event_loop_now_us() - start_us) / 1e6;
+    double cpu_s = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                   (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    unsigned long packets = up.packets + down.packets;
+
+    print_path_stats("Client to server", &up);
+    print_path_stats("Server to client", &down);
+    if (overflows > 0) {
+        printf("Delay queues: %lu datagrams not delayed or held because the queue was full\n", overflows);
+    }
+    printf("Relay: %lu datagrams | Wall: %.2f s | CPU: %.2f s | %.0f datagrams/s per core\n",
+            packets, wall_s, cpu_s, cpu_s > 0 ? packets / cpu_s : 0.0);
+    printf("Flows: %u active | %lu created | %lu closed idle | %lu rejected\n", active, created, evicted, rejected);
+    if (log_dropped() > 0) {
+        printf("Log: %lu messages dropped because the ring was full\n", log_dropped());
+    }
+} /* print_relay_stats() */
+
+/**
+ * @brief Creates and binds the socket the clients send to.
+ *
+ * @param bind_address Address to bind to.
+ * @param reuse_port Set SO_REUSEPORT so every worker can bind the port.
+ * @return SOCKET The socket, or -1 on error.
+ */
+SOCKET configure_socket(struct addrinfo *bind_address, bool reuse_port)
+{
+    SOCKET socket_listen = socket(bind_address->ai_family, bind_address->ai_socktype, bind_address->ai_protocol);
+    if (!ISVALIDSOCKET(socket_listen)) {
+        fprintf(stderr, "socket() failed. (%d)\n", GETSOCKETERRNO());
+        return -1;
+    }
+
+    // Every worker binds its own socket to the same port
+    int enable = 1;
+    if (reuse_port && setsockopt(socket_listen, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable))) {
+        fprintf(stderr, "setsockopt(SO_REUSEPORT) failed. (%d)\n", GETSOCKETERRNO());
+        CLOSESOCKET(socket_listen);
+        return -1;
+    }
+
+    // The kernel caps the sizes at net.core.rmem_max and wmem_max, smaller buffers only cost drops
+    int size = SOCKET_BUFFER;
+    setsockopt(socket_listen, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(socket_listen, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    if (bind(socket_listen, bind_address->ai_addr, bind_address->ai_addrlen)) {
+        fprintf(stderr, "bind() failed. (%d)\n", GETSOCKETERRNO());
+        CLOSESOCKET(socket_listen);
+        return -1;
+    }
+
+    return socket_listen;
+} /* configure_socket() */
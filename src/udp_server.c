@@ -9,12 +9,17 @@
  * Permission tba
  *******************************************/
 
+#define _GNU_SOURCE
+
 // Standard Headers 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
 
 // Networking Headers
 #include <sys/types.h>
@@ -24,34 +29,154 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <errno.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <poll.h>
 
 // Local Headers
 #include "../include/sleep.h"
 #include "../include/rdn_num.h"
 #include "../include/crc.h"
+#include "../include/crc32c.h"
+#include "../include/checksum.h"
+#include "../include/codec.h"
 #include "../include/rdt.h"
 #include "../include/gbn.h"
 #include "../include/sr.h"
+#include "../include/io_batch.h"
+#include "../include/event_loop.h"
+#include "../include/uring_io.h"
+#include "../include/session.h"
+#include "../include/delay_queue.h"
+#include "../include/timer_wheel.h"
+#include "../include/log.h"
 
 #define ISVALIDSOCKET(s) ((s) >= 0)
 #define CLOSESOCKET(s)   close(s)
 #define SOCKET int
 #define GETSOCKETERRNO() (errno)
 
-#define WINDOW_SIZE     5
-#define MAX_BUFFER_SIZE 50
 
 #define DEFAULT_PORT   "6666"
 
+#define DEFAULT_IDLE_TIMEOUT_S  30          /* Sessions without traffic are evicted after this */
+#define DEFAULT_MAX_SESSIONS    100000      /* Concurrent clients served */
+#define MAX_WORKERS             64          /* Worker threads with -w */
+#define DELAY_QUEUE_MAX         65536       /* Delayed datagrams parked per worker */
+#define DEFAULT_MAX_WINDOW      1024        /* Largest window a HELLO is granted */
+#define MAX_SOCKET_BUFFER       (64 << 20)  /* Upper limit of the receive buffer asked for */
+#define DEFAULT_ACK_EVERY       2           /* In order packets answered by one ACK */
+#define DEFAULT_ACK_DELAY_US    1000        /* Longest time an ACK is held back */
+
 #define RED     "\033[1;31m"
 #define ORANGE  "\033[1;33m"
 #define BLUE    "\033[1;34m"
 #define RESET   "\033[0m"
 
 
-SOCKET configure_socket(struct addrinfo *bind_address);
+/**
+ * @brief Outcome of handling a single datagram.
+ */
+enum Datagram_result {
+    DATAGRAM_HANDLED,   /**< Datagram processed, replies (if any) are queued. */
+    DATAGRAM_TEARDOWN,  /**< Teardown received, the client's session was closed. */
+    DATAGRAM_DELAYED    /**< Datagram parked in the delay queue. */
+};
 
-crc crcTable[256];
+/**
+ * @brief Configuration and sessions of the server.
+ *
+ * The mode and impairment settings are shared, every client gets its own
+ * receiver state from the session table.
+ */
+typedef struct {
+    bool rdt;                                   /**< RDT mode selected. */
+    bool gbn;                                   /**< Go-Back-N mode selected. */
+    bool sr;                                    /**< Selective Repeat mode selected. */
+    float drop_probability;                     /**< Drop probability for GBN and SR. */
+    uint64_t seed;                              /**< Seed of the impairments, worker N draws stream N. */
+    unsigned int checksums;                     /**< Checksums a HELLO may pick, bit per type. */
+    uint32_t max_window;                        /**< Largest window a HELLO is granted. */
+    Rdt_variables rdt_vars;                     /**< RDT parameters, copied to new sessions. */
+    session_table_t sessions;                   /**< Receiver state of every client. */
+    delay_queue_t delayed;                      /**< Datagrams waiting for the delay impairment. */
+    timer_wheel_t timers;                       /**< Idle timers of the sessions. */
+    timer_wheel_t ack_timers;                   /**< Delayed ACK timers of the sessions. */
+    uint32_t ack_every;                         /**< In order packets answered by one ACK, 1 answers every packet. */
+    uint64_t ack_delay_us;                      /**< Longest time an ACK is held back. */
+    uint64_t idle_timeout_us;                   /**< Idle time before a session is evicted. */
+    uint64_t now_us;                            /**< Time of the current wakeup. */
+    unsigned long packets;                      /**< Datagrams handled. */
+    unsigned long data_packets;                 /**< GBN and SR data packets answered. */
+    unsigned long acks;                         /**< GBN and SR ACKs and NAKs sent. */
+    unsigned long delayed_acks;                 /**< ACKs sent when the delay timer fired. */
+} server_state_t;
+
+SOCKET configure_socket(struct addrinfo *bind_address, bool reuse_port, int rcvbuf);
+/**
+ * @brief I/O backend that receives the datagrams and sends the replies.
+ */
+typedef struct {
+    SOCKET socket;          /**< Listening UDP socket. */
+    bool use_uring;         /**< io_uring backend active instead of epoll + batch. */
+    io_batch_t batch;       /**< recvfrom()/recvmmsg() backend. */
+    uring_io_t uring;       /**< io_uring backend. */
+} server_io_t;
+
+/**
+ * @brief A worker thread with its own socket, event loop and session shard.
+ *
+ * With `-w N` every worker binds its own SO_REUSEPORT socket to the port.
+ * The kernel hashes the 4-tuple of a client to one socket, so a client's
+ * session only ever lives on one worker and no locking is needed.
+ */
+typedef struct {
+    int id;                         /**< Worker number. */
+    int cpu;                        /**< CPU the worker is pinned to, or -1. */
+    server_state_t state;           /**< Configuration and session shard. */
+    server_io_t io;                 /**< Socket and I/O backend. */
+    event_loop_t loop;              /**< Event loop of the worker. */
+    event_source_t listen_source;   /**< The worker's socket. */
+    event_source_t timer_source;    /**< Fires when the earliest session timer is due. */
+    uint64_t timer_armed_us;        /**< Deadline the session timer is armed for, 0 if disarmed. */
+    event_source_t delay_source;    /**< Fires when the earliest delayed datagram is due. */
+    uint64_t delay_armed_us;        /**< Deadline the delay timer is armed for, 0 if disarmed. */
+    event_source_t *stop_source;    /**< signalfd with one worker, shared eventfd with more. */
+    pthread_t thread;               /**< Thread running worker_run(). */
+    uint64_t start_us;              /**< Time the worker started waiting. */
+    uint64_t stop_us;               /**< Time the worker stopped. */
+    double cpu_s;                   /**< CPU time used by the worker thread. */
+    unsigned int batch_size;        /**< Datagrams per system call for the epoll backend. */
+    bool use_uring;                 /**< Try the io_uring backend. */
+    int status;                     /**< 0, or 1 if the worker stopped on an error. */
+} server_worker_t;
+
+int handle_datagram(server_state_t *state, char *read, long bytes_received,
+                    struct sockaddr *client_address, socklen_t client_len,
+                    server_io_t *io, bool released);
+int queue_reply(server_io_t *io, const char *packet, size_t len,
+                const struct sockaddr *address, socklen_t address_len);
+int worker_setup(server_worker_t *worker, struct addrinfo *bind_address, bool reuse_port,
+                 unsigned int batch_size, bool use_uring, uint32_t max_sessions);
+int worker_io_init(server_worker_t *worker);
+void *worker_run(void *arg);
+void worker_stop_all(server_worker_t *worker);
+void worker_release_delayed(server_worker_t *worker);
+void worker_arm_timers(server_worker_t *worker);
+void worker_free(server_worker_t *worker);
+void print_server_stats(const server_worker_t *workers, int n_workers, uint64_t start_us);
+void print_io_stats(const server_io_t *io);
+bool handle_hello(server_state_t *state, session_t *session, const char *read, long bytes_received,
+                  server_io_t *io);
+int receive_selective(session_t *session, uint32_t *base, const codec_frame_t *frame);
+uint16_t session_max_payload(const session_t *session);
+int make_sack_reply(session_t *session, uint32_t base, uint32_t seq, char *packet);
+int reply_data(server_state_t *state, session_t *session, server_io_t *io, uint32_t seq, bool in_order);
+int send_ack(server_state_t *state, session_t *session, server_io_t *io);
+void send_delayed_ack(timer_node_t *timer, void *ctx);
+void print_session_data(session_t *session);
+void evict_session(timer_node_t *timer, void *ctx);
+void print_peer(int level, struct sockaddr *client_address, socklen_t client_len);
 
 int main(int argc, char* argv[]) {
     
@@ -60,28 +185,32 @@ int main(int argc, char* argv[]) {
     // UDP server port
     char *port = NULL;
     port = DEFAULT_PORT;
-    bool rdt = true;
-    Rdt_variables rdt_vars = {0, 0, 0, 0, 0, -1, 10}; 
     int c = 0;
     opterr = 0;
     float rdt_version = 0;
-
-    float drop_probability = 0;
-
+    unsigned int batch_size = 1;
+    bool use_uring = false;
+
+    uint32_t max_sessions = DEFAULT_MAX_SESSIONS;
+    int n_workers = 1;
+    bool pin_workers = false;
+    int log_level = LOG_LEVEL_INFO;
+    static impair_trace_t trace;
+
+    static server_state_t state = {
+        .rdt = true,
+        .rdt_vars = {0, 0, 0, 0, 0, -1, 10},
+        .idle_timeout_us = DEFAULT_IDLE_TIMEOUT_S * 1000000ULL,
+        .checksums = (1u << CHECKSUM_TYPES) - 1,
+        .max_window = DEFAULT_MAX_WINDOW,
+        .ack_every = DEFAULT_ACK_EVERY,
+        .ack_delay_us = DEFAULT_ACK_DELAY_US,
+    };
     
 
-    bool gbn = false;
-    
-    int expected_seq_num = 1;
-
-    bool sr = false;
-    int rcv_base = 1;
-    sr_receive_buffer_t sr_receive_buffer = {{false}, {0}};
-    int last_seq = 0;
-
-
     // Parse command line arguments
-    while((c = getopt(argc, argv, "x:p:d:r:t:v:gsh")) != -1) {
+    state.seed = rand_default_seed();
+    while((c = getopt(argc, argv, "x:p:d:r:t:v:T:S:b:ui:m:w:cl:k:n:a:A:gsh")) != -1) {
         switch (c)
         {
         case 'x':
@@ -92,7 +221,7 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
             rdt_version = atof(optarg) * 10;
-            rdt_vars.rdt = (uint16_t)rdt_version;
+            state.rdt_vars.rdt = (uint16_t)rdt_version;
             break;
         case 'p':
             // Port
@@ -100,48 +229,140 @@ int main(int argc, char* argv[]) {
             break;
         case 'r':
             // Probability for packet drop
-            rdt_vars.drop_probability = atof(optarg);
-            drop_probability = atof(optarg);
+            state.rdt_vars.drop_probability = atof(optarg);
+            state.drop_probability = atof(optarg);
             break;
         case 'd':
             // Probability for packet delay
-            rdt_vars.delay_probability = atof(optarg);
+            state.rdt_vars.delay_probability = atof(optarg);
             break;
         case 't':
             // Delay is ms
-            rdt_vars.delay_ms = atoi(optarg);
+            state.rdt_vars.delay_ms = atoi(optarg);
             break;
         case 'v':
             // Error probability
-            rdt_vars.error_probability = (double)atof(optarg);
+            state.rdt_vars.error_probability = (double)atof(optarg);
+            break;
+        case 'T':
+            // Recorded trace replayed instead of the probabilities
+            if (impair_trace_open(&trace, optarg) < 0) {
+                fprintf(stderr, "ERROR: trace %s not mapped. (%d)\n", optarg, GETSOCKETERRNO());
+                return 1;
+            }
+            state.rdt_vars.trace = &trace;
+            break;
+        case 'S':
+            // Seed of the impairments, repeats a run
+            state.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'b':
+            // Datagrams received and sent per system call
+            if (atoi(optarg) < 1 || atoi(optarg) > IO_BATCH_MAX) {
+                fprintf(stderr, "ERROR: batch size must be between 1 and %d\n", IO_BATCH_MAX);
+                return 1;
+            }
+            batch_size = atoi(optarg);
+            break;
+        case 'u':
+            // io_uring I/O backend
+            use_uring = true;
+            break;
+        case 'i':
+            // Idle time in seconds before a session is evicted
+            if (atoi(optarg) < 1) {
+                fprintf(stderr, "ERROR: idle timeout must be at least 1 second\n");
+                return 1;
+            }
+            state.idle_timeout_us = atoi(optarg) * 1000000ULL;
+            break;
+        case 'm':
+            // Maximum number of concurrent sessions
+            if (atoi(optarg) < 1) {
+                fprintf(stderr, "ERROR: at least 1 session is needed\n");
+                return 1;
+            }
+            max_sessions = atoi(optarg);
+            break;
+        case 'w':
+            // Worker threads, each with its own SO_REUSEPORT socket
+            n_workers = atoi(optarg);
+            if (n_workers < 1 || n_workers > MAX_WORKERS) {
+                fprintf(stderr, "ERROR: workers must be between 1 and %d\n", MAX_WORKERS);
+                return 1;
+            }
+            break;
+        case 'c':
+            // Pin worker N to CPU N
+            pin_workers = true;
+            break;
+        case 'l':
+            // Log level
+            log_level = log_parse_level(optarg);
+            if (log_level < 0) {
+                fprintf(stderr, "ERROR: log level must be error, warn, info or debug\n");
+                return 1;
+            }
+            break;
+        case 'k':
+            // Only this checksum is agreed to besides the CRC-8 fallback
+            if (checksum_parse(optarg) < 0) {
+                fprintf(stderr, "ERROR: checksum must be crc8 or crc32c\n");
+                return 1;
+            }
+            state.checksums = 1u << checksum_parse(optarg);
+            break;
+        case 'n':
+            // Largest window granted to a client
+            if (atoi(optarg) < 1 || atoi(optarg) > CODEC_MAX_WINDOW) {
+                fprintf(stderr, "ERROR: window must be between 1 and %d packets\n", CODEC_MAX_WINDOW);
+                return 1;
+            }
+            state.max_window = atoi(optarg);
+            break;
+        case 'a':
+            // In order packets answered by one ACK
+            if (atoi(optarg) < 1 || atoi(optarg) > CODEC_MAX_WINDOW) {
+                fprintf(stderr, "ERROR: ACK every must be between 1 and %d packets\n", CODEC_MAX_WINDOW);
+                return 1;
+            }
+            state.ack_every = atoi(optarg);
+            break;
+        case 'A':
+            // Longest time an ACK is held back in microseconds
+            if (atoi(optarg) < 1) {
+                fprintf(stderr, "ERROR: ACK delay must be at least 1 microsecond\n");
+                return 1;
+            }
+            state.ack_delay_us = atoi(optarg);
             break;
         case 'g':
             // Go-Back-N Selected
-            gbn = true;
-            rdt = false;
+            state.gbn = true;
+            state.rdt = false;
             break;
         case 's':
             // Selective Repeat Selected
-            sr = true;
-            rdt = false;
+            state.sr = true;
+            state.rdt = false;
             break;
         case 'h':
             printf("HELP: \n");
-            printf("Usage rdt:\t\t %s -x [version] -p [port] -d [delay_probability] -r [drop_probability] -t [delay_ms] -v [error_probability]\n", argv[0]);
-            printf("Usage Go-Back-N:\t %s -g -r [drop_probability]\n", argv[0]);
-            printf("Usage Selective Repeat:\t %s -s -r [drop_probability]\n", argv[0]);
+            printf("Usage rdt:\t\t %s -x [version] -p [port] -d [delay_probability] -r [drop_probability] -t [delay_ms] -v [error_probability] -T [trace_file] -S [seed] -b [batch_size] -i [idle_timeout_s] -m [max_sessions] -w [workers] -l [log_level] [-u] [-c]\n", argv[0]);
+            printf("Usage Go-Back-N:\t %s -g -r [drop_probability] -T [trace_file] -S [seed] -k [checksum] -n [max_window] -a [ack_every] -A [ack_delay_us] -b [batch_size] -i [idle_timeout_s] -m [max_sessions] -w [workers] -l [log_level] [-u] [-c]\n", argv[0]);
+            printf("Usage Selective Repeat:\t %s -s -r [drop_probability] -T [trace_file] -S [seed] -k [checksum] -n [max_window] -a [ack_every] -A [ack_delay_us] -b [batch_size] -i [idle_timeout_s] -m [max_sessions] -w [workers] -l [log_level] [-u] [-c]\n", argv[0]);
             return 1;
             break;
         default:
-            if (rdt == true) {
-                fprintf(stderr, "Usage rdt : %s -x version -p port -d delay_probability -r drop_probability -t delay_ms -v error_probability\n", argv[0]);
+            if (state.rdt == true) {
+                fprintf(stderr, "Usage rdt : %s -x version -p port -d delay_probability -r drop_probability -t delay_ms -v error_probability -T trace_file -S seed -b batch_size -i idle_timeout_s -m max_sessions -w workers -l log_level [-u] [-c]\n", argv[0]);
             }
-            else if (gbn == true) {
-                fprintf(stderr, "Usage Go-Back-N: %s -g -r drop_probability\n", argv[0]);
+            else if (state.gbn == true) {
+                fprintf(stderr, "Usage Go-Back-N: %s -g -r drop_probability -T trace_file -S seed -k checksum -n max_window -a ack_every -A ack_delay_us -b batch_size -i idle_timeout_s -m max_sessions -w workers -l log_level [-u] [-c]\n", argv[0]);
 
             }
-            else if (sr == true) {
-                fprintf(stderr, "Usage Selective Repeat: %s -s -r drop_probability\n", argv[0]);
+            else if (state.sr == true) {
+                fprintf(stderr, "Usage Selective Repeat: %s -s -r drop_probability -T trace_file -S seed -k checksum -n max_window -a ack_every -A ack_delay_us -b batch_size -i idle_timeout_s -m max_sessions -w workers -l log_level [-u] [-c]\n", argv[0]);
 
             }
             else {
@@ -152,29 +373,35 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    if (rdt == true) {
-        printf("RDT: %d Port: %s \tProbability for Packet Loss: %.1f \t Probability for Packet Delay: %.1f\t Delay: %d ms\n", rdt_vars.rdt, port,
-                                                                                                        rdt_vars.drop_probability, rdt_vars.delay_probability,
-                                                                                                        rdt_vars.delay_ms);
+    if (state.rdt == true) {
+        printf("RDT: %d Port: %s \tProbability for Packet Loss: %.3f \t Probability for Packet Delay: %.3f\t Delay: %d ms\n", state.rdt_vars.rdt, port,
+                                                                                                        state.rdt_vars.drop_probability, state.rdt_vars.delay_probability,
+                                                                                                        state.rdt_vars.delay_ms);
     }
-    else if (gbn == true) {
+    else if (state.gbn == true) {
         port = DEFAULT_PORT;
-        printf("Go-Back-N Port: %s \tProbability for Packet Loss: %.1f\n", port, drop_probability);
+        printf("Go-Back-N Port: %s \tProbability for Packet Loss: %.3f\n", port, state.drop_probability);
     }
-    else if (sr == true) {
+    else if (state.sr == true) {
         port = DEFAULT_PORT;
-        printf("Selective Repeat Port: %s \tProbability for Packet Loss %.1f\n", port, drop_probability);
+        printf("Selective Repeat Port: %s \tProbability for Packet Loss %.3f\n", port, state.drop_probability);
+    }
+    if (state.rdt_vars.trace) {
+        printf("Trace: %u records, replayed from the start for every client\n", trace.count);
+    }
+    else printf("Random seed: %lu\n", (unsigned long)state.seed);
+    if (state.rdt == false) {
+        printf("Checksums: %s%s (CRC32C engine: %s)\n", (state.checksums & (1u << CHECKSUM_CRC32C)) ? "crc32c, " : "",
+               checksum_get(CHECKSUM_CRC8)->name, crc32c_engine_name());
+        printf("Max window: %u packets\n", state.max_window);
+        printf("ACK every %u packets or after %lu us%s\n", state.ack_every, (unsigned long)state.ack_delay_us,
+               state.sr ? " (with SACK)" : "");
+    }
+
+    // Packet path messages are formatted and written by the logging thread
+    if (log_init(log_level) < 0) {
+        fprintf(stderr, "Logging thread not started, logging synchronously. (%d)\n", GETSOCKETERRNO());
     }
-    // Precompute CRC8 table for fastCRC
-    crcInit();
-    
-    char all_received[4096];
-    
-    // Preparing the Teardown data that is used to Teardown the connection. 
-    char teardown[5];
-    char *tear_data = "00";
-    snprintf(teardown, 3, "%c%s%c", 0, tear_data, 0x90);
-    
     
     printf("Configuring local address...\n");
     struct addrinfo hints;
@@ -186,273 +413,1123 @@ int main(int argc, char* argv[]) {
     struct addrinfo *bind_address;
     getaddrinfo(0, port, &hints, &bind_address);  
 
-    printf("Creating socket...\n");
-    SOCKET socket_listen = configure_socket(bind_address);
-    freeaddrinfo(bind_address);
+    // Signals are blocked before any worker starts, so only the signalfd receives them
+    event_source_t signal_source;
+    const int shutdown_signals[] = { SIGINT, SIGTERM };
+    if (event_signal_init(&signal_source, shutdown_signals, 2, NULL) < 0) {
+        fprintf(stderr, "signalfd() failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
 
-    fd_set master;
-    FD_ZERO(&master);
-    FD_SET(socket_listen, &master);
-    SOCKET max_socket = socket_listen;
+    // Workers share the port with SO_REUSEPORT and are stopped with one eventfd
+    event_source_t stop_source;
+    if (n_workers > 1 && event_notify_init(&stop_source, NULL) < 0) {
+        fprintf(stderr, "eventfd() failed. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
 
-    printf("Waiting for connections....\n\n");
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    server_worker_t *workers = calloc(n_workers, sizeof(*workers));
+    if (!workers) {
+        fprintf(stderr, "Out of memory. (%d)\n", GETSOCKETERRNO());
+        return 1;
+    }
 
-    while (1) {
-        fd_set reads;
-        reads = master;
-        if(select(max_socket +1, &reads, 0, 0, 0) < 0) {
-            fprintf(stderr, "select() failed. (%d)\n", GETSOCKETERRNO());
+    printf("Creating socket...\n");
+    for (int w = 0; w < n_workers; ++w) {
+        server_worker_t *worker = &workers[w];
+
+        worker->id = w;
+        worker->cpu = (pin_workers && n_cpus > 0) ? (int)(w % n_cpus) : -1;
+        worker->state = state;
+        worker->stop_source = (n_workers > 1) ? &stop_source : &signal_source;
+        if (worker_setup(worker, bind_address, n_workers > 1, batch_size, use_uring, max_sessions) < 0) {
             return 1;
         }
-        // Connection established
-        if (FD_ISSET(socket_listen, &reads)) {
-            struct sockaddr_storage client_address;
-            socklen_t client_len = sizeof(client_address);
+    }
+    freeaddrinfo(bind_address);
 
-            char read[1024];
-            memset(read, '\0' , sizeof(read));
+    if (n_workers > 1) {
+        printf("Workers: %d sockets on port %s with SO_REUSEPORT%s\n", n_workers, port,
+                pin_workers ? ", pinned to CPUs" : "");
+    }
+    printf("Waiting for connections....\n\n");
 
-            long bytes_received = recvfrom(socket_listen, read, 1024, 0, (struct sockaddr *)&client_address, &client_len);
-            if (bytes_received < 1) {
-                fprintf(stderr, "connection closed. (%d)\n", GETSOCKETERRNO());
+    uint64_t start_us = event_loop_now_us();
+    int status = 0;
+    if (n_workers == 1) {
+        worker_run(&workers[0]);
+    }
+    else {
+        for (int w = 0; w < n_workers; ++w) {
+            if (pthread_create(&workers[w].thread, NULL, worker_run, &workers[w]) != 0) {
+                fprintf(stderr, "pthread_create() failed.\n");
                 return 1;
             }
+        }
 
-            /* VIRTUAL SOCKET BEGINS */
-            if (rdt == true) {
-                
-                printf("----- Packet Receive Start -------\n");
-
-                // Doing the CRC check for the packet
-                crc result = process_packet (read, bytes_received, &rdt_vars);
-
-                char *recv_packet = malloc(bytes_received + 1);
-                memcpy(recv_packet, read, bytes_received);
-                recv_packet[bytes_received] = '\0';
-                                
-                char *crc_result = (result == 0) ? "OK" : "NOK";
-                printf("Packet received: SEQ %d | Data: %s | Bytes: %ld | CRC Check: %s\n", rdt_vars.seq, &recv_packet[1], bytes_received, crc_result); 
-                free(recv_packet);
-                printf("----- Packet Receive End -------\n");
-                
-                char packet[8];
-                memset(packet, 0, sizeof(packet));
-                int packet_len = 0;
-
-                // If RDT 1.0, no ACK/NAK 
-                if (rdt_vars.rdt == 10) {
-                    printf("RDT Version: %d | No ACK\n", rdt_vars.rdt);
-                    continue;
-                }
+        // The main thread waits for the shutdown signal, or for a failed worker that stopped the others
+        int signal = 0;
+        while ((signal = event_signal_read(&signal_source)) < 0) {
+            struct pollfd pfds[2] = { { signal_source.fd, POLLIN, 0 }, { stop_source.fd, POLLIN, 0 } };
+            poll(pfds, 2, -1);
+            if (pfds[1].revents & POLLIN) {
+                break;
+            }
+        }
+        if (signal >= 0) {
+            printf("\n------- Signal %d received, shutting down -------\n\n", signal);
+        }
+        else printf("\n------- Worker failed, shutting down -------\n\n");
+        event_notify_signal(&stop_source);
 
-                packet_len = make_packet(packet, rdt_vars.rdt, rdt_vars.seq, result);
-                
-                // If packet creation fails, print error but continue
-                if (packet_len < 1) {
-                fprintf(stderr, "Error creating packet!\n");
-                    continue;
-                }
-                
-                printf("\n----- Sending Response -------\n");
-                printf("Remote address is: ");
-                char address_buffer[100];
-                char service_buffer[100];
-                getnameinfo(((struct sockaddr*)&client_address),
-                    client_len,
-                    address_buffer, sizeof(address_buffer),
-                    service_buffer, sizeof(service_buffer),
-                    NI_NUMERICHOST | NI_NUMERICSERV);
-                printf("%s %s\n", address_buffer, service_buffer);
-                
-                // printf("Result is %d\n", result);
-                if (result != 0) {
-                    printf("Sent: CRC:%x, Packet size: %d\n", packet[packet_len - 1], packet_len);
-                    sendto(socket_listen, packet, strlen(packet), 0, (struct sockaddr*)&client_address, client_len);
-                }
-                // printf("Packet: %s\n", packet);
-                
-                if (rdt_vars.rdt == 20 || rdt_vars.rdt == 21) {
-                    printf("Packet Sent v%1.1f: Data: %s CRC: %x, size: %d\n", (float)rdt_vars.rdt/10, packet, packet[3], packet_len);
+        for (int w = 0; w < n_workers; ++w) {
+            pthread_join(workers[w].thread, NULL);
+        }
+    }
 
-                }
-                else printf("Packet Sent v%1.1f: SEQ: %x CRC: %x, size: %d\n", (float)rdt_vars.rdt/10, packet[0], packet[3], packet_len);
+    for (int w = 0; w < n_workers; ++w) {
+        status |= workers[w].status;
+    }
+    log_flush();
+    print_server_stats(workers, n_workers, start_us);
 
-                sendto(socket_listen, packet, packet_len , 0, (struct sockaddr*)&client_address, client_len);
-                printf("----- Sending Response End -------\n\n");
+    for (int w = 0; w < n_workers; ++w) {
+        worker_free(&workers[w]);
+    }
+    free(workers);
+    if (n_workers > 1) {
+        event_source_close(&stop_source);
+    }
+    event_source_close(&signal_source);
+    impair_trace_close(&trace);
 
-            } // RDT ENDS
+    printf("Finished.\n");
+    log_shutdown();
 
-            if ((rand_number() <= drop_probability) && (strncmp(teardown,read, 3) != 0) && rdt == false) {
-                printf(RED "------- Packet Dropped -------\n\n" RESET);
-                    
-            }
-            else if (gbn == true) {
+    return status;
 
-                // Check if connection teardown is received
-                if (strncmp(teardown, read, 3) == 0) {
-                    printf("\n------- Teardown received -------\n\n");
-                    break;
-                }
-                int gbn_result = gbn_process_packet(read, bytes_received, expected_seq_num);
-
-                    
-                // If packet is corrupted
-                if (gbn_result == CRC_NOK) {
-                    printf(RED "Packet Received | CRC Check: NOK\n\n" RESET);
-                    continue;
-                // If the SEQ number is not what expected, reduce one from counter.
-                } else if (gbn_result == SEQ_NOK) {
-                    --expected_seq_num;
-                    
-                // Adding received packet to Upper Layer
-                } else all_received[expected_seq_num-1] = read[1];
-
-                printf("\n----- Sending Response -------\n");
-                char gbn_packet[10] = {0};
-                int packet_len = 0;
-
-                packet_len = gbn_make_packet(gbn_packet, expected_seq_num);
-                if (packet_len == -1) {
-                    fprintf(stderr, "ERROR: Create packet failed");
-                    continue;
-                }
+} /* main() */
+
+/**
+ * @brief Creates the worker's socket, event loop and session shard.
+ *
+ * @param worker Worker with `id`, `cpu`, `state` and `stop_source` filled in.
+ * @param bind_address Address to bind the socket to.
+ * @param reuse_port Set SO_REUSEPORT, so the kernel spreads clients over the workers.
+ * @param batch_size Datagrams per system call for the epoll backend.
+ * @param use_uring Try the io_uring backend first.
+ * @param max_sessions Session limit of the worker.
+ * @return int `0` on success, `-1` on error.
+ */
+int worker_setup(server_worker_t *worker, struct addrinfo *bind_address, bool reuse_port,
+                 unsigned int batch_size, bool use_uring, uint32_t max_sessions)
+{
+    server_io_t *io = &worker->io;
+
+    if (session_table_init(&worker->state.sessions, 1024, max_sessions) < 0) {
+        fprintf(stderr, "session_table_init() failed. (%d)\n", GETSOCKETERRNO());
+        return -1;
+    }
+
+    // A full window of the largest frames fits in the receive buffer, RDT keeps the default.
+    // The kernel charges about twice the frame for a queued datagram.
+    int rcvbuf = 0;
+    if (worker->state.rdt == false) {
+        uint64_t window_bytes = (uint64_t)worker->state.max_window * CODEC_FRAME_MAX * 2;
+        rcvbuf = (window_bytes > MAX_SOCKET_BUFFER) ? MAX_SOCKET_BUFFER : (int)window_bytes;
+    }
+    io->socket = configure_socket(bind_address, reuse_port, rcvbuf);
+    if (!ISVALIDSOCKET(io->socket)) {
+        return -1;
+    }
 
-                printf("Remote address is: ");
-                char address_buffer[100];
-                char service_buffer[100];
-                getnameinfo(((struct sockaddr*)&client_address),
-                    client_len,
-                    address_buffer, sizeof(address_buffer),
-                    service_buffer, sizeof(service_buffer),
-                    NI_NUMERICHOST | NI_NUMERICSERV);
-                printf("%s %s\n", address_buffer, service_buffer);
-
-                printf("Sending response: %d%s\n",gbn_packet[0], &gbn_packet[1]); 
-                sendto(socket_listen, gbn_packet, packet_len, 0, (struct sockaddr*) &client_address, client_len);
-                expected_seq_num++;
-                printf("----- Sending Response End -------\n\n");
+    // Sockets, timers and signals are all watched by the same event loop
+    if (event_loop_init(&worker->loop) < 0) {
+        fprintf(stderr, "epoll_create1() failed. (%d)\n", GETSOCKETERRNO());
+        return -1;
+    }
+
+    delay_queue_init(&worker->state.delayed, DELAY_QUEUE_MAX);
+    timer_wheel_init(&worker->state.timers, event_loop_now_us());
+    timer_wheel_init(&worker->state.ack_timers, event_loop_now_us());
+
+    worker->listen_source = (event_source_t){ io->socket, EVENT_SOCKET, worker };
+    if (event_timer_init(&worker->timer_source, worker) < 0 ||
+        event_timer_init(&worker->delay_source, worker) < 0 ||
+        event_loop_add(&worker->loop, &worker->delay_source) < 0 ||
+        event_loop_add(&worker->loop, worker->stop_source) < 0 ||
+        event_loop_add(&worker->loop, &worker->timer_source) < 0) {
+        fprintf(stderr, "Event loop setup failed. (%d)\n", GETSOCKETERRNO());
+        return -1;
+    }
+
+    worker->batch_size = batch_size;
+    worker->use_uring = use_uring;
+
+    return 0;
+} /* worker_setup() */
+
+/**
+ * @brief Starts the worker's I/O backend.
+ *
+ * Runs on the worker's own thread, because an io_uring ring only accepts
+ * submissions from the thread that created it.
+ *
+ * @return int `0` on success, `-1` on error.
+ */
+int worker_io_init(server_worker_t *worker)
+{
+    server_io_t *io = &worker->io;
+    unsigned int batch_size = worker->batch_size;
+
+    // The io_uring backend watches the event loop itself, so signals and timers still work
+    if (worker->use_uring) {
+        if (uring_io_init(&io->uring, io->socket, worker->loop.epfd) == 0) {
+            io->use_uring = true;
+            if (worker->id == 0) {
+                printf("I/O backend: io_uring (multishot recvmsg, %d provided buffers)\n", URING_IO_BUFFERS);
             }
+        }
+        else {
+            printf("io_uring not available (%s), falling back to epoll\n", strerror(GETSOCKETERRNO()));
+        }
+    }
+    if (!io->use_uring) {
+        if (io_batch_init(&io->batch, batch_size) < 0) {
+            fprintf(stderr, "io_batch_init() failed. (%d)\n", GETSOCKETERRNO());
+            return -1;
+        }
+        if (event_loop_add(&worker->loop, &worker->listen_source) < 0) {
+            fprintf(stderr, "Event loop setup failed. (%d)\n", GETSOCKETERRNO());
+            return -1;
+        }
+        if (batch_size > 1 && worker->id == 0) {
+            printf("Batched I/O: up to %u datagrams per system call\n", batch_size);
+        }
+    }
 
-            /* Selective Repeat Server Part */
-            else if (sr == true) {
+    return 0;
+} /* worker_io_init() */
 
-                // Check if connection teardown is received
-                if (strncmp(teardown, read, 3) == 0) {
-                    printf("\n------- Teardown received -------\n\n");
+/**
+ * @brief Event loop of one worker.
+ *
+ * Every worker owns its socket, event loop and session shard, so nothing
+ * is shared between the workers while they run.
+ *
+ * @param arg The server_worker_t of the worker.
+ * @return void* Always NULL, errors are reported in `status` and stop the other workers.
+ */
+void *worker_run(void *arg)
+{
+    server_worker_t *worker = arg;
+    server_state_t *state = &worker->state;
+    server_io_t *io = &worker->io;
+
+    if (worker->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker->cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            LOG_WARN("Worker %d: pinning to CPU %d failed\n", worker->id, worker->cpu);
+        }
+    }
+
+    if (worker_io_init(worker) < 0) {
+        worker->status = 1;
+        worker_stop_all(worker);
+        return NULL;
+    }
+
+    // Every worker draws its own stream, the same seed repeats every worker's decisions
+    rand_seed(state->seed, worker->id);
+
+    worker->start_us = event_loop_now_us();
+    bool running = true;
+    while (running) {
+        event_source_t *ready[EVENT_LOOP_MAX_EVENTS];
+        int n_ready = 0;
+
+        state->now_us = event_loop_now_us();
+
+        if (io->use_uring) {
+            // Submits the queued ACKs and waits for completions with one system call
+            if (uring_io_wait(&io->uring) < 0) {
+                LOG_ERROR("io_uring_enter() failed. (%d)\n", GETSOCKETERRNO());
+                worker->status = 1;
+                break;
+            }
+
+            uring_io_event_t event;
+            while (uring_io_next(&io->uring, &event) != URING_EVENT_NONE) {
+                if (event.type == URING_EVENT_POLL) {
+                    // The event loop has something ready, collect it without blocking
+                    n_ready = event_loop_wait(&worker->loop, ready, EVENT_LOOP_MAX_EVENTS, 0);
                     break;
                 }
-                int sr_result = sr_process_packet(read, bytes_received);
+                handle_datagram(state, event.data, event.len, event.addr, event.addr_len, io, false);
+            }
+        }
+        else {
+            n_ready = event_loop_wait(&worker->loop, ready, EVENT_LOOP_MAX_EVENTS, -1);
+        }
 
-                // If the Packet is corrupted
-                if (sr_result == NAK) {
-                    printf(RED "Packet Received | CRC Check: NOK\n\n" RESET);
-                    continue;
-                }
-                
-                char sr_packet[10] = {0};
-                int packet_len = 0;
-                
-                // Checking that the Received packet is within the Receiving Window
-                if (sr_result >= rcv_base && sr_result < rcv_base + WINDOW_SIZE) {
-                    
-                    if(sr_receive_buffer.received[sr_result] == false) {
-                        sr_receive_buffer.received[sr_result] = true;
-                        sr_receive_buffer.data[sr_result] = read[1];
-
-                        if (sr_result == rcv_base) {
-                            rcv_base = deliver_data(sr_receive_buffer, all_received, rcv_base);
-                            
-                        }
-                    }
-                    packet_len = sr_make_packet(sr_packet, sr_result);
-                } 
-                else if (sr_result >= rcv_base - WINDOW_SIZE && sr_result < rcv_base) {
-
-                    // Packet is already received, but sending ACK anyway
-                    packet_len = sr_make_packet(sr_packet, sr_result);
+        if (n_ready < 0) {
+            LOG_ERROR("epoll_wait() failed. (%d)\n", GETSOCKETERRNO());
+            worker->status = 1;
+            break;
+        }
+
+        for (int r = 0; r < n_ready && running; ++r) {
+            // Shutdown requested with SIGINT or SIGTERM, or by the main thread
+            if (ready[r] == worker->stop_source) {
+                if (worker->stop_source->type == EVENT_SIGNAL) {
+                    LOG_INFO("\n------- Signal %d received, shutting down -------\n\n", event_signal_read(worker->stop_source));
                 }
-                else {
-                    // Packet out of range, ignoring
-                    printf("Packet %d out of range, ignore\n", sr_result);
-                    printf("Current rcvbase: %d\n", rcv_base);
-                    continue;
+                running = false;
+                break;
+            }
+
+            // Send the delayed ACKs and evict the sessions of clients that went away without a teardown
+            if (ready[r] == &worker->timer_source) {
+                event_timer_read(&worker->timer_source);
+                worker->timer_armed_us = 0;
+                state->now_us = event_loop_now_us();
+                if (timer_wheel_advance(&state->ack_timers, state->now_us, send_delayed_ack, worker) > 0 &&
+                    !io->use_uring) {
+                    io_batch_flush(&io->batch, io->socket);
                 }
+                timer_wheel_advance(&state->timers, state->now_us, evict_session, state);
+                continue;
+            }
 
-                printf("\n----- Sending Response -------\n");
+            // Delayed datagrams whose deadline has passed
+            if (ready[r] == &worker->delay_source) {
+                event_timer_read(&worker->delay_source);
+                worker->delay_armed_us = 0;
+                worker_release_delayed(worker);
+                continue;
+            }
 
-                if (packet_len == -1) {
-                    fprintf(stderr, "ERROR: Create packet failed");
-                    continue;
-                }
+            if (ready[r] != &worker->listen_source) {
+                continue;
+            }
+
+            // Drain the pending datagrams, up to one batch per wakeup
+            int received = io_batch_recv(&io->batch, io->socket);
+            if (received < 0) {
+                LOG_ERROR("connection closed. (%d)\n", GETSOCKETERRNO());
+                worker->status = 1;
+                running = false;
+                break;
+            }
+
+            for (int i = 0; i < received; ++i) {
+                socklen_t client_len = 0;
+                struct sockaddr *client_address = io_batch_addr(&io->batch, i, &client_len);
+
+                handle_datagram(state, io_batch_data(&io->batch, i), io_batch_len(&io->batch, i),
+                                client_address, client_len, io, false);
+            }
+
+            // All ACKs of the batch leave with one system call
+            io_batch_flush(&io->batch, io->socket);
+        }
+
+        worker_arm_timers(worker);
+    }
+
+    if (io->use_uring) {
+        uring_io_submit(&io->uring);
+    }
+
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    worker->cpu_s = cpu.tv_sec + cpu.tv_nsec / 1e9;
+    worker->stop_us = event_loop_now_us();
+    worker_stop_all(worker);
+
+    return NULL;
+} /* worker_run() */
+
+/**
+ * @brief Stops the other workers and wakes the main thread after a worker failed.
+ *
+ * The socket of a failed worker stays bound and the kernel would keep
+ * sending it clients, so the whole process shuts down with an error.
+ */
+void worker_stop_all(server_worker_t *worker)
+{
+    if (worker->status != 0 && worker->stop_source->type == EVENT_NOTIFY) {
+        event_notify_signal(worker->stop_source);
+    }
+} /* worker_stop_all() */
+
+/**
+ * @brief Processes every delayed datagram whose release time has passed.
+ */
+void worker_release_delayed(server_worker_t *worker)
+{
+    server_state_t *state = &worker->state;
+    delay_entry_t *entry = NULL;
+
+    state->now_us = event_loop_now_us();
+    while ((entry = delay_queue_peek(&state->delayed)) && entry->release_us <= state->now_us) {
+        handle_datagram(state, entry->data, entry->len, (struct sockaddr *)&entry->address,
+                        entry->address_len, &worker->io, true);
+        delay_queue_pop(&state->delayed);
+    }
+
+    if (!worker->io.use_uring) {
+        io_batch_flush(&worker->io.batch, worker->io.socket);
+    }
+} /* worker_release_delayed() */
+
+/**
+ * @brief Arms the delay and session timers for their earliest deadlines.
+ */
+void worker_arm_timers(server_worker_t *worker)
+{
+    uint64_t idle_us = timer_wheel_next_us(&worker->state.timers);
+    uint64_t ack_us = timer_wheel_next_us(&worker->state.ack_timers);
+
+    event_timer_arm_at(&worker->delay_source, &worker->delay_armed_us, delay_queue_next_us(&worker->state.delayed));
+    event_timer_arm_at(&worker->timer_source, &worker->timer_armed_us, (ack_us < idle_us) ? ack_us : idle_us);
+} /* worker_arm_timers() */
 
-                printf("Remote address is: ");
-                char address_buffer[100];
-                char service_buffer[100];
-                getnameinfo(((struct sockaddr*)&client_address),
-                    client_len,
-                    address_buffer, sizeof(address_buffer),
-                    service_buffer, sizeof(service_buffer),
-                    NI_NUMERICHOST | NI_NUMERICSERV);
-                printf("%s %s\n", address_buffer, service_buffer);
+/**
+ * @brief Releases the worker's I/O backend, sessions, timers and socket.
+ */
+void worker_free(server_worker_t *worker)
+{
+    if (worker->io.use_uring) {
+        uring_io_free(&worker->io.uring);
+    }
+    else {
+        io_batch_free(&worker->io.batch);
+    }
+    session_table_free(&worker->state.sessions);
+    delay_queue_free(&worker->state.delayed);
+    event_source_close(&worker->delay_source);
+    event_source_close(&worker->timer_source);
+    event_loop_close(&worker->loop);
+    if (ISVALIDSOCKET(worker->io.socket)) {
+        CLOSESOCKET(worker->io.socket);
+    }
+} /* worker_free() */
+
+/**
+ * @brief Queues a reply on the active I/O backend.
+ *
+ * @param io I/O backend.
+ * @param packet Reply to send.
+ * @param len Length of the reply.
+ * @param address Destination address.
+ * @param address_len Length of the destination address.
+ * @return int `0` on success, `-1` on error.
+ */
+int queue_reply(server_io_t *io, const char *packet, size_t len,
+                const struct sockaddr *address, socklen_t address_len)
+{
+    if (io->use_uring) {
+        return uring_io_queue(&io->uring, packet, len, address, address_len);
+    }
+    return io_batch_queue(&io->batch, io->socket, packet, len, address, address_len);
+} /* queue_reply() */
+
+/**
+ * @brief Prints the packet rate, the sessions and the I/O backend counters.
+ *
+ * The packet rate is given per CPU second used by the process, which is
+ * the packets/sec one core can handle with the selected backend. With
+ * several workers every worker's own rate is printed first.
+ *
+ * @param workers The workers.
+ * @param n_workers Number of workers.
+ * @param start_us Time when the server started waiting for packets.
+ */
+void print_server_stats(const server_worker_t *workers, int n_workers, uint64_t start_us)
+{
+    unsigned long packets = 0;
+    unsigned long data_packets = 0, acks = 0, delayed_acks = 0;
+    unsigned long created = 0, removed = 0, evicted = 0, rejected = 0;
+    uint32_t active = 0;
+
+    for (int w = 0; w < n_workers; ++w) {
+        const server_worker_t *worker = &workers[w];
+        const session_table_t *sessions = &worker->state.sessions;
+        double worker_s = (worker->stop_us - worker->start_us) / 1e6;
+
+        packets += worker->state.packets;
+        data_packets += worker->state.data_packets;
+        acks += worker->state.acks;
+        delayed_acks += worker->state.delayed_acks;
+        active += sessions->count;
+        created += sessions->created;
+        removed += sessions->removed;
+        evicted += sessions->evicted;
+        rejected += sessions->rejected;
+
+        if (n_workers > 1) {
+            // An unpinned worker has no CPU of its own
+            char cpu_name[16] = "unpinned";
+            if (worker->cpu >= 0) {
+                snprintf(cpu_name, sizeof(cpu_name), "CPU %d", worker->cpu);
+            }
+            printf("Worker %d (%s): %lu packets | %.0f packets/s | CPU: %.2f s | %.0f packets/s per core | %lu sessions\n",
+                    worker->id, cpu_name, worker->state.packets,
+                    worker_s > 0 ? worker->state.packets / worker_s : 0.0, worker->cpu_s,
+                    worker->cpu_s > 0 ? worker->state.packets / worker->cpu_s : 0.0, sessions->created);
+        }
+        print_io_stats(&worker->io);
+        if (worker->state.delayed.delayed > 0) {
+            printf("Delay queue: %lu delayed | %lu released | %u waiting | %lu overflows | max depth %u\n",
+                    worker->state.delayed.delayed, worker->state.delayed.released, worker->state.delayed.count,
+                    worker->state.delayed.overflows, worker->state.delayed.max_depth);
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double wall_s = (event_loop_now_us() - start_us) / 1e6;
+    double cpu_s = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                   (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+
+    printf("Server: %lu packets | Wall: %.2f s | CPU: %.2f s | %.0f packets/s per core\n",
+            packets, wall_s, cpu_s, cpu_s > 0 ? packets / cpu_s : 0.0);
+    if (data_packets > 0) {
+        printf("ACKs: %lu for %lu data packets | %.2f per data packet | %lu sent by the delay timer\n",
+                acks, data_packets, (double)acks / data_packets, delayed_acks);
+    }
+    printf("Sessions: %u active | %lu created | %lu torn down | %lu evicted | %lu rejected\n",
+            active, created, removed, evicted, rejected);
+    if (log_dropped() > 0) {
+        printf("Log: %lu messages dropped because the ring was full\n", log_dropped());
+    }
+} /* print_server_stats() */
+
+/**
+ * @brief Prints the counters of a worker's I/O backend.
+ */
+void print_io_stats(const server_io_t *io)
+{
+    if (io->use_uring) {
+        printf("io_uring: %lu datagrams in %lu waits | %lu ACKs completed | %lu overruns | %lu receive re-arms\n",
+                io->uring.rx_datagrams, io->uring.waits, io->uring.tx_datagrams,
+                io->uring.tx_overruns, io->uring.rx_rearms);
+    }
+    else if (io->batch.size > 1) {
+        printf("Batched I/O: %lu datagrams in %lu receive calls | Average batch occupancy: %.2f/%u (%.1f%%) | %lu ACKs in %lu send calls\n",
+                io->batch.rx_datagrams, io->batch.rx_calls, io_batch_occupancy(&io->batch), io->batch.size,
+                100.0 * io_batch_occupancy(&io->batch) / io->batch.size, io->batch.tx_datagrams, io->batch.tx_calls);
+    }
+} /* print_io_stats() */
+
+/**
+ * @brief Handles one received datagram in the selected server mode.
+ *
+ * Runs the datagram through the RDT, Go-Back-N or Selective Repeat receiver
+ * and queues the resulting ACK/NAK on the I/O backend. The replies are
+ * sent when the batch is flushed or the ring is submitted.
+ *
+ * @param state Protocol state of the server.
+ * @param read Received datagram.
+ * @param bytes_received Length of the received datagram.
+ * @param client_address Address of the sender.
+ * @param client_len Length of the sender address.
+ * @param io I/O backend where the replies are queued.
+ * @param released True if the datagram comes from the delay queue and the
+ *                 drop and delay impairments were already applied.
+ *
+ * @return `DATAGRAM_TEARDOWN` if the connection teardown was received,
+ *         `DATAGRAM_DELAYED` if the datagram was parked in the delay queue,
+ *         otherwise `DATAGRAM_HANDLED`.
+ */
+int handle_datagram(server_state_t *state, char *read, long bytes_received,
+                    struct sockaddr *client_address, socklen_t client_len,
+                    server_io_t *io, bool released)
+{
+    if (bytes_received < 1) {
+        return DATAGRAM_HANDLED;
+    }
+    if (!released) {
+        state->packets++;
+    }
+
+    // Every client has its own receiver state
+    bool created = false;
+    session_t *session = session_get(&state->sessions, client_address, client_len, &created);
+    if (!session) {
+        LOG_DEBUG(RED "------- No session for client, packet ignored -------\n\n" RESET);
+        return DATAGRAM_HANDLED;
+    }
+    if (created) {
+        session->rdt_vars = state->rdt_vars;
+        session->expected_seq_num = 1;
+        session->rcv_base = 1;
+        session->codec.window = CODEC_DEFAULT_WINDOW;
+        timer_wheel_add(&state->timers, &session->idle_timer, state->now_us + state->idle_timeout_us);
+        LOG_INFO("------- New session (%u active) -------\n", state->sessions.count);
+        print_peer(LOG_LEVEL_INFO, client_address, client_len);
+    }
+    session->last_seen_us = state->now_us;
+    if (!released) {
+        session->packets++;
+    }
 
-                printf("Sending response: %d%s\n",sr_packet[0], &sr_packet[1]); 
-                sendto(socket_listen, sr_packet, packet_len, 0, (struct sockaddr*) &client_address, client_len);
-                last_seq = sr_result;
-                printf("----- Sending Response End -------\n\n");
+    bool is_teardown = codec_is_fin(&session->codec, read, bytes_received);
 
+    /* VIRTUAL SOCKET BEGINS */
+    if (state->rdt == true) {
+        Rdt_variables *rdt_vars = &session->rdt_vars;
+        crc result = true;
 
+        // Delayed packets wait in the delay queue while other packets are served
+        uint64_t delay_us = 0;
+        int impairment = released ? RDT_PASS : rdt_impair(rdt_vars, read, bytes_received, &delay_us);
+        if (impairment == RDT_DELAY &&
+            delay_queue_push(&state->delayed, state->now_us + delay_us,
+                             read, bytes_received, client_address, client_len) == 0) {
+            return DATAGRAM_DELAYED;
+        }
+        
+        LOG_DEBUG("----- Packet Receive Start -------\n");
+
+        // Doing the CRC check for the packet, a dropped packet is answered as corrupted
+        if (impairment != RDT_DROP) {
+            result = process_packet (read, bytes_received, rdt_vars);
+        }
+
+        // The payload is only copied out when somebody reads it
+        if (LOG_ENABLED(LOG_LEVEL_DEBUG)) {
+            char recv_data[LOG_TEXT_SIZE / 2] = {0};
+            long data_len = bytes_received - 1;
+            if (data_len > (long)sizeof(recv_data) - 1) {
+                data_len = sizeof(recv_data) - 1;
             }
+            memcpy(recv_data, &read[1], data_len);
+
+            char *crc_result = (result == 0) ? "OK" : "NOK";
+            LOG_DEBUG("Packet received: SEQ %d | Data: %s | Bytes: %ld | CRC Check: %s\n", rdt_vars->seq, recv_data, bytes_received, crc_result); 
+        }
+        LOG_DEBUG("----- Packet Receive End -------\n");
+        
+        char packet[8];
+        memset(packet, 0, sizeof(packet));
+        int packet_len = 0;
+
+        // If RDT 1.0, no ACK/NAK 
+        if (rdt_vars->rdt == 10) {
+            LOG_DEBUG("RDT Version: %d | No ACK\n", rdt_vars->rdt);
+            return DATAGRAM_HANDLED;
+        }
+
+        packet_len = make_packet(packet, rdt_vars->rdt, rdt_vars->seq, result);
+        
+        // If packet creation fails, print error but continue
+        if (packet_len < 1) {
+        LOG_ERROR("Error creating packet!\n");
+            return DATAGRAM_HANDLED;
+        }
+        
+        LOG_DEBUG("\n----- Sending Response -------\n");
+        print_peer(LOG_LEVEL_DEBUG, client_address, client_len);
+        
+        // printf("Result is %d\n", result);
+        if (result != 0) {
+            LOG_DEBUG("Sent: CRC:%x, Packet size: %d\n", packet[packet_len - 1], packet_len);
+            queue_reply(io, packet, strlen(packet), client_address, client_len);
+        }
+        // printf("Packet: %s\n", packet);
+        
+        if (rdt_vars->rdt == 20 || rdt_vars->rdt == 21) {
+            LOG_DEBUG("Packet Sent v%1.1f: Data: %s CRC: %x, size: %d\n", (float)rdt_vars->rdt/10, packet, packet[3], packet_len);
+
+        }
+        else LOG_DEBUG("Packet Sent v%1.1f: SEQ: %x CRC: %x, size: %d\n", (float)rdt_vars->rdt/10, packet[0], packet[3], packet_len);
+
+        queue_reply(io, packet, packet_len, client_address, client_len);
+        LOG_DEBUG("----- Sending Response End -------\n\n");
+
+    } // RDT ENDS
+
+    // A trace replays drops, bit errors and delays for GBN and SR too, the probabilities only drop
+    int impairment = RDT_PASS;
+    if (session->rdt_vars.trace && state->rdt == false && !released && !is_teardown) {
+        uint64_t delay_us = 0;
+        impairment = rdt_impair(&session->rdt_vars, read, bytes_received, &delay_us);
+        if (impairment == RDT_DELAY &&
+            delay_queue_push(&state->delayed, state->now_us + delay_us,
+                             read, bytes_received, client_address, client_len) == 0) {
+            return DATAGRAM_DELAYED;
+        }
+    }
+
+    if (impairment == RDT_DROP || (state->drop_probability > 0 && !session->rdt_vars.trace && !is_teardown &&
+                                   state->rdt == false && rand_number() <= state->drop_probability)) {
+        LOG_DEBUG(RED "------- Packet Dropped -------\n\n" RESET);
             
+    }
+    else if (state->rdt == false && (uint8_t)read[0] == CODEC_HELLO_SEQ &&
+             handle_hello(state, session, read, bytes_received, io)) {
+        return DATAGRAM_HANDLED;
+    }
+    else if (state->gbn == true) {
+
+        // Check if connection teardown is received
+        if (is_teardown) {
+            LOG_INFO("\n------- Teardown received -------\n\n");
+            print_session_data(session);
+            timer_wheel_cancel(&state->timers, &session->idle_timer);
+            timer_wheel_cancel(&state->ack_timers, &session->ack_timer);
+            session_remove(&state->sessions, session);
+            return DATAGRAM_TEARDOWN;
         }
+        codec_frame_t frame;
+        int gbn_result = gbn_process_packet(read, bytes_received, session->expected_seq_num, &session->codec, &frame);
+
+            
+        // A frame larger than the negotiated payload is not ACKed, in order or not, its data would depend on the arrival order
+        if (gbn_result != CRC_NOK && frame.len > session_max_payload(session)) {
+            LOG_DEBUG(RED "Packet %u discarded | %u bytes over the %u byte payload\n\n" RESET,
+                      frame.seq, frame.len, session_max_payload(session));
+            return DATAGRAM_HANDLED;
+        }
+
+        // A corrupted packet or an unexpected SEQ repeats the last ACK, the duplicates trigger a fast retransmit
+        uint32_t expected_seq_num = session->expected_seq_num;
+        bool in_order = false;
+        if (gbn_result == CRC_NOK) {
+            LOG_DEBUG(RED "Packet Received | CRC Check: NOK\n\n" RESET);
+            frame.seq = expected_seq_num - 1;
+        // With SACK the packets after a gap are kept and reported, the client only resends the holes
+        } else if (session->codec.features & CODEC_FEATURE_SACK) {
+            in_order = receive_selective(session, &session->expected_seq_num, &frame) == 1 &&
+                       frame.seq == expected_seq_num && session->sr_receive_buffer.count == 0;
+        // Adding received packet to Upper Layer
+        } else if (gbn_result == OK) {
+            codec_stream_append(&session->received, frame.payload, frame.len);
+            session->expected_seq_num++;
+            in_order = true;
+        }
+
+        // Cumulative ACK of the last packet received in order, held back while packets arrive in order
+        reply_data(state, session, io, frame.seq, in_order);
     }
-    // TODO: This might not work for GBN
-    // Adding NULL to terminate the received data. Size of data depends on the mode (GBN or SR)
-    if (gbn == true) {
-        last_seq = expected_seq_num;
 
+    /* Selective Repeat Server Part */
+    else if (state->sr == true) {
+
+        // Check if connection teardown is received
+        if (is_teardown) {
+            LOG_INFO("\n------- Teardown received -------\n\n");
+            print_session_data(session);
+            timer_wheel_cancel(&state->timers, &session->idle_timer);
+            timer_wheel_cancel(&state->ack_timers, &session->ack_timer);
+            session_remove(&state->sessions, session);
+            return DATAGRAM_TEARDOWN;
+        }
+        codec_frame_t frame;
+        uint32_t rcv_base = session->rcv_base;
+        int sr_result = sr_process_packet(read, bytes_received, &session->codec, rcv_base, &frame);
+
+        char sr_packet[CODEC_ACK_MAX];
+        int packet_len = 0;
+
+        // The SEQ of a corrupted packet cannot be trusted, the NAK asks for the oldest missing packet
+        if (sr_result == NAK) {
+            LOG_DEBUG(RED "Packet Received | CRC Check: NOK\n\n" RESET);
+            LOG_DEBUG("Sending response: NAK %u\n", rcv_base);
+            packet_len = (int)codec_make_nak(&session->codec, sr_packet, rcv_base);
+            queue_reply(io, sr_packet, packet_len, client_address, client_len);
+            state->data_packets++;
+            state->acks++;
+            return DATAGRAM_HANDLED;
+        }
+        
+        // A frame larger than the negotiated payload is not ACKed, its data would depend on the arrival order
+        uint32_t seq = frame.seq;
+        if (frame.len > session_max_payload(session)) {
+            LOG_DEBUG(RED "Packet %u discarded | %u bytes over the %u byte payload\n\n" RESET,
+                      seq, frame.len, session_max_payload(session));
+            return DATAGRAM_HANDLED;
+        }
+
+        // Packets in the window are buffered, the ones behind it were received already but are ACKed anyway
+        int received = receive_selective(session, &session->rcv_base, &frame);
+        if (received < 0) {
+            LOG_DEBUG("Packet %u out of range, ignore\n", seq);
+            LOG_DEBUG("Current rcvbase: %u\n", rcv_base);
+            return DATAGRAM_HANDLED;
+        }
+
+        // Only a cumulative SACK can answer several packets, a plain SR ACK names one
+        bool in_order = (session->codec.features & CODEC_FEATURE_SACK) && received == 1 &&
+                        seq == rcv_base && session->sr_receive_buffer.count == 0;
+        reply_data(state, session, io, seq, in_order);
+    }
+
+    return DATAGRAM_HANDLED;
+
+} /* handle_datagram() */
+
+/**
+ * @brief Receives a data packet into the selective receive window of a session.
+ *
+ * In order packets go straight from the datagram to the upper layer,
+ * followed by the ones buffered behind them. Packets after a gap are
+ * buffered until the gap is filled.
+ *
+ * @param session Session of the client.
+ * @param base Receive base of the session, moved over the delivered packets.
+ * @param frame The data packet.
+ *
+ * @return `1` if the packet is in the window, `0` if it is behind the window
+ *         and was delivered before, `-1` if it is out of range or could not
+ *         be buffered.
+ */
+int receive_selective(session_t *session, uint32_t *base, const codec_frame_t *frame)
+{
+    uint32_t seq = frame->seq;
+    uint32_t window = session->codec.window;
+
+    if (seq_lt(seq, *base)) {
+        return seq_geq(seq, *base - window) ? 0 : -1;
     }
-    else if (sr == true) {
-        last_seq = rcv_base; 
+    if (!seq_lt(seq, *base + window)) {
+        return -1;
     }
-    all_received[last_seq] = '\0';
-    printf("Received data: %s\n", all_received);
 
-    printf("Finished.\n");
+    sr_receive_buffer_t *buffer = &session->sr_receive_buffer;
+    if (seq == *base) {
+        codec_stream_append(&session->received, frame->payload, frame->len);
+        *base = deliver_data(buffer, &session->received, *base + 1);
+    }
+    else if (!sr_buffer_has(buffer, seq)) {
+        // The ring is allocated when the first packet arrives out of order
+        if (!buffer->data && sr_buffer_init(buffer, sr_buffer_slots(window), session_max_payload(session)) < 0) {
+            LOG_ERROR("ERROR: Receive buffer allocation failed\n");
+            return -1;
+        }
+        if (sr_buffer_store(buffer, seq, frame->payload, frame->len) < 0) {
+            return -1;
+        }
+    }
+
+    return 1;
+} /* receive_selective() */
+
+/**
+ * @brief Largest data payload of a session, the negotiated one or CODEC_MAX_PAYLOAD for legacy peers.
+ */
+uint16_t session_max_payload(const session_t *session)
+{
+    return (session->codec.version == CODEC_VERSION) ? session->codec.max_payload : CODEC_MAX_PAYLOAD;
+} /* session_max_payload() */
+
+/**
+ * @brief Builds the cumulative ACK of a session with the SACK blocks of its receive buffer.
+ *
+ * @param session Session of the client.
+ * @param base First packet not received in order.
+ * @param seq Data packet that is answered.
+ * @param packet Buffer of at least CODEC_ACK_MAX bytes.
+ *
+ * @return Length of the ACK.
+ */
+int make_sack_reply(session_t *session, uint32_t base, uint32_t seq, char *packet)
+{
+    codec_sack_t blocks[CODEC_SACK_BLOCKS];
+    int n_blocks = sr_sack_blocks(&session->sr_receive_buffer, base, session->codec.window,
+                                  blocks, CODEC_SACK_BLOCKS);
+
+    return (int)codec_make_sack(&session->codec, packet, base - 1, seq, blocks, n_blocks);
+} /* make_sack_reply() */
+
+/**
+ * @brief Answers a GBN or SR data packet now or holds the ACK back.
+ *
+ * Packets received in order are answered by one ACK every `ack_every`
+ * packets, at most every half window, or when the delay timer fires.
+ * Anything else, a gap, a duplicate or a corrupted packet, is answered
+ * at once together with the held back packets, so loss is still reported
+ * by duplicate ACKs.
+ *
+ * @param state Protocol state of the server.
+ * @param session Session of the client.
+ * @param io I/O backend where the ACK is queued.
+ * @param seq Data packet that is answered.
+ * @param in_order True if the packet was delivered in order and nothing waits in the receive buffer.
+ *
+ * @return int `1` if an ACK was queued, `0` if it is held back, `-1` on error.
+ */
+int reply_data(server_state_t *state, session_t *session, server_io_t *io, uint32_t seq, bool in_order)
+{
+    uint32_t every = session->codec.window / 2;
+    if (every > state->ack_every) {
+        every = state->ack_every;
+    }
+
+    state->data_packets++;
+    session->ack_seq = seq;
+    if (in_order && ++session->ack_pending < every) {
+        if (!timer_armed(&session->ack_timer)) {
+            timer_wheel_add(&state->ack_timers, &session->ack_timer, state->now_us + state->ack_delay_us);
+        }
+        LOG_DEBUG("ACK of %u held back (%u pending)\n", seq, session->ack_pending);
+        return 0;
+    }
+
+    return (send_ack(state, session, io) < 0) ? -1 : 1;
+} /* reply_data() */
+
+/**
+ * @brief Queues the ACK of the latest data packet of a session and stops its delay timer.
+ *
+ * @param state Protocol state of the server.
+ * @param session Session of the client.
+ * @param io I/O backend where the ACK is queued.
+ *
+ * @return int `0` on success, `-1` on error.
+ */
+int send_ack(server_state_t *state, session_t *session, server_io_t *io)
+{
+    char packet[CODEC_ACK_MAX];
+    int packet_len = 0;
+    uint32_t base = state->gbn ? session->expected_seq_num : session->rcv_base;
+
+    session->ack_pending = 0;
+    timer_wheel_cancel(&state->ack_timers, &session->ack_timer);
+
+    LOG_DEBUG("\n----- Sending Response -------\n");
+    if (session->codec.features & CODEC_FEATURE_SACK) {
+        packet_len = make_sack_reply(session, base, session->ack_seq, packet);
+    }
+    else if (state->gbn) {
+        packet_len = gbn_make_packet(packet, base - 1, &session->codec);
+    }
+    else packet_len = sr_make_packet(packet, session->ack_seq, &session->codec);
+    if (packet_len == -1) {
+        LOG_ERROR("ERROR: Create packet failed");
+        return -1;
+    }
+
+    print_peer(LOG_LEVEL_DEBUG, (struct sockaddr *)&session->address, session->address_len);
+
+    LOG_DEBUG("Sending response: ACK %u\n", state->gbn ? base - 1 : session->ack_seq);
+    state->acks++;
+    queue_reply(io, packet, packet_len, (struct sockaddr *)&session->address, session->address_len);
+    LOG_DEBUG("----- Sending Response End -------\n\n");
 
     return 0;
+} /* send_ack() */
 
-} /* main() */
+/**
+ * @brief Sends the held back ACK of a session when its delay timer fires.
+ *
+ * @param timer The ACK timer of the session.
+ * @param ctx The server_worker_t of the worker.
+ */
+void send_delayed_ack(timer_node_t *timer, void *ctx)
+{
+    server_worker_t *worker = ctx;
+    session_t *session = timer_entry(timer, session_t, ack_timer);
+
+    worker->state.delayed_acks++;
+    send_ack(&worker->state, session, &worker->io);
+} /* send_delayed_ack() */
+
+/**
+ * @brief Answers a negotiation HELLO from a client.
+ *
+ * The client lists the checksums it supports and proposes the payload per
+ * frame, its connection id, the first sequence number and its window. The
+ * server picks the first checksum it allows, caps the payload and the
+ * window and uses the binary header if the client asks for it. A HELLO of a new connection starts the receive
+ * state over, a repeated HELLO of the current connection is only answered.
+ *
+ * @return true if the datagram was a HELLO, false if it is a data packet.
+ */
+bool handle_hello(server_state_t *state, session_t *session, const char *read, long bytes_received,
+                  server_io_t *io)
+{
+    uint8_t offered[CHECKSUM_TYPES];
+    codec_t offer;
+    int n_offered = codec_parse_hello(read, bytes_received, offered, CHECKSUM_TYPES, &offer);
+    if (n_offered < 0) {
+        return false;
+    }
+
+    codec_t *codec = &session->codec;
+    bool same_connection = (offer.version > 0 && codec->version == CODEC_VERSION &&
+                            offer.conn_id == codec->conn_id && offer.isn == codec->isn);
+    if (!same_connection) {
+        codec->version = (offer.version > CODEC_VERSION) ? CODEC_VERSION : offer.version;
+        codec->checksum = (uint8_t)codec_choose_checksum(offered, n_offered, state->checksums);
+        codec->max_payload = (offer.max_payload > CODEC_MAX_PAYLOAD) ? CODEC_MAX_PAYLOAD : offer.max_payload;
+        codec->conn_id = offer.conn_id;
+        codec->isn = offer.isn;
+        codec->window = (offer.window < 1) ? 1 : offer.window;
+        codec->features = (codec->version == CODEC_VERSION) ? (offer.features & CODEC_FEATURE_SACK) : 0;
+        if (codec->version == 0 || codec->window > state->max_window) {
+            codec->window = (codec->version == 0) ? CODEC_DEFAULT_WINDOW : state->max_window;
+        }
+
+        session->expected_seq_num = codec->isn;
+        session->rcv_base = codec->isn;
+        sr_buffer_free(&session->sr_receive_buffer);
+        memset(&session->received, 0, sizeof(session->received));
+        session->ack_pending = 0;
+        timer_wheel_cancel(&state->ack_timers, &session->ack_timer);
+
+        LOG_INFO("------- HELLO: version %d | connection %08x | ISN %u | checksum %s | payload %d bytes per frame | window %u%s -------\n",
+                 codec->version, codec->conn_id, codec->isn, checksum_get(codec->checksum)->name,
+                 codec->max_payload, codec->window, (codec->features & CODEC_FEATURE_SACK) ? " | SACK" : "");
+    }
+
+    char hello[CODEC_HELLO_MAX];
+    size_t len = codec_make_hello(hello, &codec->checksum, 1, codec);
+    queue_reply(io, hello, len, (struct sockaddr *)&session->address, session->address_len);
+
+    return true;
+} /* handle_hello() */
+
+/**
+ * @brief Prints the data the client's session delivered to the upper layer.
+ *
+ * @param session Session of the client.
+ */
+void print_session_data(session_t *session)
+{
+    const codec_stream_t *received = &session->received;
+
+    print_peer(LOG_LEVEL_INFO, (struct sockaddr *)&session->address, session->address_len);
+    LOG_INFO("Received %lu bytes | CRC32C %08x\n", (unsigned long)received->bytes, received->crc);
+
+    // Only the head of the data is kept, a log record holds LOG_TEXT_SIZE bytes of it
+    size_t len = (received->bytes < CODEC_STREAM_HEAD) ? received->bytes : CODEC_STREAM_HEAD;
+    const char *data = received->head;
+    size_t offset = 0;
+    do {
+        char piece[LOG_TEXT_SIZE - 2];
+        size_t n = len - offset;
+        if (n > sizeof(piece) - 1) {
+            n = sizeof(piece) - 1;
+        }
+        memcpy(piece, &data[offset], n);
+        piece[n] = '\0';
+
+        const char *end = (offset + n == len) ? "\n" : "";
+        if (offset == 0) {
+            LOG_INFO("Received data: %s%s", piece, end);
+        }
+        else {
+            LOG_INFO("%s%s", piece, end);
+        }
+        offset += n;
+    } while (offset < len);
+
+} /* print_session_data() */
+
+/**
+ * @brief Evicts a session when its idle timer fires.
+ *
+ * The timer is armed once per idle period instead of on every packet, so a
+ * session that was active meanwhile gets its timer armed again from the
+ * time of its last packet.
+ *
+ * @param timer The idle timer of the session.
+ * @param ctx The server_state_t of the worker.
+ */
+void evict_session(timer_node_t *timer, void *ctx)
+{
+    server_state_t *state = ctx;
+    session_t *session = timer_entry(timer, session_t, idle_timer);
+
+    if (state->now_us - session->last_seen_us < state->idle_timeout_us) {
+        timer_wheel_add(&state->timers, timer, session->last_seen_us + state->idle_timeout_us);
+        return;
+    }
+
+    LOG_INFO(ORANGE "------- Session idle, evicted after %lu packets -------\n" RESET, session->packets);
+    print_session_data(session);
+    timer_wheel_cancel(&state->ack_timers, &session->ack_timer);
+    session_evict(&state->sessions, session);
+
+} /* evict_session() */
+
+/**
+ * @brief Logs the numeric address and port of the peer.
+ *
+ * @param level Log level of the message.
+ * @param client_address Address of the peer.
+ * @param client_len Length of the address.
+ */
+void print_peer(int level, struct sockaddr *client_address, socklen_t client_len)
+{
+    // The address lookup is skipped entirely when the message would be filtered
+    if (!LOG_ENABLED(level)) {
+        return;
+    }
+
+    char address_buffer[100];
+    char service_buffer[100];
+    getnameinfo(client_address,
+        client_len,
+        address_buffer, sizeof(address_buffer),
+        service_buffer, sizeof(service_buffer),
+        NI_NUMERICHOST | NI_NUMERICSERV);
+    LOG_AT(level, "Remote address is: %s %s\n", address_buffer, service_buffer);
+
+} /* print_peer() */
 
 /**
  * @brief Configures and binds a socket to a local address.
  *
  * This function creates a socket using the provided address information and attempts
  * to bind it to a specified local address. If the socket creation or binding fails, 
- * an error message is printed, and the function returns a failure code.
+ * an error message is printed, and the function returns -1.
  *
  * @param[in] bind_address A pointer to a struct addrinfo containing the address
  *                         information to which the socket should be bound.
  *                         This includes the family, type, protocol, and address.
+ * @param[in] reuse_port Set SO_REUSEPORT so every worker can bind the port.
+ * @param[in] rcvbuf Receive buffer size in bytes, 0 keeps the default.
  *
  * @return A valid SOCKET if the socket is successfully created and bound,
- *         or a failure code (1) if an error occurs during socket creation or binding.
+ *         or -1 if an error occurs during socket creation or binding.
  *
  */
-SOCKET configure_socket(struct addrinfo *bind_address)
+SOCKET configure_socket(struct addrinfo *bind_address, bool reuse_port, int rcvbuf)
 {
 
     SOCKET socket_listen;
     socket_listen = socket(bind_address->ai_family, bind_address->ai_socktype, bind_address->ai_protocol);
     if(!ISVALIDSOCKET(socket_listen)) {
         fprintf(stderr, "socket() failed. (%d)\n", GETSOCKETERRNO());
-        // TODO: Cannot return 1!!
-        return 1;
+        return -1;
+    }
+
+    // Every worker binds its own socket to the same port
+    int enable = 1;
+    if (reuse_port && setsockopt(socket_listen, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable))) {
+        fprintf(stderr, "setsockopt(SO_REUSEPORT) failed. (%d)\n", GETSOCKETERRNO());
+        CLOSESOCKET(socket_listen);
+        return -1;
+    }
+
+    // The kernel caps the size at net.core.rmem_max, a smaller buffer only costs drops
+    if (rcvbuf > 0 && setsockopt(socket_listen, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf))) {
+        fprintf(stderr, "setsockopt(SO_RCVBUF) failed. (%d)\n", GETSOCKETERRNO());
     }
 
     printf("Binding socket to local address...\n");
     if (bind (socket_listen, bind_address->ai_addr, bind_address->ai_addrlen)) {
         fprintf(stderr, "bind() failed. (%d)\n", GETSOCKETERRNO());
-        return 1;
+        CLOSESOCKET(socket_listen);
+        return -1;
     }
 
     return socket_listen;
@@ -0,0 +1,448 @@
+/******************************************
+ *
+ * Filename:    uring_io.c
+ *
+ * Description: io_uring backend for the UDP server. A multishot recvmsg
+ *              is kept posted against a ring of provided buffers, so the
+ *              kernel delivers datagrams without a system call per packet.
+ *              ACKs are prepared as sendmsg requests and submitted in bulk
+ *              together with the next wait.
+ *
+ * Notes:       Uses the raw system calls, liburing is not required.
+ *              Needs Linux 6.0 or newer for multishot recvmsg.
+ *
+ * Copyright (c) 2025 Kariantti Laitala
+ * Permission tba
+ *******************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+#include "../include/uring_io.h"
+
+#define URING_TAG_RECV  1ULL
+#define URING_TAG_SEND  2ULL
+#define URING_TAG_POLL  3ULL
+#define URING_BGID      1       /* Provided buffer group used for receiving */
+
+#define URING_USER_DATA(tag, index)  (((tag) << 32) | (index))
+#define URING_USER_TAG(data)         ((data) >> 32)
+#define URING_USER_INDEX(data)       ((unsigned int)((data) & 0xffffffffULL))
+
+/**
+ * @brief A reply waiting for its sendmsg to complete.
+ */
+struct uring_tx_slot {
+    struct msghdr msg;
+    struct iovec iov;
+    struct sockaddr_storage addr;
+    char buf[URING_IO_BUF_SIZE];
+};
+
+static int sys_io_uring_setup(unsigned int entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * @brief Returns a zeroed submission entry, submitting pending ones if the ring is full.
+ */
+static struct io_uring_sqe *get_sqe(uring_io_t *uring)
+{
+    unsigned int head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned int tail = *uring->sq_tail;
+
+    if (tail - head >= uring->sq_entries) {
+        if (uring_io_submit(uring) < 0) {
+            return NULL;
+        }
+        head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head >= uring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    unsigned int index = tail & uring->sq_mask;
+    struct io_uring_sqe *sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    uring->sq_array[index] = index;
+
+    // The kernel sees the entry once the tail is published
+    __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    uring->to_submit++;
+
+    return sqe;
+} /* get_sqe() */
+
+/**
+ * @brief Posts the multishot recvmsg that selects its buffers from the provided ring.
+ */
+static int post_recv(uring_io_t *uring)
+{
+    struct io_uring_sqe *sqe = get_sqe(uring);
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = uring->sock;
+    sqe->addr = (unsigned long)&uring->recv_msg;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->user_data = URING_USER_DATA(URING_TAG_RECV, 0);
+
+    return 0;
+} /* post_recv() */
+
+/**
+ * @brief Posts a multishot poll for the watched descriptor.
+ */
+static int post_poll(uring_io_t *uring)
+{
+    struct io_uring_sqe *sqe = get_sqe(uring);
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = uring->poll_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = URING_USER_DATA(URING_TAG_POLL, 0);
+
+    return 0;
+} /* post_poll() */
+
+/**
+ * @brief Hands a receive buffer back to the kernel.
+ */
+static void recycle_buffer(uring_io_t *uring, unsigned int bid)
+{
+    unsigned short tail = uring->buf_ring->tail;
+    struct io_uring_buf *buf = &uring->buf_ring->bufs[tail & (URING_IO_BUFFERS - 1)];
+
+    buf->addr = (unsigned long)(uring->buffers + (size_t)bid * URING_IO_BUF_SIZE);
+    buf->len = URING_IO_BUF_SIZE;
+    buf->bid = bid;
+
+    __atomic_store_n(&uring->buf_ring->tail, tail + 1, __ATOMIC_RELEASE);
+} /* recycle_buffer() */
+
+int uring_io_init(uring_io_t *uring, int sock, int poll_fd)
+{
+    struct io_uring_params params;
+
+    memset(uring, 0, sizeof(*uring));
+    uring->ring_fd = -1;
+    uring->sock = sock;
+    uring->poll_fd = poll_fd;
+    uring->pending_bid = -1;
+
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    uring->ring_fd = sys_io_uring_setup(URING_IO_ENTRIES, &params);
+    if (uring->ring_fd < 0 && errno == EINVAL) {
+        // Older kernels do not know the optimization flags
+        memset(&params, 0, sizeof(params));
+        uring->ring_fd = sys_io_uring_setup(URING_IO_ENTRIES, &params);
+    }
+    if (uring->ring_fd < 0) {
+        return -1;
+    }
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        errno = ENOTSUP;
+        goto fail;
+    }
+
+    // Submission and completion rings share one mapping
+    size_t cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    uring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    if (cq_ring_size > uring->sq_ring_size) {
+        uring->sq_ring_size = cq_ring_size;
+    }
+
+    uring->sq_ring = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING);
+    if (uring->sq_ring == MAP_FAILED) {
+        uring->sq_ring = NULL;
+        goto fail;
+    }
+
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQES);
+    if (uring->sqes == MAP_FAILED) {
+        uring->sqes = NULL;
+        goto fail;
+    }
+
+    char *sq = uring->sq_ring;
+    char *cq = uring->sq_ring;
+    uring->sq_head = (unsigned int *)(sq + params.sq_off.head);
+    uring->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+    uring->sq_mask = *(unsigned int *)(sq + params.sq_off.ring_mask);
+    uring->sq_entries = *(unsigned int *)(sq + params.sq_off.ring_entries);
+    uring->sq_array = (unsigned int *)(sq + params.sq_off.array);
+    uring->cq_head = (unsigned int *)(cq + params.cq_off.head);
+    uring->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    uring->cq_mask = *(unsigned int *)(cq + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // Provided buffer ring, shared with the kernel and registered once
+    uring->buf_ring = mmap(NULL, URING_IO_BUFFERS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uring->buffers = malloc((size_t)URING_IO_BUFFERS * URING_IO_BUF_SIZE);
+    uring->tx_slots = calloc(URING_IO_TX_SLOTS, sizeof(*uring->tx_slots));
+    uring->tx_free = calloc(URING_IO_TX_SLOTS, sizeof(*uring->tx_free));
+    if (uring->buf_ring == MAP_FAILED || !uring->buffers || !uring->tx_slots || !uring->tx_free) {
+        if (uring->buf_ring == MAP_FAILED) {
+            uring->buf_ring = NULL;
+        }
+        errno = ENOMEM;
+        goto fail;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long)uring->buf_ring;
+    reg.ring_entries = URING_IO_BUFFERS;
+    reg.bgid = URING_BGID;
+    if (sys_io_uring_register(uring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        goto fail;
+    }
+
+    uring->buf_ring->tail = 0;
+    for (unsigned int bid = 0; bid < URING_IO_BUFFERS; ++bid) {
+        recycle_buffer(uring, bid);
+    }
+
+    for (unsigned int i = 0; i < URING_IO_TX_SLOTS; ++i) {
+        struct uring_tx_slot *slot = &uring->tx_slots[i];
+        slot->iov.iov_base = slot->buf;
+        slot->msg.msg_iov = &slot->iov;
+        slot->msg.msg_iovlen = 1;
+        slot->msg.msg_name = &slot->addr;
+        uring->tx_free[i] = i;
+    }
+    uring->tx_free_count = URING_IO_TX_SLOTS;
+
+    // Every received buffer starts with the peer address, no control data is used
+    uring->recv_msg.msg_namelen = sizeof(struct sockaddr_storage);
+    uring->recv_msg.msg_controllen = 0;
+
+    if (post_recv(uring) < 0 || (poll_fd >= 0 && post_poll(uring) < 0) || uring_io_submit(uring) < 0) {
+        goto fail;
+    }
+
+    // A kernel without multishot recvmsg fails the request right away
+    unsigned int head = *uring->cq_head;
+    while (head != __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &uring->cqes[head & uring->cq_mask];
+        if (cqe->res < 0 && !(cqe->flags & IORING_CQE_F_MORE)) {
+            errno = -cqe->res;
+            goto fail;
+        }
+        head++;
+    }
+
+    return 0;
+
+fail:
+    {
+        int saved_errno = errno;
+        uring_io_free(uring);
+        errno = saved_errno;
+    }
+    return -1;
+} /* uring_io_init() */
+
+void uring_io_free(uring_io_t *uring)
+{
+    // Closing the ring cancels the outstanding requests
+    if (uring->ring_fd >= 0) {
+        close(uring->ring_fd);
+    }
+    if (uring->sq_ring) {
+        munmap(uring->sq_ring, uring->sq_ring_size);
+    }
+    if (uring->sqes) {
+        munmap(uring->sqes, uring->sqes_size);
+    }
+    if (uring->buf_ring) {
+        munmap(uring->buf_ring, URING_IO_BUFFERS * sizeof(struct io_uring_buf));
+    }
+    free(uring->buffers);
+    free(uring->tx_slots);
+    free(uring->tx_free);
+
+    memset(uring, 0, sizeof(*uring));
+    uring->ring_fd = -1;
+} /* uring_io_free() */
+
+int uring_io_submit(uring_io_t *uring)
+{
+    if (uring->to_submit == 0) {
+        return 0;
+    }
+
+    int submitted = sys_io_uring_enter(uring->ring_fd, uring->to_submit, 0, 0);
+    if (submitted < 0) {
+        return (errno == EINTR || errno == EAGAIN || errno == EBUSY) ? 0 : -1;
+    }
+    uring->to_submit -= submitted;
+
+    return submitted;
+} /* uring_io_submit() */
+
+int uring_io_wait(uring_io_t *uring)
+{
+    // Completions already waiting, only the replies need to go out
+    if (*uring->cq_head != __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return uring_io_submit(uring) < 0 ? -1 : 0;
+    }
+
+    // Submit the queued replies and wait with the same system call
+    int submitted = sys_io_uring_enter(uring->ring_fd, uring->to_submit, 1, IORING_ENTER_GETEVENTS);
+    if (submitted < 0) {
+        return (errno == EINTR || errno == EAGAIN || errno == EBUSY) ? 0 : -1;
+    }
+    uring->to_submit -= submitted;
+    uring->waits++;
+
+    return 0;
+} /* uring_io_wait() */
+
+int uring_io_next(uring_io_t *uring, uring_io_event_t *event)
+{
+    memset(event, 0, sizeof(*event));
+
+    // The previous datagram has been handled, its buffer can be reused
+    if (uring->pending_bid >= 0) {
+        recycle_buffer(uring, uring->pending_bid);
+        uring->pending_bid = -1;
+    }
+
+    while (1) {
+        unsigned int head = *uring->cq_head;
+        if (head == __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) {
+            return URING_EVENT_NONE;
+        }
+
+        struct io_uring_cqe *cqe = &uring->cqes[head & uring->cq_mask];
+        uint64_t user_data = cqe->user_data;
+        int res = cqe->res;
+        unsigned int flags = cqe->flags;
+        __atomic_store_n(uring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+        switch (URING_USER_TAG(user_data)) {
+        case URING_TAG_SEND:
+            uring->tx_free[uring->tx_free_count++] = URING_USER_INDEX(user_data);
+            if (res >= 0) {
+                uring->tx_datagrams++;
+            }
+            continue;
+
+        case URING_TAG_POLL:
+            if (!(flags & IORING_CQE_F_MORE)) {
+                post_poll(uring);
+            }
+            if (res < 0) {
+                continue;
+            }
+            event->type = URING_EVENT_POLL;
+            return event->type;
+
+        case URING_TAG_RECV:
+            // Multishot receive ends when buffers run out, post it again
+            if (!(flags & IORING_CQE_F_MORE)) {
+                post_recv(uring);
+                uring->rx_rearms++;
+            }
+            if (res < 0 || !(flags & IORING_CQE_F_BUFFER)) {
+                continue;
+            }
+            break;
+
+        default:
+            continue;
+        }
+
+        unsigned int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        char *buf = uring->buffers + (size_t)bid * URING_IO_BUF_SIZE;
+        struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *)buf;
+        size_t header = sizeof(*out) + uring->recv_msg.msg_namelen + uring->recv_msg.msg_controllen;
+
+        uring->pending_bid = bid;
+        if ((size_t)res < header) {
+            continue;
+        }
+
+        long available = res - header;
+        event->type = URING_EVENT_RECV;
+        event->data = buf + header;
+        event->len = (out->payloadlen < (unsigned int)available) ? (long)out->payloadlen : available;
+        event->addr = (struct sockaddr *)(out + 1);
+        event->addr_len = out->namelen;
+        uring->rx_datagrams++;
+
+        return event->type;
+    }
+} /* uring_io_next() */
+
+int uring_io_queue(uring_io_t *uring, const char *packet, size_t len,
+                   const struct sockaddr *addr, socklen_t addr_len)
+{
+    if (len > URING_IO_BUF_SIZE || addr_len > sizeof(struct sockaddr_storage)) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (uring->tx_free_count == 0) {
+        uring->tx_overruns++;
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    unsigned int index = uring->tx_free[--uring->tx_free_count];
+    struct uring_tx_slot *slot = &uring->tx_slots[index];
+    memcpy(slot->buf, packet, len);
+    slot->iov.iov_len = len;
+    memcpy(&slot->addr, addr, addr_len);
+    slot->msg.msg_namelen = addr_len;
+
+    struct io_uring_sqe *sqe = get_sqe(uring);
+    if (!sqe) {
+        uring->tx_free[uring->tx_free_count++] = index;
+        uring->tx_overruns++;
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = uring->sock;
+    sqe->addr = (unsigned long)&slot->msg;
+    sqe->len = 1;
+    sqe->user_data = URING_USER_DATA(URING_TAG_SEND, index);
+
+    return 0;
+} /* uring_io_queue() */